@@ -0,0 +1,402 @@
+/*
+
+  Old School Command Line Logger - Benchmark
+
+  Builds a synthetic log and times the logger's own code paths on it:
+  logging contacts, loading them back, award status, view queries,
+  note searches, both exports and matching QSL confirmations.
+  Results are printed one JSON object per line so they can be kept and
+  compared from version to version.
+
+  How to compile:
+
+  gcc -O2 bench.c -o bench -lsqlite3 -lpthread
+
+  How to run:
+
+  ./bench [-n contacts] [-d database] [-s seed] [-k]
+
+*/
+
+#define LOGGER_NO_MAIN
+#include "logger.c"
+
+#define BENCH_DEFAULT_CONTACTS 100000
+#define BENCH_DEFAULT_DB "bench_logger.db"
+#define BENCH_SYNC_CONTACTS 200         // Contacts logged one commit at a time, as at the keyboard
+#define BENCH_CONTEST_CONTACTS 10000    // Contacts logged in contest mode
+#define BENCH_LOADS 10000
+#define BENCH_VIEWS 200
+#define BENCH_FIRST_DAY 19723           // 2024-01-01, in days since 1970
+#define BENCH_DAYS 365
+
+// Prefixes to build callsigns from, repeated to weight them roughly like a real log
+static const char *bench_prefixes[] = {
+    "K", "K", "K", "W", "W", "W", "N", "N", "AA", "KB", "KD", "WA",
+    "VE", "VA", "DL", "DL", "G", "M", "F", "I", "EA", "PA", "ON", "OK",
+    "SP", "HA", "YO", "9A", "S5", "OH", "SM", "LA", "UA", "UR", "JA", "JA",
+    "VK", "ZL", "PY", "LU", "CE", "ZS", "XE", "KH6", "KL7", "EI", "GM", "HB9"
+};
+
+// Bands the generator uses, with their CW, digital and phone frequencies in kHz
+typedef struct {
+    int cw_low;
+    int digital;
+    int phone_low;
+    int phone_high;
+} BenchBand;
+
+static const BenchBand bench_bands[] = {
+    { 1800, 1840, 1843, 2000 },
+    { 3500, 3573, 3600, 4000 },
+    { 7000, 7074, 7125, 7300 },
+    { 10100, 10136, 0, 0 },
+    { 14000, 14074, 14150, 14350 },
+    { 18068, 18100, 18110, 18168 },
+    { 21000, 21074, 21200, 21450 },
+    { 24890, 24915, 24930, 24990 },
+    { 28000, 28074, 28300, 29700 }
+};
+
+// One timed code path: how many operations, how long in total, and each one's latency
+typedef struct {
+    const char *name;
+    long long operations;
+    long long rows;
+    long long total_us;
+    long long *latency_us;
+    long long latency_count;
+} BenchResult;
+
+static unsigned long long bench_state = 88172645463325252ULL;
+static FILE *bench_results;
+static long long bench_contacts;
+
+// Function to draw the next pseudo random number (xorshift64), so runs with one seed match
+static unsigned long long bench_random(void) {
+    bench_state ^= bench_state << 13;
+    bench_state ^= bench_state >> 7;
+    bench_state ^= bench_state << 17;
+    return bench_state;
+}
+
+// Function to draw a pseudo random number from 0 to limit - 1
+static int bench_below(int limit) {
+    return (int)(bench_random() % (unsigned long long)limit);
+}
+
+// Function to fill in a synthetic but realistic contact
+static void bench_make_contact(Contact *contact) {
+    static const char *modes[] = { "CW", "CW", "CW", "SSB", "SSB", "SSB", "FT8", "FT8", "RTTY", "FM" };
+    static const char *notes[] = { "", "", "", "", "", "", "", "nice signal", "QSB", "name Bob" };
+    const BenchBand *band = &bench_bands[bench_below(sizeof(bench_bands) / sizeof(bench_bands[0]))];
+    const char *mode = modes[bench_below(sizeof(modes) / sizeof(modes[0]))];
+    int khz;
+
+    memset(contact, 0, sizeof(*contact));
+
+    // Prefix, call area digit and a one to three letter suffix
+    int length = snprintf(contact->callsign_worked, sizeof(contact->callsign_worked), "%s%d",
+                          bench_prefixes[bench_below(sizeof(bench_prefixes) / sizeof(bench_prefixes[0]))],
+                          bench_below(10));
+    for (int letters = 1 + bench_below(3); letters > 0; letters--) {
+        contact->callsign_worked[length++] = 'A' + bench_below(26);
+    }
+    contact->callsign_worked[length] = '\0';
+
+    if (strcmp(mode, "CW") == 0 || band->phone_low == 0) {
+        mode = "CW";
+        khz = band->cw_low + bench_below(60);
+    } else if (strcmp(mode, "FT8") == 0 || strcmp(mode, "RTTY") == 0) {
+        khz = band->digital + (mode[0] == 'R' ? 10 + bench_below(10) : 0);
+    } else {
+        khz = band->phone_low + bench_below(band->phone_high - band->phone_low);
+    }
+
+    // Frequencies are typed both ways, like in real logs: 14025 (kHz) or 14.250 (MHz)
+    if (bench_below(2)) {
+        snprintf(contact->frequency, sizeof(contact->frequency), "%d", khz);
+    } else {
+        snprintf(contact->frequency, sizeof(contact->frequency), "%d.%03d", khz / 1000, khz % 1000);
+    }
+    snprintf(contact->mode, sizeof(contact->mode), "%s", mode);
+
+    if (strcmp(mode, "FT8") == 0) {
+        snprintf(contact->sent_report, sizeof(contact->sent_report), "%d", -20 + bench_below(30));
+        snprintf(contact->received_report, sizeof(contact->received_report), "%d", -20 + bench_below(30));
+    } else {
+        const char *report = mode[0] == 'S' || mode[0] == 'F' ? "59" : "599";
+        snprintf(contact->sent_report, sizeof(contact->sent_report), "%s", report);
+        snprintf(contact->received_report, sizeof(contact->received_report), "%s", report);
+    }
+
+    // Spread over a year, with times typed as HH:MM or HH:MM:SS
+    int year, month, day;
+    civil_from_days(BENCH_FIRST_DAY + bench_below(BENCH_DAYS), &year, &month, &day);
+    snprintf(contact->contact_date, sizeof(contact->contact_date), "%04d-%02d-%02d", year, month, day);
+    if (bench_below(2)) {
+        snprintf(contact->contact_time, sizeof(contact->contact_time), "%02d:%02d", bench_below(24), bench_below(60));
+    } else {
+        snprintf(contact->contact_time, sizeof(contact->contact_time), "%02d:%02d:%02d",
+                 bench_below(24), bench_below(60), bench_below(60));
+    }
+    snprintf(contact->comment, sizeof(contact->comment), "%s", notes[bench_below(sizeof(notes) / sizeof(notes[0]))]);
+}
+
+// Function to compare two latencies for qsort
+static int bench_compare(const void *a, const void *b) {
+    long long left = *(const long long *)a, right = *(const long long *)b;
+    return left < right ? -1 : left > right;
+}
+
+// Function to start timing a code path that will run up to count times
+static void bench_start(BenchResult *result, const char *name, long long count) {
+    memset(result, 0, sizeof(*result));
+    result->name = name;
+    result->latency_us = count > 0 ? malloc(count * sizeof(long long)) : NULL;
+}
+
+// Function to record one timed operation
+static void bench_record(BenchResult *result, long long started_us, long long rows) {
+    long long elapsed = monotonic_us() - started_us;
+    result->operations++;
+    result->rows += rows;
+    result->total_us += elapsed;
+    if (result->latency_us) {
+        result->latency_us[result->latency_count++] = elapsed;
+    }
+}
+
+// Function to print a result as one line of JSON and free it
+static void bench_report(BenchResult *result) {
+    double seconds = result->total_us / 1e6;
+    fprintf(bench_results, "{\"bench\":\"%s\",\"version\":\"%s\",\"sqlite\":\"%s\",\"contacts\":%lld,"
+            "\"operations\":%lld,\"rows\":%lld,\"seconds\":%.6f,\"ops_per_sec\":%.1f,\"rows_per_sec\":%.1f",
+            result->name, CODE_VERSION, sqlite3_libversion(), bench_contacts,
+            result->operations, result->rows, seconds,
+            seconds > 0 ? result->operations / seconds : 0.0, seconds > 0 ? result->rows / seconds : 0.0);
+
+    if (result->latency_count > 0) {
+        qsort(result->latency_us, result->latency_count, sizeof(long long), bench_compare);
+        fprintf(bench_results, ",\"mean_us\":%.1f,\"p50_us\":%lld,\"p99_us\":%lld,\"max_us\":%lld",
+                (double)result->total_us / result->operations,
+                result->latency_us[result->latency_count / 2],
+                result->latency_us[result->latency_count * 99 / 100],
+                result->latency_us[result->latency_count - 1]);
+    }
+    fprintf(bench_results, "}\n");
+    fflush(bench_results);
+    free(result->latency_us);
+}
+
+// Function to log count synthetic contacts, timing each one
+static int bench_log_contacts(LoggerSession *session, const char *name, long long count) {
+    BenchResult result;
+    Contact contact;
+
+    bench_start(&result, name, count);
+    for (long long i = 0; i < count; i++) {
+        bench_make_contact(&contact);
+        long long started_us = monotonic_us();
+        if (log_contact(session, &contact) != SQLITE_OK) {
+            free(result.latency_us);
+            return SQLITE_ERROR;
+        }
+        bench_record(&result, started_us, 1);
+    }
+
+    // Whatever contest or batch mode still holds is part of the cost
+    long long started_us = monotonic_us();
+    int rc = flush_group_commit(session);
+    result.total_us += monotonic_us() - started_us;
+    bench_report(&result);
+    return rc;
+}
+
+// Function to time a view command run count times, with fixed parameters or random one-day ranges
+static void bench_views(LoggerSession *session, const char *name, long long count, const char *fixed_params) {
+    BenchResult result;
+    char params[INPUT_BUFFER_SIZE];
+
+    bench_start(&result, name, count);
+    for (long long i = 0; i < count; i++) {
+        if (fixed_params) {
+            snprintf(params, sizeof(params), "%s", fixed_params);
+        } else {
+            // A one-day range somewhere in the log
+            int year, month, day;
+            civil_from_days(BENCH_FIRST_DAY + bench_below(BENCH_DAYS), &year, &month, &day);
+            snprintf(params, sizeof(params), "from=%04d-%02d-%02d to=%04d-%02d-%02d sort=time",
+                     year, month, day, year, month, day);
+        }
+        long long started_us = monotonic_us();
+        view_contacts(session, params);
+        fflush(stdout);
+        bench_record(&result, started_us, session->view.page_size);
+    }
+    bench_report(&result);
+}
+
+// Function to time one export to a scratch file
+static void bench_export(LoggerSession *session, const char *name, const char *file_name, ExportFormat format) {
+    BenchResult result;
+
+    bench_start(&result, name, 1);
+    long long started_us = monotonic_us();
+    if (export_log(session, file_name, format, NULL) == SQLITE_OK) {
+        fflush(stdout);
+        bench_record(&result, started_us, bench_contacts);
+        bench_report(&result);
+    } else {
+        fprintf(stderr, "Export to '%s' failed.\n", file_name);
+        free(result.latency_us);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    const char *db_name = BENCH_DEFAULT_DB;
+    int keep = 0;
+    bench_contacts = BENCH_DEFAULT_CONTACTS;
+
+    // Handle the command line options
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            bench_contacts = atoll(argv[++i]);
+        } else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+            db_name = argv[++i];
+        } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            bench_state = strtoull(argv[++i], NULL, 10) | 1;
+        } else if (strcmp(argv[i], "-k") == 0) {
+            keep = 1;
+        } else {
+            fprintf(stderr, "Usage: %s [-n contacts] [-d database] [-s seed] [-k]\n", argv[0]);
+            fprintf(stderr, "  -n  Size of the synthetic log (default %d)\n", BENCH_DEFAULT_CONTACTS);
+            fprintf(stderr, "  -d  Database file to build, replaced if it exists (default %s)\n", BENCH_DEFAULT_DB);
+            fprintf(stderr, "  -s  Random seed, so runs can be repeated exactly\n");
+            fprintf(stderr, "  -k  Keep the database and export files afterwards\n");
+            return 1;
+        }
+    }
+    if (bench_contacts < BENCH_SYNC_CONTACTS + BENCH_CONTEST_CONTACTS) {
+        bench_contacts = BENCH_SYNC_CONTACTS + BENCH_CONTEST_CONTACTS;
+    }
+
+    char csv_file[512], adif_file[512], journal[512];
+    snprintf(csv_file, sizeof(csv_file), "%s.csv", db_name);
+    snprintf(adif_file, sizeof(adif_file), "%s.adi", db_name);
+    snprintf(journal, sizeof(journal), "%s-journal", db_name);
+    unlink(db_name);
+    unlink(journal);
+
+    // Results go to the real standard output; the logger's own messages are thrown away
+    bench_results = fdopen(dup(STDOUT_FILENO), "w");
+    int null_fd = open("/dev/null", O_WRONLY);
+    if (bench_results == NULL || null_fd < 0) {
+        fprintf(stderr, "Cannot set up output.\n");
+        return 1;
+    }
+    fflush(stdout);
+    dup2(null_fd, STDOUT_FILENO);
+    close(null_fd);
+
+    LoggerSession session;
+    if (initialize_database(db_name) != SQLITE_OK || open_session(&session, db_name) != SQLITE_OK) {
+        fprintf(stderr, "Failed to create the benchmark database '%s'.\n", db_name);
+        return 1;
+    }
+
+    // Fill most of the log the fastest way, as a batch, then log the rest in contest mode
+    // and finally one commit per contact, as the operator would at the keyboard
+    long long bulk = bench_contacts - BENCH_SYNC_CONTACTS - BENCH_CONTEST_CONTACTS;
+    session.batch_mode = 1;
+    int rc = bench_log_contacts(&session, "log_contact_batch", bulk);
+    session.batch_mode = 0;
+    if (rc == SQLITE_OK && set_contest_mode(&session, 1) == SQLITE_OK) {
+        rc = bench_log_contacts(&session, "log_contact_contest", BENCH_CONTEST_CONTACTS);
+    }
+    if (rc == SQLITE_OK && set_contest_mode(&session, 0) == SQLITE_OK) {
+        rc = bench_log_contacts(&session, "log_contact", BENCH_SYNC_CONTACTS);
+    }
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "Logging contacts failed.\n");
+        close_session(&session);
+        return 1;
+    }
+
+    // Start-up cost on a log this size: opening the session builds the dupe index
+    BenchResult result;
+    bench_start(&result, "open_session", 1);
+    close_session(&session);
+    long long started_us = monotonic_us();
+    if (open_session(&session, db_name) != SQLITE_OK) {
+        fprintf(stderr, "Failed to reopen '%s'.\n", db_name);
+        return 1;
+    }
+    bench_record(&result, started_us, bench_contacts);
+    bench_report(&result);
+
+    // Loading random contacts, as 'u' does
+    Contact contact;
+    bench_start(&result, "load_contact", BENCH_LOADS);
+    for (int i = 0; i < BENCH_LOADS; i++) {
+        int id = 1 + bench_below((int)bench_contacts);
+        started_us = monotonic_us();
+        load_contact(&session, id, &contact);
+        bench_record(&result, started_us, 1);
+    }
+    bench_report(&result);
+
+    // Award status of random contacts, as 'c' shows it
+    bench_start(&result, "award_status", BENCH_LOADS);
+    for (int i = 0; i < BENCH_LOADS; i++) {
+        load_contact(&session, 1 + bench_below((int)bench_contacts), &contact);
+        started_us = monotonic_us();
+        display_award_status(&session, &contact);
+        bench_record(&result, started_us, 1);
+    }
+    bench_report(&result);
+
+    // View queries: first pages of date ranges and searches, then paging through a listing
+    bench_views(&session, "view_date_range", BENCH_VIEWS, NULL);
+    bench_views(&session, "view_band_mode", BENCH_VIEWS, "band=20m mode=CW");
+    bench_views(&session, "view_first_page", BENCH_VIEWS, "");
+    bench_views(&session, "view_next_page", BENCH_VIEWS, "next");
+    bench_views(&session, "view_prev_page", BENCH_VIEWS, "prev");
+    view_contacts(&session, "-20");
+    bench_views(&session, "view_next_page_from_end", BENCH_VIEWS, "next");
+
+    // Note searches, each one ranking every note that matches
+    static const char *searches[] = { "signal", "QSB", "bob", "nic*", "nice OR name" };
+    bench_start(&result, "note_search", BENCH_VIEWS);
+    for (int i = 0; i < BENCH_VIEWS; i++) {
+        started_us = monotonic_us();
+        search_notes(&session, searches[i % (int)(sizeof(searches) / sizeof(searches[0]))]);
+        fflush(stdout);
+        bench_record(&result, started_us, NOTE_SEARCH_LIMIT);
+    }
+    bench_report(&result);
+
+    bench_export(&session, "export_csv", csv_file, EXPORT_CSV);
+    bench_export(&session, "export_adif", adif_file, EXPORT_ADIF);
+
+    // The ADIF export read back as a file of QSL confirmations, every one of which has its contact
+    bench_start(&result, "qsl_match", 1);
+    started_us = monotonic_us();
+    if (import_confirmations(&session, adif_file, QSL_MATCH_MINUTES) == SQLITE_OK) {
+        bench_record(&result, started_us, bench_contacts);
+        bench_report(&result);
+    } else {
+        fprintf(stderr, "Matching confirmations from '%s' failed.\n", adif_file);
+        free(result.latency_us);
+    }
+
+    close_session(&session);
+    if (!keep) {
+        unlink(db_name);
+        unlink(journal);
+        unlink(csv_file);
+        unlink(adif_file);
+    }
+    fclose(bench_results);
+    return 0;
+}
@@ -0,0 +1,219 @@
+/*
+
+  Old School Command Line Logger - fake rigctld
+
+  Stands in for hamlib's rigctld (and a radio) when trying out the logger's
+  rig polling: answers the f, m, F and M commands over TCP the way rigctld
+  does, can retune itself every so often as an operator would, and can be
+  made slow or made to stop answering altogether, to see that the logger's
+  prompt doesn't wait on it.
+
+  How to compile:
+
+  gcc -O2 fake_rigctld.c -o fake_rigctld
+
+  How to run (then ./logger -r, or 'R on' in the logger):
+
+  ./fake_rigctld [-p port] [-t seconds] [-d ms] [-s]
+
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#define FAKE_DEFAULT_PORT 4532
+#define FAKE_MAX_CLIENTS 16
+
+// Where the fake rig is tuned, stepped through in turn with -t
+typedef struct {
+    long long hz;
+    const char *mode;
+    int passband;
+} FakeSetting;
+
+static const FakeSetting fake_settings[] = {
+    { 14074000, "PKTUSB", 3000 },
+    { 14025000, "CW", 500 },
+    { 14250000, "USB", 2400 },
+    { 7030000, "CW", 500 },
+    { 7185000, "LSB", 2400 },
+    { 3573000, "PKTUSB", 3000 },
+    { 21300000, "USB", 2400 },
+    { 28074000, "PKTUSB", 3000 }
+};
+#define FAKE_SETTING_COUNT (sizeof(fake_settings) / sizeof(fake_settings[0]))
+
+// A connected client and the part of a command line it has sent so far
+typedef struct {
+    int fd;
+    char line[256];
+    size_t used;
+} FakeClient;
+
+static long long fake_hz = 14074000;
+static char fake_mode[16] = "PKTUSB";
+static int fake_passband = 3000;
+
+// Function to get a monotonic time in milliseconds
+static long long fake_now_ms(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000LL + now.tv_nsec / 1000000;
+}
+
+// Function to answer one command line the way rigctld does
+static void fake_answer(int fd, char *command, int delay_ms) {
+    char answer[128];
+    char mode[16];
+    long long hz;
+    int passband;
+
+    command[strcspn(command, "\r\n")] = '\0';
+    if (strcmp(command, "f") == 0 || strcmp(command, "\\get_freq") == 0) {
+        snprintf(answer, sizeof(answer), "%lld\n", fake_hz);
+    } else if (strcmp(command, "m") == 0 || strcmp(command, "\\get_mode") == 0) {
+        snprintf(answer, sizeof(answer), "%s\n%d\n", fake_mode, fake_passband);
+    } else if (sscanf(command, "F %lld", &hz) == 1 && hz > 0) {
+        fake_hz = hz;
+        snprintf(answer, sizeof(answer), "RPRT 0\n");
+    } else if (sscanf(command, "M %15s %d", mode, &passband) == 2) {
+        snprintf(fake_mode, sizeof(fake_mode), "%s", mode);
+        fake_passband = passband;
+        snprintf(answer, sizeof(answer), "RPRT 0\n");
+    } else if (command[0] == '\0') {
+        return;
+    } else {
+        snprintf(answer, sizeof(answer), "RPRT -11\n"); // Feature not available
+    }
+
+    // A slow rig (or a slow serial link to it) holds up every answer
+    if (delay_ms > 0) {
+        struct timespec pause = { delay_ms / 1000, (delay_ms % 1000) * 1000000L };
+        nanosleep(&pause, NULL);
+    }
+    ssize_t ignored = send(fd, answer, strlen(answer), MSG_NOSIGNAL);
+    (void)ignored;
+}
+
+int main(int argc, char *argv[]) {
+    int port = FAKE_DEFAULT_PORT;
+    double retune_seconds = 0;
+    int delay_ms = 0;
+    int silent = 0;
+
+    // Handle the command line options
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+            port = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            retune_seconds = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+            delay_ms = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-s") == 0) {
+            silent = 1;
+        } else {
+            fprintf(stderr, "Usage: %s [-p port] [-t seconds] [-d ms] [-s]\n", argv[0]);
+            fprintf(stderr, "  -p  TCP port to listen on (default %d)\n", FAKE_DEFAULT_PORT);
+            fprintf(stderr, "  -t  Retune to the next frequency and mode every so many seconds\n");
+            fprintf(stderr, "  -d  Wait this many milliseconds before each answer, like a slow rig\n");
+            fprintf(stderr, "  -s  Accept connections but never answer, like a rig that has hung\n");
+            return 1;
+        }
+    }
+
+    int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    int reuse = 1;
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons((unsigned short)port);
+    if (listen_fd < 0 ||
+        setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) != 0 ||
+        bind(listen_fd, (struct sockaddr *)&address, sizeof(address)) != 0 ||
+        listen(listen_fd, 4) != 0) {
+        fprintf(stderr, "Cannot listen on TCP port %d: %s\n", port, strerror(errno));
+        return 1;
+    }
+    printf("Fake rigctld on port %d: %lld Hz %s%s.\n", port, fake_hz, fake_mode, silent ? " (not answering)" : "");
+    fflush(stdout);
+
+    FakeClient clients[FAKE_MAX_CLIENTS];
+    int client_count = 0;
+    size_t setting = 0;
+    long long next_retune_ms = retune_seconds > 0 ? fake_now_ms() + (long long)(retune_seconds * 1000) : -1;
+
+    while (1) {
+        struct pollfd pfds[1 + FAKE_MAX_CLIENTS];
+        pfds[0] = (struct pollfd){ listen_fd, POLLIN, 0 };
+        for (int i = 0; i < client_count; i++) {
+            pfds[i + 1] = (struct pollfd){ clients[i].fd, POLLIN, 0 };
+        }
+        int timeout_ms = -1;
+        if (next_retune_ms >= 0) {
+            long long remaining_ms = next_retune_ms - fake_now_ms();
+            timeout_ms = remaining_ms > 0 ? (int)remaining_ms : 0;
+        }
+        if (poll(pfds, 1 + client_count, timeout_ms) < 0 && errno != EINTR) {
+            perror("poll");
+            return 1;
+        }
+
+        // Turn the dial, as the operator would
+        if (next_retune_ms >= 0 && fake_now_ms() >= next_retune_ms) {
+            setting = (setting + 1) % FAKE_SETTING_COUNT;
+            fake_hz = fake_settings[setting].hz;
+            snprintf(fake_mode, sizeof(fake_mode), "%s", fake_settings[setting].mode);
+            fake_passband = fake_settings[setting].passband;
+            next_retune_ms += (long long)(retune_seconds * 1000);
+            printf("Retuned to %lld Hz %s.\n", fake_hz, fake_mode);
+            fflush(stdout);
+        }
+
+        for (int i = 0; i < client_count; i++) {
+            if (!(pfds[i + 1].revents & (POLLIN | POLLHUP | POLLERR))) {
+                continue;
+            }
+            FakeClient *client = &clients[i];
+            ssize_t count = recv(client->fd, client->line + client->used, sizeof(client->line) - 1 - client->used, 0);
+            int overlong = count > 0 && client->used + (size_t)count == sizeof(client->line) - 1 &&
+                           !memchr(client->line, '\n', client->used + (size_t)count);
+            if (count <= 0 || overlong) {
+                close(client->fd);
+                clients[i] = clients[--client_count];
+                pfds[i + 1] = pfds[client_count + 1];
+                i--;
+                continue;
+            }
+            client->used += count;
+
+            // Answer each complete command line
+            char *newline;
+            while ((newline = memchr(client->line, '\n', client->used)) != NULL) {
+                *newline = '\0';
+                if (!silent) {
+                    fake_answer(client->fd, client->line, delay_ms);
+                }
+                size_t length = (size_t)(newline - client->line) + 1;
+                memmove(client->line, newline + 1, client->used - length);
+                client->used -= length;
+            }
+        }
+
+        if (pfds[0].revents & POLLIN) {
+            int fd = accept(listen_fd, NULL, NULL);
+            if (fd >= 0 && client_count < FAKE_MAX_CLIENTS) {
+                clients[client_count++] = (FakeClient){ fd, "", 0 };
+            } else if (fd >= 0) {
+                close(fd);
+            }
+        }
+    }
+}
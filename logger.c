@@ -7,7 +7,7 @@
 
   How to compile:
 
-  gcc logger.c -o logger -lsqlite3
+  gcc logger.c -o logger -lsqlite3 -lpthread
 
   How to run:
 
@@ -20,11 +20,133 @@
 #include <stdlib.h>
 #include <time.h>
 #include <ctype.h>  // For toupper
+#include <stddef.h> // For offsetof
+#include <stdint.h>
+#include <errno.h>
+#include <limits.h> // For LLONG_MIN
+#include <fcntl.h>
+#include <poll.h>   // For waiting on input with a timeout
+#include <pthread.h> // For the UDP listener thread
+#include <signal.h> // For stopping the logging daemon cleanly
+#include <stdatomic.h>
+#include <strings.h> // For strncasecmp
+#include <unistd.h> // For read
+#include <sys/mman.h> // For memory mapping files
+#include <sys/stat.h>
+#include <sys/socket.h> // For the UDP listener and the logging daemon
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
 #include <sqlite3.h> // For SQLite3 database functions
 
-#define INPUT_BUFFER_SIZE 256
+#define INPUT_BUFFER_SIZE 1024
+#define NOTE_SIZE 1024
 #define CODE_VERSION "2024.12.14.16.01"
 
+// Size of the output buffer used by the CSV and ADIF export engine
+#define EXPORT_BUFFER_SIZE (1024 * 1024)
+
+// Parallel export of big logs: the most worker threads, how many IDs a log must span before it's
+// split between them, the IDs in each range a worker formats at a time, and how many ranges each
+// worker may get ahead of the file
+#define EXPORT_MAX_THREADS 8
+#define EXPORT_PARALLEL_MIN_IDS 100000
+#define EXPORT_CHUNK_IDS 16384
+#define EXPORT_CHUNKS_AHEAD 4
+
+// A date/time that can't be read, in seconds since 1970; any other value, before 1970 too, is a real time
+#define NO_EPOCH LLONG_MIN
+
+// How often ADIF import reports its progress, in records
+#define IMPORT_PROGRESS_INTERVAL 50000
+
+// QSL confirmation matching: how far apart the logged and confirmed times may be, in minutes,
+// and how many unmatched or ambiguous confirmations to list
+#define QSL_MATCH_MINUTES 30
+#define QSL_REPORT_LIMIT 10
+
+// UDP listener for QSOs logged by WSJT-X, JTDX and the like: default port, the size of the queue
+// between the listener thread and the writer (a power of two), and how many recent QSOs are
+// remembered to spot the same one arriving twice
+#define UDP_DEFAULT_PORT 2237
+#define UDP_QUEUE_SIZE 1024
+#define UDP_RECENT_QSOS 16
+#define UDP_RECEIVE_BUFFER (1024 * 1024)
+#define UDP_LISTED_QSOS 5
+#define WSJTX_MAGIC 0xadbccbdaU
+
+// Rig control through rigctld (hamlib's network rig daemon, or anything that speaks its protocol):
+// where it usually listens, the poll interval while the rig is being tuned and once it has settled,
+// how long to wait for it to connect or answer, and the longest wait between tries when it's missing
+#define RIG_DEFAULT_ADDRESS "localhost:4532"
+#define RIG_POLL_MIN_MS 100
+#define RIG_POLL_MAX_MS 2000
+#define RIG_TIMEOUT_MS 1000
+#define RIG_RETRY_MAX_MS 10000
+
+// Multi-operator logging daemon: the address it listens on unless told otherwise (a Unix-domain
+// socket file; a port number or host:port means TCP), how many positions can connect, the most
+// requests written in one group commit, and how long a position waits for the daemon to answer
+#define DAEMON_DEFAULT_ADDRESS "logger.sock"
+#define DAEMON_MAX_POSITIONS 64
+#define DAEMON_BATCH_SIZE 256
+#define DAEMON_LINE_SIZE (NOTE_SIZE + 512)
+#define DAEMON_MAX_BACKLOG (16 * 1024 * 1024)
+#define DAEMON_REPLY_TIMEOUT_MS 10000
+
+// How many note search matches to list
+#define NOTE_SEARCH_LIMIT 20
+
+// Contest mode group commit defaults: flush after this many contacts or this many milliseconds
+#define DEFAULT_GROUP_COMMIT_QSOS 10
+#define DEFAULT_GROUP_COMMIT_MS 1000
+
+// Country file: the cty.dat text and the binary prefix trie image built from it
+#define CTY_TEXT_FILE "cty.dat"
+#define CTY_IMAGE_FILE "cty.bin"
+#define CTY_IMAGE_MAGIC "OSLCTY1"
+
+// Log archives: the columnar file A writes and reads, with a column for each of the contacts table's
+#define ARCHIVE_MAGIC "OSLARC2"
+#define ARCHIVE_COLUMN_COUNT 21
+#define ARCHIVE_FIRST_YEAR 1900 // Years a scan counts QSOs by
+#define ARCHIVE_LAST_YEAR 2100
+
+// Super Check Partial: master callsign file and how many matches to list
+#define SCP_FILE "MASTER.SCP"
+#define SCP_MAX_LISTED 40
+#define SCP_SYMBOLS 37 // A-Z, 0-9 and '/'
+
+// Starting number of slots in the in-memory dupe index (always a power of two)
+#define DUPE_INDEX_INITIAL_CAPACITY 4096
+
+// Contest scoring: starting number of slots in its station and multiplier tables (a power of two),
+// and how many kinds of multiplier one contest can have
+#define CONTEST_TABLE_INITIAL_CAPACITY 1024
+#define CONTEST_MAX_MULTS 2
+
+// Statistics: HyperLogLog registers per unique-call estimate (16384, for about 1%), modes listed
+// by name, starting slots for the minutes with QSOs (a power of two), and the longest rate sheet
+#define STATS_HLL_BITS 14
+#define STATS_HLL_REGISTERS (1 << STATS_HLL_BITS)
+#define STATS_MAX_MODES 16
+#define STATS_MINUTES_INITIAL_CAPACITY 4096
+#define STATS_RATE_SHEET_HOURS 48
+
+// Page cache for the session's main log, in KB
+#define SESSION_CACHE_KB (32 * 1024)
+
+// Log files: the one opened by default, and how many can be open at once (the main log included)
+#define DEFAULT_LOG_FILE "contacts_logger.db"
+#define MAX_LOGS 8
+
+
+// A read-only file mapped into memory
+typedef struct {
+    const char *data;
+    size_t size;
+} MappedFile;
 
 // Define a structure to hold contact details
 typedef struct {
@@ -35,40 +157,931 @@ typedef struct {
     char mode[20];
     char contact_date[20];
     char contact_time[20];
-    char comment[100];
+    char comment[NOTE_SIZE];
     unsigned int id;
+    char country[40];       // Country file entity, resolved from the callsign
+    char country_prefix[8]; // The entity's primary prefix, e.g. K or DL
+    int cq_zone;
+    int itu_zone;
+    char continent[4];
+    char state[8];          // US state (or other subdivision) for WAS
+    long long serial;       // Serial number sent, or 0 if none was
 } Contact;
 
+// Country file entity, as stored in the binary image
+typedef struct {
+    char name[40];
+    char prefix[8];
+    uint8_t cq_zone;
+    uint8_t itu_zone;
+    char continent[2];
+    float latitude;
+    float longitude;
+    float utc_offset;
+} CtyEntity;
+
+// What a prefix or exact callsign resolves to: an entity plus any zone/continent overrides
+typedef struct {
+    uint16_t entity;
+    uint8_t cq_zone;
+    uint8_t itu_zone;
+    char continent[2];
+    uint16_t reserved;
+} CtyRecord;
+
+// Prefix trie node. A node's children are stored next to each other, sorted by symbol.
+typedef struct {
+    uint32_t first_child;
+    uint16_t child_count;
+    char symbol;
+    uint8_t reserved;
+    int32_t prefix_record;  // Record for calls starting with this prefix, or -1
+    int32_t exact_record;   // Record for a callsign exactly equal to this path, or -1
+} CtyNode;
+
+// Header of the binary country file image, followed by the entity, record and node arrays
+typedef struct {
+    char magic[8];
+    uint32_t entity_count;
+    uint32_t record_count;
+    uint32_t node_count;
+    uint32_t reserved;
+} CtyImageHeader;
+
+// A country file image mapped into memory
+typedef struct {
+    MappedFile image;
+    const CtyEntity *entities;
+    const CtyRecord *records;
+    const CtyNode *nodes;
+    uint32_t entity_count;
+    uint32_t node_count;
+} CountryFile;
+
+// How a column is stored in a log archive.  Dictionary codes are 0 for NULL and 1 for the first
+// entry, so a column with few distinct values takes a byte a row.
+typedef enum {
+    ARCHIVE_DELTA,          // Integers: a bitmap of the NULLs, then zigzag varint differences from the last value
+    ARCHIVE_TEXT,           // Dictionary of the distinct strings, then a code for each row
+    ARCHIVE_INTEGER,        // Dictionary of the distinct integers, then a code for each row
+    ARCHIVE_DATE_TIME       // Like ARCHIVE_TEXT, but codes 1 and 2 are the row's qso_epoch as YYYY-MM-DD HH:MM[:SS]
+} ArchiveEncoding;
+
+// Where one column is in a log archive.  Sections start on 8-byte boundaries, so the dictionaries
+// and codes can be used in place once the file is mapped.
+typedef struct {
+    char name[24];
+    uint32_t encoding;
+    uint32_t code_width;    // Bytes in each row's dictionary code: 1, 2 or 4
+    uint64_t entry_count;   // Dictionary entries, or bytes of varints for ARCHIVE_DELTA
+    uint64_t offset;        // From the start of the file
+    uint64_t size;
+} ArchiveColumn;
+
+// Header of a log archive, followed by the columns' sections
+typedef struct {
+    char magic[8];
+    uint64_t row_count;
+    uint32_t column_count;
+    uint32_t reserved;
+    uint64_t id_sequence;   // Highest ID the log had ever given out, deleted contacts' included
+    ArchiveColumn columns[ARCHIVE_COLUMN_COUNT];
+} ArchiveHeader;
+
+// A log archive mapped into memory
+typedef struct {
+    MappedFile image;
+    const ArchiveHeader *header;
+} LogArchive;
+
+// Reads one column of a mapped log archive, a row at a time
+typedef struct {
+    const ArchiveColumn *column;
+    const uint64_t *string_offsets; // Dictionary of an ARCHIVE_TEXT or ARCHIVE_DATE_TIME column
+    const char *strings;
+    const int64_t *values;          // Dictionary of an ARCHIVE_INTEGER column
+    const unsigned char *codes;
+    uint64_t max_code;
+    const uint64_t *nulls;          // ARCHIVE_DELTA column
+    const unsigned char *next;
+    const unsigned char *end;
+    long long previous;
+    uint64_t row;
+} ArchiveCursor;
+
+// A column being built for a log archive: its dictionary and the rows' codes, or its varints
+typedef struct {
+    unsigned char *bytes;           // Dictionary strings one after another, or varints
+    size_t bytes_used;
+    size_t bytes_capacity;
+    uint64_t *string_offsets;       // Where each string starts in bytes, plus where the last one ends
+    int64_t *values;
+    size_t entry_count;
+    size_t entry_capacity;
+    uint32_t *slots;                // Hash table of entry numbers plus one, 0 for an empty slot
+    size_t slot_capacity;
+    uint32_t *codes;
+    uint64_t *nulls;
+    long long previous;
+} ArchiveBuilder;
+
+// Identifiers for the statements kept in the session's prepared statement cache
+typedef enum {
+    STMT_INSERT_CONTACT,
+    STMT_UPDATE_CONTACT,
+    STMT_DELETE_CONTACT,
+    STMT_SELECT_CONTACT,
+    STMT_SELECT_ALL_CONTACTS,
+    STMT_BEGIN,
+    STMT_COMMIT,
+    STMT_SELECT_CALLSIGN_BY_ID,
+    STMT_SELECT_CALLSIGN_HISTORY,
+    STMT_COUNT_RECENT,
+    STMT_SELECT_MAX_ID,
+    STMT_SELECT_WORKED,
+    STMT_AWARD_STATUS,
+    STMT_SELECT_CONTACT_ROW,
+    STMT_COUNT
+} StatementId;
+
+// Super Check Partial index: every known callsign, sorted, with an inverted index from
+// each two- and three-character sequence to the callsigns containing it
+typedef struct {
+    char *names;            // Callsigns, NUL separated
+    uint32_t *calls;        // Offset of each callsign in names, in sorted order
+    uint8_t *in_log;        // Non-zero if the callsign has been worked
+    uint32_t call_count;
+    uint32_t *gram_start;   // Postings for gram g are gram_calls[gram_start[g] .. gram_start[g + 1])
+    uint32_t *gram_calls;
+    char (*recent)[sizeof(((Contact *)0)->callsign_worked)]; // Callsigns logged since the index was built, scanned directly
+    size_t recent_count;
+    size_t recent_capacity;
+    char scp_file[256];     // Master callsign file the index was built from, if any
+} PartialIndex;
+
+// Mode groups used for dupe checking; contests count SSB, USB, LSB, AM and FM as one phone mode
+typedef enum {
+    MODE_CW,
+    MODE_PHONE,
+    MODE_DIGITAL,
+    MODE_NONE,
+    MODE_CATEGORY_COUNT
+} ModeCategory;
+
+// Awards tracked in the award_credits table, which names them as in award_names
+typedef enum {
+    AWARD_DXCC,
+    AWARD_WAS,
+    AWARD_WPX,
+    AWARD_COUNT
+} AwardId;
+
+static const char *award_names[AWARD_COUNT] = { "DXCC", "WAS", "WPX" };
+
+// One station in the dupe index, with a bit per band it has been worked on for each mode group
+typedef struct {
+    char callsign[sizeof(((Contact *)0)->callsign_worked)]; // Normalized callsign, empty for an unused slot
+    unsigned int hash;
+    unsigned int worked[MODE_CATEGORY_COUNT]; // Bit n is bands[n]; bit BAND_COUNT is an unknown band
+} DupeEntry;
+
+// Open-addressing hash table of stations worked, keyed by normalized callsign
+typedef struct {
+    DupeEntry *entries;
+    size_t capacity;
+    size_t used;
+} DupeIndex;
+
+// How a contest counts QSO points
+typedef enum {
+    POINTS_CQWW,            // 3 between continents, 1 within one (2 between North American countries), 0 within a country
+    POINTS_WPX,             // As CQWW, but 1 within a country, and doubled on 160, 80 and 40 m
+    POINTS_ARRL_DX,         // 3 between W/VE and the rest of the world, none otherwise
+    POINTS_IARU,            // 1 within an ITU zone, 3 within a continent, 5 between continents
+    POINTS_FIELD_DAY,       // 2 for CW and digital, 1 for phone
+    POINTS_TWO              // 2 for every QSO
+} ContestPoints;
+
+// Which QSOs with the same station are dupes
+typedef enum {
+    DUPE_BAND,              // Once per band
+    DUPE_BAND_MODE,         // Once per band and mode group
+    DUPE_ONCE               // Once in the contest
+} ContestDupes;
+
+// What a contest counts as multipliers
+typedef enum {
+    MULT_NONE,
+    MULT_DXCC,              // DXCC entities, by the country file's prefix
+    MULT_CQ_ZONE,           // CQ zones, from the received exchange or else the country file
+    MULT_ITU_ZONE,          // ITU zones, likewise
+    MULT_WPX,               // WPX prefixes
+    MULT_ARRL_DX,           // Entities outside W/VE for W/VE stations, states and provinces for the rest
+    MULT_SECTION            // ARRL and RAC sections, the last word of the received exchange
+} ContestMultiplier;
+
+// What goes after the signal report in the exchange, when it isn't just typed into the reports
+typedef enum {
+    EXCHANGE_TYPED,
+    EXCHANGE_CQ_ZONE,
+    EXCHANGE_ITU_ZONE,
+    EXCHANGE_SERIAL
+} ContestExchange;
+
+// A contest the scoreboard knows the rules of, selected with K by name
+typedef struct {
+    const char *name;               // As typed after K
+    const char *title;
+    const char *cabrillo;           // CONTEST: in the Cabrillo header; %s takes the mode (CW, SSB or RTTY)
+    int hours;                      // How long it runs from the start time given with K
+    ContestPoints points;
+    ContestDupes dupes;
+    ContestMultiplier mults[CONTEST_MAX_MULTS];
+    int mults_per_band;             // Each multiplier counts once per band, rather than once in the contest
+    int multiply;                   // The score is the points times the multipliers, rather than just the points
+    ContestExchange exchange;
+    int rst;                        // The exchange starts with a signal report
+} ContestEvent;
+
+// A QSO as the contest sees it, read from the log or from the contact being entered
+typedef struct {
+    char callsign[sizeof(((Contact *)0)->callsign_worked)]; // Normalized
+    int band;                       // bands[] index, or BAND_COUNT
+    int mode;                       // ModeCategory
+    char mode_name[20];
+    long long hz;
+    long long epoch;                // NO_EPOCH if the date/time can't be read
+    char country_prefix[8];
+    char continent[4];
+    int cq_zone;
+    int itu_zone;
+    char wpx[16];
+    char state[8];
+    char sent[16];                  // Reports (or exchanges) as logged
+    char received[16];
+    long long serial;               // Serial number sent, or 0 if none was stored
+
+    // Worked out from the contest's rules by score_contest_qso
+    int points;
+    char mults[CONTEST_MAX_MULTS][16]; // The multiplier it counts for of each kind, empty if none
+} ContestQso;
+
+// A station or multiplier counted by the scoreboard, with how many QSOs count for it.  Slots are
+// kept when the count drops back to zero, so removing a QSO never moves anything.
+typedef struct {
+    char key[40];                   // Empty for an unused slot
+    unsigned int hash;
+    int count;
+    int band;                       // Band of the QSO that first counted for it
+    int points;                     // For a station, the points its QSO is worth
+} ContestEntry;
+
+// Open-addressing hash table of contest entries, keyed by text
+typedef struct {
+    ContestEntry *entries;
+    size_t capacity;
+    size_t used;
+} ContestTable;
+
+// QSOs made in one minute, for the best rates the statistics command finds
+typedef struct {
+    long long minute;               // Minutes since 1970
+    long long count;                // Zero for an unused slot
+} StatsMinute;
+
+// Open-addressing hash table of the minutes QSOs were made in
+typedef struct {
+    StatsMinute *entries;
+    size_t capacity;
+    size_t used;
+} StatsMinutes;
+
+// The running score of the contest being scored, defined after the bands it counts by
+typedef struct ContestScore ContestScore;
+
+// A view query being assembled from 'v' parameters: SQL with placeholders plus the values to bind
+#define VIEW_MAX_BINDINGS 12
+typedef struct {
+    char where[512];
+    int sort_by_time;       // ORDER BY qso_epoch instead of id
+    int descending;         // Newest first, for -N
+    int backwards;          // Read against the sort order (from a cursor), returned in sort order
+    int binding_count;
+    int too_many;           // More values than VIEW_MAX_BINDINGS were given; the query can't be run
+    int binding_is_text[VIEW_MAX_BINDINGS];
+    long long int_values[VIEW_MAX_BINDINGS];
+    char text_values[VIEW_MAX_BINDINGS][64];
+} ViewQuery;
+
+// The 'v' listing being paged through with v next and v prev.  Pages are found by seeking
+// past the sort key of the first or last row shown, so no page costs more than the first.
+#define VIEW_PAGE_SIZE 20
+#define VIEW_BUFFER_SIZE (64 * 1024)    // Output buffer for a page; a long page is written in pieces
+typedef struct {
+    ViewQuery query;        // Search terms and sort order, without any cursor
+    int page_size;
+    int active;             // A listing has been shown and can be paged
+    long long first_epoch;  // Sort key (qso_epoch, id, log) of the first row on the page
+    long long first_id;
+    int first_log;
+    long long last_epoch;   // ...and of the last row
+    long long last_id;
+    int last_log;
+} ViewPager;
+
+// A latency histogram: bucket i counts the samples under 2^i microseconds, the last one the rest
+#define LATENCY_BUCKETS 24
+typedef struct {
+    long long count;
+    long long total_us;
+    long long max_us;
+    long long buckets[LATENCY_BUCKETS];
+} LatencyHistogram;
+
+// What the 'w' command reports, collected since startup or the last 'w reset'
+typedef struct {
+    LatencyHistogram commands[128];     // Per command letter, from dispatch to the next command
+    LatencyHistogram redisplay;         // Printing the current contact and the prompt
+    long long prepare_count;            // Statements compiled (parsing and query planning)
+    long long prepare_us;
+    long long finalized_vm_steps;       // VM steps of one-off statements, counted when finalized
+    long long started_us;
+} SessionStats;
+
+// File I/O through the timing VFS.  SQLite's VFS calls carry no session, so this is global.
+typedef struct {
+    LatencyHistogram sync;
+    long long write_count;
+    long long write_us;
+    long long write_bytes;
+    long long read_count;
+    long long read_us;
+    long long read_bytes;
+} IoStats;
+
+static IoStats io_stats;
+
+// A QSO decoded by the UDP listener thread, waiting in the queue for the writer
+typedef struct {
+    Contact contact;
+    long long received_us;  // When its datagram arrived
+} UdpQso;
+
+// The UDP listener: a thread that decodes datagrams into QSOs and a single-producer,
+// single-consumer ring that hands them to the main thread, which writes them in batches.
+// The listener only advances head and the writer only advances tail, so no lock is needed.
+typedef struct {
+    int port;
+    int socket_fd;
+    int wake_fds[2];        // Pipe the listener pokes after queueing, so the writer wakes up
+    pthread_t thread;
+    atomic_int stop;
+    atomic_size_t head;     // Next slot the listener fills
+    atomic_size_t tail;     // Next slot the writer takes
+    UdpQso slots[UDP_QUEUE_SIZE];
+
+    // Kept by the listener
+    atomic_llong packets;       // Datagrams received
+    atomic_llong qsos;          // QSOs queued
+    atomic_llong duplicates;    // QSOs already queued (WSJT-X sends each one twice)
+    atomic_llong ignored;       // Status, decode and other messages that aren't QSOs
+    atomic_llong malformed;     // Datagrams that couldn't be decoded
+    atomic_llong dropped;       // QSOs lost because the queue was full
+    char recent_calls[UDP_RECENT_QSOS][sizeof(((Contact *)0)->callsign_worked)];
+    long long recent_epochs[UDP_RECENT_QSOS];
+    int recent_next;
+
+    // Kept by the writer
+    long long written;
+    long long failed;
+    long long batches;
+    long long started_us;
+    LatencyHistogram latency;   // From the datagram arriving to its QSO being written
+} UdpListener;
+
+// The rig poller: a thread that asks rigctld for the frequency and mode, never blocking the
+// prompt.  It publishes what it reads under the lock; the main thread copies it into the
+// current contact when it changes.
+typedef struct {
+    char address[256];
+    pthread_t thread;
+    int stop_fds[2];        // Pipe written to stop the thread, which waits on it instead of sleeping
+    pthread_mutex_t lock;
+
+    // Shared, under the lock
+    long long hz;
+    char mode[20];          // As rigctld names it: USB, CW, PKTUSB...
+    unsigned long long changes; // Bumped whenever the frequency or mode changes
+    int connected;
+    int interval_ms;        // Current poll interval
+    long long polls;
+    long long failures;
+    char error[96];         // Why the last poll or connection failed
+    LatencyHistogram latency;   // Round trip of each poll
+
+    // Kept by the main thread
+    unsigned long long applied; // Value of changes last copied into the current contact
+    long long started_us;
+} RigPoller;
+
+// A position's connection to the logging daemon, defined with the daemon code
+typedef struct RemoteLog RemoteLog;
+
+// A log file open in the session: the main log, or another one attached to it
+typedef struct {
+    char name[32];          // File name without directory or extension, shown in listings
+    char schema[16];        // Schema it's attached as: main, log1, log2...
+} LogFile;
+
+// A long-lived database session: one open connection plus a cache of prepared statements
+typedef struct {
+    sqlite3 *db;
+    sqlite3_stmt *statements[STMT_COUNT];
+    DupeIndex dupes;
+    CountryFile countries;
+    PartialIndex partials;
+    ViewPager view;
+    SessionStats stats;
+
+    // Open logs.  logs[0] is the main log that new contacts go into; the all_contacts view
+    // joins all of them for searches, dupe checks and exports.
+    LogFile logs[MAX_LOGS];
+    int log_count;
+
+    // Contest mode: WAL journaling with writes grouped into fewer, larger commits
+    int contest_mode;
+    char synchronous[8];            // PRAGMA synchronous setting used in contest mode
+    int group_commit_qsos;          // Commit once this many writes are pending...
+    int group_commit_ms;            // ...or once the oldest pending write is this old
+    int pending_writes;             // Writes in the open transaction, not yet committed
+    long long pending_since_us;     // Monotonic time of the first pending write
+    long long contest_started_us;   // When contest mode was switched on
+    long long contest_writes;       // Writes made since contest mode was switched on
+    long long contest_commits;      // Group commits made since contest mode was switched on
+    long long contest_write_us;     // Time spent in the database for those writes and commits
+
+    // Batch mode: a whole command script runs in one transaction, committed at the end
+    int batch_mode;
+    long long batch_writes;         // Writes made by the script
+
+    // QSOs arriving over UDP from digital mode software, when the listener is running
+    UdpListener *udp;
+
+    // Frequency and mode from the rig, when it's being polled
+    RigPoller *rig;
+
+    // The contest being scored, when one has been selected with K
+    ContestScore *contest;
+
+    // Worker threads used to export a big log; 1 exports on this thread alone
+    int export_threads;
+
+    // On a position connected to the logging daemon, where new contacts, edits and deletes go
+    // instead of the log file, and where the dupe index and serial numbers come from
+    RemoteLog *remote;
+} LoggerSession;
+
+// Columns read by the export engine, in the order write_csv_row expects
+#define EXPORT_COLUMNS "id, callsign, frequency, mode, sent_report, received_report, date_time, comment, " \
+                       "country, country_prefix, cq_zone, itu_zone, continent, frequency_hz, band, qso_epoch, " \
+                       "state, wpx_prefix, qsl_rcvd, qsl_rcvd_date, serial"
+
+// SQL text for each cached statement, indexed by StatementId
+static const char *statement_sql[STMT_COUNT] = {
+    "INSERT INTO contacts (callsign, frequency, mode, sent_report, received_report, date_time, comment, "
+    "country, country_prefix, cq_zone, itu_zone, continent, frequency_hz, band, qso_epoch, state, wpx_prefix, "
+    "qsl_rcvd, qsl_rcvd_date, serial) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?);",
+    "UPDATE contacts SET callsign = ?, frequency = ?, mode = ?, sent_report = ?, received_report = ?, "
+    "date_time = ?, comment = ?, country = ?, country_prefix = ?, cq_zone = ?, itu_zone = ?, continent = ?, "
+    "frequency_hz = ?, band = ?, qso_epoch = ?, state = ?, wpx_prefix = ? WHERE id = ?",
+    "DELETE FROM contacts WHERE id = ?",
+    "SELECT callsign, frequency, mode, sent_report, received_report, "
+    "date_time, comment, country, country_prefix, cq_zone, itu_zone, continent, state, serial FROM contacts WHERE id = ?",
+    "SELECT " EXPORT_COLUMNS " FROM contacts ORDER BY id",
+    "BEGIN IMMEDIATE",
+    "COMMIT",
+    "SELECT callsign FROM contacts WHERE id = ?",
+    "SELECT frequency_hz, mode FROM all_contacts WHERE callsign = ?",
+    "SELECT count(*) FROM contacts WHERE qso_epoch > (SELECT max(qso_epoch) FROM contacts) - ?",
+    "SELECT max(id) FROM contacts",
+    "SELECT callsign, frequency_hz, mode FROM all_contacts",
+    "SELECT 0, band, mode FROM all_award_credits WHERE award = 'DXCC' AND entity = ?1 UNION ALL "
+    "SELECT 1, band, mode FROM all_award_credits WHERE award = 'WAS' AND entity = ?2 UNION ALL "
+    "SELECT 2, band, mode FROM all_award_credits WHERE award = 'WPX' AND entity = ?3",
+    "SELECT " EXPORT_COLUMNS " FROM contacts WHERE id = ?"
+};
+
+// One ADIF data specifier (<TAG:len>value), pointing straight into the source bytes
+typedef struct {
+    const char *name;
+    size_t name_length;
+    const char *value;
+    size_t value_length;
+} AdifField;
+
+// Streaming ADIF parser over an in-memory buffer
+typedef struct {
+    const char *data;
+    size_t size;
+    size_t position;
+} AdifParser;
+
+// The fields of one ADIF record that the logger uses; unset fields have a NULL value
+typedef struct {
+    AdifField call;
+    AdifField freq;
+    AdifField mode;
+    AdifField submode;
+    AdifField rst_sent;
+    AdifField rst_rcvd;
+    AdifField qso_date;
+    AdifField time_on;
+    AdifField comment;
+    AdifField notes;
+    AdifField country;
+    AdifField cq_zone;
+    AdifField itu_zone;
+    AdifField continent;
+    AdifField state;
+    AdifField band;
+    AdifField qsl_rcvd;
+    AdifField qsl_rcvd_date;
+    AdifField stx;
+} AdifRecord;
+
+// A QSO reduced to the keys confirmations are matched on, for the sort-merge join
+typedef struct {
+    char callsign[sizeof(((Contact *)0)->callsign_worked)]; // Normalized callsign
+    int band;               // bands[] index, BAND_COUNT if unknown
+    int mode;               // Mode group
+    long long epoch;        // QSO date and time, seconds since 1970
+    long long id;           // Contact ID, or for a confirmation its record number in the file
+    char qsl_date[12];      // For a confirmation, QSLRDATE as YYYY-MM-DD
+} QslKey;
+
+// File formats written by the export engine
+typedef enum {
+    EXPORT_CSV,
+    EXPORT_ADIF,
+    EXPORT_CABRILLO
+} ExportFormat;
+
+// Large write buffer in front of a file descriptor, used by the export engine
+typedef struct {
+    int fd;
+    char *data;
+    size_t used;
+    size_t capacity;
+    int error;
+} OutputBuffer;
+
+// A range of IDs in a parallel export, formatted in memory by a worker until its turn to be written
+typedef struct {
+    long long first_id;
+    long long last_id;
+    OutputBuffer text;              // The range's rows, as they go in the file
+    OutputBuffer messages;          // What the serial export prints for the range's skipped rows
+    long long rows;
+    long long skipped;
+    int done;                       // Set by the worker once the range is formatted
+} ExportChunk;
+
+// A parallel export shared by the worker threads and the thread writing the file
+typedef struct {
+    const char *path;               // The log file, which each worker opens for itself
+    ExportFormat format;
+    ExportChunk *chunks;
+    size_t chunk_count;
+    size_t next_chunk;              // The next range for a worker to take
+    size_t written;                 // Ranges written to the file so far
+    int started;                    // Workers that have begun their read transaction
+    int failed;                     // Set to stop the workers early
+    char error[256];                // Why, when a worker failed
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+} ParallelExport;
+
+// An amateur band and its edges in Hz
+typedef struct {
+    const char *name;
+    long long low_hz;
+    long long high_hz;
+} Band;
+
+static const Band bands[] = {
+    { "2200m", 135700, 137800 },
+    { "630m", 472000, 479000 },
+    { "160m", 1800000, 2000000 },
+    { "80m", 3500000, 4000000 },
+    { "60m", 5060000, 5450000 },
+    { "40m", 7000000, 7300000 },
+    { "30m", 10100000, 10150000 },
+    { "20m", 14000000, 14350000 },
+    { "17m", 18068000, 18168000 },
+    { "15m", 21000000, 21450000 },
+    { "12m", 24890000, 24990000 },
+    { "10m", 28000000, 29700000 },
+    { "6m", 50000000, 54000000 },
+    { "4m", 70000000, 71000000 },
+    { "2m", 144000000, 148000000 },
+    { "1.25m", 222000000, 225000000 },
+    { "70cm", 420000000, 450000000 },
+    { "33cm", 902000000, 928000000 },
+    { "23cm", 1240000000, 1300000000 }
+};
+#define BAND_COUNT (sizeof(bands) / sizeof(bands[0]))
+
+// The running score of the contest being scored.  Every logged, edited or deleted contact adds
+// or takes away its part, so nothing here is ever recounted from the log after K starts it.
+struct ContestScore {
+    const ContestEvent *event;
+    char station[16];               // Our own callsign, and where it is
+    char country_prefix[8];
+    char continent[4];
+    int cq_zone;
+    int itu_zone;
+    int w_ve;                       // In the 48 states or Canada, for the ARRL DX contest
+    long long start_epoch;          // QSOs counted, or NO_EPOCH for the whole log
+    long long end_epoch;
+
+    ContestTable stations;          // Keyed by callsign, plus band and mode if the dupe rules say so
+    ContestTable mults;             // Keyed by multiplier kind and value, plus band if they count per band
+    long long qsos;                 // QSOs counted, dupes included
+    long long unique;               // ...of which are not dupes
+    long long points;
+    long long mult_count[CONTEST_MAX_MULTS];
+    long long band_qsos[BAND_COUNT + 1];
+    long long band_unique[BAND_COUNT + 1];
+    long long band_points[BAND_COUNT + 1];
+    long long band_mults[CONTEST_MAX_MULTS][BAND_COUNT + 1];
+    long long mode_qsos[MODE_CATEGORY_COUNT];
+    long long next_serial;          // Sent with the next QSO, one past the highest counted so far
+
+    long long *times;               // Times of the QSOs counted, sorted, for the QSO rates
+    size_t time_count;
+    size_t time_capacity;
+    int counting_log;               // Counting the whole log: times are appended, then sorted once
+};
+
+// Contests K can score
+static const ContestEvent contest_events[] = {
+    { "cqww", "CQ World Wide DX", "CQ-WW-%s", 48, POINTS_CQWW, DUPE_BAND, { MULT_CQ_ZONE, MULT_DXCC }, 1, 1, EXCHANGE_CQ_ZONE, 1 },
+    { "wpx", "CQ WPX", "CQ-WPX-%s", 48, POINTS_WPX, DUPE_BAND, { MULT_WPX, MULT_NONE }, 0, 1, EXCHANGE_SERIAL, 1 },
+    { "arrldx", "ARRL International DX", "ARRL-DX-%s", 48, POINTS_ARRL_DX, DUPE_BAND, { MULT_ARRL_DX, MULT_NONE }, 1, 1, EXCHANGE_TYPED, 1 },
+    { "iaru", "IARU HF World Championship", "IARU-HF", 24, POINTS_IARU, DUPE_BAND_MODE, { MULT_ITU_ZONE, MULT_NONE }, 1, 1, EXCHANGE_ITU_ZONE, 1 },
+    { "ss", "ARRL November Sweepstakes", "ARRL-SS-%s", 30, POINTS_TWO, DUPE_ONCE, { MULT_SECTION, MULT_NONE }, 0, 1, EXCHANGE_SERIAL, 0 },
+    { "fd", "ARRL Field Day", "ARRL-FD", 27, POINTS_FIELD_DAY, DUPE_BAND_MODE, { MULT_SECTION, MULT_NONE }, 0, 0, EXCHANGE_TYPED, 0 }
+};
+#define CONTEST_EVENT_COUNT (sizeof(contest_events) / sizeof(contest_events[0]))
+
+// Award credits earned by a contact: one (award, entity, band, mode group) row per award.  r is
+// the row (NEW or OLD in a trigger, or the contacts table).  The mode groups follow mode_category(),
+// and WAS only counts states of US entities (or of contacts that weren't looked up).
+#define AWARD_MODE_SQL(r) \
+    "CASE WHEN upper(" r ".mode) = 'CW' THEN 'CW' " \
+    "WHEN upper(" r ".mode) IN ('SSB', 'USB', 'LSB', 'AM', 'FM', 'PH', 'PHONE', 'DV') THEN 'PHONE' " \
+    "WHEN coalesce(" r ".mode, '') = '' THEN '' ELSE 'DIGITAL' END"
+#define AWARD_DXCC_SQL(r) r ".country_prefix"
+#define AWARD_WAS_SQL(r) "CASE WHEN coalesce(" r ".country_prefix, 'K') IN ('K', 'KL', 'KH6') THEN upper(" r ".state) END"
+#define AWARD_WPX_SQL(r) r ".wpx_prefix"
+
+// Trigger steps adding and removing one contact's credit for one award.  Each is a single
+// primary key lookup; rows are dropped when their count reaches zero.
+#define AWARD_KEY_SQL(r, award, entity) \
+    "award = '" award "' AND entity = " entity " AND band = coalesce(" r ".band, '') AND mode = " AWARD_MODE_SQL(r)
+#define AWARD_ADD_SQL(r, award, entity) \
+    "INSERT INTO award_credits (award, entity, band, mode, qsos) " \
+    "SELECT '" award "', " entity ", coalesce(" r ".band, ''), " AWARD_MODE_SQL(r) ", 1 WHERE " entity " <> '' " \
+    "ON CONFLICT (award, entity, band, mode) DO UPDATE SET qsos = qsos + 1;"
+#define AWARD_REMOVE_SQL(r, award, entity) \
+    "UPDATE award_credits SET qsos = qsos - 1 WHERE " AWARD_KEY_SQL(r, award, entity) ";" \
+    "DELETE FROM award_credits WHERE " AWARD_KEY_SQL(r, award, entity) " AND qsos <= 0;"
+#define AWARD_ADD_ALL_SQL(r) \
+    AWARD_ADD_SQL(r, "DXCC", AWARD_DXCC_SQL(r)) AWARD_ADD_SQL(r, "WAS", AWARD_WAS_SQL(r)) \
+    AWARD_ADD_SQL(r, "WPX", AWARD_WPX_SQL(r))
+#define AWARD_REMOVE_ALL_SQL(r) \
+    AWARD_REMOVE_SQL(r, "DXCC", AWARD_DXCC_SQL(r)) AWARD_REMOVE_SQL(r, "WAS", AWARD_WAS_SQL(r)) \
+    AWARD_REMOVE_SQL(r, "WPX", AWARD_WPX_SQL(r))
+
+// Schema migrations, applied in order.  PRAGMA user_version records how many have run.
+static const char *schema_migrations[] = {
+    // 1: Indexes for the view command's callsign, prefix, date range and mode searches
+    "CREATE INDEX IF NOT EXISTS idx_contacts_callsign ON contacts(callsign, date_time);"
+    "CREATE INDEX IF NOT EXISTS idx_contacts_date_time ON contacts(date_time);"
+    "CREATE INDEX IF NOT EXISTS idx_contacts_mode ON contacts(mode, date_time);",
+
+    // 2: Country file entity, zones and continent stored with each contact
+    "ALTER TABLE contacts ADD COLUMN country TEXT;"
+    "ALTER TABLE contacts ADD COLUMN country_prefix TEXT;"
+    "ALTER TABLE contacts ADD COLUMN cq_zone INTEGER;"
+    "ALTER TABLE contacts ADD COLUMN itu_zone INTEGER;"
+    "ALTER TABLE contacts ADD COLUMN continent TEXT;",
+
+    // 3: Frequency in whole Hz and the band it falls in, so band and frequency searches use an index
+    "ALTER TABLE contacts ADD COLUMN frequency_hz INTEGER;"
+    "ALTER TABLE contacts ADD COLUMN band TEXT;"
+    "UPDATE contacts SET frequency_hz = parse_frequency_hz(frequency), band = frequency_band(frequency);"
+    "CREATE INDEX IF NOT EXISTS idx_contacts_band ON contacts(band);"
+    "CREATE INDEX IF NOT EXISTS idx_contacts_frequency_hz ON contacts(frequency_hz);",
+
+    // 4: Date/time as seconds since 1970 UTC, which takes over from the date_time text index
+    "ALTER TABLE contacts ADD COLUMN qso_epoch INTEGER;"
+    "UPDATE contacts SET qso_epoch = date_time_epoch(date_time);"
+    "CREATE INDEX IF NOT EXISTS idx_contacts_qso_epoch ON contacts(qso_epoch);"
+    "DROP INDEX IF EXISTS idx_contacts_date_time;",
+
+    // 5: State and WPX prefix, and award credit counts per award, entity, band and mode,
+    // kept up to date by triggers so award status never has to scan the log
+    "ALTER TABLE contacts ADD COLUMN state TEXT;"
+    "ALTER TABLE contacts ADD COLUMN wpx_prefix TEXT;"
+    "UPDATE contacts SET wpx_prefix = wpx_prefix(callsign);"
+    "CREATE TABLE award_credits (award TEXT NOT NULL, entity TEXT NOT NULL, band TEXT NOT NULL, mode TEXT NOT NULL, "
+    "qsos INTEGER NOT NULL, PRIMARY KEY (award, entity, band, mode)) WITHOUT ROWID;"
+    "INSERT INTO award_credits (award, entity, band, mode, qsos) "
+    "SELECT award, entity, band, mode, count(*) FROM ("
+    "SELECT 'DXCC' AS award, " AWARD_DXCC_SQL("contacts") " AS entity, coalesce(band, '') AS band, "
+    AWARD_MODE_SQL("contacts") " AS mode FROM contacts UNION ALL "
+    "SELECT 'WAS', " AWARD_WAS_SQL("contacts") ", coalesce(band, ''), " AWARD_MODE_SQL("contacts") " FROM contacts UNION ALL "
+    "SELECT 'WPX', " AWARD_WPX_SQL("contacts") ", coalesce(band, ''), " AWARD_MODE_SQL("contacts") " FROM contacts) "
+    "WHERE entity <> '' GROUP BY award, entity, band, mode;"
+    "CREATE TRIGGER award_credits_insert AFTER INSERT ON contacts BEGIN " AWARD_ADD_ALL_SQL("NEW") " END;"
+    "CREATE TRIGGER award_credits_delete AFTER DELETE ON contacts BEGIN " AWARD_REMOVE_ALL_SQL("OLD") " END;"
+    "CREATE TRIGGER award_credits_update AFTER UPDATE OF callsign, mode, band, country_prefix, state, wpx_prefix "
+    "ON contacts BEGIN " AWARD_REMOVE_ALL_SQL("OLD") AWARD_ADD_ALL_SQL("NEW") " END;",
+
+    // 6: QSL received status and date, set by confirmation imports
+    "ALTER TABLE contacts ADD COLUMN qsl_rcvd TEXT;"
+    "ALTER TABLE contacts ADD COLUMN qsl_rcvd_date TEXT;",
+
+    // 7: Full-text index of the notes, kept in step with the contacts table by triggers.
+    // Contacts without a note are left out of it, so logging them costs nothing extra.
+    "CREATE VIRTUAL TABLE contacts_notes USING fts5(comment, content='contacts', content_rowid='id', "
+    "tokenize='porter unicode61');"
+    "INSERT INTO contacts_notes (rowid, comment) SELECT id, comment FROM contacts WHERE coalesce(comment, '') <> '';"
+    "CREATE TRIGGER contacts_notes_insert AFTER INSERT ON contacts WHEN coalesce(NEW.comment, '') <> '' BEGIN "
+    "INSERT INTO contacts_notes (rowid, comment) VALUES (NEW.id, NEW.comment); END;"
+    "CREATE TRIGGER contacts_notes_delete AFTER DELETE ON contacts WHEN coalesce(OLD.comment, '') <> '' BEGIN "
+    "INSERT INTO contacts_notes (contacts_notes, rowid, comment) VALUES ('delete', OLD.id, OLD.comment); END;"
+    "CREATE TRIGGER contacts_notes_update AFTER UPDATE OF comment ON contacts "
+    "WHEN coalesce(OLD.comment, '') IS NOT coalesce(NEW.comment, '') BEGIN "
+    "INSERT INTO contacts_notes (contacts_notes, rowid, comment) SELECT 'delete', OLD.id, OLD.comment "
+    "WHERE coalesce(OLD.comment, '') <> '';"
+    "INSERT INTO contacts_notes (rowid, comment) SELECT NEW.id, NEW.comment WHERE coalesce(NEW.comment, '') <> ''; END;",
+
+    // 8: Serial number sent with each contact, for the contests that exchange one
+    "ALTER TABLE contacts ADD COLUMN serial INTEGER;"
+};
+#define SCHEMA_VERSION ((int)(sizeof(schema_migrations) / sizeof(schema_migrations[0])))
+
+// Buffered reader for standard input that can give up waiting after a timeout,
+// so that pending group commits get flushed while the operator is idle
+typedef struct {
+    int fd;
+    char buffer[INPUT_BUFFER_SIZE * 4];
+    size_t start;
+    size_t end;
+    int eof;
+    int wake_fd;            // Also wait on this descriptor, if not -1
+    int remote_fd;          // ...and on this one, the logging daemon's connection
+} InputReader;
+
 // Function declarations
 void display_help();
 void display_title();
+void display_usage(const char *program);
 void display_current_contact(Contact *contact);
 void get_current_date(char *buffer, size_t buffer_size);
 void get_current_time(char *buffer, size_t buffer_size);
+long long days_from_civil(int year, int month, int day);
+long long parse_date_time_epoch(const char *text, size_t length);
 int initialize_database(const char *db_name);
-int log_contact(const char *db_name, Contact *contact);
-int view_contacts(const char *db_name, const char *params);
+int apply_migrations(sqlite3 *db);
+int register_functions(sqlite3 *db);
+long long parse_frequency_hz(const char *text, size_t length);
+const char *band_for_hz(long long hz);
+void format_frequency(long long hz, char *buffer, size_t buffer_size);
+int open_session(LoggerSession *session, const char *db_name);
+sqlite3_stmt *session_statement(LoggerSession *session, StatementId id);
+void close_session(LoggerSession *session);
+int rebuild_log_view(LoggerSession *session);
+int attach_log(LoggerSession *session, const char *file_name);
+int detach_log(LoggerSession *session, const char *name);
+void display_logs(LoggerSession *session);
+long long monotonic_us(void);
+void latency_record(LatencyHistogram *histogram, long long elapsed_us);
+int install_timing_vfs(void);
+int session_prepare(LoggerSession *session, const char *sql, unsigned int flags, sqlite3_stmt **stmt);
+void session_finalize(LoggerSession *session, sqlite3_stmt *stmt);
+void reset_stats(LoggerSession *session);
+void display_stats(LoggerSession *session);
+int set_contest_mode(LoggerSession *session, int enable);
+int flush_group_commit(LoggerSession *session);
+int group_commit_timeout_ms(LoggerSession *session);
+void display_contest_status(LoggerSession *session);
+int read_input_line(InputReader *reader, char *line, size_t line_size, int timeout_ms);
+int mode_category(const char *mode, size_t length);
+int band_index_for_hz(long long hz);
+int band_index_for_frequency(const char *frequency, size_t length);
+void normalize_callsign(const char *callsign, size_t length, char *buffer, size_t buffer_size);
+int dupe_index_add(DupeIndex *index, const char *callsign, size_t length, int band, int mode);
+int dupe_index_refresh(LoggerSession *session, const char *callsign);
+int build_dupe_index(LoggerSession *session);
+void display_dupe_status(LoggerSession *session, const Contact *contact);
+void wpx_prefix(const char *callsign, char *buffer, size_t buffer_size);
+void display_award_status(LoggerSession *session, const Contact *contact);
+int display_awards(LoggerSession *session, const char *award_name);
+int display_statistics(LoggerSession *session, const char *params);
+int rebuild_contest_score(LoggerSession *session);
+int start_contest_scoring(LoggerSession *session, const char *name, const char *station, const char *date, const char *time);
+void stop_contest_scoring(LoggerSession *session);
+void display_contest_summary(LoggerSession *session);
+void display_contest_score(LoggerSession *session);
+void display_contest_qso(LoggerSession *session, const Contact *contact);
+int map_file(const char *file_name, MappedFile *mapped);
+void unmap_file(MappedFile *mapped);
+int adif_next_field(AdifParser *parser, AdifField *field);
+int adif_next_record(AdifParser *parser, AdifRecord *record);
+int import_adif(LoggerSession *session, const char *file_name);
+int import_confirmations(LoggerSession *session, const char *file_name, int minutes);
+int decode_wsjtx_packet(const unsigned char *data, size_t size, Contact *contact);
+int parse_udp_port(const char *text);
+int start_udp_listener(LoggerSession *session, int port);
+int drain_udp_queue(LoggerSession *session);
+void stop_udp_listener(LoggerSession *session);
+void display_udp_status(LoggerSession *session);
+int start_rig_poller(LoggerSession *session, const char *address);
+void stop_rig_poller(LoggerSession *session);
+int apply_rig_state(LoggerSession *session, Contact *contact);
+void display_rig_status(LoggerSession *session);
+int run_daemon(LoggerSession *session, const char *address);
+int open_position_session(LoggerSession *session, const char *address);
+int connect_to_daemon(LoggerSession *session);
+int log_readable(const LoggerSession *session, int quiet);
+void disconnect_from_daemon(LoggerSession *session);
+int remote_poll(LoggerSession *session);
+int remote_log_contact(LoggerSession *session, Contact *contact);
+int remote_reserve_serial(LoggerSession *session, Contact *contact);
+int remote_delete_contact(LoggerSession *session, int contact_id);
+int build_country_image(const char *text_file, const char *image_file);
+int load_country_image(CountryFile *countries, const char *image_file);
+void free_country_file(CountryFile *countries);
+int lookup_country(const CountryFile *countries, const char *callsign, Contact *contact);
+void load_country_file_at_startup(CountryFile *countries);
+int build_partial_index(LoggerSession *session, const char *scp_file);
+void free_partial_index(PartialIndex *index);
+void partial_index_note_call(PartialIndex *index, const char *callsign, int first_contact);
+void super_check_partial(LoggerSession *session, const char *fragment);
+int log_contact(LoggerSession *session, Contact *contact);
+int export_log(LoggerSession *session, const char *file_name, ExportFormat format, const char *filters);
+int export_contacts(LoggerSession *session, const char *file_name, const char *filters);
+int export_adif(LoggerSession *session, const char *file_name, const char *filters);
+int export_cabrillo(LoggerSession *session, const char *file_name);
+int archive_log(LoggerSession *session, const char *file_name);
+int restore_archive(LoggerSession *session, const char *file_name);
+int scan_archive(const char *file_name);
+void parse_view_params(ViewQuery *query, const char *params, int *limit);
+char *take_view_params(char *params, size_t params_size);
+sqlite3_stmt *prepare_view_query(LoggerSession *session, ViewQuery *query, const char *columns, int limit);
+int view_contacts(LoggerSession *session, const char *params);
+int search_notes(LoggerSession *session, const char *words);
 
 // Function to display the help message
 void display_help() {
     printf("\nCommands:\n");
     printf("  h - Show this help message\n");
     printf("  a <ID> - erAse a contact by its ID (e.g., d 5)\n");
-    printf("  e <filename> - Export logged contacts to a CSV file (e.g., e contacts.csv)\n");   
-    printf("  i <filename> - Export the database in ADIF format (e.g., i log.adif)\n"); 
+    printf("  b [award] - Award progress for DXCC, WAS and WPX, or everything worked for one (e.g., b, b was)\n");
+    printf("  e <filename> [search] - Export logged contacts to a CSV file (e.g., e contacts.csv, e 20m.csv band=20m)\n");   
+    printf("  g <filename> - Get (import) contacts from an ADIF file (e.g., g other.adif)\n");
+    printf("  i <filename> [search] - Export the database in ADIF format (e.g., i log.adif, i cw.adif mode=CW)\n"); 
+    printf("  j - Listen for QSOs logged by WSJT-X, JTDX and similar over UDP (options: j, j on [port], j off)\n");
+    printf("  k - Kontest mode (options: k, k on, k off, k sync OFF|NORMAL|FULL, k batch <QSOs> <ms>)\n");
     printf("  l - Log a contact with the current settings\n");
+    printf("  o [file] - Open another log alongside this one for searches, dupe checks and exports (options: o, o <file>, o close <name>)\n");
+    printf("  K - Kontest scoring as you log (options: K, K <contest> <your call> [YYYY-MM-DD [HH:MM]], K off; e.g., K cqww K3NG 2024-11-30)\n");
+    printf("  C <filename> - Cabrillo export of the contest being scored (e.g., C cqww.log)\n");
+    printf("  A <filename> - Archive the log to a compact columnar file (options: A <file>, A load <file>, A scan <file>)\n");
+    printf("  T [search] - sTatistics: QSOs by band, mode, hour and continent, unique calls and best rates (e.g., T, T from=2024-11-30 to=2024-12-01)\n");
+    printf("  R - Rig frequency and mode from rigctld, polled in the background (options: R, R on [host:port], R off)\n");
+    printf("  q <filename> [minutes] - QSL confirmations from an ADIF file (LoTW, eQSL) matched to the log (e.g., q lotw.adi, q cards.adi 60)\n");
+    printf("  p <fragment> - Partial callsign check against %s and the log, ? matches any character (e.g., p ?3N)\n", SCP_FILE);
+    printf("  / <words> - Search the notes of every open log, best matches first (e.g., / 4-square, / beam* OR yagi)\n");
     printf("  u <ID> - Load a contact by its ID for editing (e.g., u 5)\n");
-    printf("  v - View logged contacts (options: v, v +N, v -N, v ID, v ID1-ID2)\n");
+    printf("  v - View logged contacts a page at a time (options: v, v +N, v -N, v ID, v ID1-ID2, v next, v prev)\n");
+    printf("      Search with call=, prefix=, band=, freq=LOW-HIGH, mode=, from=YYYY-MM-DD, to=YYYY-MM-DD, sort=time, qsl=yes|no (e.g., v prefix=W3 band=20m -10)\n");
+    printf("  w - Where the time goes: command latencies, disk syncs, SQLite cache and memory (options: w, w reset)\n");
     printf("  x - Exit the program\n");
 
     printf("\nField Commands:\n");
-    printf("  c - Set the callsign worked (e.g., c W3ABC)\n");
-    printf("  f - Set the frequency (e.g., f 14.250)\n");
+    printf("  c - Set the callsign worked (e.g., c W3ABC, or c ?3N for a partial check)\n");
+    printf("  f - Set the frequency in kHz or MHz (e.g., f 14.250, f 7025, f 144.2M)\n");
     printf("  s - Set the sent report (e.g., s 59)\n");
     printf("  r - Set the received report (e.g., r 59)\n");
     printf("  m - Set the mode (e.g., m USB, CW)\n");
+    printf("  y - Set the state, for WAS (e.g., y CT)\n");
     printf("  d - Set the contact date (default: today's date)\n");
     printf("  t - Set the contact time (default: current time)\n");
+    printf("  z <filename> - Load a cty.dat country file for callsign lookups (default: %s)\n", CTY_TEXT_FILE);
     printf("  n - Add a note (e.g., n This is my note; l)\n");
 
     printf("\nUsage:\n");
@@ -85,10 +1098,36 @@ void display_title() {
     printf("\r\n\r\n");
 }
 
+// Function to display the command line options
+void display_usage(const char *program) {
+    printf("Usage: %s [-d|--db file] [-o|--open file]... [-j|--udp [port]] [-r|--rig [address]] [-b|--batch [file]]\n"
+           "       [-t|--threads n]\n", program);
+    printf("       %s [-d|--db file] --daemon [address]\n", program);
+    printf("       %s --connect [address]\n", program);
+    printf("  -d, --db file       Log new contacts to this log file (default: %s)\n", DEFAULT_LOG_FILE);
+    printf("  -o, --open file     Also open this log for searches, dupe checks and exports (can be repeated)\n");
+    printf("  -j, --udp [port]    Log QSOs sent over UDP by WSJT-X, JTDX and similar (default port: %d)\n", UDP_DEFAULT_PORT);
+    printf("  -r, --rig [address] Take the frequency and mode from rigctld (default: %s)\n", RIG_DEFAULT_ADDRESS);
+    printf("  --daemon [address]  Run as the logging daemon for several positions, owning the log file\n");
+    printf("  --connect [address] Log through the daemon as one position (address: socket file, port or\n");
+    printf("                      host:port; default %s)\n", DAEMON_DEFAULT_ADDRESS);
+    printf("  -b, --batch [file]  Run the commands in file (or standard input, or '-') without prompts,\n");
+    printf("                      as one transaction, and exit at the end of the input\n");
+    printf("  -t, --threads n     Export big logs on up to n threads (1 to %d; default: one per CPU)\n", EXPORT_MAX_THREADS);
+    printf("  -h, --help          Show this message\n");
+}
+
 // Function to display the current contact details
 void display_current_contact(Contact *contact) {
     printf("\nCurrent Contact Details:\n");
     printf("  Callsign Worked: %s\n", contact->callsign_worked);
+    if (contact->country[0]) {
+        printf("  Country: %s (%s)  CQ Zone: %d  ITU Zone: %d  Continent: %s\n", contact->country,
+               contact->country_prefix, contact->cq_zone, contact->itu_zone, contact->continent);
+    }
+    if (contact->state[0]) {
+        printf("  State: %s\n", contact->state);
+    }
     printf("  Frequency: %s\n", contact->frequency);
     printf("  Sent Report: %s\n", contact->sent_report);
     printf("  Received Report: %s\n", contact->received_report);
@@ -112,9 +1151,68 @@ void get_current_time(char *buffer, size_t buffer_size) {
     strftime(buffer, buffer_size, "%H:%M", tm_info);
 }
 
-// Function to initialize the SQLite3 database and create the table if it doesn't exist
-int initialize_database(const char *db_name) {
-    sqlite3 *db;
+// Function to count the days from 1970-01-01 to a date in the proleptic Gregorian calendar
+long long days_from_civil(int year, int month, int day) {
+    year -= month <= 2;
+    long long era = (year >= 0 ? year : year - 399) / 400;
+    long long year_of_era = year - era * 400;
+    long long day_of_year = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    long long day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+    return era * 146097 + day_of_era - 719468;
+}
+
+// Function to split a day count from 1970-01-01 back into year, month and day
+static void civil_from_days(long long days, int *year, int *month, int *day) {
+    days += 719468;
+    long long era = (days >= 0 ? days : days - 146096) / 146097;
+    long long day_of_era = days - era * 146097;
+    long long year_of_era = (day_of_era - day_of_era / 1460 + day_of_era / 36524 - day_of_era / 146096) / 365;
+    long long day_of_year = day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+    long long mp = (5 * day_of_year + 2) / 153;
+    *day = (int)(day_of_year - (153 * mp + 2) / 5 + 1);
+    *month = (int)(mp < 10 ? mp + 3 : mp - 9);
+    *year = (int)(year_of_era + era * 400 + (*month <= 2));
+}
+
+// Function to split seconds since 1970 into year, month, day and seconds since midnight,
+// rounding down (not towards zero) for times before 1970
+static void epoch_to_civil(long long epoch, int *year, int *month, int *day, int *seconds) {
+    long long days = epoch >= 0 ? epoch / 86400 : (epoch - 86399) / 86400;
+    civil_from_days(days, year, month, day);
+    *seconds = (int)(epoch - days * 86400);
+}
+
+// Function to read a stored "YYYY-MM-DD HH:MM[:SS]" date_time as seconds since 1970 UTC.
+// Returns NO_EPOCH if it isn't in that format.
+long long parse_date_time_epoch(const char *text, size_t length) {
+    static const char pattern[] = "dddd-dd-dd dd:dd";
+    int value[6] = { 0, 0, 0, 0, 0, 0 };
+    static const int offset[6] = { 0, 5, 8, 11, 14, 17 };
+    static const int digits[6] = { 4, 2, 2, 2, 2, 2 };
+
+    if (length < sizeof(pattern) - 1) {
+        return NO_EPOCH;
+    }
+    for (size_t i = 0; i < sizeof(pattern) - 1; i++) {
+        if (pattern[i] == 'd' ? !isdigit((unsigned char)text[i]) : text[i] != pattern[i] && !(i == 10 && text[i] == 'T')) {
+            return NO_EPOCH;
+        }
+    }
+    int fields = length >= 19 && text[16] == ':' && isdigit((unsigned char)text[17]) && isdigit((unsigned char)text[18]) ? 6 : 5;
+    for (int f = 0; f < fields; f++) {
+        for (int i = 0; i < digits[f]; i++) {
+            value[f] = value[f] * 10 + (text[offset[f] + i] - '0');
+        }
+    }
+    if (value[1] < 1 || value[1] > 12 || value[2] < 1 || value[2] > 31 ||
+        value[3] > 23 || value[4] > 59 || value[5] > 59) {
+        return NO_EPOCH;
+    }
+    return days_from_civil(value[0], value[1], value[2]) * 86400 + value[3] * 3600 + value[4] * 60 + value[5];
+}
+
+// Function to create the contacts table if it doesn't exist and bring the schema up to date
+static int create_schema(sqlite3 *db) {
     char *err_msg = NULL;
 
     const char *sql_create_table = 
@@ -128,280 +1226,8263 @@ int initialize_database(const char *db_name) {
         "date_time TEXT NOT NULL, "
         "comment TEXT);";
 
-    int rc = sqlite3_open(db_name, &db);
-
+    int rc = sqlite3_exec(db, sql_create_table, 0, 0, &err_msg);
     if (rc != SQLITE_OK) {
-        fprintf(stderr, "Cannot open database: %s\n", sqlite3_errmsg(db));
+        fprintf(stderr, "SQL error: %s\n", err_msg);
+        sqlite3_free(err_msg);
         return rc;
     }
 
-    rc = sqlite3_exec(db, sql_create_table, 0, 0, &err_msg);
+    rc = register_functions(db);
+    if (rc == SQLITE_OK) {
+        rc = apply_migrations(db);
+    }
+    return rc;
+}
+
+// Function to initialize the SQLite3 database and create the table if it doesn't exist
+int initialize_database(const char *db_name) {
+    sqlite3 *db;
+
+    install_timing_vfs();
+    int rc = sqlite3_open(db_name, &db);
 
     if (rc != SQLITE_OK) {
-        fprintf(stderr, "SQL error: %s\n", err_msg);
-        sqlite3_free(err_msg);
-        sqlite3_close(db);
+        fprintf(stderr, "Cannot open database: %s\n", sqlite3_errmsg(db));
         return rc;
     }
 
+    rc = create_schema(db);
     sqlite3_close(db);
-    return SQLITE_OK;
+    return rc;
 }
 
-// Function to log the current contact into the SQLite3 database
-
-int log_contact(const char *db_name, Contact *contact) {
-    sqlite3 *db;
-    char *err_msg = NULL;
-    int rc;
+// Function to bring the schema up to date by running any migrations it hasn't had yet
+int apply_migrations(sqlite3 *db) {
     sqlite3_stmt *stmt;
+    char *err_msg = NULL;
+    int version = 0;
 
-    const char *sql_insert = 
-        "INSERT INTO contacts (callsign, frequency, mode, sent_report, received_report, date_time, comment) "
-        "VALUES (?, ?, ?, ?, ?, ?, ?);";
+    int rc = sqlite3_prepare_v2(db, "PRAGMA user_version", -1, &stmt, NULL);
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "Failed to prepare statement: %s\n", sqlite3_errmsg(db));
+        return rc;
+    }
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        version = sqlite3_column_int(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
 
-    const char *sql_update =
-        "UPDATE contacts SET callsign = ?, frequency = ?, mode = ?, sent_report = ?, received_report = ?, "
-        "date_time = ?, comment = ? WHERE id = ?";
+    while (version < SCHEMA_VERSION) {
+        char set_version[64];
+        snprintf(set_version, sizeof(set_version), "PRAGMA user_version = %d;", version + 1);
 
-    // Check if this is an update (comment contains an ID marker)
-    //int update_id = 0;
-    //if (sscanf(contact->comment, "UPDATE:%d", &update_id) == 1 && update_id > 0) {
-    if (contact->id > 0) {
-        rc = sqlite3_open(db_name, &db);
+        const char *file = sqlite3_db_filename(db, "main");
+        if (file && file[0]) {
+            printf("Upgrading database schema to version %d...\n", version + 1); // Not for a log in memory
+        }
+        rc = sqlite3_exec(db, "BEGIN IMMEDIATE", 0, 0, &err_msg);
+        if (rc == SQLITE_OK) {
+            rc = sqlite3_exec(db, schema_migrations[version], 0, 0, &err_msg);
+        }
+        if (rc == SQLITE_OK) {
+            rc = sqlite3_exec(db, set_version, 0, 0, &err_msg);
+        }
+        if (rc == SQLITE_OK) {
+            rc = sqlite3_exec(db, "COMMIT", 0, 0, &err_msg);
+        }
         if (rc != SQLITE_OK) {
-            fprintf(stderr, "Cannot open database: %s\n", sqlite3_errmsg(db));
+            fprintf(stderr, "SQL error: %s\n", err_msg ? err_msg : sqlite3_errmsg(db));
+            sqlite3_free(err_msg);
+            sqlite3_exec(db, "ROLLBACK", 0, 0, NULL);
             return rc;
         }
+        version++;
+    }
 
-        rc = sqlite3_prepare_v2(db, sql_update, -1, &stmt, NULL);
-        if (rc != SQLITE_OK) {
-            fprintf(stderr, "Failed to prepare update statement: %s\n", sqlite3_errmsg(db));
-            sqlite3_close(db);
-            return rc;
+    return SQLITE_OK;
+}
+
+// Function to find the band a frequency in Hz falls in, or NULL if it's outside the amateur bands
+const char *band_for_hz(long long hz) {
+    for (size_t i = 0; i < BAND_COUNT; i++) {
+        if (hz >= bands[i].low_hz && hz <= bands[i].high_hz) {
+            return bands[i].name;
         }
+    }
+    return NULL;
+}
 
-        // Bind parameters for update
-        sqlite3_bind_text(stmt, 1, contact->callsign_worked, -1, SQLITE_STATIC);
-        sqlite3_bind_text(stmt, 2, contact->frequency, -1, SQLITE_STATIC);
-        sqlite3_bind_text(stmt, 3, contact->mode, -1, SQLITE_STATIC);
-        sqlite3_bind_text(stmt, 4, contact->sent_report, -1, SQLITE_STATIC);
-        sqlite3_bind_text(stmt, 5, contact->received_report, -1, SQLITE_STATIC);
+// Function to write a frequency in Hz the way the logger keeps it: in kHz, e.g. 14074000 + 1500 Hz
+// audio -> 14075.5.  Below 1 MHz it's written in MHz instead (0.4755), as parse_frequency_hz
+// reads a decimal under 1000 as MHz.  Nothing is written for a frequency that can't be right.
+void format_frequency(long long hz, char *buffer, size_t buffer_size) {
+    buffer[0] = '\0';
+    if (hz <= 0 || hz >= 1000000000000LL) {
+        return;
+    }
+    if (hz < 1000000) {
+        snprintf(buffer, buffer_size, "0.%06d", (int)hz);
+    } else {
+        snprintf(buffer, buffer_size, "%d.%03d", (int)(hz / 1000), (int)(hz % 1000));
+    }
 
-        char date_time[40];
-        snprintf(date_time, sizeof(date_time), "%s %s", contact->contact_date, contact->contact_time);
-        sqlite3_bind_text(stmt, 6, date_time, -1, SQLITE_STATIC);
-        //sqlite3_bind_text(stmt, 7, contact->comment + 7, -1, SQLITE_STATIC); // Skip "UPDATE:"
-        sqlite3_bind_text(stmt, 7, contact->comment, -1, SQLITE_STATIC);
+    // Trim trailing zeros, and the decimal point if nothing is left after it
+    char *last = buffer + strlen(buffer) - 1;
+    while (buffer[0] && *last == '0') {
+        *last-- = '\0';
+    }
+    if (buffer[0] && *last == '.') {
+        *last = '\0';
+    }
+}
 
-        // Bind the ID
-        sqlite3_bind_int(stmt, 8, contact->id);
+// Function to parse a frequency as typed or imported and return it in Hz, or 0 if it isn't usable.
+// A unit suffix (Hz, kHz/k, MHz/M, GHz/G) is honoured; without one a decimal value below 1000
+// is MHz (14.250) and anything else is kHz (14025, 0755).
+long long parse_frequency_hz(const char *text, size_t length) {
+    char number[32];
+    while (length > 0 && isspace((unsigned char)*text)) {
+        text++;
+        length--;
+    }
+    while (length > 0 && isspace((unsigned char)text[length - 1])) {
+        length--;
+    }
+    if (length == 0 || length >= sizeof(number)) {
+        return 0;
+    }
+    memcpy(number, text, length);
+    number[length] = '\0';
 
-        // Execute the statement
-        rc = sqlite3_step(stmt);
-        sqlite3_finalize(stmt);
-        sqlite3_close(db);
-        return rc == SQLITE_DONE ? SQLITE_OK : rc;
+    char *end;
+    double value = strtod(number, &end);
+    if (end == number || value <= 0) {
+        return 0;
+    }
+    while (isspace((unsigned char)*end)) {
+        end++;
+    }
+
+    double scale;
+    if (*end == '\0') {
+        scale = (memchr(number, '.', end - number) && value < 1000.0) ? 1e6 : 1e3;
+    } else if (strcasecmp(end, "hz") == 0) {
+        scale = 1.0;
+    } else if (strcasecmp(end, "k") == 0 || strcasecmp(end, "khz") == 0) {
+        scale = 1e3;
+    } else if (strcasecmp(end, "m") == 0 || strcasecmp(end, "mhz") == 0) {
+        scale = 1e6;
+    } else if (strcasecmp(end, "g") == 0 || strcasecmp(end, "ghz") == 0) {
+        scale = 1e9;
     } else {
-        rc = sqlite3_open(db_name, &db);
-        if (rc != SQLITE_OK) {
-            fprintf(stderr, "Cannot open database: %s\n", sqlite3_errmsg(db));
-            return rc;
-        }
+        return 0;
+    }
+    return (long long)(value * scale + 0.5);
+}
 
-        rc = sqlite3_prepare_v2(db, sql_insert, -1, &stmt, NULL);
-        if (rc != SQLITE_OK) {
-            fprintf(stderr, "Failed to prepare statement: %s\n", sqlite3_errmsg(db));
-            sqlite3_close(db);
-            return rc;
-        }
+// SQL function parse_frequency_hz(frequency): a stored frequency text in Hz, or NULL
+static void sql_parse_frequency_hz(sqlite3_context *context, int argc, sqlite3_value **argv) {
+    const char *text = (const char *)sqlite3_value_text(argv[0]);
+    long long hz = text ? parse_frequency_hz(text, sqlite3_value_bytes(argv[0])) : 0;
+    (void)argc;
 
-        // Bind parameters to the prepared statement
-        sqlite3_bind_text(stmt, 1, contact->callsign_worked, -1, SQLITE_STATIC);
-        sqlite3_bind_text(stmt, 2, contact->frequency, -1, SQLITE_STATIC);
-        sqlite3_bind_text(stmt, 3, contact->mode, -1, SQLITE_STATIC);
-        sqlite3_bind_text(stmt, 4, contact->sent_report, -1, SQLITE_STATIC);
-        sqlite3_bind_text(stmt, 5, contact->received_report, -1, SQLITE_STATIC);
+    if (hz > 0) {
+        sqlite3_result_int64(context, hz);
+    } else {
+        sqlite3_result_null(context);
+    }
+}
 
-        // Combine date and time into a single string
-        char date_time[40];
-        snprintf(date_time, sizeof(date_time), "%s %s", contact->contact_date, contact->contact_time);
-        sqlite3_bind_text(stmt, 6, date_time, -1, SQLITE_STATIC);
+// SQL function frequency_band(frequency): the band of a stored frequency text, or NULL
+static void sql_frequency_band(sqlite3_context *context, int argc, sqlite3_value **argv) {
+    const char *text = (const char *)sqlite3_value_text(argv[0]);
+    const char *band = text ? band_for_hz(parse_frequency_hz(text, sqlite3_value_bytes(argv[0]))) : NULL;
+    (void)argc;
 
-        sqlite3_bind_text(stmt, 7, contact->comment, -1, SQLITE_STATIC);
+    if (band) {
+        sqlite3_result_text(context, band, -1, SQLITE_STATIC);
+    } else {
+        sqlite3_result_null(context);
+    }
+}
 
-        // Execute the statement
-        rc = sqlite3_step(stmt);
-        if (rc != SQLITE_DONE) {
-            fprintf(stderr, "Failed to insert contact: %s\n", sqlite3_errmsg(db));
-        }
+// SQL function date_time_epoch(date_time): a stored date_time in seconds since 1970 UTC, or NULL
+static void sql_date_time_epoch(sqlite3_context *context, int argc, sqlite3_value **argv) {
+    const char *text = (const char *)sqlite3_value_text(argv[0]);
+    long long epoch = text ? parse_date_time_epoch(text, sqlite3_value_bytes(argv[0])) : NO_EPOCH;
+    (void)argc;
 
-        sqlite3_finalize(stmt);
-        sqlite3_close(db);
-        return rc == SQLITE_DONE ? SQLITE_OK : rc;       
+    if (epoch != NO_EPOCH) {
+        sqlite3_result_int64(context, epoch);
+    } else {
+        sqlite3_result_null(context);
     }
+}
 
-    return 0;
+// SQL function wpx_prefix(callsign): a callsign's WPX prefix, or NULL
+static void sql_wpx_prefix(sqlite3_context *context, int argc, sqlite3_value **argv) {
+    const char *text = (const char *)sqlite3_value_text(argv[0]);
+    char prefix[16] = "";
+    (void)argc;
+
+    if (text) {
+        wpx_prefix(text, prefix, sizeof(prefix));
+    }
+    if (prefix[0]) {
+        sqlite3_result_text(context, prefix, -1, SQLITE_TRANSIENT);
+    } else {
+        sqlite3_result_null(context);
+    }
 }
 
+// Function to register the logger's SQL functions on a connection
+int register_functions(sqlite3 *db) {
+    int rc = sqlite3_create_function(db, "frequency_band", 1, SQLITE_UTF8 | SQLITE_DETERMINISTIC, NULL,
+                                     sql_frequency_band, NULL, NULL);
+    if (rc == SQLITE_OK) {
+        rc = sqlite3_create_function(db, "parse_frequency_hz", 1, SQLITE_UTF8 | SQLITE_DETERMINISTIC, NULL,
+                                     sql_parse_frequency_hz, NULL, NULL);
+    }
+    if (rc == SQLITE_OK) {
+        rc = sqlite3_create_function(db, "date_time_epoch", 1, SQLITE_UTF8 | SQLITE_DETERMINISTIC, NULL,
+                                     sql_date_time_epoch, NULL, NULL);
+    }
+    if (rc == SQLITE_OK) {
+        rc = sqlite3_create_function(db, "wpx_prefix", 1, SQLITE_UTF8 | SQLITE_DETERMINISTIC, NULL,
+                                     sql_wpx_prefix, NULL, NULL);
+    }
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "Failed to register SQL functions: %s\n", sqlite3_errmsg(db));
+    }
+    return rc;
+}
 
-// Function to view logged contacts in the SQLite3 database
-int view_contacts(const char *db_name, const char *params) {
-    // Query construction based on parameters (not shown for brevity)
-    // Refer to previous code for detailed handling of 'v +N', 'v -N', etc.
-    return 0; // Placeholder for simplicity
+// Function to get the name a log is shown under: its file name without directory or extension
+static void log_display_name(const char *file_name, char *buffer, size_t buffer_size) {
+    const char *base = strrchr(file_name, '/');
+    base = base ? base + 1 : file_name;
+    const char *dot = strrchr(base, '.');
+    size_t length = dot && dot != base ? (size_t)(dot - base) : strlen(base);
+    snprintf(buffer, buffer_size, "%.*s", (int)length, base);
 }
 
-#include <ctype.h>  // For toupper
-#include <string.h> // For strtok
+// Function to open the long-lived database session used for all operations, with the flags
+// sqlite3_open_v2 takes.  An in-memory log is given the schema here, as nothing else can reach it.
+static int open_session_flags(LoggerSession *session, const char *db_name, int flags) {
+    memset(session, 0, sizeof(*session));
+    snprintf(session->synchronous, sizeof(session->synchronous), "NORMAL");
+    session->group_commit_qsos = DEFAULT_GROUP_COMMIT_QSOS;
+    session->group_commit_ms = DEFAULT_GROUP_COMMIT_MS;
+    session->stats.started_us = monotonic_us();
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    session->export_threads = cpus < 1 ? 1 : cpus > EXPORT_MAX_THREADS ? EXPORT_MAX_THREADS : (int)cpus;
+
+    install_timing_vfs();
+    int rc = sqlite3_open_v2(db_name, &session->db, flags, NULL);
+    if (rc == SQLITE_OK && strcmp(db_name, ":memory:") == 0) {
+        rc = create_schema(session->db);
+    }
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "Cannot open database: %s\n", sqlite3_errmsg(session->db));
+        sqlite3_close(session->db);
+        session->db = NULL;
+        return rc;
+    }
 
-#define INPUT_BUFFER_SIZE 256
+    log_display_name(db_name, session->logs[0].name, sizeof(session->logs[0].name));
+    snprintf(session->logs[0].schema, sizeof(session->logs[0].schema), "main");
+    session->log_count = 1;
 
-#include <stdio.h>
+    // A page cache big enough that a batch or import transaction doesn't spill to the file midway,
+    // and statement journals (which the award triggers need) kept in memory rather than temp files
+    char pragma[96];
+    snprintf(pragma, sizeof(pragma), "PRAGMA main.cache_size = -%d; PRAGMA temp_store = MEMORY;", SESSION_CACHE_KB);
+    rc = sqlite3_exec(session->db, pragma, 0, 0, NULL);
 
-// Function to export contacts to a CSV file
-int export_contacts(const char *db_name, const char *file_name) {
-    sqlite3 *db;
-    sqlite3_stmt *stmt;
-    FILE *file;
-    int rc;
+    if (rc == SQLITE_OK) {
+        rc = register_functions(session->db);
+    }
+    if (rc == SQLITE_OK) {
+        rc = rebuild_log_view(session);
+    }
+    if (rc == SQLITE_OK) {
+        rc = build_dupe_index(session);
+    }
+    return rc;
+}
 
-    const char *sql = "SELECT id, callsign, frequency, mode, sent_report, received_report, date_time, comment FROM contacts";
+// Function to open the long-lived database session used for all operations
+int open_session(LoggerSession *session, const char *db_name) {
+    return open_session_flags(session, db_name, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE);
+}
 
-    rc = sqlite3_open(db_name, &db);
-    if (rc != SQLITE_OK) {
-        fprintf(stderr, "Cannot open database: %s\n", sqlite3_errmsg(db));
-        return rc;
+// Function to fetch a cached prepared statement, preparing it on first use.
+// The statement comes back reset with its bindings cleared, ready to be bound again.
+sqlite3_stmt *session_statement(LoggerSession *session, StatementId id) {
+    sqlite3_stmt *stmt = session->statements[id];
+
+    if (stmt == NULL) {
+        int rc = session_prepare(session, statement_sql[id], SQLITE_PREPARE_PERSISTENT, &stmt);
+        if (rc != SQLITE_OK) {
+            fprintf(stderr, "Failed to prepare statement: %s\n", sqlite3_errmsg(session->db));
+            return NULL;
+        }
+        session->statements[id] = stmt;
+    } else {
+        sqlite3_reset(stmt);
+        sqlite3_clear_bindings(stmt);
+    }
+
+    return stmt;
+}
+
+// Function to finalize all cached statements and close the session's connection
+void close_session(LoggerSession *session) {
+    stop_rig_poller(session);
+    stop_udp_listener(session);
+    flush_group_commit(session);
+    disconnect_from_daemon(session);
+
+    for (int i = 0; i < STMT_COUNT; i++) {
+        if (session->statements[i]) {
+            sqlite3_finalize(session->statements[i]);
+            session->statements[i] = NULL;
+        }
+    }
+    if (session->db) {
+        sqlite3_close(session->db);
+        session->db = NULL;
+    }
+
+    free(session->dupes.entries);
+    memset(&session->dupes, 0, sizeof(session->dupes));
+    free_country_file(&session->countries);
+    free_partial_index(&session->partials);
+    stop_contest_scoring(session);
+}
+
+// Function to (re)create the all_contacts view: every contact of every open log in one UNION ALL,
+// with a log column numbering the logs in session order.  Every log has been brought up to the
+// same schema version, so their columns line up.  all_award_credits does the same for award credits.
+int rebuild_log_view(LoggerSession *session) {
+    char sql[256 + MAX_LOGS * 128];
+    char *err_msg = NULL;
+    size_t used = snprintf(sql, sizeof(sql), "DROP VIEW IF EXISTS temp.all_contacts; CREATE TEMP VIEW all_contacts AS ");
+
+    for (int i = 0; i < session->log_count; i++) {
+        used += snprintf(sql + used, sizeof(sql) - used, "%sSELECT %d AS log, * FROM %s.contacts",
+                         i > 0 ? " UNION ALL " : "", i, session->logs[i].schema);
+    }
+    used += snprintf(sql + used, sizeof(sql) - used,
+                     "; DROP VIEW IF EXISTS temp.all_award_credits; CREATE TEMP VIEW all_award_credits AS ");
+    for (int i = 0; i < session->log_count; i++) {
+        used += snprintf(sql + used, sizeof(sql) - used, "%sSELECT * FROM %s.award_credits",
+                         i > 0 ? " UNION ALL " : "", session->logs[i].schema);
     }
 
-    rc = sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
+    int rc = sqlite3_exec(session->db, sql, 0, 0, &err_msg);
     if (rc != SQLITE_OK) {
-        fprintf(stderr, "Failed to prepare statement: %s\n", sqlite3_errmsg(db));
-        sqlite3_close(db);
-        return rc;
+        fprintf(stderr, "SQL error: %s\n", err_msg);
+        sqlite3_free(err_msg);
     }
+    session->view.active = 0; // Log numbers in a paged listing may have moved
+    return rc;
+}
 
-    file = fopen(file_name, "w");
-    if (file == NULL) {
-        fprintf(stderr, "Cannot open file '%s' for writing.\n", file_name);
-        sqlite3_finalize(stmt);
-        sqlite3_close(db);
-        return -1;
+// Function to rebuild the dupe and partial check indexes after the set of open logs changes
+static void rebuild_log_indexes(LoggerSession *session) {
+    char scp_file[sizeof(session->partials.scp_file)];
+
+    free(session->dupes.entries);
+    memset(&session->dupes, 0, sizeof(session->dupes));
+    build_dupe_index(session);
+
+    snprintf(scp_file, sizeof(scp_file), "%s", session->partials.scp_file);
+    build_partial_index(session, scp_file[0] ? scp_file : NULL);
+}
+
+// Function to attach another log file to the session, so searches, dupe checks and exports cover it too.
+// New contacts still go into the main log.
+int attach_log(LoggerSession *session, const char *file_name) {
+    char name[sizeof(session->logs[0].name)];
+    char sql[64];
+    sqlite3_stmt *stmt;
+
+    if (session->log_count >= MAX_LOGS) {
+        printf("Error: At most %d logs can be open at once.\n", MAX_LOGS);
+        return SQLITE_ERROR;
+    }
+    if (access(file_name, R_OK) != 0) {
+        printf("Error: Cannot find log file '%s'.\n", file_name);
+        return SQLITE_CANTOPEN;
+    }
+    log_display_name(file_name, name, sizeof(name));
+    for (int i = 0; i < session->log_count; i++) {
+        if (strcmp(session->logs[i].name, name) == 0) {
+            printf("Error: A log named '%s' is already open.\n", name);
+            return SQLITE_ERROR;
+        }
     }
 
-    // Write the CSV header
-    fprintf(file, "ID,Callsign,Frequency,Mode,Sent Report,Received Report,Date/Time,Note\n");
+    // ATTACH can't run inside a transaction.  Contest mode's pending writes can be committed now,
+    // but a batch script's transaction is only committed at its end.
+    if (session->batch_mode && !sqlite3_get_autocommit(session->db)) {
+        printf("Error: Logs can't be opened after a batch script has started writing; open them with -o instead.\n");
+        return SQLITE_ERROR;
+    }
 
-    // Write each row to the file
-    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
-        fprintf(file, "%d,%s,%s,%s,%s,%s,%s,%s\n",
-                sqlite3_column_int(stmt, 0),
-                sqlite3_column_text(stmt, 1),
-                sqlite3_column_text(stmt, 2),
-                sqlite3_column_text(stmt, 3),
-                sqlite3_column_text(stmt, 4),
-                sqlite3_column_text(stmt, 5),
-                sqlite3_column_text(stmt, 6),
-                sqlite3_column_text(stmt, 7) ? (const char *)sqlite3_column_text(stmt, 7) : "");
+    // Bring its schema up to date first, as for the main log
+    if (initialize_database(file_name) != SQLITE_OK) {
+        return SQLITE_ERROR;
     }
 
-    if (rc != SQLITE_DONE) {
-        fprintf(stderr, "Failed to retrieve contacts: %s\n", sqlite3_errmsg(db));
+    int rc = flush_group_commit(session);
+    if (rc != SQLITE_OK) {
+        return rc;
     }
 
-    fclose(file);
-    sqlite3_finalize(stmt);
-    sqlite3_close(db);
+    // Use the first free schema name: log1, log2, ...
+    LogFile *log = &session->logs[session->log_count];
+    for (int number = 1; number <= MAX_LOGS; number++) {
+        int taken = 0;
+        snprintf(log->schema, sizeof(log->schema), "log%d", number);
+        for (int i = 0; i < session->log_count; i++) {
+            taken |= strcmp(session->logs[i].schema, log->schema) == 0;
+        }
+        if (!taken) {
+            break;
+        }
+    }
+    snprintf(log->name, sizeof(log->name), "%s", name);
 
-    printf("Contacts successfully exported to '%s'.\n", file_name);
-    return SQLITE_OK;
+    snprintf(sql, sizeof(sql), "ATTACH DATABASE ? AS %s", log->schema);
+    rc = session_prepare(session, sql, 0, &stmt);
+    if (rc == SQLITE_OK) {
+        sqlite3_bind_text(stmt, 1, file_name, -1, SQLITE_STATIC);
+        rc = sqlite3_step(stmt) == SQLITE_DONE ? SQLITE_OK : sqlite3_errcode(session->db);
+    }
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "Cannot attach log '%s': %s\n", file_name, sqlite3_errmsg(session->db));
+        session_finalize(session, stmt);
+        return rc;
+    }
+    session_finalize(session, stmt);
+
+    session->log_count++;
+    rc = rebuild_log_view(session);
+    rebuild_log_indexes(session);
+    return rc;
 }
 
-// Function to delete a contact by ID
-int delete_contact(const char *db_name, int contact_id) {
-    sqlite3 *db;
+// Function to detach an attached log by name
+int detach_log(LoggerSession *session, const char *name) {
+    char sql[64];
     char *err_msg = NULL;
-    int rc;
+    int index;
 
-    const char *sql = "DELETE FROM contacts WHERE id = ?";
+    for (index = 1; index < session->log_count; index++) {
+        if (strcmp(session->logs[index].name, name) == 0) {
+            break;
+        }
+    }
+    if (index >= session->log_count) {
+        printf("Error: No attached log named '%s'.\n", name);
+        return SQLITE_ERROR;
+    }
 
-    rc = sqlite3_open(db_name, &db);
+    // DETACH can't run inside a transaction either (see attach_log)
+    if (session->batch_mode && !sqlite3_get_autocommit(session->db)) {
+        printf("Error: Logs can't be closed after a batch script has started writing.\n");
+        return SQLITE_ERROR;
+    }
+    int rc = flush_group_commit(session);
     if (rc != SQLITE_OK) {
-        fprintf(stderr, "Cannot open database: %s\n", sqlite3_errmsg(db));
         return rc;
     }
 
-    sqlite3_stmt *stmt;
-    rc = sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
-    if (rc != SQLITE_OK) {
-        fprintf(stderr, "Failed to prepare statement: %s\n", sqlite3_errmsg(db));
-        sqlite3_close(db);
-        return rc;
+    // The view refers to the log, so it has to go first
+    session->log_count--;
+    LogFile detached = session->logs[index];
+    memmove(&session->logs[index], &session->logs[index + 1], (session->log_count - index) * sizeof(LogFile));
+    rc = rebuild_log_view(session);
+    if (rc == SQLITE_OK) {
+        snprintf(sql, sizeof(sql), "DETACH DATABASE %s", detached.schema);
+        rc = sqlite3_exec(session->db, sql, 0, 0, &err_msg);
+        if (rc != SQLITE_OK) {
+            fprintf(stderr, "SQL error: %s\n", err_msg);
+            sqlite3_free(err_msg);
+        }
     }
 
-    // Bind the contact ID to the prepared statement
-    sqlite3_bind_int(stmt, 1, contact_id);
+    rebuild_log_indexes(session);
+    return rc;
+}
 
-    // Execute the statement
-    rc = sqlite3_step(stmt);
+// Function to list the open logs with how many contacts each holds
+void display_logs(LoggerSession *session) {
+    char sql[64];
+    sqlite3_stmt *stmt;
+
+    printf("Open logs:\n");
+    for (int i = 0; i < session->log_count; i++) {
+        long long count = 0;
+        snprintf(sql, sizeof(sql), "SELECT count(*) FROM %s.contacts", session->logs[i].schema);
+        if (session_prepare(session, sql, 0, &stmt) == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW) {
+            count = sqlite3_column_int64(stmt, 0);
+        }
+        session_finalize(session, stmt);
+        printf("  %-16s %8lld contacts  %s%s\n", session->logs[i].name, count,
+               sqlite3_db_filename(session->db, session->logs[i].schema), i == 0 ? "  (main, new contacts go here)" : "");
+    }
+}
+
+// Function to read a monotonic clock in microseconds
+long long monotonic_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+// Function to add one latency to a histogram
+void latency_record(LatencyHistogram *histogram, long long elapsed_us) {
+    int bucket = 0;
+    while (bucket < LATENCY_BUCKETS - 1 && elapsed_us >= (1LL << bucket)) {
+        bucket++;
+    }
+    histogram->buckets[bucket]++;
+    histogram->count++;
+    histogram->total_us += elapsed_us;
+    if (elapsed_us > histogram->max_us) {
+        histogram->max_us = elapsed_us;
+    }
+}
+
+// Function to estimate a percentile from a histogram: the upper edge of its bucket, or the maximum if lower
+static long long latency_percentile(const LatencyHistogram *histogram, double fraction) {
+    long long wanted = (long long)(histogram->count * fraction + 0.5), seen = 0;
+    for (int bucket = 0; bucket < LATENCY_BUCKETS; bucket++) {
+        seen += histogram->buckets[bucket];
+        if (seen >= wanted && seen > 0) {
+            return bucket < LATENCY_BUCKETS - 1 && (1LL << bucket) < histogram->max_us ? 1LL << bucket : histogram->max_us;
+        }
+    }
+    return histogram->max_us;
+}
+
+// Timing VFS: passes every call through to the default VFS, timing syncs, reads and writes
+typedef struct {
+    sqlite3_file base;      // Must come first
+    sqlite3_file *real;     // The default VFS's file, stored right after this struct
+} TimedFile;
+
+static sqlite3_vfs *timed_parent;
+#define TIMED_REAL(file) (((TimedFile *)(file))->real)
+
+static int timed_close(sqlite3_file *file) {
+    return TIMED_REAL(file)->pMethods->xClose(TIMED_REAL(file));
+}
+
+static int timed_read(sqlite3_file *file, void *buffer, int amount, sqlite3_int64 offset) {
+    long long started_us = monotonic_us();
+    int rc = TIMED_REAL(file)->pMethods->xRead(TIMED_REAL(file), buffer, amount, offset);
+    io_stats.read_us += monotonic_us() - started_us;
+    io_stats.read_count++;
+    io_stats.read_bytes += amount;
+    return rc;
+}
+
+static int timed_write(sqlite3_file *file, const void *buffer, int amount, sqlite3_int64 offset) {
+    long long started_us = monotonic_us();
+    int rc = TIMED_REAL(file)->pMethods->xWrite(TIMED_REAL(file), buffer, amount, offset);
+    io_stats.write_us += monotonic_us() - started_us;
+    io_stats.write_count++;
+    io_stats.write_bytes += amount;
+    return rc;
+}
+
+static int timed_truncate(sqlite3_file *file, sqlite3_int64 size) {
+    return TIMED_REAL(file)->pMethods->xTruncate(TIMED_REAL(file), size);
+}
+
+static int timed_sync(sqlite3_file *file, int flags) {
+    long long started_us = monotonic_us();
+    int rc = TIMED_REAL(file)->pMethods->xSync(TIMED_REAL(file), flags);
+    latency_record(&io_stats.sync, monotonic_us() - started_us);
+    return rc;
+}
+
+static int timed_file_size(sqlite3_file *file, sqlite3_int64 *size) {
+    return TIMED_REAL(file)->pMethods->xFileSize(TIMED_REAL(file), size);
+}
+
+static int timed_lock(sqlite3_file *file, int lock) {
+    return TIMED_REAL(file)->pMethods->xLock(TIMED_REAL(file), lock);
+}
+
+static int timed_unlock(sqlite3_file *file, int lock) {
+    return TIMED_REAL(file)->pMethods->xUnlock(TIMED_REAL(file), lock);
+}
+
+static int timed_check_reserved_lock(sqlite3_file *file, int *result) {
+    return TIMED_REAL(file)->pMethods->xCheckReservedLock(TIMED_REAL(file), result);
+}
+
+static int timed_file_control(sqlite3_file *file, int op, void *arg) {
+    return TIMED_REAL(file)->pMethods->xFileControl(TIMED_REAL(file), op, arg);
+}
+
+static int timed_sector_size(sqlite3_file *file) {
+    return TIMED_REAL(file)->pMethods->xSectorSize(TIMED_REAL(file));
+}
+
+static int timed_device_characteristics(sqlite3_file *file) {
+    return TIMED_REAL(file)->pMethods->xDeviceCharacteristics(TIMED_REAL(file));
+}
+
+static int timed_shm_map(sqlite3_file *file, int page, int page_size, int extend, void volatile **memory) {
+    return TIMED_REAL(file)->pMethods->xShmMap(TIMED_REAL(file), page, page_size, extend, memory);
+}
+
+static int timed_shm_lock(sqlite3_file *file, int offset, int count, int flags) {
+    return TIMED_REAL(file)->pMethods->xShmLock(TIMED_REAL(file), offset, count, flags);
+}
+
+static void timed_shm_barrier(sqlite3_file *file) {
+    TIMED_REAL(file)->pMethods->xShmBarrier(TIMED_REAL(file));
+}
+
+static int timed_shm_unmap(sqlite3_file *file, int delete_flag) {
+    return TIMED_REAL(file)->pMethods->xShmUnmap(TIMED_REAL(file), delete_flag);
+}
+
+static int timed_fetch(sqlite3_file *file, sqlite3_int64 offset, int amount, void **pointer) {
+    return TIMED_REAL(file)->pMethods->xFetch(TIMED_REAL(file), offset, amount, pointer);
+}
+
+static int timed_unfetch(sqlite3_file *file, sqlite3_int64 offset, void *pointer) {
+    return TIMED_REAL(file)->pMethods->xUnfetch(TIMED_REAL(file), offset, pointer);
+}
+
+// One table for each version of the methods a real file can have, so a file is given the same
+// version as its own: SQLite only calls the shared memory (version 2) and memory mapping
+// (version 3) methods when the version says they're there
+static const sqlite3_io_methods timed_io_methods[3] = {
+    { 1, timed_close, timed_read, timed_write, timed_truncate, timed_sync, timed_file_size,
+      timed_lock, timed_unlock, timed_check_reserved_lock, timed_file_control, timed_sector_size,
+      timed_device_characteristics, NULL, NULL, NULL, NULL, NULL, NULL },
+    { 2, timed_close, timed_read, timed_write, timed_truncate, timed_sync, timed_file_size,
+      timed_lock, timed_unlock, timed_check_reserved_lock, timed_file_control, timed_sector_size,
+      timed_device_characteristics, timed_shm_map, timed_shm_lock, timed_shm_barrier, timed_shm_unmap,
+      NULL, NULL },
+    { 3, timed_close, timed_read, timed_write, timed_truncate, timed_sync, timed_file_size,
+      timed_lock, timed_unlock, timed_check_reserved_lock, timed_file_control, timed_sector_size,
+      timed_device_characteristics, timed_shm_map, timed_shm_lock, timed_shm_barrier, timed_shm_unmap,
+      timed_fetch, timed_unfetch }
+};
+
+static int timed_open(sqlite3_vfs *vfs, sqlite3_filename name, sqlite3_file *file, int flags, int *out_flags) {
+    TimedFile *timed = (TimedFile *)file;
+    (void)vfs;
+    timed->real = (sqlite3_file *)&timed[1];
+    int rc = timed_parent->xOpen(timed_parent, name, timed->real, flags, out_flags);
+    const sqlite3_io_methods *real = timed->real->pMethods;
+    file->pMethods = real ? &timed_io_methods[real->iVersion < 1 ? 0 : real->iVersion > 3 ? 2 : real->iVersion - 1] : NULL;
+    return rc;
+}
+
+static int timed_delete(sqlite3_vfs *vfs, const char *name, int sync_dir) {
+    (void)vfs;
+    return timed_parent->xDelete(timed_parent, name, sync_dir);
+}
+
+static int timed_access(sqlite3_vfs *vfs, const char *name, int flags, int *result) {
+    (void)vfs;
+    return timed_parent->xAccess(timed_parent, name, flags, result);
+}
+
+static int timed_full_pathname(sqlite3_vfs *vfs, const char *name, int size, char *out) {
+    (void)vfs;
+    return timed_parent->xFullPathname(timed_parent, name, size, out);
+}
+
+static void *timed_dl_open(sqlite3_vfs *vfs, const char *name) {
+    (void)vfs;
+    return timed_parent->xDlOpen(timed_parent, name);
+}
+
+static void timed_dl_error(sqlite3_vfs *vfs, int size, char *message) {
+    (void)vfs;
+    timed_parent->xDlError(timed_parent, size, message);
+}
+
+static void (*timed_dl_sym(sqlite3_vfs *vfs, void *handle, const char *symbol))(void) {
+    (void)vfs;
+    return timed_parent->xDlSym(timed_parent, handle, symbol);
+}
+
+static void timed_dl_close(sqlite3_vfs *vfs, void *handle) {
+    (void)vfs;
+    timed_parent->xDlClose(timed_parent, handle);
+}
+
+static int timed_randomness(sqlite3_vfs *vfs, int size, char *out) {
+    (void)vfs;
+    return timed_parent->xRandomness(timed_parent, size, out);
+}
+
+static int timed_sleep(sqlite3_vfs *vfs, int microseconds) {
+    (void)vfs;
+    return timed_parent->xSleep(timed_parent, microseconds);
+}
+
+static int timed_current_time(sqlite3_vfs *vfs, double *now) {
+    (void)vfs;
+    return timed_parent->xCurrentTime(timed_parent, now);
+}
+
+static int timed_get_last_error(sqlite3_vfs *vfs, int size, char *message) {
+    (void)vfs;
+    return timed_parent->xGetLastError(timed_parent, size, message);
+}
+
+static int timed_current_time_int64(sqlite3_vfs *vfs, sqlite3_int64 *now) {
+    (void)vfs;
+    return timed_parent->xCurrentTimeInt64(timed_parent, now);
+}
+
+// Function to put the timing VFS in front of the default one, before any database is opened
+int install_timing_vfs(void) {
+    static sqlite3_vfs timed_vfs;
+
+    if (timed_parent) {
+        return SQLITE_OK;
+    }
+    timed_parent = sqlite3_vfs_find(NULL);
+    if (timed_parent == NULL || timed_parent->iVersion < 2) {
+        timed_parent = NULL;
+        return SQLITE_ERROR; // No timings, but everything still works through the default VFS
+    }
+
+    timed_vfs = (sqlite3_vfs) {
+        2, (int)sizeof(TimedFile) + timed_parent->szOsFile, timed_parent->mxPathname, NULL, "osl-timed", NULL,
+        timed_open, timed_delete, timed_access, timed_full_pathname,
+        timed_dl_open, timed_dl_error, timed_dl_sym, timed_dl_close,
+        timed_randomness, timed_sleep, timed_current_time, timed_get_last_error,
+        timed_current_time_int64, NULL, NULL, NULL
+    };
+    return sqlite3_vfs_register(&timed_vfs, 1);
+}
+
+// Function to compile a statement, counting the time spent in SQLite's parser and query planner
+int session_prepare(LoggerSession *session, const char *sql, unsigned int flags, sqlite3_stmt **stmt) {
+    long long started_us = monotonic_us();
+    int rc = sqlite3_prepare_v3(session->db, sql, -1, flags, stmt, NULL);
+    session->stats.prepare_count++;
+    session->stats.prepare_us += monotonic_us() - started_us;
+    return rc;
+}
+
+// Function to finalize a one-off statement, keeping its VM step count for the statistics
+void session_finalize(LoggerSession *session, sqlite3_stmt *stmt) {
+    if (stmt) {
+        session->stats.finalized_vm_steps += sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_VM_STEP, 0);
+        sqlite3_finalize(stmt);
+    }
+}
+
+// Function to clear the statistics the 'w' command shows
+void reset_stats(LoggerSession *session) {
+    int current, high;
+    memset(&session->stats, 0, sizeof(session->stats));
+    memset(&io_stats, 0, sizeof(io_stats));
+    session->stats.started_us = monotonic_us();
+
+    sqlite3_status(SQLITE_STATUS_MEMORY_USED, &current, &high, 1);
+    sqlite3_db_status(session->db, SQLITE_DBSTATUS_CACHE_HIT, &current, &high, 1);
+    sqlite3_db_status(session->db, SQLITE_DBSTATUS_CACHE_MISS, &current, &high, 1);
+    sqlite3_db_status(session->db, SQLITE_DBSTATUS_CACHE_WRITE, &current, &high, 1);
+    sqlite3_db_status(session->db, SQLITE_DBSTATUS_CACHE_SPILL, &current, &high, 1);
+    for (int i = 0; i < STMT_COUNT; i++) {
+        if (session->statements[i]) {
+            sqlite3_stmt_status(session->statements[i], SQLITE_STMTSTATUS_VM_STEP, 1);
+            sqlite3_stmt_status(session->statements[i], SQLITE_STMTSTATUS_FULLSCAN_STEP, 1);
+            sqlite3_stmt_status(session->statements[i], SQLITE_STMTSTATUS_SORT, 1);
+        }
+    }
+}
+
+// Function to print one histogram as a table row, then its non-empty buckets
+static void display_latency(const char *name, const LatencyHistogram *histogram) {
+    printf("  %-9s %7lld %9.3f %9.3f %9.3f %9.3f %9.3f\n", name, histogram->count,
+           histogram->total_us / 1000.0 / histogram->count,
+           latency_percentile(histogram, 0.5) / 1000.0, latency_percentile(histogram, 0.9) / 1000.0,
+           latency_percentile(histogram, 0.99) / 1000.0, histogram->max_us / 1000.0);
+    printf("           ");
+    for (int bucket = 0; bucket < LATENCY_BUCKETS; bucket++) {
+        if (histogram->buckets[bucket]) {
+            if (bucket < 10) {
+                printf(" <%lldus:%lld", 1LL << bucket, histogram->buckets[bucket]);
+            } else if (bucket < LATENCY_BUCKETS - 1) {
+                printf(" <%gms:%lld", (1LL << bucket) / 1000.0, histogram->buckets[bucket]);
+            } else {
+                printf(" more:%lld", histogram->buckets[bucket]);
+            }
+        }
+    }
+    printf("\n");
+}
+
+// Function to show where the time has gone: command latencies, file syncs, query planning,
+// terminal output and SQLite's own counters
+void display_stats(LoggerSession *session) {
+    static const char *statement_names[STMT_COUNT] = {
+        [STMT_INSERT_CONTACT] = "insert contact", [STMT_UPDATE_CONTACT] = "update contact",
+        [STMT_DELETE_CONTACT] = "delete contact", [STMT_SELECT_CONTACT] = "load contact",
+        [STMT_SELECT_ALL_CONTACTS] = "all contacts", [STMT_BEGIN] = "begin", [STMT_COMMIT] = "commit",
+        [STMT_SELECT_CALLSIGN_BY_ID] = "callsign by id", [STMT_SELECT_CALLSIGN_HISTORY] = "callsign history",
+        [STMT_COUNT_RECENT] = "recent count", [STMT_SELECT_MAX_ID] = "max id", [STMT_SELECT_WORKED] = "worked",
+        [STMT_AWARD_STATUS] = "award status", [STMT_SELECT_CONTACT_ROW] = "contact row"
+    };
+    SessionStats *stats = &session->stats;
+    int current, high;
+
+    printf("\nStatistics for the last %.1f s:\n", (monotonic_us() - stats->started_us) / 1e6);
+    printf("\nCommand latency (ms):\n");
+    printf("  command     count      mean      p50<      p90<      p99<       max\n");
+    for (int command = 0; command < 128; command++) {
+        if (stats->commands[command].count) {
+            char name[4] = { (char)command, '\0' };
+            display_latency(name, &stats->commands[command]);
+        }
+    }
+    if (stats->redisplay.count) {
+        display_latency("display", &stats->redisplay);
+    }
+
+    printf("\nWhere the time went:\n");
+    printf("  File syncs (fsync):    %lld, %.1f ms total", io_stats.sync.count, io_stats.sync.total_us / 1000.0);
+    if (io_stats.sync.count) {
+        printf(", %.2f ms each, slowest %.1f ms", io_stats.sync.total_us / 1000.0 / io_stats.sync.count,
+               io_stats.sync.max_us / 1000.0);
+    }
+    printf("\n  File writes:           %lld, %.1f KB in %.1f ms\n", io_stats.write_count,
+           io_stats.write_bytes / 1024.0, io_stats.write_us / 1000.0);
+    printf("  File reads:            %lld, %.1f KB in %.1f ms\n", io_stats.read_count,
+           io_stats.read_bytes / 1024.0, io_stats.read_us / 1000.0);
+    printf("  Query planning:        %lld statements compiled in %.1f ms\n", stats->prepare_count, stats->prepare_us / 1000.0);
+    printf("  Terminal output:       %.1f ms redisplaying the current contact and prompt\n",
+           stats->redisplay.total_us / 1000.0);
+
+    printf("\nSQLite:\n");
+    sqlite3_status(SQLITE_STATUS_MEMORY_USED, &current, &high, 0);
+    printf("  Memory used:           %.1f KB (high water %.1f KB)\n", current / 1024.0, high / 1024.0);
+
+    int hits, misses, writes, spills, cache_used, statement_used, schema_used;
+    sqlite3_db_status(session->db, SQLITE_DBSTATUS_CACHE_HIT, &hits, &high, 0);
+    sqlite3_db_status(session->db, SQLITE_DBSTATUS_CACHE_MISS, &misses, &high, 0);
+    sqlite3_db_status(session->db, SQLITE_DBSTATUS_CACHE_WRITE, &writes, &high, 0);
+    sqlite3_db_status(session->db, SQLITE_DBSTATUS_CACHE_SPILL, &spills, &high, 0);
+    sqlite3_db_status(session->db, SQLITE_DBSTATUS_CACHE_USED, &cache_used, &high, 0);
+    sqlite3_db_status(session->db, SQLITE_DBSTATUS_STMT_USED, &statement_used, &high, 0);
+    sqlite3_db_status(session->db, SQLITE_DBSTATUS_SCHEMA_USED, &schema_used, &high, 0);
+    printf("  Page cache:            %d hits, %d misses", hits, misses);
+    if (hits + misses > 0) {
+        printf(" (%.1f%% hit rate)", 100.0 * hits / (hits + misses));
+    }
+    printf(", %d pages written, %d spilled, %.1f KB in use\n", writes, spills, cache_used / 1024.0);
+    printf("  Statements:            %.1f KB, schema %.1f KB\n", statement_used / 1024.0, schema_used / 1024.0);
+
+    printf("  VM steps:              ");
+    long long total_steps = stats->finalized_vm_steps;
+    for (int i = 0; i < STMT_COUNT; i++) {
+        if (session->statements[i]) {
+            int steps = sqlite3_stmt_status(session->statements[i], SQLITE_STMTSTATUS_VM_STEP, 0);
+            int full_scan = sqlite3_stmt_status(session->statements[i], SQLITE_STMTSTATUS_FULLSCAN_STEP, 0);
+            int sorts = sqlite3_stmt_status(session->statements[i], SQLITE_STMTSTATUS_SORT, 0);
+            total_steps += steps;
+            if (steps) {
+                printf("%s %d", statement_names[i] ? statement_names[i] : "?", steps);
+                if (full_scan || sorts) {
+                    printf(" (%d full scan, %d sorts)", full_scan, sorts);
+                }
+                printf("; ");
+            }
+        }
+    }
+    printf("searches and exports %lld; total %lld\n", stats->finalized_vm_steps, total_steps);
+}
+
+// Function to switch contest mode on or off.
+// On: WAL journaling, the configured synchronous level, and group commits.
+// Off: any pending writes are committed and the default rollback journal is restored.
+int set_contest_mode(LoggerSession *session, int enable) {
+    char pragma[96];
+    char *err_msg = NULL;
+    int rc = flush_group_commit(session);
+    if (rc != SQLITE_OK) {
+        return rc;
+    }
+
+    if (enable) {
+        snprintf(pragma, sizeof(pragma), "PRAGMA main.journal_mode=WAL; PRAGMA main.synchronous=%s;", session->synchronous);
+    } else {
+        snprintf(pragma, sizeof(pragma), "PRAGMA main.journal_mode=DELETE; PRAGMA main.synchronous=FULL;");
+    }
+
+    rc = sqlite3_exec(session->db, pragma, 0, 0, &err_msg);
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "SQL error: %s\n", err_msg);
+        sqlite3_free(err_msg);
+        return rc;
+    }
+
+    if (enable && !session->contest_mode) {
+        session->contest_started_us = monotonic_us();
+        session->contest_writes = 0;
+        session->contest_commits = 0;
+        session->contest_write_us = 0;
+    }
+    session->contest_mode = enable;
+    return SQLITE_OK;
+}
+
+// Function to open the group commit transaction before a write, if contest or batch mode needs one
+static int begin_write(LoggerSession *session) {
+    if ((!session->contest_mode && !session->batch_mode) || !sqlite3_get_autocommit(session->db)) {
+        return SQLITE_OK;
+    }
+
+    sqlite3_stmt *stmt = session_statement(session, STMT_BEGIN);
+    if (stmt == NULL) {
+        return SQLITE_ERROR;
+    }
+
+    int rc = sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+    if (rc != SQLITE_DONE) {
+        fprintf(stderr, "Failed to begin transaction: %s\n", sqlite3_errmsg(session->db));
+        return rc;
+    }
+
+    session->pending_writes = 0;
+    session->pending_since_us = monotonic_us();
+    return SQLITE_OK;
+}
+
+// Function to account for a completed write and commit the group once it is full.
+// Batch mode leaves everything to the commit at the end of the script.
+static int end_write(LoggerSession *session, long long started_us) {
+    int rc = SQLITE_OK;
+
+    if (session->batch_mode) {
+        session->pending_writes++;
+        session->batch_writes++;
+    } else if (session->contest_mode) {
+        session->pending_writes++;
+        session->contest_writes++;
+        if (session->pending_writes >= session->group_commit_qsos) {
+            rc = flush_group_commit(session);
+        }
+        session->contest_write_us += monotonic_us() - started_us;
+    }
+
+    return rc;
+}
+
+// Function to commit any writes pending in the group commit transaction
+int flush_group_commit(LoggerSession *session) {
+    if (session->db == NULL || sqlite3_get_autocommit(session->db)) {
+        return SQLITE_OK;
+    }
+
+    long long started_us = monotonic_us();
+    sqlite3_stmt *stmt = session_statement(session, STMT_COMMIT);
+    if (stmt == NULL) {
+        return SQLITE_ERROR;
+    }
+
+    int rc = sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+    if (rc != SQLITE_DONE) {
+        fprintf(stderr, "Failed to commit contacts: %s\n", sqlite3_errmsg(session->db));
+        return rc;
+    }
+
+    session->pending_writes = 0;
+    session->contest_commits++;
+    session->contest_write_us += monotonic_us() - started_us;
+    return SQLITE_OK;
+}
+
+// Function to get how long input may be waited on before pending writes must be committed.
+// Returns -1 (wait forever) when nothing is pending.
+int group_commit_timeout_ms(LoggerSession *session) {
+    if (session->db == NULL || session->batch_mode || sqlite3_get_autocommit(session->db)) {
+        return -1;
+    }
+
+    long long remaining_us = session->pending_since_us + (long long)session->group_commit_ms * 1000 - monotonic_us();
+    return remaining_us > 0 ? (int)((remaining_us + 999) / 1000) : 0;
+}
+
+// Function to display the contest mode settings and sustained write rate
+void display_contest_status(LoggerSession *session) {
+    printf("Contest mode: %s (journal %s, synchronous %s, commit every %d QSOs or %d ms)\n",
+           session->contest_mode ? "on" : "off",
+           session->contest_mode ? "WAL" : "DELETE",
+           session->contest_mode ? session->synchronous : "FULL",
+           session->group_commit_qsos, session->group_commit_ms);
+
+    if (session->contest_mode) {
+        double elapsed = (monotonic_us() - session->contest_started_us) / 1e6;
+        double db_seconds = session->contest_write_us / 1e6;
+        printf("  %lld writes in %lld group commits over %.1f s, %d pending\n",
+               session->contest_writes, session->contest_commits, elapsed, session->pending_writes);
+        if (session->contest_writes > 0 && db_seconds > 0) {
+            printf("  Sustained insert rate: %.0f inserts/sec (%.3f ms database time per QSO)\n",
+                   session->contest_writes / db_seconds, session->contest_write_us / 1000.0 / session->contest_writes);
+        }
+    }
+
+    // QSO rate over the most recent stretch of the log, counted from the qso_epoch index
+    static const int windows[] = { 600, 3600 };
+    long long counts[2] = { 0, 0 };
+    for (int i = 0; i < 2; i++) {
+        sqlite3_stmt *stmt = session_statement(session, STMT_COUNT_RECENT);
+        if (stmt == NULL) {
+            return;
+        }
+        sqlite3_bind_int(stmt, 1, windows[i]);
+        if (sqlite3_step(stmt) == SQLITE_ROW) {
+            counts[i] = sqlite3_column_int64(stmt, 0);
+        }
+        sqlite3_reset(stmt);
+    }
+    printf("  QSO rate: %lld in the last 10 minutes (%lld/hour), %lld in the last hour of the log\n",
+           counts[0], counts[0] * 6, counts[1]);
+}
+
+// Function to read one line of input, like fgets, waiting at most timeout_ms (-1 waits forever).
+// Returns 1 when a line was read, 0 on timeout, 2 when the wake descriptor is readable,
+// 3 when the logging daemon's connection is and -1 at end of input.
+int read_input_line(InputReader *reader, char *line, size_t line_size, int timeout_ms) {
+    long long deadline_us = timeout_ms >= 0 ? monotonic_us() + (long long)timeout_ms * 1000 : -1;
+
+    while (1) {
+        char *newline = memchr(reader->buffer + reader->start, '\n', reader->end - reader->start);
+        size_t available = reader->end - reader->start;
+
+        // Hand back a complete line, a final unterminated line, or a line too long for the buffer
+        if (newline || (reader->eof && available > 0) || available == sizeof(reader->buffer)) {
+            size_t length = newline ? (size_t)(newline - (reader->buffer + reader->start)) + 1 : available;
+            size_t copy = length < line_size - 1 ? length : line_size - 1;
+            memcpy(line, reader->buffer + reader->start, copy);
+            line[copy] = '\0';
+            reader->start += length;
+            return 1;
+        }
+
+        if (reader->eof) {
+            return -1;
+        }
+
+        // Make room at the end of the buffer for more input
+        if (reader->start > 0) {
+            memmove(reader->buffer, reader->buffer + reader->start, available);
+            reader->start = 0;
+            reader->end = available;
+        }
+
+        int wait_ms = -1;
+        if (deadline_us >= 0) {
+            long long remaining_us = deadline_us - monotonic_us();
+            wait_ms = remaining_us > 0 ? (int)((remaining_us + 999) / 1000) : 0;
+        }
+
+        struct pollfd pfd[3] = { { reader->fd, POLLIN, 0 }, { reader->wake_fd, POLLIN, 0 }, { reader->remote_fd, POLLIN, 0 } };
+        int ready = poll(pfd, 3, wait_ms);
+        if (ready < 0 && errno == EINTR) {
+            continue;
+        }
+        if (ready == 0) {
+            return 0;
+        }
+        if (reader->wake_fd >= 0 && (pfd[1].revents & POLLIN)) {
+            return 2;
+        }
+        if (reader->remote_fd >= 0 && (pfd[2].revents & (POLLIN | POLLHUP | POLLERR))) {
+            return 3;
+        }
+
+        ssize_t count = read(reader->fd, reader->buffer + reader->end, sizeof(reader->buffer) - reader->end);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            reader->eof = 1;
+        } else {
+            reader->end += count;
+        }
+    }
+}
+
+// Function to sort a mode into the group used for dupe checking
+int mode_category(const char *mode, size_t length) {
+    static const char *phone_modes[] = { "SSB", "USB", "LSB", "AM", "FM", "PH", "PHONE", "DV" };
+
+    if (mode == NULL || length == 0) {
+        return MODE_NONE;
+    }
+    if (length == 2 && strncasecmp(mode, "CW", 2) == 0) {
+        return MODE_CW;
+    }
+    for (size_t i = 0; i < sizeof(phone_modes) / sizeof(phone_modes[0]); i++) {
+        if (strlen(phone_modes[i]) == length && strncasecmp(mode, phone_modes[i], length) == 0) {
+            return MODE_PHONE;
+        }
+    }
+    return MODE_DIGITAL;
+}
+
+// Function to find the bands[] index of a frequency in Hz, or BAND_COUNT if it isn't in a band
+int band_index_for_hz(long long hz) {
+    for (size_t i = 0; i < BAND_COUNT; i++) {
+        if (hz >= bands[i].low_hz && hz <= bands[i].high_hz) {
+            return (int)i;
+        }
+    }
+    return BAND_COUNT;
+}
+
+// Function to find the bands[] index of a frequency as typed, or BAND_COUNT if it isn't in a band
+int band_index_for_frequency(const char *frequency, size_t length) {
+    return band_index_for_hz(frequency ? parse_frequency_hz(frequency, length) : 0);
+}
+
+// Function to normalize a callsign for comparison: upper case with surrounding spaces removed
+void normalize_callsign(const char *callsign, size_t length, char *buffer, size_t buffer_size) {
+    size_t out = 0;
+    while (length > 0 && isspace((unsigned char)*callsign)) {
+        callsign++;
+        length--;
+    }
+    while (length > 0 && isspace((unsigned char)callsign[length - 1])) {
+        length--;
+    }
+    for (size_t i = 0; i < length && out < buffer_size - 1; i++) {
+        buffer[out++] = toupper((unsigned char)callsign[i]);
+    }
+    buffer[out] = '\0';
+}
+
+// Function to check for a portable suffix that plays no part in a WPX prefix, like /P or /QRP
+static int wpx_ignored_part(const char *part) {
+    static const char *ignored[] = { "P", "M", "MM", "AM", "QRP", "A", "B" };
+    for (size_t i = 0; i < sizeof(ignored) / sizeof(ignored[0]); i++) {
+        if (strcmp(part, ignored[i]) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Function to work out a callsign's WPX prefix: everything up to and including the last digit
+// (N8BJQ -> N8, 2E0ABC -> 2E0, W100AW -> W100).  A portable designator takes over from the home
+// call (W1AW/KH6 -> KH6, PA/K1ABC -> PA0), a portable digit replaces the call's (W1AW/3 -> W3),
+// and prefixes without a digit get a 0.  Empty if there's no callsign.
+void wpx_prefix(const char *callsign, char *buffer, size_t buffer_size) {
+    char call[64];
+    const char *parts[3];
+    int part_count = 0;
+    char digit = '\0';
+
+    buffer[0] = '\0';
+    normalize_callsign(callsign, strlen(callsign), call, sizeof(call));
+
+    // Split on '/' by hand: the command line parser is in the middle of a strtok
+    char *part = call;
+    while (part && part_count < 3) {
+        char *slash = strchr(part, '/');
+        if (slash) {
+            *slash = '\0';
+        }
+        if (part[0] && part[1] == '\0' && isdigit((unsigned char)part[0])) {
+            digit = part[0];
+        } else if (part[0] && !wpx_ignored_part(part)) {
+            parts[part_count++] = part;
+        }
+        part = slash ? slash + 1 : NULL;
+    }
+    if (part_count == 0) {
+        return;
+    }
+
+    // Of a call and a designator, the designator is the shorter
+    const char *base = part_count > 1 && strlen(parts[1]) < strlen(parts[0]) ? parts[1] : parts[0];
+    size_t length = strlen(base), last_digit = length;
+    for (size_t i = 0; i < length; i++) {
+        if (isdigit((unsigned char)base[i])) {
+            last_digit = i;
+        }
+    }
+
+    int used = last_digit < length ? snprintf(buffer, buffer_size, "%.*s", (int)last_digit + 1, base)
+                                   : snprintf(buffer, buffer_size, "%.2s0", base);
+    if (digit && used > 0 && (size_t)used < buffer_size) {
+        buffer[used - 1] = digit;
+    }
+}
+
+// Function to hash a normalized callsign (FNV-1a)
+static unsigned int callsign_hash(const char *callsign) {
+    unsigned int hash = 2166136261u;
+    while (*callsign) {
+        hash = (hash ^ (unsigned char)*callsign++) * 16777619u;
+    }
+    return hash;
+}
+
+// Function to find a station in the dupe index, optionally adding an empty entry for it.
+// Callsigns too long for an entry aren't indexed, rather than truncated into another station's.
+static DupeEntry *dupe_find(DupeIndex *index, const char *normalized, int create) {
+    if (strlen(normalized) >= sizeof(index->entries->callsign)) {
+        return NULL;
+    }
+    if (index->entries == NULL || (create && (index->used + 1) * 2 > index->capacity)) {
+        if (!create) {
+            return NULL;
+        }
+
+        // Grow the table and re-insert everything
+        size_t capacity = index->capacity ? index->capacity * 2 : DUPE_INDEX_INITIAL_CAPACITY;
+        DupeEntry *entries = calloc(capacity, sizeof(DupeEntry));
+        if (entries == NULL) {
+            return NULL;
+        }
+        for (size_t i = 0; i < index->capacity; i++) {
+            if (index->entries[i].callsign[0]) {
+                size_t slot = index->entries[i].hash & (capacity - 1);
+                while (entries[slot].callsign[0]) {
+                    slot = (slot + 1) & (capacity - 1);
+                }
+                entries[slot] = index->entries[i];
+            }
+        }
+        free(index->entries);
+        index->entries = entries;
+        index->capacity = capacity;
+    }
+
+    unsigned int hash = callsign_hash(normalized);
+    size_t slot = hash & (index->capacity - 1);
+    while (index->entries[slot].callsign[0]) {
+        DupeEntry *entry = &index->entries[slot];
+        if (entry->hash == hash && strcmp(entry->callsign, normalized) == 0) {
+            return entry;
+        }
+        slot = (slot + 1) & (index->capacity - 1);
+    }
+
+    if (!create) {
+        return NULL;
+    }
+    DupeEntry *entry = &index->entries[slot];
+    snprintf(entry->callsign, sizeof(entry->callsign), "%s", normalized);
+    entry->hash = hash;
+    index->used++;
+    return entry;
+}
+
+// Function to record a contact in the dupe index. Returns 1 if the station wasn't in the index yet.
+int dupe_index_add(DupeIndex *index, const char *callsign, size_t length, int band, int mode) {
+    char normalized[64];
+    normalize_callsign(callsign, length, normalized, sizeof(normalized));
+    if (normalized[0] == '\0') {
+        return 0;
+    }
+
+    size_t used = index->used;
+    DupeEntry *entry = dupe_find(index, normalized, 1);
+    if (entry) {
+        entry->worked[mode] |= 1u << band;
+    }
+    return index->used > used;
+}
+
+// Function to rebuild one station's dupe index entry from the database, after an edit or delete
+int dupe_index_refresh(LoggerSession *session, const char *callsign) {
+    char normalized[64];
+    normalize_callsign(callsign, strlen(callsign), normalized, sizeof(normalized));
+    if (normalized[0] == '\0' || strlen(normalized) >= sizeof(session->dupes.entries->callsign)) {
+        return SQLITE_OK;
+    }
+
+    DupeEntry *entry = dupe_find(&session->dupes, normalized, 1);
+    sqlite3_stmt *stmt = session_statement(session, STMT_SELECT_CALLSIGN_HISTORY);
+    if (entry == NULL || stmt == NULL) {
+        return SQLITE_ERROR;
+    }
+
+    memset(entry->worked, 0, sizeof(entry->worked));
+    sqlite3_bind_text(stmt, 1, normalized, -1, SQLITE_STATIC);
+
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        int band = band_index_for_hz(sqlite3_column_int64(stmt, 0));
+        int mode = mode_category((const char *)sqlite3_column_text(stmt, 1), sqlite3_column_bytes(stmt, 1));
+        entry->worked[mode] |= 1u << band;
+    }
+    sqlite3_reset(stmt);
+    return rc == SQLITE_DONE ? SQLITE_OK : rc;
+}
+
+// Function to build the dupe index from every logged contact, in every open log
+int build_dupe_index(LoggerSession *session) {
+    sqlite3_stmt *stmt = session_statement(session, STMT_SELECT_WORKED);
+    if (stmt == NULL) {
+        return SQLITE_ERROR;
+    }
+
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        dupe_index_add(&session->dupes,
+                       (const char *)sqlite3_column_text(stmt, 0), sqlite3_column_bytes(stmt, 0),
+                       band_index_for_hz(sqlite3_column_int64(stmt, 1)),
+                       mode_category((const char *)sqlite3_column_text(stmt, 2), sqlite3_column_bytes(stmt, 2)));
+    }
+    sqlite3_reset(stmt);
+
+    if (rc != SQLITE_DONE) {
+        fprintf(stderr, "Failed to build the dupe index: %s\n", sqlite3_errmsg(session->db));
+        return rc;
+    }
+    return SQLITE_OK;
+}
+
+// Function to show whether the current contact would be a dupe, a new band or mode, or a new station
+void display_dupe_status(LoggerSession *session, const Contact *contact) {
+    static const char *mode_names[MODE_CATEGORY_COUNT] = { "CW", "phone", "digital", "no mode" };
+    char normalized[64];
+
+    normalize_callsign(contact->callsign_worked, strlen(contact->callsign_worked), normalized, sizeof(normalized));
+    DupeEntry *entry = dupe_find(&session->dupes, normalized, 0);
+
+    unsigned int any_mode = 0;
+    if (entry) {
+        for (int m = 0; m < MODE_CATEGORY_COUNT; m++) {
+            any_mode |= entry->worked[m];
+        }
+    }
+    if (any_mode == 0) {
+        printf("  %s: NEW STATION - not in the log.\n", normalized);
+        return;
+    }
+
+    int band = band_index_for_frequency(contact->frequency, strlen(contact->frequency));
+    int mode = mode_category(contact->mode, strlen(contact->mode));
+    const char *band_name = band < (int)BAND_COUNT ? bands[band].name : "unknown band";
+
+    if (entry->worked[mode] & (1u << band)) {
+        printf("  %s: ** DUPE ** - already worked on %s %s.\n", normalized, band_name, mode_names[mode]);
+    } else if (band == (int)BAND_COUNT) {
+        printf("  %s: worked before; set the frequency to check the band.\n", normalized);
+    } else if (!(any_mode & (1u << band))) {
+        printf("  %s: NEW BAND - worked before, but not on %s.\n", normalized, band_name);
+    } else {
+        printf("  %s: NEW MODE - worked on %s before, but not %s.\n", normalized, band_name, mode_names[mode]);
+    }
+}
+
+// The 50 states counted for Worked All States
+static const char *was_states[] = {
+    "AK", "AL", "AR", "AZ", "CA", "CO", "CT", "DE", "FL", "GA", "HI", "IA", "ID", "IL", "IN", "KS", "KY",
+    "LA", "MA", "MD", "ME", "MI", "MN", "MO", "MS", "MT", "NC", "ND", "NE", "NH", "NJ", "NM", "NV", "NY",
+    "OH", "OK", "OR", "PA", "RI", "SC", "SD", "TN", "TX", "UT", "VA", "VT", "WA", "WI", "WV", "WY"
+};
+#define WAS_STATE_COUNT (sizeof(was_states) / sizeof(was_states[0]))
+
+// Award credit mode groups, indexed by ModeCategory, as stored in award_credits.mode
+static const char *award_modes[MODE_CATEGORY_COUNT] = { "CW", "PHONE", "DIGITAL", "" };
+
+// Function to find an award by its name in award_credits, or AWARD_COUNT
+static int award_index(const char *name) {
+    int award;
+    for (award = 0; award < AWARD_COUNT; award++) {
+        if (name && strcasecmp(name, award_names[award]) == 0) {
+            break;
+        }
+    }
+    return award;
+}
+
+// Function to work out the award entities a contact would count for: its DXCC entity (the
+// country file prefix), its state for WAS (US entities only) and its WPX prefix
+static void award_entities(const Contact *contact, char entities[AWARD_COUNT][16]) {
+    const char *dxcc = contact->country_prefix;
+    int in_us = dxcc[0] == '\0' || strcmp(dxcc, "K") == 0 || strcmp(dxcc, "KL") == 0 || strcmp(dxcc, "KH6") == 0;
+
+    snprintf(entities[AWARD_DXCC], 16, "%s", dxcc);
+    snprintf(entities[AWARD_WAS], 16, "%s", in_us ? contact->state : "");
+    wpx_prefix(contact->callsign_worked, entities[AWARD_WPX], 16);
+}
+
+// Function to show which awards the current contact would be a new one for: a new entity,
+// or a known entity on a new band or a new mode on that band.  One indexed lookup per award.
+void display_award_status(LoggerSession *session, const Contact *contact) {
+    char entities[AWARD_COUNT][16];
+    if (!log_readable(session, 1)) {
+        return;
+    }
+    award_entities(contact, entities);
+
+    const char *band = band_for_hz(parse_frequency_hz(contact->frequency, strlen(contact->frequency)));
+    const char *mode = award_modes[mode_category(contact->mode, strlen(contact->mode))];
+
+    sqlite3_stmt *stmt = session_statement(session, STMT_AWARD_STATUS);
+    if (stmt == NULL) {
+        return;
+    }
+    for (int award = 0; award < AWARD_COUNT; award++) {
+        sqlite3_bind_text(stmt, award + 1, entities[award], -1, SQLITE_STATIC);
+    }
+
+    // Each award is a prefix range scan of the credit table's key; the band and mode rows it
+    // returns are compared here rather than grouped in SQL, which would need a sorter per call
+    int worked[AWARD_COUNT] = { 0 }, on_band[AWARD_COUNT] = { 0 }, on_mode[AWARD_COUNT] = { 0 };
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        int award = sqlite3_column_int(stmt, 0);
+        const char *row_band = (const char *)sqlite3_column_text(stmt, 1);
+        const char *row_mode = (const char *)sqlite3_column_text(stmt, 2);
+        if (award < 0 || award >= AWARD_COUNT) {
+            continue;
+        }
+        worked[award] = 1;
+        if (band && row_band && strcmp(row_band, band) == 0) {
+            on_band[award] = 1;
+            if (row_mode && strcmp(row_mode, mode) == 0) {
+                on_mode[award] = 1;
+            }
+        }
+    }
+    sqlite3_reset(stmt);
+
+    for (int award = 0; award < AWARD_COUNT; award++) {
+        if (entities[award][0] == '\0') {
+            continue;
+        }
+        if (!worked[award]) {
+            printf("  %s: NEW ONE - %s%s%s%s.\n", award_names[award], entities[award],
+                   award == AWARD_DXCC ? " (" : "", award == AWARD_DXCC ? contact->country : "", award == AWARD_DXCC ? ")" : "");
+        } else if (band && !on_band[award]) {
+            printf("  %s: %s new on %s.\n", award_names[award], entities[award], band);
+        } else if (band && mode[0] && !on_mode[award]) {
+            printf("  %s: %s new on %s %s.\n", award_names[award], entities[award], band, mode);
+        }
+    }
+}
+
+// Function to print a set of bands (bit n is bands[n]) in band order
+static void print_band_list(unsigned int mask) {
+    for (size_t i = 0; i < BAND_COUNT; i++) {
+        if (mask & (1u << i)) {
+            printf(" %s", bands[i].name);
+        }
+    }
+}
+
+// Function to find the bands[] index of a band name, or BAND_COUNT
+static int band_index_for_name(const char *name) {
+    for (size_t i = 0; i < BAND_COUNT; i++) {
+        if (name && strcmp(bands[i].name, name) == 0) {
+            return (int)i;
+        }
+    }
+    return BAND_COUNT;
+}
+
+// Function to show award progress: entities worked per award, band and mode, or with an award
+// name, every entity worked for it with its bands and modes (and for WAS, the states still needed)
+int display_awards(LoggerSession *session, const char *award_name) {
+    sqlite3_stmt *stmt;
+    int rc;
+
+    if (!log_readable(session, 0)) {
+        return SQLITE_CANTOPEN;
+    }
+
+    if (award_name == NULL) {
+        // Summary: count distinct entities overall, per band and per mode, straight from the credit table
+        rc = session_prepare(session,
+            "SELECT award, '' AS band, '' AS mode, count(DISTINCT entity) FROM all_award_credits GROUP BY award "
+            "UNION ALL SELECT award, band, NULL, count(DISTINCT entity) FROM all_award_credits GROUP BY award, band "
+            "UNION ALL SELECT award, NULL, mode, count(DISTINCT entity) FROM all_award_credits GROUP BY award, mode",
+            0, &stmt);
+        if (rc != SQLITE_OK) {
+            fprintf(stderr, "Failed to prepare statement: %s\n", sqlite3_errmsg(session->db));
+            return rc;
+        }
+
+        long long totals[AWARD_COUNT] = { 0 };
+        long long per_band[AWARD_COUNT][BAND_COUNT + 1];
+        long long per_mode[AWARD_COUNT][MODE_CATEGORY_COUNT];
+        memset(per_band, 0, sizeof(per_band));
+        memset(per_mode, 0, sizeof(per_mode));
+        while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+            int award = award_index((const char *)sqlite3_column_text(stmt, 0));
+            const char *band = (const char *)sqlite3_column_text(stmt, 1);
+            const char *mode = (const char *)sqlite3_column_text(stmt, 2);
+            long long count = sqlite3_column_int64(stmt, 3);
+            if (award == AWARD_COUNT) {
+                continue;
+            }
+            if (band && mode) {
+                totals[award] = count;
+            } else if (band) {
+                per_band[award][band_index_for_name(band)] = count;
+            } else {
+                for (int m = 0; m < MODE_CATEGORY_COUNT; m++) {
+                    if (mode && strcmp(mode, award_modes[m]) == 0) {
+                        per_mode[award][m] = count;
+                    }
+                }
+            }
+        }
+        session_finalize(session, stmt);
+        if (rc != SQLITE_DONE) {
+            fprintf(stderr, "Failed to read award credits: %s\n", sqlite3_errmsg(session->db));
+            return rc;
+        }
+
+        printf("\nAward progress:\n");
+        for (int award = 0; award < AWARD_COUNT; award++) {
+            printf("  %-5s %5lld worked", award_names[award], totals[award]);
+            if (award == AWARD_WAS) {
+                printf(" of %d", (int)WAS_STATE_COUNT);
+            }
+            for (int m = 0; m < MODE_CATEGORY_COUNT - 1; m++) {
+                printf("  %s %lld", award_modes[m], per_mode[award][m]);
+            }
+            printf("\n");
+            if (totals[award]) {
+                printf("       ");
+                for (size_t i = 0; i < BAND_COUNT; i++) {
+                    if (per_band[award][i]) {
+                        printf(" %s %lld", bands[i].name, per_band[award][i]);
+                    }
+                }
+                printf("\n");
+            }
+        }
+        return SQLITE_OK;
+    }
+
+    int award = award_index(award_name);
+    if (award == AWARD_COUNT) {
+        printf("Error: Unknown award '%s'. Use dxcc, was or wpx.\n", award_name);
+        return SQLITE_ERROR;
+    }
+
+    // Rows come in primary key order, entity by entity, so each entity's bands and modes are adjacent
+    rc = session_prepare(session,
+        "SELECT entity, band, mode, qsos FROM all_award_credits WHERE award = ? ORDER BY entity", 0, &stmt);
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "Failed to prepare statement: %s\n", sqlite3_errmsg(session->db));
+        return rc;
+    }
+    sqlite3_bind_text(stmt, 1, award_names[award], -1, SQLITE_STATIC);
+
+    char entity[16] = "";
+    unsigned int band_mask = 0, mode_mask = 0;
+    long long qsos = 0, entity_count = 0;
+    int state_worked[WAS_STATE_COUNT] = { 0 };
+
+    printf("\n%s worked:\n", award_names[award]);
+    while (1) {
+        rc = sqlite3_step(stmt);
+        const char *next = rc == SQLITE_ROW ? (const char *)sqlite3_column_text(stmt, 0) : NULL;
+
+        // Print the previous entity once all of its rows have been seen
+        if (entity[0] && (next == NULL || strcmp(next, entity) != 0)) {
+            printf("  %-8s %5lld QSOs ", entity, qsos);
+            for (int m = 0; m < MODE_CATEGORY_COUNT - 1; m++) {
+                printf(" %-7s", mode_mask & (1u << m) ? award_modes[m] : "");
+            }
+            print_band_list(band_mask);
+            printf("\n");
+            for (size_t i = 0; award == AWARD_WAS && i < WAS_STATE_COUNT; i++) {
+                state_worked[i] |= strcmp(entity, was_states[i]) == 0;
+            }
+            entity_count++;
+            band_mask = mode_mask = 0;
+            qsos = 0;
+        }
+        if (next == NULL) {
+            break;
+        }
+
+        snprintf(entity, sizeof(entity), "%s", next);
+        band_mask |= 1u << band_index_for_name((const char *)sqlite3_column_text(stmt, 1));
+        const char *mode = (const char *)sqlite3_column_text(stmt, 2);
+        for (int m = 0; m < MODE_CATEGORY_COUNT - 1; m++) {
+            if (mode && strcmp(mode, award_modes[m]) == 0) {
+                mode_mask |= 1u << m;
+            }
+        }
+        qsos += sqlite3_column_int64(stmt, 3);
+    }
+    session_finalize(session, stmt);
+    if (rc != SQLITE_DONE) {
+        fprintf(stderr, "Failed to read award credits: %s\n", sqlite3_errmsg(session->db));
+        return rc;
+    }
+
+    printf("%lld %s worked.\n", entity_count, award == AWARD_WPX ? "prefixes" : award == AWARD_WAS ? "states" : "entities");
+    if (award == AWARD_WAS) {
+        printf("Still needed:");
+        for (size_t i = 0; i < WAS_STATE_COUNT; i++) {
+            if (!state_worked[i]) {
+                printf(" %s", was_states[i]);
+            }
+        }
+        printf("\n");
+    }
+    return SQLITE_OK;
+}
+
+// Function to find an entry in a contest table, optionally adding an empty one for it
+static ContestEntry *contest_find(ContestTable *table, const char *key, int create) {
+    if (table->entries == NULL || (create && (table->used + 1) * 2 > table->capacity)) {
+        if (!create) {
+            return NULL;
+        }
+
+        // Grow the table and re-insert everything
+        size_t capacity = table->capacity ? table->capacity * 2 : CONTEST_TABLE_INITIAL_CAPACITY;
+        ContestEntry *entries = calloc(capacity, sizeof(ContestEntry));
+        if (entries == NULL) {
+            return NULL;
+        }
+        for (size_t i = 0; i < table->capacity; i++) {
+            if (table->entries[i].key[0]) {
+                size_t slot = table->entries[i].hash & (capacity - 1);
+                while (entries[slot].key[0]) {
+                    slot = (slot + 1) & (capacity - 1);
+                }
+                entries[slot] = table->entries[i];
+            }
+        }
+        free(table->entries);
+        table->entries = entries;
+        table->capacity = capacity;
+    }
+
+    unsigned int hash = callsign_hash(key);
+    size_t slot = hash & (table->capacity - 1);
+    while (table->entries[slot].key[0]) {
+        ContestEntry *entry = &table->entries[slot];
+        if (entry->hash == hash && strncmp(entry->key, key, sizeof(entry->key) - 1) == 0) {
+            return entry;
+        }
+        slot = (slot + 1) & (table->capacity - 1);
+    }
+
+    if (!create) {
+        return NULL;
+    }
+    ContestEntry *entry = &table->entries[slot];
+    snprintf(entry->key, sizeof(entry->key), "%s", key);
+    entry->hash = hash;
+    table->used++;
+    return entry;
+}
+
+// Function to check for the end of a word in a report.  Reports are typed as one word, so the
+// parts of a contest exchange are written with slashes between them, e.g. r 599/14 or r 3A/EPA.
+static int report_separator(char c) {
+    return c == '/' || isspace((unsigned char)c);
+}
+
+// Function to copy the last word of a report, e.g. the section of "3A/EPA", upper-cased.
+// Returns 1 if it's all digits, 2 if it's all letters and 0 otherwise (or if there isn't one).
+static int report_last_word(const char *report, char *buffer, size_t buffer_size) {
+    const char *end = report + strlen(report);
+    while (end > report && report_separator(end[-1])) {
+        end--;
+    }
+    const char *start = end;
+    while (start > report && !report_separator(start[-1])) {
+        start--;
+    }
+
+    int digits = start < end, letters = start < end;
+    size_t used = 0;
+    for (const char *c = start; c < end; c++) {
+        digits &= isdigit((unsigned char)*c) != 0;
+        letters &= isalpha((unsigned char)*c) != 0;
+        if (used + 1 < buffer_size) {
+            buffer[used++] = (char)toupper((unsigned char)*c);
+        }
+    }
+    buffer[used] = '\0';
+    return digits ? 1 : letters ? 2 : 0;
+}
+
+// Function to copy a report's words with single spaces between them.  Returns how many there are.
+static int report_words(const char *report, char *buffer, size_t buffer_size) {
+    int words = 0;
+    size_t used = 0;
+    for (const char *c = report; *c; c++) {
+        if (report_separator(*c)) {
+            continue;
+        }
+        if (c == report || report_separator(c[-1])) {
+            if (words++ && used + 1 < buffer_size) {
+                buffer[used++] = ' ';
+            }
+        }
+        if (used + 1 < buffer_size) {
+            buffer[used++] = (char)toupper((unsigned char)*c);
+        }
+    }
+    buffer[used] = '\0';
+    return words;
+}
+
+// Function to check whether an entity counts as W/VE in the ARRL DX contest: the 48 states and Canada
+static int contest_w_ve(const char *country_prefix) {
+    return strcmp(country_prefix, "K") == 0 || strcmp(country_prefix, "VE") == 0;
+}
+
+// Function to work out a QSO's points and multipliers from the contest's rules.  This is the only
+// place they're worked out, for the scoreboard, the c command and the Cabrillo export alike.
+static void score_contest_qso(const ContestScore *score, ContestQso *qso) {
+    const ContestEvent *event = score->event;
+    int same_country = qso->country_prefix[0] && strcmp(qso->country_prefix, score->country_prefix) == 0;
+    int same_continent = !qso->continent[0] || !score->continent[0] || strcmp(qso->continent, score->continent) == 0;
+    int north_america = strcmp(qso->continent, "NA") == 0 && strcmp(score->continent, "NA") == 0;
+    const char *band = qso->band < (int)BAND_COUNT ? bands[qso->band].name : "";
+    int low_band = strcmp(band, "160m") == 0 || strcmp(band, "80m") == 0 || strcmp(band, "40m") == 0;
+
+    // A zone in the received exchange is what the other station sent; otherwise the country file's
+    char word[16];
+    int numeric = report_last_word(qso->received, word, sizeof(word)) == 1;
+    int cq_zone = numeric && atoi(word) >= 1 && atoi(word) <= 40 ? atoi(word) : qso->cq_zone;
+    int itu_zone = numeric && atoi(word) >= 1 && atoi(word) <= 90 ? atoi(word) : qso->itu_zone;
+
+    switch (event->points) {
+        case POINTS_CQWW:
+            qso->points = same_country ? 0 : !same_continent ? 3 : north_america ? 2 : 1;
+            break;
+        case POINTS_WPX:
+            qso->points = (same_country ? 1 : !same_continent ? 3 : north_america ? 2 : 1) * (low_band ? 2 : 1);
+            break;
+        case POINTS_ARRL_DX:
+            qso->points = contest_w_ve(qso->country_prefix) != score->w_ve ? 3 : 0;
+            break;
+        case POINTS_IARU:
+            qso->points = itu_zone == 0 || itu_zone == score->itu_zone ? 1 : same_continent ? 3 : 5;
+            break;
+        case POINTS_FIELD_DAY:
+            qso->points = qso->mode == MODE_PHONE ? 1 : 2;
+            break;
+        case POINTS_TWO:
+            qso->points = 2;
+            break;
+    }
+
+    for (int i = 0; i < CONTEST_MAX_MULTS; i++) {
+        char *mult = qso->mults[i];
+        mult[0] = '\0';
+        switch (event->mults[i]) {
+            case MULT_NONE:
+                break;
+            case MULT_DXCC:
+                snprintf(mult, sizeof(qso->mults[i]), "%s", qso->country_prefix);
+                break;
+            case MULT_CQ_ZONE:
+            case MULT_ITU_ZONE: {
+                int zone = event->mults[i] == MULT_CQ_ZONE ? cq_zone : itu_zone;
+                if (zone > 0) {
+                    snprintf(mult, sizeof(qso->mults[i]), "%d", zone);
+                }
+                break;
+            }
+            case MULT_WPX:
+                snprintf(mult, sizeof(qso->mults[i]), "%s", qso->wpx);
+                break;
+            case MULT_ARRL_DX:
+                // W/VE stations count the entities they work outside W/VE, everyone else the states and provinces
+                if (score->w_ve && !contest_w_ve(qso->country_prefix)) {
+                    snprintf(mult, sizeof(qso->mults[i]), "%s", qso->country_prefix);
+                } else if (!score->w_ve && contest_w_ve(qso->country_prefix)) {
+                    if (qso->state[0]) {
+                        snprintf(mult, sizeof(qso->mults[i]), "%s", qso->state);
+                    } else if (report_last_word(qso->received, word, sizeof(word)) == 2) {
+                        snprintf(mult, sizeof(qso->mults[i]), "%s", word);
+                    }
+                }
+                break;
+            case MULT_SECTION:
+                if (report_last_word(qso->received, word, sizeof(word)) == 2) {
+                    snprintf(mult, sizeof(qso->mults[i]), "%s", word);
+                }
+                break;
+        }
+    }
+}
+
+// Function to read a QSO for the contest from a row of EXPORT_COLUMNS
+static void contest_qso_from_row(sqlite3_stmt *stmt, ContestQso *qso) {
+    const char *text;
+    memset(qso, 0, sizeof(*qso));
+    normalize_callsign((const char *)sqlite3_column_text(stmt, 1), sqlite3_column_bytes(stmt, 1), qso->callsign, sizeof(qso->callsign));
+    qso->hz = sqlite3_column_int64(stmt, 13);
+    qso->band = band_index_for_hz(qso->hz);
+    qso->mode = mode_category((const char *)sqlite3_column_text(stmt, 3), sqlite3_column_bytes(stmt, 3));
+    qso->epoch = sqlite3_column_type(stmt, 15) == SQLITE_NULL ? NO_EPOCH : sqlite3_column_int64(stmt, 15);
+    qso->cq_zone = sqlite3_column_int(stmt, 10);
+    qso->itu_zone = sqlite3_column_int(stmt, 11);
+    if ((text = (const char *)sqlite3_column_text(stmt, 3))) {
+        snprintf(qso->mode_name, sizeof(qso->mode_name), "%s", text);
+    }
+    if ((text = (const char *)sqlite3_column_text(stmt, 4))) {
+        snprintf(qso->sent, sizeof(qso->sent), "%s", text);
+    }
+    if ((text = (const char *)sqlite3_column_text(stmt, 5))) {
+        snprintf(qso->received, sizeof(qso->received), "%s", text);
+    }
+    if ((text = (const char *)sqlite3_column_text(stmt, 9))) {
+        snprintf(qso->country_prefix, sizeof(qso->country_prefix), "%s", text);
+    }
+    if ((text = (const char *)sqlite3_column_text(stmt, 12))) {
+        snprintf(qso->continent, sizeof(qso->continent), "%s", text);
+    }
+    if ((text = (const char *)sqlite3_column_text(stmt, 16))) {
+        snprintf(qso->state, sizeof(qso->state), "%s", text);
+    }
+    if ((text = (const char *)sqlite3_column_text(stmt, 17))) {
+        snprintf(qso->wpx, sizeof(qso->wpx), "%s", text);
+    }
+    qso->serial = sqlite3_column_int64(stmt, 20);
+}
+
+// Function to read a QSO for the contest from the contact being entered
+static void contest_qso_from_contact(const Contact *contact, ContestQso *qso) {
+    char date_time[40];
+    memset(qso, 0, sizeof(*qso));
+    normalize_callsign(contact->callsign_worked, strlen(contact->callsign_worked), qso->callsign, sizeof(qso->callsign));
+    qso->hz = parse_frequency_hz(contact->frequency, strlen(contact->frequency));
+    qso->band = band_index_for_hz(qso->hz);
+    qso->mode = mode_category(contact->mode, strlen(contact->mode));
+    snprintf(date_time, sizeof(date_time), "%s %s", contact->contact_date, contact->contact_time);
+    qso->epoch = parse_date_time_epoch(date_time, strlen(date_time));
+    qso->cq_zone = contact->cq_zone;
+    qso->itu_zone = contact->itu_zone;
+    snprintf(qso->mode_name, sizeof(qso->mode_name), "%s", contact->mode);
+    snprintf(qso->sent, sizeof(qso->sent), "%s", contact->sent_report);
+    snprintf(qso->received, sizeof(qso->received), "%s", contact->received_report);
+    snprintf(qso->country_prefix, sizeof(qso->country_prefix), "%s", contact->country_prefix);
+    snprintf(qso->continent, sizeof(qso->continent), "%s", contact->continent);
+    snprintf(qso->state, sizeof(qso->state), "%s", contact->state);
+    wpx_prefix(contact->callsign_worked, qso->wpx, sizeof(qso->wpx));
+    qso->serial = contact->serial;
+}
+
+// Function to read a logged contact by ID and score it.  Returns 1 if it was found.
+static int contest_read_qso(LoggerSession *session, long long id, ContestQso *qso) {
+    sqlite3_stmt *stmt = session_statement(session, STMT_SELECT_CONTACT_ROW);
+    if (stmt == NULL) {
+        return 0;
+    }
+    sqlite3_bind_int64(stmt, 1, id);
+    int found = sqlite3_step(stmt) == SQLITE_ROW;
+    if (found) {
+        contest_qso_from_row(stmt, qso);
+        score_contest_qso(session->contest, qso);
+    }
+    sqlite3_reset(stmt);
+    return found;
+}
+
+// Function to check whether a QSO falls within the contest
+static int contest_counts_qso(const ContestScore *score, const ContestQso *qso) {
+    return qso->callsign[0] &&
+           (score->start_epoch == NO_EPOCH || (qso->epoch >= score->start_epoch && qso->epoch < score->end_epoch));
+}
+
+// Function to make the key a QSO's station is counted under: the callsign, with the band and mode
+// group as well if the contest allows the station to be worked again on another one
+static void contest_station_key(const ContestScore *score, const ContestQso *qso, char *key, size_t key_size) {
+    switch (score->event->dupes) {
+        case DUPE_BAND:
+            snprintf(key, key_size, "%s %d", qso->callsign, qso->band);
+            break;
+        case DUPE_BAND_MODE:
+            snprintf(key, key_size, "%s %d %d", qso->callsign, qso->band, qso->mode);
+            break;
+        case DUPE_ONCE:
+            snprintf(key, key_size, "%s", qso->callsign);
+            break;
+    }
+}
+
+// Function to make the key a multiplier is counted under: its kind and value, and the band if
+// the contest counts it again on each band
+static void contest_mult_key(const ContestScore *score, const ContestQso *qso, int kind, char *key, size_t key_size) {
+    if (score->event->mults_per_band) {
+        snprintf(key, key_size, "%d %s %d", kind, qso->mults[kind], qso->band);
+    } else {
+        snprintf(key, key_size, "%d %s", kind, qso->mults[kind]);
+    }
+}
+
+// Function to find where a time goes among the sorted QSO times: the first index with a later time
+static size_t contest_time_index(const ContestScore *score, long long epoch) {
+    size_t low = 0, high = score->time_count;
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if (score->times[middle] <= epoch) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+// Function to add (delta 1) or take away (delta -1) a scored QSO's part in the running score.
+// The first QSO with a station earns its points and the first with a multiplier earns that;
+// taking the last one away takes them back.
+static void contest_count(ContestScore *score, const ContestQso *qso, int delta) {
+    if (!contest_counts_qso(score, qso)) {
+        return;
+    }
+    char key[64];
+
+    score->qsos += delta;
+    score->band_qsos[qso->band] += delta;
+    score->mode_qsos[qso->mode] += delta;
+    if (delta > 0 && qso->serial >= score->next_serial) {
+        score->next_serial = qso->serial + 1; // Not taken back on a delete, so a number is never sent twice
+    }
+
+    contest_station_key(score, qso, key, sizeof(key));
+    ContestEntry *entry = contest_find(&score->stations, key, delta > 0);
+    if (entry) {
+        entry->count += delta;
+        if (delta > 0 && entry->count == 1) {
+            entry->band = qso->band;
+            entry->points = qso->points;
+            score->unique++;
+            score->points += entry->points;
+            score->band_unique[entry->band]++;
+            score->band_points[entry->band] += entry->points;
+        } else if (delta < 0 && entry->count == 0) {
+            score->unique--;
+            score->points -= entry->points;
+            score->band_unique[entry->band]--;
+            score->band_points[entry->band] -= entry->points;
+        }
+    }
+
+    for (int i = 0; i < CONTEST_MAX_MULTS; i++) {
+        if (qso->mults[i][0] == '\0') {
+            continue;
+        }
+        contest_mult_key(score, qso, i, key, sizeof(key));
+        entry = contest_find(&score->mults, key, delta > 0);
+        if (entry == NULL) {
+            continue;
+        }
+        entry->count += delta;
+        if (delta > 0 && entry->count == 1) {
+            entry->band = qso->band;
+            score->mult_count[i]++;
+            score->band_mults[i][entry->band]++;
+        } else if (delta < 0 && entry->count == 0) {
+            score->mult_count[i]--;
+            score->band_mults[i][entry->band]--;
+        }
+    }
+
+    // Keep the QSO times in order for the rates
+    if (qso->epoch == NO_EPOCH) {
+        return;
+    }
+    size_t index = score->counting_log ? score->time_count : contest_time_index(score, qso->epoch);
+    if (delta > 0) {
+        if (score->time_count == score->time_capacity) {
+            size_t capacity = score->time_capacity ? score->time_capacity * 2 : CONTEST_TABLE_INITIAL_CAPACITY;
+            long long *times = realloc(score->times, capacity * sizeof(long long));
+            if (times == NULL) {
+                return;
+            }
+            score->times = times;
+            score->time_capacity = capacity;
+        }
+        memmove(score->times + index + 1, score->times + index, (score->time_count - index) * sizeof(long long));
+        score->times[index] = qso->epoch;
+        score->time_count++;
+    } else if (index > 0 && score->times[index - 1] == qso->epoch) {
+        memmove(score->times + index - 1, score->times + index, (score->time_count - index) * sizeof(long long));
+        score->time_count--;
+    }
+}
+
+// Function to count the QSOs in the last so many seconds of the contest's part of the log
+static long long contest_recent(const ContestScore *score, int seconds) {
+    if (score->time_count == 0) {
+        return 0;
+    }
+    return (long long)(score->time_count - contest_time_index(score, score->times[score->time_count - 1] - seconds));
+}
+
+// Function to get the claimed score: the points, times the multipliers if the contest has them
+static long long contest_total(const ContestScore *score) {
+    long long mults = 0;
+    for (int i = 0; i < CONTEST_MAX_MULTS; i++) {
+        mults += score->mult_count[i];
+    }
+    return score->event->multiply ? score->points * mults : score->points;
+}
+
+// Function to name a kind of multiplier, one or several of them
+static const char *contest_mult_name(const ContestScore *score, int kind, int plural) {
+    switch (score->event->mults[kind]) {
+        case MULT_DXCC:
+            return plural ? "countries" : "country";
+        case MULT_CQ_ZONE:
+        case MULT_ITU_ZONE:
+            return plural ? "zones" : "zone";
+        case MULT_WPX:
+            return plural ? "prefixes" : "prefix";
+        case MULT_ARRL_DX:
+            return score->w_ve ? (plural ? "countries" : "country") : (plural ? "states" : "state");
+        case MULT_SECTION:
+            return plural ? "sections" : "section";
+        default:
+            return "";
+    }
+}
+
+// Function to order QSO times
+static int compare_contest_times(const void *a, const void *b) {
+    long long x = *(const long long *)a, y = *(const long long *)b;
+    return (x > y) - (x < y);
+}
+
+// Function to drop all the counts, keeping the contest and station they're for
+static void clear_contest_counts(ContestScore *score) {
+    free(score->stations.entries);
+    free(score->mults.entries);
+    free(score->times);
+    memset(&score->stations, 0, sizeof(*score) - offsetof(ContestScore, stations));
+}
+
+// Function to count the whole main log into the score, once, when scoring starts or after an import
+int rebuild_contest_score(LoggerSession *session) {
+    ContestScore *score = session->contest;
+    ContestQso qso;
+    clear_contest_counts(score);
+
+    sqlite3_stmt *stmt = session_statement(session, STMT_SELECT_ALL_CONTACTS);
+    if (stmt == NULL) {
+        return SQLITE_ERROR;
+    }
+    int rc;
+    score->counting_log = 1;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        contest_qso_from_row(stmt, &qso);
+        score_contest_qso(score, &qso);
+        contest_count(score, &qso, 1);
+    }
+    sqlite3_reset(stmt);
+    score->counting_log = 0;
+    qsort(score->times, score->time_count, sizeof(long long), compare_contest_times);
+
+    if (rc != SQLITE_DONE) {
+        fprintf(stderr, "Failed to score the log: %s\n", sqlite3_errmsg(session->db));
+        return rc;
+    }
+    return SQLITE_OK;
+}
+
+// Function to stop scoring a contest
+void stop_contest_scoring(LoggerSession *session) {
+    if (session->contest) {
+        clear_contest_counts(session->contest);
+        free(session->contest);
+        session->contest = NULL;
+    }
+}
+
+// Function to start scoring a contest for our station, from the whole log or from a start date and
+// time for as long as the contest runs.  The log is counted once; after that every change to it
+// adjusts the score as it's made.
+int start_contest_scoring(LoggerSession *session, const char *name, const char *station, const char *date, const char *time) {
+    const ContestEvent *event = NULL;
+    if (!log_readable(session, 0)) {
+        return SQLITE_CANTOPEN;
+    }
+    for (size_t i = 0; i < CONTEST_EVENT_COUNT; i++) {
+        if (strcasecmp(name, contest_events[i].name) == 0) {
+            event = &contest_events[i];
+        }
+    }
+    if (event == NULL) {
+        printf("Error: Unknown contest '%s'. Contests:", name);
+        for (size_t i = 0; i < CONTEST_EVENT_COUNT; i++) {
+            printf(" %s", contest_events[i].name);
+        }
+        printf("\n");
+        return SQLITE_OK;
+    }
+    if (session->remote) {
+        printf("Error: The score is kept by the logger that writes the log, not on a position.\n");
+        return SQLITE_OK;
+    }
+
+    long long start_epoch = NO_EPOCH;
+    if (date) {
+        char date_time[40];
+        snprintf(date_time, sizeof(date_time), "%s %s", date, time ? time : "00:00");
+        start_epoch = parse_date_time_epoch(date_time, strlen(date_time));
+        if (start_epoch == NO_EPOCH) {
+            printf("Error: The start must be a date and time, YYYY-MM-DD [HH:MM].\n");
+            return SQLITE_OK;
+        }
+    }
+
+    ContestScore *score = calloc(1, sizeof(ContestScore));
+    if (score == NULL) {
+        fprintf(stderr, "Out of memory starting the contest score.\n");
+        return SQLITE_NOMEM;
+    }
+    score->event = event;
+    normalize_callsign(station, strlen(station), score->station, sizeof(score->station));
+    score->start_epoch = start_epoch;
+    score->end_epoch = start_epoch == NO_EPOCH ? NO_EPOCH : start_epoch + event->hours * 3600LL;
+
+    // Where we are decides the points, so look our own callsign up too
+    Contact mine;
+    memset(&mine, 0, sizeof(mine));
+    if (lookup_country(&session->countries, score->station, &mine)) {
+        snprintf(score->country_prefix, sizeof(score->country_prefix), "%s", mine.country_prefix);
+        snprintf(score->continent, sizeof(score->continent), "%s", mine.continent);
+        score->cq_zone = mine.cq_zone;
+        score->itu_zone = mine.itu_zone;
+        score->w_ve = contest_w_ve(mine.country_prefix);
+    } else {
+        printf("Warning: '%s' isn't in the country file, so points that depend on where you are will be off.\n", score->station);
+    }
+
+    stop_contest_scoring(session);
+    session->contest = score;
+    long long started_us = monotonic_us();
+    int rc = rebuild_contest_score(session);
+    if (rc != SQLITE_OK) {
+        stop_contest_scoring(session);
+        return rc;
+    }
+    printf("Scoring the %s for %s: %lld QSOs counted from the log in %.1f ms.\n", event->title, score->station,
+           score->qsos, (monotonic_us() - started_us) / 1000.0);
+    display_contest_summary(session);
+    return SQLITE_OK;
+}
+
+// Function to write a time as YYYY-MM-DD HH:MM
+static void format_contest_time(long long epoch, char *buffer, size_t buffer_size) {
+    int year, month, day, seconds;
+    epoch_to_civil(epoch, &year, &month, &day, &seconds);
+    snprintf(buffer, buffer_size, "%04d-%02d-%02d %02d:%02d", year, month, day, seconds / 3600, seconds / 60 % 60);
+}
+
+// Function to show the running score in one line, as after each QSO
+void display_contest_summary(LoggerSession *session) {
+    const ContestScore *score = session->contest;
+    if (score == NULL) {
+        return;
+    }
+    long long mults = 0;
+    for (int i = 0; i < CONTEST_MAX_MULTS; i++) {
+        mults += score->mult_count[i];
+    }
+    if (score->event->multiply) {
+        printf("  Score: %lld QSOs, %lld points x %lld multiplier%s = %lld (%lld in the last 10 minutes)\n",
+               score->unique, score->points, mults, mults == 1 ? "" : "s", contest_total(score), contest_recent(score, 600));
+    } else {
+        printf("  Score: %lld QSOs, %lld points, %lld %s (%lld in the last 10 minutes)\n", score->unique, score->points,
+               mults, contest_mult_name(score, 0, 1), contest_recent(score, 600));
+    }
+}
+
+// Function to show the scoreboard: QSOs, dupes, points and multipliers by band, the score and the QSO rates
+void display_contest_score(LoggerSession *session) {
+    const ContestScore *score = session->contest;
+    if (score == NULL) {
+        printf("Not scoring a contest. Use 'K <contest> <your call> [YYYY-MM-DD [HH:MM]]' to start. Contests:\n");
+        for (size_t i = 0; i < CONTEST_EVENT_COUNT; i++) {
+            printf("  %-8s %s\n", contest_events[i].name, contest_events[i].title);
+        }
+        return;
+    }
+
+    const ContestEvent *event = score->event;
+    printf("\n%s for %s", event->title, score->station);
+    if (score->country_prefix[0]) {
+        printf(" (%s, %s, CQ zone %d, ITU zone %d)", score->country_prefix, score->continent, score->cq_zone, score->itu_zone);
+    }
+    if (score->start_epoch != NO_EPOCH) {
+        char start[24], end[24];
+        format_contest_time(score->start_epoch, start, sizeof(start));
+        format_contest_time(score->end_epoch, end, sizeof(end));
+        printf(", %s to %s", start, end);
+    } else {
+        printf(", the whole log");
+    }
+    printf(":\n  Band       QSOs   Dupes  Points");
+    for (int i = 0; i < CONTEST_MAX_MULTS; i++) {
+        if (event->mults[i] != MULT_NONE) {
+            const char *name = contest_mult_name(score, i, 1);
+            printf(" %*c%s", 9 - (int)strlen(name), toupper((unsigned char)name[0]), name + 1);
+        }
+    }
+    printf("\n");
+
+    for (size_t band = 0; band <= BAND_COUNT; band++) {
+        if (score->band_qsos[band] == 0) {
+            continue;
+        }
+        printf("  %-7s %7lld %7lld %7lld", band < BAND_COUNT ? bands[band].name : "other", score->band_qsos[band],
+               score->band_qsos[band] - score->band_unique[band], score->band_points[band]);
+        for (int i = 0; i < CONTEST_MAX_MULTS; i++) {
+            if (event->mults[i] != MULT_NONE) {
+                printf(" %9lld", score->band_mults[i][band]);
+            }
+        }
+        printf("\n");
+    }
+    printf("  %-7s %7lld %7lld %7lld", "Total", score->qsos, score->qsos - score->unique, score->points);
+    long long mults = 0;
+    for (int i = 0; i < CONTEST_MAX_MULTS; i++) {
+        if (event->mults[i] != MULT_NONE) {
+            printf(" %9lld", score->mult_count[i]);
+            mults += score->mult_count[i];
+        }
+    }
+    printf("\n");
+
+    if (event->multiply) {
+        printf("  Score: %lld points x %lld multiplier%s = %lld\n", score->points, mults, mults == 1 ? "" : "s", contest_total(score));
+    } else {
+        printf("  Score: %lld points\n", score->points);
+    }
+    long long last_10 = contest_recent(score, 600);
+    printf("  QSO rate: %lld in the last 10 minutes (%lld/hour), %lld in the last hour of the log\n",
+           last_10, last_10 * 6, contest_recent(score, 3600));
+}
+
+// Function to get the serial number a new contact goes out with: the one it already has, or the
+// contest's next if the contest being scored exchanges them.  Returns 0 if it has none.
+static long long contest_serial(const ContestScore *score, const Contact *contact) {
+    if (contact->serial > 0 || score == NULL || score->event->exchange != EXCHANGE_SERIAL) {
+        return contact->serial;
+    }
+    return score->next_serial > 0 ? score->next_serial : 1;
+}
+
+// Function to show what the current contact would be worth: its points, or that it's a dupe,
+// and any multipliers it would be the first QSO for
+void display_contest_qso(LoggerSession *session, const Contact *contact) {
+    ContestScore *score = session->contest;
+    ContestQso qso;
+    char key[64];
+    if (score == NULL) {
+        return;
+    }
+
+    // Shown under the contest's name in capitals, like the award lines above it
+    char name[16];
+    for (size_t i = 0; i < sizeof(name); i++) {
+        name[i] = (char)toupper((unsigned char)score->event->name[i]);
+        if (name[i] == '\0') {
+            break;
+        }
+    }
+    name[sizeof(name) - 1] = '\0';
+
+    contest_qso_from_contact(contact, &qso);
+    score_contest_qso(score, &qso);
+    contest_station_key(score, &qso, key, sizeof(key));
+    ContestEntry *entry = contest_find(&score->stations, key, 0);
+    char serial[32] = "";
+    if (contact->id == 0 && contest_serial(score, contact) > 0) {
+        snprintf(serial, sizeof(serial), "serial %03lld, ", contest_serial(score, contact));
+    }
+    if (entry && entry->count > 0) {
+        printf("  %s: %sdupe, no points.\n", name, serial);
+        return;
+    }
+
+    printf("  %s: %s%d point%s", name, serial, qso.points, qso.points == 1 ? "" : "s");
+    int new_mults = 0;
+    for (int i = 0; i < CONTEST_MAX_MULTS; i++) {
+        if (qso.mults[i][0] == '\0') {
+            continue;
+        }
+        contest_mult_key(score, &qso, i, key, sizeof(key));
+        entry = contest_find(&score->mults, key, 0);
+        if (entry == NULL || entry->count == 0) {
+            printf("%s %s %s", new_mults++ ? "," : ", NEW MULTIPLIER:", contest_mult_name(score, i, 0), qso.mults[i]);
+        }
+    }
+    printf(".\n");
+}
+
+// Function to hash a callsign for the unique-call estimate: 64-bit FNV-1a, then mixed (the
+// MurmurHash3 finalizer) so the register number and the run of zeros both come out uniform
+static unsigned long long stats_call_hash(const unsigned char *callsign, int length) {
+    unsigned long long hash = 14695981039346656037ULL;
+    for (int i = 0; i < length; i++) {
+        hash = (hash ^ callsign[i]) * 1099511628211ULL;
+    }
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+// Function to count a hashed callsign in a HyperLogLog: the first bits pick a register, which
+// keeps the longest run of zeros seen in the rest
+static void stats_hll_add(unsigned char *registers, unsigned long long hash) {
+    unsigned int index = (unsigned int)(hash >> (64 - STATS_HLL_BITS));
+    unsigned long long rest = hash << STATS_HLL_BITS;
+    unsigned char rank = 1;
+    while (rank <= 64 - STATS_HLL_BITS && !(rest & (1ULL << 63))) {
+        rank++;
+        rest <<= 1;
+    }
+    if (rank > registers[index]) {
+        registers[index] = rank;
+    }
+}
+
+// Function to take the natural log of a number of at least 1, so the logger still builds without
+// libm: halve it down below 2, then sum the atanh series, ln x = 2 atanh((x - 1) / (x + 1))
+static double stats_ln(double x) {
+    double result = 0;
+    while (x >= 2) {
+        x /= 2;
+        result += 0.69314718055994531;
+    }
+    double y = (x - 1) / (x + 1), term = y;
+    for (int n = 1; n < 40; n += 2) {
+        result += 2 * term / n;
+        term *= y * y;
+    }
+    return result;
+}
+
+// Function to estimate how many different callsigns went into a HyperLogLog.  Small counts,
+// where many registers are still empty, are estimated from the empty ones (linear counting).
+static long long stats_hll_estimate(const unsigned char *registers) {
+    double m = STATS_HLL_REGISTERS, sum = 0;
+    int empty = 0;
+    for (int i = 0; i < STATS_HLL_REGISTERS; i++) {
+        sum += 1.0 / (double)(1ULL << registers[i]);
+        empty += registers[i] == 0;
+    }
+    double estimate = 0.7213 / (1 + 1.079 / m) * m * m / sum;
+    if (estimate <= 2.5 * m && empty > 0) {
+        estimate = m * stats_ln(m / empty);
+    }
+    return (long long)(estimate + 0.5);
+}
+
+// Function to find the counter for a minute, adding it if it's new; NULL if out of memory
+static StatsMinute *stats_minute(StatsMinutes *minutes, long long minute) {
+    if (minutes->entries == NULL || (minutes->used + 1) * 2 > minutes->capacity) {
+        size_t capacity = minutes->capacity ? minutes->capacity * 2 : STATS_MINUTES_INITIAL_CAPACITY;
+        StatsMinute *entries = calloc(capacity, sizeof(StatsMinute));
+        if (entries == NULL) {
+            return NULL;
+        }
+        for (size_t i = 0; i < minutes->capacity; i++) {
+            if (minutes->entries[i].count > 0) {
+                size_t slot = (size_t)(minutes->entries[i].minute * 2654435761ULL) & (capacity - 1);
+                while (entries[slot].count > 0) {
+                    slot = (slot + 1) & (capacity - 1);
+                }
+                entries[slot] = minutes->entries[i];
+            }
+        }
+        free(minutes->entries);
+        minutes->entries = entries;
+        minutes->capacity = capacity;
+    }
+
+    size_t slot = (size_t)(minute * 2654435761ULL) & (minutes->capacity - 1);
+    while (minutes->entries[slot].count > 0 && minutes->entries[slot].minute != minute) {
+        slot = (slot + 1) & (minutes->capacity - 1);
+    }
+    if (minutes->entries[slot].count == 0) {
+        minutes->entries[slot].minute = minute;
+        minutes->used++;
+    }
+    return &minutes->entries[slot];
+}
+
+// Function to order minute counters by time
+static int compare_stats_minutes(const void *a, const void *b) {
+    long long x = ((const StatsMinute *)a)->minute, y = ((const StatsMinute *)b)->minute;
+    return (x > y) - (x < y);
+}
+
+// Function to find the most QSOs made in any window of the given length, and when it started.
+// The minutes must be sorted; the window slides from one minute with QSOs to the next.
+static long long stats_best_rate(const StatsMinute *minutes, size_t count, long long window, long long *start) {
+    long long best = 0, in_window = 0;
+    size_t first = 0;
+    for (size_t last = 0; last < count; last++) {
+        in_window += minutes[last].count;
+        while (minutes[first].minute <= minutes[last].minute - window) {
+            in_window -= minutes[first++].count;
+        }
+        if (in_window > best) {
+            best = in_window;
+            *start = minutes[first].minute * 60;
+        }
+    }
+    return best;
+}
+
+// Function to show statistics for the log, or the part of it a search picks out: QSOs by band,
+// mode, hour and continent, unique calls and the best rates.  It is one pass over the contacts
+// in the order they're stored, counting into fixed tables; only the minutes with QSOs, for the
+// rates, are kept as they come.  Unique calls are HyperLogLog estimates, so the memory doesn't
+// grow with the log.
+int display_statistics(LoggerSession *session, const char *params) {
+    static const char *continents[] = { "AF", "AN", "AS", "EU", "NA", "OC", "SA" };
+    enum { CONTINENT_COUNT = sizeof(continents) / sizeof(continents[0]) };
+    long long band_qsos[BAND_COUNT + 1][MODE_CATEGORY_COUNT] = { { 0 } };
+    long long mode_qsos[STATS_MAX_MODES + 1] = { 0 };
+    char mode_names[STATS_MAX_MODES][24];
+    int mode_categories[STATS_MAX_MODES];
+    int mode_count = 0, m = STATS_MAX_MODES;
+    int band = BAND_COUNT;
+    long long hour_qsos[24] = { 0 };
+    long long continent_qsos[CONTINENT_COUNT + 1] = { 0 };
+    long long qsos = 0, undated = 0, first_epoch = 0, last_epoch = 0;
+    StatsMinutes minutes = { NULL, 0, 0 };
+    int rc;
+
+    if (!log_readable(session, 0)) {
+        return SQLITE_CANTOPEN;
+    }
+
+    // One HyperLogLog per band (the last for no band) and one for the whole selection
+    unsigned char (*calls)[STATS_HLL_REGISTERS] = calloc(BAND_COUNT + 2, STATS_HLL_REGISTERS);
+    if (calls == NULL) {
+        fprintf(stderr, "Out of memory.\n");
+        return SQLITE_NOMEM;
+    }
+
+    ViewQuery query;
+    int limit;
+    parse_view_params(&query, params, &limit);
+    sqlite3_stmt *stmt = prepare_view_query(session, &query, "callsign, frequency_hz, mode, qso_epoch, continent", limit);
+    if (stmt == NULL) {
+        free(calls);
+        return SQLITE_ERROR;
+    }
+
+    long long started_us = monotonic_us();
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        const unsigned char *callsign = sqlite3_column_text(stmt, 0);
+        int callsign_length = sqlite3_column_bytes(stmt, 0);
+        const char *mode = (const char *)sqlite3_column_text(stmt, 2);
+        const char *continent = (const char *)sqlite3_column_text(stmt, 4);
+        qsos++;
+
+        // Runs of QSOs on one band are the rule, so the last band is tried first
+        if (sqlite3_column_type(stmt, 1) == SQLITE_NULL) {
+            band = BAND_COUNT;
+        } else {
+            long long hz = sqlite3_column_int64(stmt, 1);
+            if (band == BAND_COUNT || hz < bands[band].low_hz || hz > bands[band].high_hz) {
+                band = band_index_for_hz(hz);
+            }
+        }
+
+        // Modes as logged, the first few seen getting a line each; again the last one is tried first
+        mode = mode ? mode : "";
+        if (m == STATS_MAX_MODES || strcmp(mode_names[m], mode) != 0) {
+            m = 0;
+            while (m < mode_count && strcmp(mode_names[m], mode) != 0) {
+                m++;
+            }
+            if (m == mode_count && mode_count < STATS_MAX_MODES && strlen(mode) < sizeof(mode_names[0])) {
+                snprintf(mode_names[mode_count], sizeof(mode_names[0]), "%s", mode);
+                mode_categories[mode_count++] = mode_category(mode, strlen(mode));
+            } else if (m == mode_count) {
+                m = STATS_MAX_MODES;
+            }
+        }
+        mode_qsos[m]++;
+        band_qsos[band][m < STATS_MAX_MODES ? mode_categories[m] : mode_category(mode, strlen(mode))]++;
+
+        // Imported calls may be stored in lower case, so the normalized form is what gets counted
+        char normalized[64];
+        normalize_callsign((const char *)callsign, callsign_length, normalized, sizeof(normalized));
+        size_t normalized_length = strlen(normalized);
+        if (normalized_length > 0) {
+            unsigned long long hash = stats_call_hash((const unsigned char *)normalized, (int)normalized_length);
+            stats_hll_add(calls[band], hash);
+            stats_hll_add(calls[BAND_COUNT + 1], hash);
+        }
+
+        int c = 0;
+        while (c < CONTINENT_COUNT && !(continent && strcmp(continents[c], continent) == 0)) {
+            c++;
+        }
+        continent_qsos[c]++;
+
+        if (sqlite3_column_type(stmt, 3) == SQLITE_NULL) {
+            undated++;
+            continue;
+        }
+        long long epoch = sqlite3_column_int64(stmt, 3);
+        long long minute = epoch >= 0 ? epoch / 60 : (epoch - 59) / 60;
+        if (qsos - undated == 1 || epoch < first_epoch) {
+            first_epoch = epoch;
+        }
+        if (qsos - undated == 1 || epoch > last_epoch) {
+            last_epoch = epoch;
+        }
+        hour_qsos[(minute % 1440 + 1440) % 1440 / 60]++;
+        StatsMinute *counter = stats_minute(&minutes, minute);
+        if (counter == NULL) {
+            rc = SQLITE_NOMEM;
+            break;
+        }
+        counter->count++;
+    }
+    if (rc != SQLITE_DONE) {
+        fprintf(stderr, "Failed to retrieve contacts: %s\n", rc == SQLITE_NOMEM ? "out of memory" : sqlite3_errmsg(session->db));
+        session_finalize(session, stmt);
+        free(minutes.entries);
+        free(calls);
+        return rc;
+    }
+    session_finalize(session, stmt);
+
+    // The minutes with QSOs, in time order, for the best rates and the rate sheet
+    size_t minute_count = 0;
+    for (size_t i = 0; i < minutes.capacity; i++) {
+        if (minutes.entries[i].count > 0) {
+            minutes.entries[minute_count++] = minutes.entries[i];
+        }
+    }
+    qsort(minutes.entries, minute_count, sizeof(StatsMinute), compare_stats_minutes);
+    double seconds = (monotonic_us() - started_us) / 1e6;
+
+    if (qsos == 0) {
+        printf("No contacts found.\n");
+        free(minutes.entries);
+        free(calls);
+        return SQLITE_OK;
+    }
+
+    char first[32], last[32];
+    format_contest_time(first_epoch, first, sizeof(first));
+    format_contest_time(last_epoch, last, sizeof(last));
+    printf("Statistics for %lld QSO%s", qsos, qsos == 1 ? "" : "s");
+    if (qsos > undated) {
+        printf(", %s to %s", first, last);
+    }
+    printf(" (%.2f s):\n", seconds);
+
+    printf("  Band        QSOs   Calls      CW   Phone Digital   Other\n");
+    for (size_t b = 0; b <= BAND_COUNT; b++) {
+        long long total = 0;
+        for (int category = 0; category < MODE_CATEGORY_COUNT; category++) {
+            total += band_qsos[b][category];
+        }
+        if (total > 0) {
+            printf("  %-7s %8lld %7lld %7lld %7lld %7lld %7lld\n", b < BAND_COUNT ? bands[b].name : "other",
+                   total, stats_hll_estimate(calls[b]), band_qsos[b][MODE_CW], band_qsos[b][MODE_PHONE],
+                   band_qsos[b][MODE_DIGITAL], band_qsos[b][MODE_NONE]);
+        }
+    }
+    printf("  %-7s %8lld %7lld\n", "Total", qsos, stats_hll_estimate(calls[BAND_COUNT + 1]));
+    printf("  (Calls are unique callsigns, estimated to within about 1%%.)\n");
+
+    printf("  Modes:");
+    for (m = 0; m < mode_count; m++) {
+        printf(" %s %lld", mode_names[m][0] ? mode_names[m] : "none", mode_qsos[m]);
+    }
+    if (mode_qsos[STATS_MAX_MODES] > 0) {
+        printf(" others %lld", mode_qsos[STATS_MAX_MODES]);
+    }
+    printf("\n  Continents:");
+    for (int c = 0; c <= CONTINENT_COUNT; c++) {
+        if (continent_qsos[c] > 0) {
+            printf(" %s %lld (%.1f%%)", c < CONTINENT_COUNT ? continents[c] : "unknown", continent_qsos[c],
+                   100.0 * continent_qsos[c] / qsos);
+        }
+    }
+    printf("\n");
+
+    if (minute_count > 0) {
+        printf("  QSOs by hour (UTC):\n");
+        for (int row = 0; row < 4; row++) {
+            printf("   ");
+            for (int hour = row * 6; hour < row * 6 + 6; hour++) {
+                printf("  %02dz %7lld", hour, hour_qsos[hour]);
+            }
+            printf("\n");
+        }
+
+        long long hour_start = 0, ten_start = 0;
+        long long best_hour = stats_best_rate(minutes.entries, minute_count, 60, &hour_start);
+        long long best_ten = stats_best_rate(minutes.entries, minute_count, 10, &ten_start);
+        format_contest_time(hour_start, first, sizeof(first));
+        format_contest_time(ten_start, last, sizeof(last));
+        printf("  Best 60 minutes: %lld QSO%s from %s; best 10 minutes: %lld QSO%s from %s (%lld/hour)\n",
+               best_hour, best_hour == 1 ? "" : "s", first, best_ten, best_ten == 1 ? "" : "s", last, best_ten * 6);
+
+        // A rate sheet, hour by hour, when the QSOs fit in a contest weekend
+        long long first_hour = minutes.entries[0].minute / 60;
+        long long last_hour = minutes.entries[minute_count - 1].minute / 60;
+        if (last_hour - first_hour < STATS_RATE_SHEET_HOURS) {
+            printf("  Rate sheet:\n");
+            long long running = 0;
+            size_t i = 0;
+            for (long long hour = first_hour; hour <= last_hour; hour++) {
+                long long in_hour = 0;
+                for (; i < minute_count && minutes.entries[i].minute / 60 == hour; i++) {
+                    in_hour += minutes.entries[i].count;
+                }
+                running += in_hour;
+                format_contest_time(hour * 3600, first, sizeof(first));
+                printf("    %s %6lld %8lld\n", first, in_hour, running);
+            }
+        }
+    }
+    if (undated > 0) {
+        printf("  %lld QSO%s without a usable date/time %s only counted by band, mode and continent.\n",
+               undated, undated == 1 ? "" : "s", undated == 1 ? "is" : "are");
+    }
+
+    free(minutes.entries);
+    free(calls);
+    return SQLITE_OK;
+}
+
+// Function to bind a frequency's Hz value and band to two consecutive placeholders.
+// Both stay NULL when the frequency can't be read.  Returns the frequency in Hz.
+static long long bind_frequency(sqlite3_stmt *stmt, int index, const char *frequency, size_t length) {
+    long long hz = parse_frequency_hz(frequency, length);
+    if (hz > 0) {
+        const char *band = band_for_hz(hz);
+        sqlite3_bind_int64(stmt, index, hz);
+        if (band) {
+            sqlite3_bind_text(stmt, index + 1, band, -1, SQLITE_STATIC);
+        }
+    }
+    return hz;
+}
+
+// Function to log the current contact into the SQLite3 database
+
+int log_contact(LoggerSession *session, Contact *contact) {
+    int rc;
+    sqlite3_stmt *stmt;
+    long long started_us = monotonic_us();
+
+    // On a position, the daemon does the writing
+    if (session->remote) {
+        return remote_log_contact(session, contact);
+    }
+
+    rc = begin_write(session);
+    if (rc != SQLITE_OK) {
+        return rc;
+    }
+
+    // Combine date and time into a single string
+    char date_time[40];
+    snprintf(date_time, sizeof(date_time), "%s %s", contact->contact_date, contact->contact_time);
+
+    // A non-zero ID means this contact was loaded with 'u' and is an update.
+    // Note which callsign it had, so its dupe index entry can be refreshed too.
+    char previous_callsign[64] = "";
+    if (contact->id > 0) {
+        stmt = session_statement(session, STMT_SELECT_CALLSIGN_BY_ID);
+        if (stmt == NULL) {
+            return SQLITE_ERROR;
+        }
+        sqlite3_bind_int(stmt, 1, contact->id);
+        if (sqlite3_step(stmt) == SQLITE_ROW) {
+            snprintf(previous_callsign, sizeof(previous_callsign), "%s", (const char *)sqlite3_column_text(stmt, 0));
+        }
+        sqlite3_reset(stmt);
+    }
+
+    // An edited contact's old part in the contest score is taken away once the edit is made
+    ContestQso before;
+    int counted_before = session->contest && contact->id > 0 && contest_read_qso(session, contact->id, &before);
+
+    stmt = session_statement(session, contact->id > 0 ? STMT_UPDATE_CONTACT : STMT_INSERT_CONTACT);
+    if (stmt == NULL) {
+        return SQLITE_ERROR;
+    }
+
+    // Bind parameters to the prepared statement
+    sqlite3_bind_text(stmt, 1, contact->callsign_worked, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 2, contact->frequency, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 3, contact->mode, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 4, contact->sent_report, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 5, contact->received_report, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 6, date_time, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 7, contact->comment, -1, SQLITE_STATIC);
+
+    // Country file details are left NULL when the callsign wasn't looked up
+    if (contact->country[0]) {
+        sqlite3_bind_text(stmt, 8, contact->country, -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt, 9, contact->country_prefix, -1, SQLITE_STATIC);
+        sqlite3_bind_int(stmt, 10, contact->cq_zone);
+        sqlite3_bind_int(stmt, 11, contact->itu_zone);
+        sqlite3_bind_text(stmt, 12, contact->continent, -1, SQLITE_STATIC);
+    }
+
+    // Frequency in Hz and its band, both left NULL if the frequency can't be read
+    long long hz = bind_frequency(stmt, 13, contact->frequency, strlen(contact->frequency));
+    long long epoch = parse_date_time_epoch(date_time, strlen(date_time));
+    if (epoch != NO_EPOCH) {
+        sqlite3_bind_int64(stmt, 15, epoch);
+    }
+
+    // State and WPX prefix, which the award_credits triggers count
+    char prefix[16];
+    wpx_prefix(contact->callsign_worked, prefix, sizeof(prefix));
+    if (contact->state[0]) {
+        sqlite3_bind_text(stmt, 16, contact->state, -1, SQLITE_STATIC);
+    }
+    if (prefix[0]) {
+        sqlite3_bind_text(stmt, 17, prefix, -1, SQLITE_STATIC);
+    }
+
+    // An edit keeps the serial number the contact was sent with; a new contact gets its own, or the
+    // contest's next one
+    long long serial = contact->id > 0 ? 0 : contest_serial(session->contest, contact);
+    if (contact->id > 0) {
+        // Bind the ID
+        sqlite3_bind_int(stmt, 18, contact->id);
+    } else if (serial > 0) {
+        sqlite3_bind_int64(stmt, 20, serial);
+    }
+
+    // Execute the statement
+    rc = sqlite3_step(stmt);
+    if (rc != SQLITE_DONE) {
+        fprintf(stderr, "Failed to %s contact: %s\n", contact->id > 0 ? "update" : "insert", sqlite3_errmsg(session->db));
+        sqlite3_reset(stmt);
+        return rc;
+    }
+    sqlite3_reset(stmt);
+
+    // Keep the dupe index and partial checks in step with the log
+    if (contact->id > 0) {
+        dupe_index_refresh(session, previous_callsign);
+        dupe_index_refresh(session, contact->callsign_worked);
+        partial_index_note_call(&session->partials, contact->callsign_worked, 0);
+    } else {
+        // A call that was deleted and is logged again still has its (emptied) dupe entry, but may have
+        // dropped out of the partial index since, so it's noted every time
+        int first_contact = dupe_index_add(&session->dupes, contact->callsign_worked, strlen(contact->callsign_worked),
+                                           band_index_for_hz(hz), mode_category(contact->mode, strlen(contact->mode)));
+        partial_index_note_call(&session->partials, contact->callsign_worked, first_contact);
+    }
+
+    // ...and the score counts the contact as it now reads in the log
+    if (session->contest) {
+        ContestQso after;
+        if (serial >= session->contest->next_serial) {
+            session->contest->next_serial = serial + 1;
+        }
+        if (counted_before) {
+            contest_count(session->contest, &before, -1);
+        }
+        if (contest_read_qso(session, contact->id > 0 ? contact->id : sqlite3_last_insert_rowid(session->db), &after)) {
+            contest_count(session->contest, &after, 1);
+        }
+    }
+
+    return end_write(session, started_us);
+}
+
+
+// Function to add a condition to a view query's WHERE clause
+static void view_condition(ViewQuery *query, const char *condition) {
+    size_t used = strlen(query->where);
+    snprintf(query->where + used, sizeof(query->where) - used, "%s%s", used ? " AND " : " WHERE ", condition);
+}
+
+// Function to queue an integer value to bind to the next placeholder of a view query
+static int view_bind_int(ViewQuery *query, long long value) {
+    if (query->binding_count >= VIEW_MAX_BINDINGS) {
+        query->too_many = 1;
+        return 0;
+    }
+    query->binding_is_text[query->binding_count] = 0;
+    query->int_values[query->binding_count++] = value;
+    return 1;
+}
+
+// Function to queue a text value to bind to the next placeholder of a view query
+static int view_bind_text(ViewQuery *query, const char *value) {
+    if (query->binding_count >= VIEW_MAX_BINDINGS) {
+        query->too_many = 1;
+        return 0;
+    }
+    query->binding_is_text[query->binding_count] = 1;
+    snprintf(query->text_values[query->binding_count++], sizeof(query->text_values[0]), "%s", value);
+    return 1;
+}
+
+// Function to turn a 'v' search term (key=value) into a condition. Returns 0 if it isn't understood.
+static int view_search_term(ViewQuery *query, const char *key, char *value) {
+    if (*value == '\0') {
+        return 0;
+    }
+
+    if (strcmp(key, "call") == 0 || strcmp(key, "prefix") == 0 || strcmp(key, "mode") == 0) {
+        for (int i = 0; value[i] != '\0'; i++) {
+            value[i] = toupper((unsigned char)value[i]);
+        }
+    }
+
+    if (strcmp(key, "call") == 0) {
+        view_condition(query, "callsign = ?");
+        return view_bind_text(query, value);
+    } else if (strcmp(key, "prefix") == 0) {
+        // callsign >= 'W3' AND callsign < 'W4' keeps the search on the callsign index
+        char upper[64];
+        snprintf(upper, sizeof(upper), "%s", value);
+        upper[strlen(upper) - 1]++;
+        view_condition(query, "callsign >= ? AND callsign < ?");
+        return view_bind_text(query, value) && view_bind_text(query, upper);
+    } else if (strcmp(key, "mode") == 0) {
+        view_condition(query, "mode = ?");
+        return view_bind_text(query, value);
+    } else if (strcmp(key, "band") == 0) {
+        for (int i = 0; value[i] != '\0'; i++) {
+            value[i] = tolower((unsigned char)value[i]);
+        }
+        view_condition(query, "band = ?");
+        return view_bind_text(query, value);
+    } else if (strcmp(key, "sort") == 0) {
+        // sort=time lists contacts by when they were made rather than the order they were logged
+        if (strcmp(value, "time") != 0 && strcmp(value, "id") != 0) {
+            return 0;
+        }
+        if (strcmp(value, "time") == 0 && !query->sort_by_time) {
+            // Contacts without a usable date/time have no place in time order
+            view_condition(query, "qso_epoch IS NOT NULL");
+            query->sort_by_time = 1;
+        }
+        return 1;
+    } else if (strcmp(key, "freq") == 0) {
+        // freq=14000-14070 is a range, freq=14.074 a single frequency, both read like the 'f' command
+        char *dash = strchr(value, '-');
+        long long low = parse_frequency_hz(value, dash ? (size_t)(dash - value) : strlen(value));
+        long long high = dash ? parse_frequency_hz(dash + 1, strlen(dash + 1)) : low;
+        if (low <= 0 || high < low) {
+            return 0;
+        }
+        view_condition(query, "frequency_hz BETWEEN ? AND ?");
+        return view_bind_int(query, low) && view_bind_int(query, high);
+    } else if (strcmp(key, "from") == 0 || strcmp(key, "to") == 0) {
+        int year, month, day;
+        if (sscanf(value, "%4d-%2d-%2d", &year, &month, &day) != 3 ||
+            year < 1900 || year > 2100 || month < 1 || month > 12 || day < 1 || day > 31) {
+            return 0;
+        }
+        // 'to' includes the whole day, so compare against the start of the next one
+        long long epoch = days_from_civil(year, month, day) * 86400;
+        if (strcmp(key, "from") == 0) {
+            view_condition(query, "qso_epoch >= ?");
+            return view_bind_int(query, epoch);
+        }
+        view_condition(query, "qso_epoch < ?");
+        return view_bind_int(query, epoch + 86400);
+    } else if (strcmp(key, "qsl") == 0) {
+        // qsl=yes lists confirmed contacts, qsl=no the ones still waiting for a QSL
+        if (strcasecmp(value, "yes") == 0 || strcasecmp(value, "y") == 0) {
+            view_condition(query, "qsl_rcvd = 'Y'");
+        } else if (strcasecmp(value, "no") == 0 || strcasecmp(value, "n") == 0) {
+            view_condition(query, "coalesce(qsl_rcvd, '') <> 'Y'");
+        } else {
+            return 0;
+        }
+        return 1;
+    }
+
+    return 0;
+}
+
+// Function to turn 'v' parameters (search terms, ID, ID range, +N or -N) into a view query.
+// Sets *limit to N when +N or -N was given, otherwise to 0.
+void parse_view_params(ViewQuery *query, const char *params, int *limit) {
+    char terms[INPUT_BUFFER_SIZE];
+    char *save = NULL;
+
+    memset(query, 0, sizeof(*query));
+    snprintf(terms, sizeof(terms), "%s", params ? params : "");
+    *limit = 0;
+
+    // Handle the different types of parameters; search terms can be combined with +N or -N
+    for (char *term = strtok_r(terms, " ", &save); term; term = strtok_r(NULL, " ", &save)) {
+        char *equals = strchr(term, '=');
+        if (equals) {
+            *equals = '\0';
+            if (!view_search_term(query, term, equals + 1) && !query->too_many) {
+                printf("Invalid search term '%s=%s'. Ignoring it.\n", term, equals + 1);
+            }
+        } else if (term[0] == '+') {
+            // First N contacts
+            *limit = atoi(term + 1);
+            if (*limit <= 0) {
+                printf("Invalid parameter for '+N'. Showing all contacts.\n");
+            }
+        } else if (term[0] == '-') {
+            // Last N contacts
+            *limit = atoi(term + 1);
+            if (*limit > 0) {
+                query->descending = 1;
+            } else {
+                printf("Invalid parameter for '-N'. Showing all contacts.\n");
+            }
+        } else if (strchr(term, '-')) {
+            // Range of IDs
+            int start_id, end_id;
+            if (sscanf(term, "%d-%d", &start_id, &end_id) == 2 && start_id > 0 && end_id >= start_id) {
+                view_condition(query, "id BETWEEN ? AND ?");
+                view_bind_int(query, start_id);
+                view_bind_int(query, end_id);
+            } else {
+                printf("Invalid range for 'ID-Range'. Showing all contacts.\n");
+            }
+        } else if (isdigit((unsigned char)term[0])) {
+            // Single ID
+            int id = atoi(term);
+            if (id > 0) {
+                view_condition(query, "id = ?");
+                view_bind_int(query, id);
+            } else {
+                printf("Invalid parameter for 'ID'. Showing all contacts.\n");
+            }
+        } else {
+            printf("Unknown parameter '%s'. Type 'h' for the search options.\n", term);
+        }
+    }
+}
+
+// Function to gather the words of a command line that are view parameters (key=value, +N, -N, an
+// ID or an ID range) into params.  Returns the first word that isn't one, which is the next
+// command, or NULL at the end of the line.
+char *take_view_params(char *params, size_t params_size) {
+    size_t used = 0;
+    char *term;
+
+    params[0] = '\0';
+    while ((term = strtok(NULL, " ")) != NULL) {
+        if (!strchr(term, '=') && term[0] != '+' && term[0] != '-' && !isdigit((unsigned char)term[0])) {
+            return term;
+        }
+        if (used < params_size) {
+            used += snprintf(params + used, params_size - used, "%s%s", used ? " " : "", term);
+        }
+    }
+    return NULL;
+}
+
+// Function to prepare a view query selecting the given columns, with its values bound.
+// With other logs attached it runs over all of them, adds the log number as a last column
+// and uses it to break ties between IDs from different logs.
+// The caller finalizes the statement.  Returns NULL if it can't be prepared.
+sqlite3_stmt *prepare_view_query(LoggerSession *session, ViewQuery *query, const char *columns, int limit) {
+    char sql[1024];
+    sqlite3_stmt *stmt;
+
+    static const char *orders[2][2][2] = {
+        { { "id", "id DESC" }, { "qso_epoch, id", "qso_epoch DESC, id DESC" } },
+        { { "id, log", "id DESC, log DESC" }, { "qso_epoch, id, log", "qso_epoch DESC, id DESC, log DESC" } }
+    };
+    int by_log = session->log_count > 1;
+    const char *order = orders[by_log][query->sort_by_time][query->descending];
+    const char *log_column = by_log ? ", log" : "";
+
+    // The ORDER BY columns are all selected, which lets SQLite merge the logs' index orders
+    // rather than sort the lot
+    if (query->backwards) {
+        snprintf(sql, sizeof(sql), "SELECT * FROM (SELECT %s%s FROM all_contacts%s ORDER BY %s%s) ORDER BY %s",
+                 columns, log_column, query->where, orders[by_log][query->sort_by_time][!query->descending],
+                 limit > 0 ? " LIMIT ?" : "", order);
+    } else {
+        snprintf(sql, sizeof(sql), "SELECT %s%s FROM all_contacts%s ORDER BY %s%s",
+                 columns, log_column, query->where, order, limit > 0 ? " LIMIT ?" : "");
+    }
+    if (limit > 0) {
+        view_bind_int(query, limit);
+    }
+
+    // A placeholder left unbound would quietly match nothing, so the query isn't run at all
+    if (query->too_many) {
+        printf("Error: Too many search terms (at most %d values, counting ID ranges, +N/-N and paging).\n", VIEW_MAX_BINDINGS);
+        return NULL;
+    }
+
+    if (session_prepare(session, sql, 0, &stmt) != SQLITE_OK) {
+        fprintf(stderr, "Failed to prepare statement: %s\n", sqlite3_errmsg(session->db));
+        return NULL;
+    }
+
+    // The query's values outlive the statement, so they can be bound without copying
+    for (int i = 0; i < query->binding_count; i++) {
+        if (query->binding_is_text[i]) {
+            sqlite3_bind_text(stmt, i + 1, query->text_values[i], -1, SQLITE_STATIC);
+        } else {
+            sqlite3_bind_int64(stmt, i + 1, query->int_values[i]);
+        }
+    }
+    return stmt;
+}
+
+// Function to write out whatever is in the output buffer
+static void output_flush(OutputBuffer *out) {
+    size_t done = 0;
+    while (done < out->used && !out->error) {
+        ssize_t count = write(out->fd, out->data + done, out->used - done);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            out->error = 1;
+        } else {
+            done += count;
+        }
+    }
+    out->used = 0;
+}
+
+// Function to append bytes to the output buffer.  A buffer with no file descriptor (fd -1) keeps
+// everything in memory, growing as needed.
+static void output_bytes(OutputBuffer *out, const char *bytes, size_t length) {
+    if (out->used + length > out->capacity && out->fd < 0) {
+        size_t capacity = out->capacity ? out->capacity * 2 : 65536;
+        while (capacity < out->used + length) {
+            capacity *= 2;
+        }
+        char *data = realloc(out->data, capacity);
+        if (data == NULL) {
+            out->error = 1;
+            return;
+        }
+        out->data = data;
+        out->capacity = capacity;
+    } else if (out->used + length > out->capacity) {
+        output_flush(out);
+        if (length > out->capacity) {
+            // Too big to buffer, write it straight through
+            OutputBuffer direct = { out->fd, (char *)bytes, length, length, 0 };
+            output_flush(&direct);
+            out->error |= direct.error;
+            return;
+        }
+    }
+    memcpy(out->data + out->used, bytes, length);
+    out->used += length;
+}
+
+// Function to append a NUL-terminated string to the output buffer
+static void output_string(OutputBuffer *out, const char *text) {
+    output_bytes(out, text, strlen(text));
+}
+
+// Function to append a non-negative integer without going through printf
+static void output_uint(OutputBuffer *out, unsigned long long value) {
+    char digits[24];
+    char *p = digits + sizeof(digits);
+    do {
+        *--p = (char)('0' + value % 10);
+        value /= 10;
+    } while (value);
+    output_bytes(out, p, digits + sizeof(digits) - p);
+}
+
+// Function to append a CSV field, quoting it if it holds a comma, quote or line break
+static void output_csv_field(OutputBuffer *out, const char *value, size_t length) {
+    size_t i;
+    for (i = 0; i < length; i++) {
+        char c = value[i];
+        if (c == ',' || c == '"' || c == '\n' || c == '\r') {
+            break;
+        }
+    }
+    if (i == length) {
+        output_bytes(out, value, length);
+        return;
+    }
+
+    output_bytes(out, "\"", 1);
+    size_t run = 0;
+    for (i = 0; i < length; i++) {
+        if (value[i] == '"') {
+            // Double the quote: write the run including this quote, then one more
+            output_bytes(out, value + run, i - run + 1);
+            output_bytes(out, "\"", 1);
+            run = i + 1;
+        }
+    }
+    output_bytes(out, value + run, length - run);
+    output_bytes(out, "\"", 1);
+}
+
+// Function to append an ADIF <TAG:len>value field followed by a space; empty values are left out
+static void output_adif_field(OutputBuffer *out, const char *tag, size_t tag_length, const char *value, size_t length) {
+    if (length == 0) {
+        return;
+    }
+    output_bytes(out, "<", 1);
+    output_bytes(out, tag, tag_length);
+    output_bytes(out, ":", 1);
+    output_uint(out, length);
+    output_bytes(out, ">", 1);
+    output_bytes(out, value, length);
+    output_bytes(out, " ", 1);
+}
+
+// Function to append a frequency in Hz as ADIF's MHz, e.g. 14025000 -> 14.025
+static void output_mhz(OutputBuffer *out, long long hz) {
+    char fraction[7];
+    long long remainder = hz % 1000000;
+    int digits = 6;
+
+    output_uint(out, hz / 1000000);
+    for (int i = 5; i >= 0; i--) {
+        fraction[i] = (char)('0' + remainder % 10);
+        remainder /= 10;
+    }
+    while (digits > 3 && fraction[digits - 1] == '0') {
+        digits--;
+    }
+    output_bytes(out, ".", 1);
+    output_bytes(out, fraction, digits);
+}
+
+// Columns listed by the view command
+#define VIEW_COLUMNS "id, callsign, frequency, mode, sent_report, received_report, date_time, comment, qso_epoch"
+
+// Function to append text left aligned in a column of the given width
+static void output_padded(OutputBuffer *out, const char *text, size_t length, size_t width) {
+    static const char spaces[] = "                                        ";
+    output_bytes(out, text, length);
+    while (length < width) {
+        size_t count = width - length < sizeof(spaces) - 1 ? width - length : sizeof(spaces) - 1;
+        output_bytes(out, spaces, count);
+        length += count;
+    }
+}
+
+// Function to append one column of a view row from the statement, followed by the separator
+static void output_view_column(OutputBuffer *out, sqlite3_stmt *stmt, int column, size_t width) {
+    const char *value = (const char *)sqlite3_column_text(stmt, column);
+    output_padded(out, value ? value : "", value ? sqlite3_column_bytes(stmt, column) : 0, width);
+    output_bytes(out, " | ", 3);
+}
+
+// Function to show one page of the current 'v' listing.
+// direction is 0 for the first page, 1 for the next page and -1 for the previous one.
+static int view_page(LoggerSession *session, int direction) {
+    ViewPager *pager = &session->view;
+    ViewQuery query = pager->query;
+    OutputBuffer out = { STDOUT_FILENO, NULL, 0, VIEW_BUFFER_SIZE, 0 };
+    int rc;
+
+    // Seek past the first or last row already shown, in the listing's sort order
+    int by_log = session->log_count > 1;
+    if (direction != 0) {
+        const char *op = (direction > 0) != query.descending ? ">" : "<";
+        char condition[64];
+        if (query.sort_by_time) {
+            snprintf(condition, sizeof(condition), "(qso_epoch, id%s) %s (?, ?%s)",
+                     by_log ? ", log" : "", op, by_log ? ", ?" : "");
+            view_condition(&query, condition);
+            view_bind_int(&query, direction > 0 ? pager->last_epoch : pager->first_epoch);
+        } else if (by_log) {
+            snprintf(condition, sizeof(condition), "(id, log) %s (?, ?)", op);
+            view_condition(&query, condition);
+        } else {
+            snprintf(condition, sizeof(condition), "id %s ?", op);
+            view_condition(&query, condition);
+        }
+        view_bind_int(&query, direction > 0 ? pager->last_id : pager->first_id);
+        if (by_log) {
+            view_bind_int(&query, direction > 0 ? pager->last_log : pager->first_log);
+        }
+        query.backwards = direction < 0;
+    }
+
+    // With other logs open, each row says which log it's from
+    size_t log_width = 0;
+    for (int i = 0; by_log && i < session->log_count; i++) {
+        size_t length = strlen(session->logs[i].name);
+        log_width = length > log_width ? length : log_width;
+    }
+
+    // Size the ID column for the largest ID in the log
+    size_t id_width = 2;
+    sqlite3_stmt *stmt = session_statement(session, STMT_SELECT_MAX_ID);
+    if (stmt == NULL) {
+        return SQLITE_ERROR;
+    }
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        for (long long max_id = sqlite3_column_int64(stmt, 0); max_id >= 100; max_id /= 10) {
+            id_width++;
+        }
+    }
+    sqlite3_reset(stmt);
+
+    stmt = prepare_view_query(session, &query, VIEW_COLUMNS, pager->page_size);
+    out.data = malloc(out.capacity);
+    if (stmt == NULL || out.data == NULL) {
+        session_finalize(session, stmt);
+        free(out.data);
+        return SQLITE_ERROR;
+    }
+
+    int rows = 0;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        long long id = sqlite3_column_int64(stmt, 0);
+        int log = by_log ? sqlite3_column_int(stmt, 9) : 0;
+        if (rows == 0) {
+            printf("\nLogged Contacts:\n");
+            if (by_log) {
+                printf("| %-*s ", (int)log_width, "Log");
+            }
+            printf("| %-*s | Call Sign  | Frequency | Mode | Sent Rpt  | Recv Rpt  | Date/Time           | Notes \n",
+                   (int)id_width, "ID");
+            fflush(stdout);
+            pager->first_id = id;
+            pager->first_epoch = sqlite3_column_int64(stmt, 8);
+            pager->first_log = log;
+        }
+        pager->last_id = id;
+        pager->last_epoch = sqlite3_column_int64(stmt, 8);
+        pager->last_log = log;
+
+        char number[24];
+        if (by_log) {
+            const char *name = log < session->log_count ? session->logs[log].name : "";
+            output_bytes(&out, "| ", 2);
+            output_padded(&out, name, strlen(name), log_width);
+            output_bytes(&out, " ", 1);
+        }
+        output_bytes(&out, "| ", 2);
+        output_padded(&out, number, snprintf(number, sizeof(number), "%lld", id), id_width);
+        output_bytes(&out, " | ", 3);
+        output_view_column(&out, stmt, 1, 10);
+        output_view_column(&out, stmt, 2, 9);
+        output_view_column(&out, stmt, 3, 4);
+        output_view_column(&out, stmt, 4, 9);
+        output_view_column(&out, stmt, 5, 9);
+        output_view_column(&out, stmt, 6, 19);
+        const char *comment = (const char *)sqlite3_column_text(stmt, 7);
+        output_padded(&out, comment ? comment : "", comment ? sqlite3_column_bytes(stmt, 7) : 0, 12);
+        output_bytes(&out, " \n", 2);
+        rows++;
+    }
+    output_flush(&out);
+
+    if (rc != SQLITE_DONE) {
+        fprintf(stderr, "Failed to retrieve contacts: %s\n", sqlite3_errmsg(session->db));
+    } else if (rows == 0) {
+        printf(direction == 0 ? "No contacts found.\n" : "No more contacts that way.\n");
+    } else if (rows == pager->page_size || direction != 0) {
+        printf("(%d shown; 'v next' and 'v prev' page through the rest)\n", rows);
+    }
+
+    session_finalize(session, stmt);
+    free(out.data);
+    return rc == SQLITE_DONE ? SQLITE_OK : rc;
+}
+
+// Function to view logged contacts in the SQLite3 database, one page at a time
+int view_contacts(LoggerSession *session, const char *params) {
+    if (!log_readable(session, 0)) {
+        return SQLITE_CANTOPEN;
+    }
+    if (params && (strcmp(params, "next") == 0 || strcmp(params, "prev") == 0)) {
+        if (!session->view.active) {
+            printf("Nothing to page through yet. Use 'v' first.\n");
+            return SQLITE_OK;
+        }
+        return view_page(session, strcmp(params, "next") == 0 ? 1 : -1);
+    }
+
+    // A new listing; +N or -N sets the page size
+    int limit;
+    parse_view_params(&session->view.query, params, &limit);
+    session->view.page_size = limit > 0 ? limit : VIEW_PAGE_SIZE;
+    session->view.active = 1;
+    return view_page(session, 0);
+}
+
+// Function to turn typed search words into an FTS5 query: each word is quoted as a phrase, so
+// "4-square" or "K3NG's" can't be taken for query syntax, a trailing * keeps its prefix meaning,
+// and OR and NOT pass through as operators.  Returns 0 if there are no words or they don't fit.
+static int note_search_query(const char *words, char *query, size_t query_size) {
+    char copy[INPUT_BUFFER_SIZE];
+    char *save = NULL;
+    size_t used = 0;
+
+    snprintf(copy, sizeof(copy), "%s", words);
+    for (char *word = strtok_r(copy, " \t", &save); word; word = strtok_r(NULL, " \t", &save)) {
+        if (used + strlen(word) * 2 + 8 > query_size) {
+            return 0;
+        }
+        if (used) {
+            query[used++] = ' ';
+        }
+        if (strcmp(word, "OR") == 0 || strcmp(word, "NOT") == 0) {
+            used += sprintf(query + used, "%s", word);
+            continue;
+        }
+
+        size_t length = strlen(word);
+        int prefix = length > 1 && word[length - 1] == '*';
+        query[used++] = '"';
+        for (size_t i = 0; i < length - prefix; i++) {
+            if (word[i] == '"') {
+                query[used++] = '"';
+            }
+            query[used++] = word[i];
+        }
+        query[used++] = '"';
+        if (prefix) {
+            query[used++] = '*';
+        }
+    }
+    query[used] = '\0';
+    return used > 0;
+}
+
+// Function to search the notes of every open log, best matches first, showing where each
+// matched with a snippet of the note
+int search_notes(LoggerSession *session, const char *words) {
+    char query[INPUT_BUFFER_SIZE * 2];
+    char sql[128 + MAX_LOGS * 320];
+    size_t used = 0;
+    sqlite3_stmt *stmt;
+
+    if (!log_readable(session, 0)) {
+        return SQLITE_CANTOPEN;
+    }
+    if (!note_search_query(words, query, sizeof(query))) {
+        printf("Error: Nothing to search for. Usage: / <words> (e.g., / 4-square, / beam* OR yagi)\n");
+        return SQLITE_OK;
+    }
+
+    // The best few from each log, merged by rank.  Ordering by the index's own rank column lets FTS5
+    // sort the matches itself, so snippets are only made, and contacts only read, for the rows shown.
+    for (int i = 0; i < session->log_count; i++) {
+        const char *schema = session->logs[i].schema;
+        used += snprintf(sql + used, sizeof(sql) - used,
+                         "%sSELECT * FROM (SELECT %d, c.id, c.callsign, c.date_time, m.snip, m.rank FROM "
+                         "(SELECT rowid, rank, snippet(contacts_notes, 0, '[', ']', '...', 10) AS snip FROM %s.contacts_notes "
+                         "WHERE contacts_notes MATCH ?1 ORDER BY rank LIMIT %d) AS m JOIN %s.contacts AS c ON c.id = m.rowid)",
+                         i ? " UNION ALL " : "", i, schema, NOTE_SEARCH_LIMIT + 1, schema);
+    }
+    snprintf(sql + used, sizeof(sql) - used, " ORDER BY 6 LIMIT %d", NOTE_SEARCH_LIMIT + 1);
+
+    long long started_us = monotonic_us();
+    int rc = session_prepare(session, sql, 0, &stmt);
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "Failed to search notes: %s\n", sqlite3_errmsg(session->db));
+        return rc;
+    }
+    sqlite3_bind_text(stmt, 1, query, -1, SQLITE_STATIC);
+
+    int rows = 0;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW && rows < NOTE_SEARCH_LIMIT) {
+        if (rows++ == 0) {
+            printf("\nNotes matching '%s':\n", words);
+        }
+        int log = sqlite3_column_int(stmt, 0);
+        const char *callsign = (const char *)sqlite3_column_text(stmt, 2);
+        const char *date_time = (const char *)sqlite3_column_text(stmt, 3);
+        if (session->log_count > 1) {
+            printf("  %-12s", log < session->log_count ? session->logs[log].name : "");
+        }
+        printf("  %-6lld %-10s %-19s  %s\n", sqlite3_column_int64(stmt, 1), callsign ? callsign : "",
+               date_time ? date_time : "", (const char *)sqlite3_column_text(stmt, 4));
+    }
+    int more = rc == SQLITE_ROW;
+    session_finalize(session, stmt);
+    if (rc != SQLITE_ROW && rc != SQLITE_DONE) {
+        fprintf(stderr, "Failed to search notes: %s\n", sqlite3_errmsg(session->db));
+        return rc;
+    }
+
+    double ms = (monotonic_us() - started_us) / 1000.0;
+    if (rows == 0) {
+        printf("No notes match '%s' (%.1f ms).\n", words, ms);
+    } else {
+        printf("%d match%s%s (%.1f ms).\n", rows, rows == 1 ? "" : "es", more ? " shown, best first; there are more" : "", ms);
+    }
+    return SQLITE_OK;
+}
+
+// Function to write one row from the all-contacts query as CSV, ending with the log's name if given
+static void write_csv_row(OutputBuffer *out, sqlite3_stmt *stmt, const char *log_name) {
+    output_uint(out, (unsigned long long)sqlite3_column_int64(stmt, 0));
+    for (int column = 1; column <= 20; column++) {
+        if (column == 13 || column == 15 || column == 17) {
+            continue; // frequency_hz and qso_epoch only feed the ADIF fields, and wpx_prefix is derived
+        }
+        const char *value = (const char *)sqlite3_column_text(stmt, column);
+        output_bytes(out, ",", 1);
+        output_csv_field(out, value ? value : "", sqlite3_column_bytes(stmt, column));
+    }
+    if (log_name) {
+        output_bytes(out, ",", 1);
+        output_csv_field(out, log_name, strlen(log_name));
+    }
+    output_bytes(out, "\n", 1);
+}
+
+// Function to write one row from the all-contacts query as an ADIF record.
+// Returns 0 if the row has no usable date/time and was skipped.
+static int write_adif_row(OutputBuffer *out, sqlite3_stmt *stmt) {
+    if (sqlite3_column_type(stmt, 15) == SQLITE_NULL) {
+        return 0;
+    }
+
+    // Seconds since 1970 -> YYYYMMDD and HHMM[SS], with seconds only if date_time was typed with them
+    int year, month, day, seconds;
+    char date[8], time[6];
+
+    epoch_to_civil(sqlite3_column_int64(stmt, 15), &year, &month, &day, &seconds);
+    int date_parts[4] = { year / 100, year % 100, month, day };
+    int time_parts[3] = { seconds / 3600, seconds / 60 % 60, seconds % 60 };
+    for (int i = 0; i < 4; i++) {
+        date[i * 2] = '0' + date_parts[i] / 10;
+        date[i * 2 + 1] = '0' + date_parts[i] % 10;
+    }
+    for (int i = 0; i < 3; i++) {
+        time[i * 2] = '0' + time_parts[i] / 10;
+        time[i * 2 + 1] = '0' + time_parts[i] % 10;
+    }
+
+    output_adif_field(out, "QSO_DATE", 8, date, 8);
+    output_adif_field(out, "TIME_ON", 7, time, sqlite3_column_bytes(stmt, 6) >= 19 ? 6 : 4);
+    output_adif_field(out, "CALL", 4, (const char *)sqlite3_column_text(stmt, 1), sqlite3_column_bytes(stmt, 1));
+
+    long long hz = sqlite3_column_int64(stmt, 13);
+    if (hz > 0) {
+        char mhz[32];
+        OutputBuffer field = { -1, mhz, 0, sizeof(mhz), 0 };
+        output_mhz(&field, hz);
+        output_adif_field(out, "FREQ", 4, mhz, field.used);
+    }
+
+    output_adif_field(out, "BAND", 4, (const char *)sqlite3_column_text(stmt, 14), sqlite3_column_bytes(stmt, 14));
+    output_adif_field(out, "MODE", 4, (const char *)sqlite3_column_text(stmt, 3), sqlite3_column_bytes(stmt, 3));
+    output_adif_field(out, "RST_SENT", 8, (const char *)sqlite3_column_text(stmt, 4), sqlite3_column_bytes(stmt, 4));
+    output_adif_field(out, "RST_RCVD", 8, (const char *)sqlite3_column_text(stmt, 5), sqlite3_column_bytes(stmt, 5));
+    output_adif_field(out, "STX", 3, (const char *)sqlite3_column_text(stmt, 20), sqlite3_column_bytes(stmt, 20));
+    output_adif_field(out, "COMMENT", 7, (const char *)sqlite3_column_text(stmt, 7), sqlite3_column_bytes(stmt, 7));
+    output_adif_field(out, "COUNTRY", 7, (const char *)sqlite3_column_text(stmt, 8), sqlite3_column_bytes(stmt, 8));
+    output_adif_field(out, "CQZ", 3, (const char *)sqlite3_column_text(stmt, 10), sqlite3_column_bytes(stmt, 10));
+    output_adif_field(out, "ITUZ", 4, (const char *)sqlite3_column_text(stmt, 11), sqlite3_column_bytes(stmt, 11));
+    output_adif_field(out, "CONT", 4, (const char *)sqlite3_column_text(stmt, 12), sqlite3_column_bytes(stmt, 12));
+    output_adif_field(out, "STATE", 5, (const char *)sqlite3_column_text(stmt, 16), sqlite3_column_bytes(stmt, 16));
+    output_adif_field(out, "QSL_RCVD", 8, (const char *)sqlite3_column_text(stmt, 18), sqlite3_column_bytes(stmt, 18));
+    const char *qsl_date = (const char *)sqlite3_column_text(stmt, 19);
+    if (qsl_date && sqlite3_column_bytes(stmt, 19) == 10) {
+        char adif_date[8] = { qsl_date[0], qsl_date[1], qsl_date[2], qsl_date[3], qsl_date[5], qsl_date[6], qsl_date[8], qsl_date[9] };
+        output_adif_field(out, "QSLRDATE", 8, adif_date, 8);
+    }
+    output_bytes(out, "<EOR>\n", 6);
+    return 1;
+}
+
+// Function to make the exchange sent or received on a QSO, as Cabrillo has it: the report as
+// logged, with a signal report if the contest has one and none was logged, and the zone or serial
+// number the contest exchanges if the report stops at the signal report.  Returns 0 if the contest
+// exchanges serial numbers and none was stored with the QSO or typed into its sent report.
+static int contest_exchange(const ContestScore *score, const ContestQso *qso, int sent, char *buffer, size_t buffer_size) {
+    const ContestEvent *event = score->event;
+    char words[32], extra[24] = "";
+    int count = report_words(sent ? qso->sent : qso->received, words, sizeof(words));
+
+    if (event->exchange == EXCHANGE_SERIAL && sent) {
+        if (qso->serial > 0) {
+            snprintf(extra, sizeof(extra), "%03lld", qso->serial);
+        } else if (event->rst ? count < 2 : !isdigit((unsigned char)words[0])) {
+            return 0;
+        }
+    } else if (event->exchange == EXCHANGE_CQ_ZONE || event->exchange == EXCHANGE_ITU_ZONE) {
+        // Ours from the country file; theirs as scored, from the exchange or the country file
+        int zone = event->exchange == EXCHANGE_CQ_ZONE ? score->cq_zone : score->itu_zone;
+        if (!sent) {
+            ContestMultiplier kind = event->exchange == EXCHANGE_CQ_ZONE ? MULT_CQ_ZONE : MULT_ITU_ZONE;
+            zone = 0;
+            for (int i = 0; i < CONTEST_MAX_MULTS; i++) {
+                zone = event->mults[i] == kind ? atoi(qso->mults[i]) : zone;
+            }
+        }
+        if (zone > 0) {
+            snprintf(extra, sizeof(extra), "%02d", zone);
+        }
+    }
+
+    if (event->rst && count == 0) {
+        snprintf(buffer, buffer_size, "%s%s%s", qso->mode == MODE_PHONE ? "59" : "599", extra[0] ? " " : "", extra);
+    } else if (event->rst && count == 1 && extra[0]) {
+        snprintf(buffer, buffer_size, "%s %s", words, extra);
+    } else if (!event->rst && sent && extra[0]) {
+        snprintf(buffer, buffer_size, "%s%s%s", extra, count ? " " : "", words);
+    } else {
+        snprintf(buffer, buffer_size, "%s", words);
+    }
+    return 1;
+}
+
+// Function to get the Cabrillo mode of a QSO: CW, PH, FM, RY or DG
+static const char *cabrillo_mode(const ContestQso *qso) {
+    if (qso->mode == MODE_PHONE) {
+        return strcasecmp(qso->mode_name, "FM") == 0 ? "FM" : "PH";
+    } else if (qso->mode == MODE_DIGITAL) {
+        return strcasecmp(qso->mode_name, "RTTY") == 0 ? "RY" : "DG";
+    }
+    return "CW";
+}
+
+// Function to write one row from the all-contacts query as a Cabrillo QSO line, scored and with the
+// exchanges worked out as the scoreboard has them.  Returns 0 if the row has no usable date/time,
+// or -1 if the serial number sent with it isn't known.
+static int write_cabrillo_row(OutputBuffer *out, sqlite3_stmt *stmt, const ContestScore *score) {
+    ContestQso qso;
+    char date_time[24], sent[40], received[40], line[192];
+    contest_qso_from_row(stmt, &qso);
+    if (qso.epoch == NO_EPOCH) {
+        return 0;
+    }
+    if (!contest_exchange(score, &qso, 1, sent, sizeof(sent))) {
+        return -1;
+    }
+    score_contest_qso(score, &qso);
+
+    // HF in kHz; VHF and up as the band's name in Cabrillo
+    static const struct { long long low_hz; const char *name; } cabrillo_bands[] = {
+        { 50000000, "50" }, { 70000000, "70" }, { 144000000, "144" }, { 222000000, "222" },
+        { 420000000, "432" }, { 902000000, "902" }, { 1240000000, "1.2G" }
+    };
+    char frequency[24];
+    snprintf(frequency, sizeof(frequency), "%lld", qso.hz / 1000);
+    for (size_t i = 0; i < sizeof(cabrillo_bands) / sizeof(cabrillo_bands[0]); i++) {
+        if (qso.band < (int)BAND_COUNT && bands[qso.band].low_hz == cabrillo_bands[i].low_hz) {
+            snprintf(frequency, sizeof(frequency), "%s", cabrillo_bands[i].name);
+        }
+    }
+
+    format_contest_time(qso.epoch, date_time, sizeof(date_time));
+    date_time[13] = date_time[14];
+    date_time[14] = date_time[15];
+    date_time[15] = '\0';
+    contest_exchange(score, &qso, 0, received, sizeof(received));
+    int length = snprintf(line, sizeof(line), "QSO: %5s %s %s %-13s %-10s %-13s %s\n", frequency, cabrillo_mode(&qso),
+                          date_time, score->station, sent, qso.callsign, received);
+    output_bytes(out, line, length < (int)sizeof(line) ? (size_t)length : sizeof(line) - 1);
+    return 1;
+}
+
+// Function to decide whether the whole log is big enough to export on worker threads, and if so to take
+// the write lock, so that no QSO can be committed before every worker has started reading and all of them
+// see the same log.  (SQLite's snapshot API would let them share one snapshot instead, but it isn't in
+// every build.)  Returns 1 with the lock held and the range of IDs to export, or 0 to export serially.
+static int start_parallel_export(LoggerSession *session, long long *first_id, long long *last_id) {
+    const char *path = sqlite3_db_filename(session->db, "main");
+    if (session->export_threads < 2 || session->log_count > 1 || !sqlite3_threadsafe() || path == NULL || path[0] == '\0') {
+        return 0;
+    }
+
+    // The workers only see what has been committed: a batch script's open transaction keeps the export on
+    // this connection, and contest mode's pending writes are committed first
+    if ((session->batch_mode && !sqlite3_get_autocommit(session->db)) || flush_group_commit(session) != SQLITE_OK ||
+        !sqlite3_get_autocommit(session->db) || sqlite3_exec(session->db, "BEGIN IMMEDIATE", NULL, NULL, NULL) != SQLITE_OK) {
+        return 0;
+    }
+
+    sqlite3_stmt *stmt = NULL;
+    int big = 0;
+    if (session_prepare(session, "SELECT min(id), max(id) FROM contacts", 0, &stmt) == SQLITE_OK &&
+        sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_type(stmt, 0) == SQLITE_INTEGER) {
+        *first_id = sqlite3_column_int64(stmt, 0);
+        *last_id = sqlite3_column_int64(stmt, 1);
+        big = *last_id - *first_id >= EXPORT_PARALLEL_MIN_IDS - 1;
+    }
+    session_finalize(session, stmt);
+    if (!big) {
+        sqlite3_exec(session->db, "COMMIT", NULL, NULL, NULL);
+    }
+    return big;
+}
+
+// Function run by each parallel export worker: reads the log on a read-only connection of its own, in one
+// read transaction, formatting ranges of IDs into memory until none are left
+static void *export_worker_thread(void *arg) {
+    ParallelExport *job = arg;
+    sqlite3 *db = NULL;
+    sqlite3_stmt *stmt = NULL;
+    char error[sizeof(job->error)] = "";
+
+    // Straight to the real VFS: the timing VFS's I/O counters belong to the session's thread
+    int rc = sqlite3_open_v2(job->path, &db, SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX, timed_parent ? timed_parent->zName : NULL);
+    if (rc == SQLITE_OK) {
+        rc = sqlite3_exec(db, "BEGIN; SELECT max(id) FROM contacts;", NULL, NULL, NULL);
+    }
+    if (rc == SQLITE_OK) {
+        rc = sqlite3_prepare_v2(db, "SELECT " EXPORT_COLUMNS " FROM contacts WHERE id BETWEEN ?1 AND ?2 ORDER BY id", -1, &stmt, NULL);
+    }
+    if (rc != SQLITE_OK) {
+        snprintf(error, sizeof(error), "%s", db ? sqlite3_errmsg(db) : "out of memory");
+    }
+
+    pthread_mutex_lock(&job->lock);
+    job->started++;
+    pthread_cond_broadcast(&job->changed);
+    while (!job->failed && error[0] == '\0') {
+        // Stay only a few ranges ahead of the file, so memory doesn't grow with the log
+        while (!job->failed && job->next_chunk < job->chunk_count && job->next_chunk >= job->written + EXPORT_CHUNKS_AHEAD * job->started) {
+            pthread_cond_wait(&job->changed, &job->lock);
+        }
+        if (job->failed || job->next_chunk >= job->chunk_count) {
+            break;
+        }
+        ExportChunk *chunk = &job->chunks[job->next_chunk++];
+        pthread_mutex_unlock(&job->lock);
+
+        sqlite3_bind_int64(stmt, 1, chunk->first_id);
+        sqlite3_bind_int64(stmt, 2, chunk->last_id);
+        while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+            if (job->format == EXPORT_CSV) {
+                write_csv_row(&chunk->text, stmt, NULL);
+            } else if (!write_adif_row(&chunk->text, stmt)) {
+                char message[96];
+                int length = snprintf(message, sizeof(message), "Error: No usable date/time in database for ID %lld, skipped.\n",
+                                      (long long)sqlite3_column_int64(stmt, 0));
+                output_bytes(&chunk->messages, message, (size_t)length);
+                chunk->skipped++;
+                continue;
+            }
+            chunk->rows++;
+        }
+        if (rc != SQLITE_DONE) {
+            snprintf(error, sizeof(error), "%s", sqlite3_errmsg(db));
+        } else if (chunk->text.error || chunk->messages.error) {
+            snprintf(error, sizeof(error), "out of memory");
+        }
+        sqlite3_reset(stmt);
+
+        pthread_mutex_lock(&job->lock);
+        chunk->done = 1;
+        pthread_cond_broadcast(&job->changed);
+    }
+    if (error[0] != '\0' && !job->failed) {
+        job->failed = 1;
+        snprintf(job->error, sizeof(job->error), "%s", error);
+        pthread_cond_broadcast(&job->changed);
+    }
+    pthread_mutex_unlock(&job->lock);
+
+    sqlite3_finalize(stmt);
+    sqlite3_close(db);
+    return NULL;
+}
+
+// Function to write the whole log between two IDs using worker threads, each formatting ranges of IDs
+// while this thread writes the finished ranges to the file in order, so the file (and what's printed
+// about skipped rows) is the same as the serial export's.  Releases the write lock start_parallel_export
+// took once the workers have all started.  Returns SQLITE_DONE, as a finished statement would, or an error.
+static int export_parallel(LoggerSession *session, OutputBuffer *out, ExportFormat format, long long first_id,
+                           long long last_id, long long *rows, long long *skipped) {
+    ParallelExport job;
+    pthread_t threads[EXPORT_MAX_THREADS];
+    int thread_count = 0;
+
+    memset(&job, 0, sizeof(job));
+    job.path = sqlite3_db_filename(session->db, "main");
+    job.format = format;
+    job.chunk_count = (size_t)((last_id - first_id) / EXPORT_CHUNK_IDS) + 1;
+    job.chunks = calloc(job.chunk_count, sizeof(ExportChunk));
+    pthread_mutex_init(&job.lock, NULL);
+    pthread_cond_init(&job.changed, NULL);
+    if (job.chunks == NULL) {
+        snprintf(job.error, sizeof(job.error), "out of memory");
+        job.chunk_count = 0;
+    }
+    for (size_t i = 0; i < job.chunk_count; i++) {
+        ExportChunk *chunk = &job.chunks[i];
+        chunk->first_id = first_id + (long long)i * EXPORT_CHUNK_IDS;
+        chunk->last_id = i + 1 < job.chunk_count ? chunk->first_id + EXPORT_CHUNK_IDS - 1 : last_id;
+        chunk->text.fd = -1;
+        chunk->messages.fd = -1;
+    }
+
+    int wanted = session->export_threads < EXPORT_MAX_THREADS ? session->export_threads : EXPORT_MAX_THREADS;
+    while (thread_count < wanted && (size_t)thread_count < job.chunk_count &&
+           pthread_create(&threads[thread_count], NULL, export_worker_thread, &job) == 0) {
+        thread_count++;
+    }
+    if (thread_count == 0 && job.chunk_count > 0) {
+        snprintf(job.error, sizeof(job.error), "cannot start the export threads");
+    }
+
+    // Once every worker is reading, QSOs can be logged again without the workers seeing them
+    pthread_mutex_lock(&job.lock);
+    while (job.started < thread_count) {
+        pthread_cond_wait(&job.changed, &job.lock);
+    }
+    pthread_mutex_unlock(&job.lock);
+    sqlite3_exec(session->db, "COMMIT", NULL, NULL, NULL);
+
+    for (size_t i = 0; i < job.chunk_count && thread_count > 0; i++) {
+        ExportChunk *chunk = &job.chunks[i];
+        pthread_mutex_lock(&job.lock);
+        while (!chunk->done && !job.failed) {
+            pthread_cond_wait(&job.changed, &job.lock);
+        }
+        int failed = job.failed;
+        pthread_mutex_unlock(&job.lock);
+        if (failed) {
+            break;
+        }
+
+        if (chunk->text.used > 0) {
+            output_bytes(out, chunk->text.data, chunk->text.used);
+        }
+        if (chunk->messages.used > 0) {
+            fwrite(chunk->messages.data, 1, chunk->messages.used, stdout);
+        }
+        *rows += chunk->rows;
+        *skipped += chunk->skipped;
+        free(chunk->text.data);
+        free(chunk->messages.data);
+        chunk->text.data = chunk->messages.data = NULL;
+
+        // A failed write ends the export here, as there's no point formatting the rest
+        pthread_mutex_lock(&job.lock);
+        job.written = i + 1;
+        job.failed |= out->error;
+        pthread_cond_broadcast(&job.changed);
+        pthread_mutex_unlock(&job.lock);
+    }
+
+    for (int i = 0; i < thread_count; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    for (size_t i = 0; i < job.chunk_count; i++) {
+        free(job.chunks[i].text.data);
+        free(job.chunks[i].messages.data);
+    }
+    free(job.chunks);
+    pthread_mutex_destroy(&job.lock);
+    pthread_cond_destroy(&job.changed);
+
+    if (job.error[0] != '\0') {
+        fprintf(stderr, "Failed to retrieve contacts: %s\n", job.error);
+        return SQLITE_ERROR;
+    }
+    return SQLITE_DONE;
+}
+
+// Function to export all contacts in CSV, ADIF or Cabrillo format through one buffered row pipeline
+int export_log(LoggerSession *session, const char *file_name, ExportFormat format, const char *filters) {
+    OutputBuffer out = { -1, NULL, 0, EXPORT_BUFFER_SIZE, 0 };
+    long long rows = 0, skipped = 0;
+    int rc;
+
+    if (!log_readable(session, 0)) {
+        return SQLITE_CANTOPEN;
+    }
+    out.fd = open(file_name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (out.fd < 0) {
+        fprintf(stderr, "Cannot open file '%s' for writing.\n", file_name);
+        return -1;
+    }
+    out.data = malloc(out.capacity);
+    if (out.data == NULL) {
+        fprintf(stderr, "Out of memory.\n");
+        close(out.fd);
+        return -1;
+    }
+
+    // The whole log goes through the cached statement; search terms and attached logs need a query of their own,
+    // and so does Cabrillo, which has the contest's QSOs from the main log in time order
+    ViewQuery query;
+    int limit = 0;
+    int by_log = session->log_count > 1 && format != EXPORT_CABRILLO;
+    int own_statement = (filters && *filters) || by_log || format == EXPORT_CABRILLO;
+    const ContestScore *score = session->contest;
+    sqlite3_stmt *stmt = NULL;
+    if (format == EXPORT_CABRILLO) {
+        if (session_prepare(session, score->start_epoch != NO_EPOCH ?
+                            "SELECT " EXPORT_COLUMNS " FROM contacts WHERE qso_epoch >= ?1 AND qso_epoch < ?2 ORDER BY qso_epoch, id" :
+                            "SELECT " EXPORT_COLUMNS " FROM contacts ORDER BY qso_epoch, id", 0, &stmt) == SQLITE_OK) {
+            sqlite3_bind_int64(stmt, 1, score->start_epoch);
+            sqlite3_bind_int64(stmt, 2, score->end_epoch);
+        } else {
+            fprintf(stderr, "Failed to retrieve contacts: %s\n", sqlite3_errmsg(session->db));
+        }
+    } else if (own_statement) {
+        parse_view_params(&query, filters, &limit);
+        stmt = prepare_view_query(session, &query, EXPORT_COLUMNS, limit);
+    }
+
+    // The whole of a big log in CSV or ADIF is formatted on worker threads where it can be
+    long long first_id = 0, last_id = 0;
+    int parallel = !own_statement && start_parallel_export(session, &first_id, &last_id);
+    if (!own_statement && !parallel) {
+        stmt = session_statement(session, STMT_SELECT_ALL_CONTACTS);
+    }
+    if (stmt == NULL && !parallel) {
+        free(out.data);
+        close(out.fd);
+        return SQLITE_ERROR;
+    }
+
+    long long started_us = monotonic_us();
+
+    // Write the header
+    if (format == EXPORT_CSV) {
+        output_string(&out, "ID,Callsign,Frequency,Mode,Sent Report,Received Report,Date/Time,Note,"
+                            "Country,Country Prefix,CQ Zone,ITU Zone,Continent,Band,State,QSL Received,QSL Date,Serial");
+        output_string(&out, by_log ? ",Log\n" : "\n");
+    } else if (format == EXPORT_CABRILLO) {
+        // The contest's name carries the mode most of its QSOs were made in, where it has one
+        char contest[32], header[256];
+        int mode = MODE_CW;
+        for (int m = MODE_PHONE; m <= MODE_DIGITAL; m++) {
+            mode = score->mode_qsos[m] > score->mode_qsos[mode] ? m : mode;
+        }
+        snprintf(contest, sizeof(contest), score->event->cabrillo, mode == MODE_PHONE ? "SSB" : mode == MODE_DIGITAL ? "RTTY" : "CW");
+        snprintf(header, sizeof(header), "START-OF-LOG: 3.0\nCREATED-BY: K3NG's Old School Logger %s\nCONTEST: %s\n"
+                 "CALLSIGN: %s\nCLAIMED-SCORE: %lld\n", CODE_VERSION, contest, score->station, contest_total(score));
+        output_string(&out, header);
+    } else {
+        output_string(&out, "K3NG's Old School Logger ADIF export\n");
+        output_adif_field(&out, "ADIF_VER", 8, "3.1.2", 5);
+        output_adif_field(&out, "PROGRAMID", 9, "OSL", 3);
+        output_adif_field(&out, "PROGRAMVERSION", 14, CODE_VERSION, strlen(CODE_VERSION));
+        output_string(&out, "<EOH>\n\n");
+    }
+
+    // Write each row to the file
+    if (parallel) {
+        rc = export_parallel(session, &out, format, first_id, last_id, &rows, &skipped);
+    }
+    while (!parallel && (rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        if (format == EXPORT_CSV) {
+            int log = by_log ? sqlite3_column_int(stmt, sqlite3_column_count(stmt) - 1) : 0;
+            write_csv_row(&out, stmt, by_log && log < session->log_count ? session->logs[log].name : NULL);
+        } else {
+            int written = format == EXPORT_CABRILLO ? write_cabrillo_row(&out, stmt, score) : write_adif_row(&out, stmt);
+            if (written <= 0) {
+                printf(written < 0 ? "Error: No serial number was stored with ID %lld, so what was sent isn't known; skipped.\n" :
+                       "Error: No usable date/time in database for ID %lld, skipped.\n", (long long)sqlite3_column_int64(stmt, 0));
+                skipped++;
+                continue;
+            }
+        }
+        rows++;
+    }
+
+    if (rc != SQLITE_DONE && !parallel) {
+        fprintf(stderr, "Failed to retrieve contacts: %s\n", sqlite3_errmsg(session->db));
+    }
+    if (own_statement) {
+        session_finalize(session, stmt);
+    } else if (!parallel) {
+        sqlite3_reset(stmt);
+    }
+    if (format == EXPORT_CABRILLO) {
+        output_string(&out, "END-OF-LOG:\n");
+    }
+
+    output_flush(&out);
+    free(out.data);
+    if (close(out.fd) != 0 || out.error) {
+        fprintf(stderr, "Error writing to file '%s'.\n", file_name);
+        return -1;
+    }
+    if (rc != SQLITE_DONE) {
+        return rc;
+    }
+
+    double seconds = (monotonic_us() - started_us) / 1e6;
+    printf("%lld contacts written in %.2f s (%.0f rows/sec)", rows, seconds, seconds > 0 ? rows / seconds : 0.0);
+    if (skipped > 0) {
+        printf(", %lld skipped", skipped);
+    }
+    printf(".\n");
+    return SQLITE_OK;
+}
+
+// Function to export contacts to a CSV file
+int export_contacts(LoggerSession *session, const char *file_name, const char *filters) {
+    int rc = export_log(session, file_name, EXPORT_CSV, filters);
+    if (rc == SQLITE_OK) {
+        printf("Contacts successfully exported to '%s'.\n", file_name);
+    }
+    return rc;
+}
+
+// Function to export contacts to an ADIF file
+int export_adif(LoggerSession *session, const char *file_name, const char *filters) {
+    int rc = export_log(session, file_name, EXPORT_ADIF, filters);
+    if (rc == SQLITE_OK) {
+        printf("Database exported to '%s' in ADIF format.\n", file_name);
+    }
+    return rc;
+}
+
+// Function to export the contest being scored to a Cabrillo file, for submitting it
+int export_cabrillo(LoggerSession *session, const char *file_name) {
+    if (session->contest == NULL) {
+        printf("Error: Not scoring a contest. Use 'K <contest> <your call>' first.\n");
+        return SQLITE_OK;
+    }
+    int rc = export_log(session, file_name, EXPORT_CABRILLO, NULL);
+    if (rc == SQLITE_OK) {
+        printf("%s log for %s exported to '%s' in Cabrillo format.\n", session->contest->event->title,
+               session->contest->station, file_name);
+    }
+    return rc;
+}
+
+// Columns of a log archive: the contacts table's, in its order (that of EXPORT_COLUMNS)
+static const struct {
+    const char *name;
+    ArchiveEncoding encoding;
+} archive_columns[ARCHIVE_COLUMN_COUNT] = {
+    { "id", ARCHIVE_DELTA }, { "callsign", ARCHIVE_TEXT }, { "frequency", ARCHIVE_TEXT }, { "mode", ARCHIVE_TEXT },
+    { "sent_report", ARCHIVE_TEXT }, { "received_report", ARCHIVE_TEXT }, { "date_time", ARCHIVE_DATE_TIME },
+    { "comment", ARCHIVE_TEXT }, { "country", ARCHIVE_TEXT }, { "country_prefix", ARCHIVE_TEXT },
+    { "cq_zone", ARCHIVE_INTEGER }, { "itu_zone", ARCHIVE_INTEGER }, { "continent", ARCHIVE_TEXT },
+    { "frequency_hz", ARCHIVE_INTEGER }, { "band", ARCHIVE_TEXT }, { "qso_epoch", ARCHIVE_DELTA },
+    { "state", ARCHIVE_TEXT }, { "wpx_prefix", ARCHIVE_TEXT }, { "qsl_rcvd", ARCHIVE_TEXT },
+    { "qsl_rcvd_date", ARCHIVE_TEXT }, { "serial", ARCHIVE_INTEGER }
+};
+
+// Function to round a size up to the next 8-byte boundary
+static uint64_t archive_align(uint64_t size) {
+    return (size + 7) & ~(uint64_t)7;
+}
+
+// Function to write seconds since 1970 the way date_time is stored, with or without the seconds
+static void archive_date_time(long long epoch, int with_seconds, char *buffer, size_t buffer_size) {
+    int year, month, day, seconds;
+    epoch_to_civil(epoch, &year, &month, &day, &seconds);
+    if (with_seconds) {
+        snprintf(buffer, buffer_size, "%04d-%02d-%02d %02d:%02d:%02d", year, month, day,
+                 seconds / 3600, seconds / 60 % 60, seconds % 60);
+    } else {
+        snprintf(buffer, buffer_size, "%04d-%02d-%02d %02d:%02d", year, month, day, seconds / 3600, seconds / 60 % 60);
+    }
+}
+
+// Function to make room for at least needed items in an array, doubling it as it grows.
+// Returns the array, which may have moved, or NULL (leaving it as it was) if out of memory.
+static void *archive_reserve(void *data, size_t *capacity, size_t needed, size_t item_size) {
+    if (needed <= *capacity) {
+        return data;
+    }
+    size_t grown = *capacity ? *capacity : 1024;
+    while (grown < needed) {
+        grown *= 2;
+    }
+    void *moved = realloc(data, grown * item_size);
+    if (moved != NULL) {
+        *capacity = grown;
+    }
+    return moved;
+}
+
+// Function to hash a dictionary entry: FNV-1a over a string's bytes, or an integer's bits mixed
+static uint32_t archive_hash(int is_text, const unsigned char *text, size_t length, long long value) {
+    if (!is_text) {
+        return (uint32_t)(((unsigned long long)value * 0x9e3779b97f4a7c15ULL) >> 32);
+    }
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ text[i]) * 16777619u;
+    }
+    return hash;
+}
+
+// Function to find a string (or, with text NULL, an integer) in a column's dictionary, adding it
+// if it's new.  Returns its entry number, or -1 if out of memory.
+static long long archive_dictionary_entry(ArchiveBuilder *builder, const unsigned char *text, size_t length, long long value) {
+    int is_text = text != NULL;
+    if ((builder->entry_count + 1) * 2 > builder->slot_capacity) {
+        size_t capacity = builder->slot_capacity ? builder->slot_capacity * 2 : 1024;
+        uint32_t *slots = calloc(capacity, sizeof(uint32_t));
+        if (slots == NULL) {
+            return -1;
+        }
+        for (size_t entry = 0; entry < builder->entry_count; entry++) {
+            uint32_t hash = is_text ? archive_hash(1, builder->bytes + builder->string_offsets[entry],
+                                                   builder->string_offsets[entry + 1] - builder->string_offsets[entry], 0) :
+                                      archive_hash(0, NULL, 0, builder->values[entry]);
+            size_t slot = hash & (capacity - 1);
+            while (slots[slot]) {
+                slot = (slot + 1) & (capacity - 1);
+            }
+            slots[slot] = (uint32_t)(entry + 1);
+        }
+        free(builder->slots);
+        builder->slots = slots;
+        builder->slot_capacity = capacity;
+    }
+
+    size_t slot = archive_hash(is_text, text, length, value) & (builder->slot_capacity - 1);
+    while (builder->slots[slot]) {
+        size_t entry = builder->slots[slot] - 1;
+        if (is_text ? builder->string_offsets[entry + 1] - builder->string_offsets[entry] == length &&
+                      (length == 0 || memcmp(builder->bytes + builder->string_offsets[entry], text, length) == 0) :
+                   builder->values[entry] == value) {
+            return (long long)entry;
+        }
+        slot = (slot + 1) & (builder->slot_capacity - 1);
+    }
+
+    // A new entry: its string goes on the end of the bytes, or its value on the end of the values
+    size_t entry_capacity = builder->entry_capacity;
+    if (is_text) {
+        void *offsets = archive_reserve(builder->string_offsets, &entry_capacity, builder->entry_count + 2, sizeof(uint64_t));
+        if (offsets == NULL) {
+            return -1;
+        }
+        builder->string_offsets = offsets;
+        void *bytes = archive_reserve(builder->bytes, &builder->bytes_capacity, builder->bytes_used + length + 1, 1);
+        if (bytes == NULL) {
+            return -1;
+        }
+        builder->bytes = bytes;
+        memcpy(builder->bytes + builder->bytes_used, text, length);
+        builder->string_offsets[builder->entry_count] = builder->bytes_used;
+        builder->bytes_used += length;
+        builder->string_offsets[builder->entry_count + 1] = builder->bytes_used;
+    } else {
+        void *values = archive_reserve(builder->values, &entry_capacity, builder->entry_count + 1, sizeof(int64_t));
+        if (values == NULL) {
+            return -1;
+        }
+        builder->values = values;
+        builder->values[builder->entry_count] = value;
+    }
+    builder->entry_capacity = entry_capacity;
+    builder->slots[slot] = (uint32_t)(builder->entry_count + 1);
+    return (long long)builder->entry_count++;
+}
+
+// Function to add one row's value to a column being built.  row_capacity is how many rows the
+// codes and NULL bitmaps have room for.  Returns 0, -1 if out of memory, or -2 for a value the
+// column can't hold exactly (text in an integer column, say).
+static int archive_add_value(ArchiveBuilder *builder, ArchiveEncoding encoding, sqlite3_stmt *stmt, int index, uint64_t row) {
+    int type = sqlite3_column_type(stmt, index);
+
+    if (encoding == ARCHIVE_DELTA) {
+        if (type == SQLITE_NULL) {
+            builder->nulls[row / 64] |= 1ULL << (row % 64);
+            return 0;
+        }
+        if (type != SQLITE_INTEGER) {
+            return -2;
+        }
+        long long value = sqlite3_column_int64(stmt, index);
+        unsigned long long delta = (unsigned long long)value - (unsigned long long)builder->previous;
+        unsigned long long zigzag = (delta << 1) ^ (unsigned long long)-(long long)(delta >> 63);
+        builder->previous = value;
+        void *bytes = archive_reserve(builder->bytes, &builder->bytes_capacity, builder->bytes_used + 10, 1);
+        if (bytes == NULL) {
+            return -1;
+        }
+        builder->bytes = bytes;
+        do {
+            builder->bytes[builder->bytes_used++] = (unsigned char)((zigzag & 0x7f) | (zigzag > 0x7f ? 0x80 : 0));
+            zigzag >>= 7;
+        } while (zigzag);
+        return 0;
+    }
+
+    long long entry;
+    if (type == SQLITE_NULL) {
+        builder->codes[row] = 0;
+        return 0;
+    } else if (encoding == ARCHIVE_INTEGER) {
+        if (type != SQLITE_INTEGER) {
+            return -2;
+        }
+        entry = archive_dictionary_entry(builder, NULL, 0, sqlite3_column_int64(stmt, index));
+    } else {
+        if (type != SQLITE_TEXT) {
+            return -2;
+        }
+        const unsigned char *text = sqlite3_column_text(stmt, index);
+        size_t length = (size_t)sqlite3_column_bytes(stmt, index);
+
+        // A date_time that says what qso_epoch (column 15) does is stored as just which way it was written
+        if (encoding == ARCHIVE_DATE_TIME && sqlite3_column_type(stmt, 15) == SQLITE_INTEGER) {
+            char written[32];
+            for (int with_seconds = 0; with_seconds <= 1; with_seconds++) {
+                archive_date_time(sqlite3_column_int64(stmt, 15), with_seconds, written, sizeof(written));
+                if (strlen(written) == length && memcmp(written, text, length) == 0) {
+                    builder->codes[row] = 1 + with_seconds;
+                    return 0;
+                }
+            }
+        }
+        entry = archive_dictionary_entry(builder, text, length, 0);
+    }
+    if (entry < 0) {
+        return -1;
+    }
+    builder->codes[row] = (uint32_t)(entry + (encoding == ARCHIVE_DATE_TIME ? 3 : 1));
+    return 0;
+}
+
+// Function to work out a built column's largest code, and so how many bytes each row's code takes
+static uint32_t archive_code_width(const ArchiveBuilder *builder, ArchiveEncoding encoding) {
+    uint64_t max_code = builder->entry_count + (encoding == ARCHIVE_DATE_TIME ? 2 : 0);
+    return max_code <= 0xff ? 1 : max_code <= 0xffff ? 2 : 4;
+}
+
+// Function to work out the size of a column's section from its counts.  Returns UINT64_MAX if a
+// count is too large for the file, so a damaged header can't lead to an overflow.
+static uint64_t archive_section_size(ArchiveEncoding encoding, uint64_t rows, uint64_t entry_count, uint32_t code_width,
+                                     uint64_t string_bytes, uint64_t file_size) {
+    if (rows > file_size || entry_count > file_size / 8 || string_bytes > file_size) {
+        return UINT64_MAX;
+    }
+    if (encoding == ARCHIVE_DELTA) {
+        return (rows + 63) / 64 * 8 + archive_align(entry_count);
+    }
+    uint64_t codes = archive_align(rows * code_width);
+    if (encoding == ARCHIVE_INTEGER) {
+        return entry_count * 8 + codes;
+    }
+    return (entry_count + 1) * 8 + archive_align(string_bytes) + codes;
+}
+
+// Function to make room for more rows in every column being built: codes for the dictionary
+// columns and NULL bits for the others.  Returns 0, or -1 if out of memory.
+static int archive_grow_rows(ArchiveBuilder *builders, size_t *row_capacity) {
+    size_t rows = *row_capacity ? *row_capacity * 2 : 1024;
+    for (int i = 0; i < ARCHIVE_COLUMN_COUNT; i++) {
+        if (archive_columns[i].encoding == ARCHIVE_DELTA) {
+            uint64_t *nulls = realloc(builders[i].nulls, rows / 64 * sizeof(uint64_t));
+            if (nulls == NULL) {
+                return -1;
+            }
+            memset(nulls + *row_capacity / 64, 0, (rows - *row_capacity) / 64 * sizeof(uint64_t));
+            builders[i].nulls = nulls;
+        } else {
+            uint32_t *codes = realloc(builders[i].codes, rows * sizeof(uint32_t));
+            if (codes == NULL) {
+                return -1;
+            }
+            builders[i].codes = codes;
+        }
+    }
+    *row_capacity = rows;
+    return 0;
+}
+
+// Function to append zero bytes up to the next 8-byte boundary
+static void output_align(OutputBuffer *out, uint64_t written) {
+    static const char zeros[8] = { 0 };
+    output_bytes(out, zeros, archive_align(written) - written);
+}
+
+// Function to write the whole log to a columnar archive: callsigns, modes, bands and the other
+// text columns dictionary encoded, IDs and times as varint differences, so the file is a fraction
+// of the database's size and a scan only reads the columns it needs.  One pass over the log
+// builds every column in memory, and then they're written out one after another.
+int archive_log(LoggerSession *session, const char *file_name) {
+    ArchiveBuilder builders[ARCHIVE_COLUMN_COUNT];
+    size_t row_capacity = 0;
+    uint64_t rows = 0;
+    int rc = SQLITE_OK, failed = 0;
+
+    if (!log_readable(session, 0)) {
+        return SQLITE_CANTOPEN;
+    }
+    memset(builders, 0, sizeof(builders));
+    sqlite3_stmt *stmt = session_statement(session, STMT_SELECT_ALL_CONTACTS);
+    if (stmt == NULL) {
+        return SQLITE_ERROR;
+    }
+
+    long long started_us = monotonic_us();
+    while (!failed && (rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        if (rows == row_capacity && archive_grow_rows(builders, &row_capacity) != 0) {
+            fprintf(stderr, "Out of memory.\n");
+            failed = 1;
+            break;
+        }
+        for (int i = 0; i < ARCHIVE_COLUMN_COUNT; i++) {
+            int added = archive_add_value(&builders[i], archive_columns[i].encoding, stmt, i, rows);
+            if (added == -2) {
+                fprintf(stderr, "Contact ID %lld has a %s that can't be archived exactly.\n",
+                        (long long)sqlite3_column_int64(stmt, 0), archive_columns[i].name);
+            } else if (added != 0) {
+                fprintf(stderr, "Out of memory.\n");
+            }
+            if (added != 0) {
+                failed = 1;
+                break;
+            }
+        }
+        rows++;
+    }
+    if (!failed && rc != SQLITE_DONE) {
+        fprintf(stderr, "Failed to retrieve contacts: %s\n", sqlite3_errmsg(session->db));
+        failed = 1;
+    }
+    sqlite3_reset(stmt);
+
+    // Contact IDs are never reused, so the archive keeps the highest one given out for A load to carry on from
+    long long id_sequence = 0;
+    if (!failed && session_prepare(session, "SELECT seq FROM sqlite_sequence WHERE name = 'contacts'", 0,
+                                   &stmt) == SQLITE_OK) {
+        id_sequence = sqlite3_step(stmt) == SQLITE_ROW ? sqlite3_column_int64(stmt, 0) : 0;
+        session_finalize(session, stmt);
+    }
+
+    // Lay out the sections after the header, then write it all
+    ArchiveHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, ARCHIVE_MAGIC, sizeof(ARCHIVE_MAGIC));
+    header.row_count = rows;
+    header.column_count = ARCHIVE_COLUMN_COUNT;
+    header.id_sequence = id_sequence > 0 ? (uint64_t)id_sequence : 0;
+    uint64_t offset = archive_align(sizeof(header));
+    for (int i = 0; i < ARCHIVE_COLUMN_COUNT; i++) {
+        ArchiveColumn *column = &header.columns[i];
+        ArchiveEncoding encoding = archive_columns[i].encoding;
+        snprintf(column->name, sizeof(column->name), "%s", archive_columns[i].name);
+        column->encoding = encoding;
+        column->code_width = encoding == ARCHIVE_DELTA ? 0 : archive_code_width(&builders[i], encoding);
+        column->entry_count = encoding == ARCHIVE_DELTA ? builders[i].bytes_used : builders[i].entry_count;
+        column->offset = offset;
+        column->size = archive_section_size(encoding, rows, column->entry_count, column->code_width,
+                                            builders[i].bytes_used, UINT64_MAX);
+        offset += column->size;
+    }
+
+    // Written alongside and renamed over the file, so an archive that's already there is only
+    // replaced by a complete one
+    OutputBuffer out = { -1, NULL, 0, EXPORT_BUFFER_SIZE, 0 };
+    char temp_file[1024];
+    snprintf(temp_file, sizeof(temp_file), "%s.tmp", file_name);
+    if (!failed) {
+        out.fd = open(temp_file, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        out.data = malloc(out.capacity);
+        if (out.fd < 0) {
+            fprintf(stderr, "Cannot open file '%s' for writing.\n", temp_file);
+            failed = 1;
+        } else if (out.data == NULL) {
+            fprintf(stderr, "Out of memory.\n");
+            failed = 1;
+        }
+    }
+    if (!failed) {
+        output_bytes(&out, (const char *)&header, sizeof(header));
+        output_align(&out, sizeof(header));
+        for (int i = 0; i < ARCHIVE_COLUMN_COUNT; i++) {
+            const ArchiveBuilder *builder = &builders[i];
+            const ArchiveColumn *column = &header.columns[i];
+            if (column->encoding == ARCHIVE_DELTA) {
+                output_bytes(&out, (const char *)builder->nulls, (rows + 63) / 64 * sizeof(uint64_t));
+                output_bytes(&out, (const char *)builder->bytes, builder->bytes_used);
+                output_align(&out, builder->bytes_used);
+                continue;
+            }
+            if (column->encoding == ARCHIVE_INTEGER) {
+                output_bytes(&out, (const char *)builder->values, builder->entry_count * sizeof(int64_t));
+            } else {
+                uint64_t none = 0;
+                output_bytes(&out, (const char *)(builder->entry_count ? builder->string_offsets : &none),
+                             (builder->entry_count + 1) * sizeof(uint64_t));
+                output_bytes(&out, (const char *)builder->bytes, builder->bytes_used);
+                output_align(&out, builder->bytes_used);
+            }
+
+            // The codes, narrowed to their width a block at a time
+            unsigned char block[4096];
+            size_t used = 0;
+            for (uint64_t row = 0; row < rows; row++) {
+                uint32_t code = builder->codes[row];
+                if (column->code_width == 1) {
+                    block[used] = (unsigned char)code;
+                } else if (column->code_width == 2) {
+                    uint16_t narrow = (uint16_t)code;
+                    memcpy(block + used, &narrow, 2);
+                } else {
+                    memcpy(block + used, &code, 4);
+                }
+                used += column->code_width;
+                if (used == sizeof(block)) {
+                    output_bytes(&out, (const char *)block, used);
+                    used = 0;
+                }
+            }
+            output_bytes(&out, (const char *)block, used);
+            output_align(&out, rows * column->code_width);
+        }
+        output_flush(&out);
+        if (out.error || fsync(out.fd) != 0 || close(out.fd) != 0) {
+            fprintf(stderr, "Error writing to file '%s'.\n", temp_file);
+            failed = 1;
+        } else if (rename(temp_file, file_name) != 0) {
+            fprintf(stderr, "Cannot replace file '%s': %s\n", file_name, strerror(errno));
+            failed = 1;
+        }
+        if (failed) {
+            unlink(temp_file);
+        }
+    } else if (out.fd >= 0) {
+        close(out.fd);
+        unlink(temp_file);
+    }
+
+    free(out.data);
+    for (int i = 0; i < ARCHIVE_COLUMN_COUNT; i++) {
+        free(builders[i].bytes);
+        free(builders[i].string_offsets);
+        free(builders[i].values);
+        free(builders[i].slots);
+        free(builders[i].codes);
+        free(builders[i].nulls);
+    }
+    if (failed) {
+        return SQLITE_ERROR;
+    }
+
+    double seconds = (monotonic_us() - started_us) / 1e6;
+    printf("%llu contacts archived to '%s' in %.2f s: %.1f MB, %.0f bytes a contact.\n", (unsigned long long)rows,
+           file_name, seconds, offset / 1048576.0, rows ? (double)offset / rows : 0.0);
+    return SQLITE_OK;
+}
+
+// Function to close a mapped log archive
+static void close_archive(LogArchive *archive) {
+    unmap_file(&archive->image);
+    archive->header = NULL;
+}
+
+// Function to map a log archive and check that its header and dictionaries hold together, so
+// reading it can trust every offset.  Returns 0, or -1 having said what's wrong.
+static int open_archive(const char *file_name, LogArchive *archive) {
+    memset(archive, 0, sizeof(*archive));
+    if (map_file(file_name, &archive->image) != 0) {
+        return -1;
+    }
+
+    const ArchiveHeader *header = (const ArchiveHeader *)archive->image.data;
+    uint64_t file_size = archive->image.size;
+    int valid = file_size >= sizeof(ArchiveHeader) && memcmp(header->magic, ARCHIVE_MAGIC, sizeof(ARCHIVE_MAGIC)) == 0 &&
+                header->column_count == ARCHIVE_COLUMN_COUNT;
+    for (int i = 0; valid && i < ARCHIVE_COLUMN_COUNT; i++) {
+        const ArchiveColumn *column = &header->columns[i];
+        ArchiveEncoding encoding = archive_columns[i].encoding;
+        valid = strncmp(column->name, archive_columns[i].name, sizeof(column->name)) == 0 &&
+                column->encoding == (uint32_t)encoding && column->offset % 8 == 0 &&
+                column->offset <= file_size && column->size <= file_size - column->offset &&
+                (encoding == ARCHIVE_DELTA ? column->code_width == 0 :
+                 column->code_width == 1 || column->code_width == 2 || column->code_width == 4);
+        if (!valid || encoding == ARCHIVE_DELTA || encoding == ARCHIVE_INTEGER) {
+            valid = valid && column->size == archive_section_size(encoding, header->row_count, column->entry_count,
+                                                                   column->code_width, 0, file_size);
+            continue;
+        }
+
+        // The dictionary's string offsets must climb from 0 to the end of its strings
+        const uint64_t *offsets = (const uint64_t *)(archive->image.data + column->offset);
+        valid = column->entry_count < column->size / 8 && offsets[0] == 0;
+        for (uint64_t entry = 0; valid && entry < column->entry_count; entry++) {
+            valid = offsets[entry + 1] >= offsets[entry];
+        }
+        valid = valid && column->size == archive_section_size(encoding, header->row_count, column->entry_count,
+                                                              column->code_width, offsets[column->entry_count], file_size);
+    }
+    if (!valid) {
+        fprintf(stderr, "Error: '%s' is not a valid log archive.\n", file_name);
+        unmap_file(&archive->image);
+        return -1;
+    }
+    archive->header = header;
+    return 0;
+}
+
+// Function to start reading one column of a mapped archive from its first row
+static void archive_cursor(const LogArchive *archive, int index, ArchiveCursor *cursor) {
+    const ArchiveColumn *column = &archive->header->columns[index];
+    const unsigned char *section = (const unsigned char *)archive->image.data + column->offset;
+    uint64_t rows = archive->header->row_count;
+
+    memset(cursor, 0, sizeof(*cursor));
+    cursor->column = column;
+    if (column->encoding == ARCHIVE_DELTA) {
+        cursor->nulls = (const uint64_t *)section;
+        cursor->next = section + (rows + 63) / 64 * 8;
+        cursor->end = cursor->next + column->entry_count;
+    } else if (column->encoding == ARCHIVE_INTEGER) {
+        cursor->values = (const int64_t *)section;
+        cursor->codes = section + column->entry_count * 8;
+    } else {
+        cursor->string_offsets = (const uint64_t *)section;
+        cursor->strings = (const char *)(section + (column->entry_count + 1) * 8);
+        cursor->codes = (const unsigned char *)cursor->strings + archive_align(cursor->string_offsets[column->entry_count]);
+    }
+    cursor->max_code = column->entry_count + (column->encoding == ARCHIVE_DATE_TIME ? 2 : 0);
+}
+
+// Function to read the next row's dictionary code from a cursor, 0 for NULL.  Returns -1 for a
+// code with no entry, which only a damaged file has.
+static long long archive_next_code(ArchiveCursor *cursor) {
+    uint64_t row = cursor->row++;
+    uint32_t code;
+    if (cursor->column->code_width == 1) {
+        code = cursor->codes[row];
+    } else if (cursor->column->code_width == 2) {
+        uint16_t narrow;
+        memcpy(&narrow, cursor->codes + row * 2, 2);
+        code = narrow;
+    } else {
+        memcpy(&code, cursor->codes + row * 4, 4);
+    }
+    return code <= cursor->max_code ? (long long)code : -1;
+}
+
+// Function to read the next row of an integer column.  Returns 1 with *value set, 0 for NULL,
+// or -1 if the file is damaged.
+static int archive_next_integer(ArchiveCursor *cursor, long long *value) {
+    if (cursor->column->encoding == ARCHIVE_INTEGER) {
+        long long code = archive_next_code(cursor);
+        if (code > 0) {
+            *value = cursor->values[code - 1];
+        }
+        return code > 0 ? 1 : (int)code;
+    }
+
+    uint64_t row = cursor->row++;
+    if (cursor->nulls[row / 64] & (1ULL << (row % 64))) {
+        return 0;
+    }
+    unsigned long long zigzag = 0;
+    for (int shift = 0;; shift += 7) {
+        if (cursor->next == cursor->end || shift > 63) {
+            return -1;
+        }
+        unsigned char byte = *cursor->next++;
+        zigzag |= (unsigned long long)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            break;
+        }
+    }
+    unsigned long long delta = (zigzag >> 1) ^ (unsigned long long)-(long long)(zigzag & 1);
+    cursor->previous = (long long)((unsigned long long)cursor->previous + delta);
+    *value = cursor->previous;
+    return 1;
+}
+
+// Function to read the next row of a text column.  A date_time written from qso_epoch is written
+// again into buffer, which needs room for 20 characters.  Returns 1 with *text and *length set,
+// 0 for NULL, or -1 if the file is damaged.
+static int archive_next_text(ArchiveCursor *cursor, const char **text, size_t *length, long long epoch, int has_epoch,
+                             char *buffer, size_t buffer_size) {
+    long long code = archive_next_code(cursor);
+    if (code <= 0) {
+        return (int)code;
+    }
+    if (cursor->column->encoding == ARCHIVE_DATE_TIME) {
+        if (code <= 2) {
+            if (!has_epoch) {
+                return -1;
+            }
+            archive_date_time(epoch, code == 2, buffer, buffer_size);
+            *text = buffer;
+            *length = strlen(buffer);
+            return 1;
+        }
+        code -= 2;
+    }
+    *text = cursor->strings + cursor->string_offsets[code - 1];
+    *length = cursor->string_offsets[code] - cursor->string_offsets[code - 1];
+    return 1;
+}
+
+// Function to load a log archive into the log.  Into an empty log it puts back exactly what was
+// archived, IDs and all; into a log that has contacts, they're added with new IDs.  Every row goes
+// in through the contacts table, so the award credits and notes index are kept as usual.
+int restore_archive(LoggerSession *session, const char *file_name) {
+    LogArchive archive;
+    ArchiveCursor cursors[ARCHIVE_COLUMN_COUNT];
+    char *err_msg = NULL;
+    sqlite3_stmt *insert = NULL;
+    int rc;
+
+    if (open_archive(file_name, &archive) != 0) {
+        return -1;
+    }
+
+    // Commit anything contest mode has pending, then take the whole load as one transaction.  In a
+    // batch script's transaction it's a savepoint instead, committed with the rest of the script.
+    int in_batch = session->batch_mode && !sqlite3_get_autocommit(session->db);
+    const char *rollback = in_batch ? "ROLLBACK TO restore_archive; RELEASE restore_archive" : "ROLLBACK";
+    rc = in_batch ? SQLITE_OK : flush_group_commit(session);
+    if (rc == SQLITE_OK) {
+        rc = sqlite3_exec(session->db, in_batch ? "SAVEPOINT restore_archive" : "BEGIN IMMEDIATE", 0, 0, &err_msg);
+    }
+    if (rc == SQLITE_OK) {
+        rc = session_prepare(session, "INSERT INTO contacts (" EXPORT_COLUMNS ") VALUES "
+                             "(?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)", 0, &insert);
+    }
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "SQL error: %s\n", err_msg ? err_msg : sqlite3_errmsg(session->db));
+        sqlite3_free(err_msg);
+        sqlite3_exec(session->db, rollback, 0, 0, NULL);
+        close_archive(&archive);
+        return rc;
+    }
+
+    // The IDs are kept if the log is empty
+    int keep_ids = 0;
+    sqlite3_stmt *stmt = session_statement(session, STMT_SELECT_MAX_ID);
+    if (stmt) {
+        keep_ids = sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_type(stmt, 0) == SQLITE_NULL;
+        sqlite3_reset(stmt);
+    }
+
+    long long started_us = monotonic_us();
+    for (int i = 0; i < ARCHIVE_COLUMN_COUNT; i++) {
+        archive_cursor(&archive, i, &cursors[i]);
+    }
+    uint64_t rows = archive.header->row_count, row;
+    for (row = 0; row < rows && rc == SQLITE_OK; row++) {
+        // qso_epoch first, since date_time may be written from it
+        long long epoch = 0;
+        int has_epoch = archive_next_integer(&cursors[15], &epoch);
+        rc = has_epoch < 0 ? SQLITE_CORRUPT : SQLITE_OK;
+        for (int i = 0; i < ARCHIVE_COLUMN_COUNT && rc == SQLITE_OK; i++) {
+            char buffer[32];
+            const char *text = NULL;
+            size_t length = 0;
+            long long value = epoch;
+            int found = i == 15 ? has_epoch :
+                        archive_columns[i].encoding == ARCHIVE_DELTA || archive_columns[i].encoding == ARCHIVE_INTEGER ?
+                        archive_next_integer(&cursors[i], &value) :
+                        archive_next_text(&cursors[i], &text, &length, epoch, has_epoch == 1, buffer, sizeof(buffer));
+            if (found < 0) {
+                rc = SQLITE_CORRUPT;
+            } else if (found == 0 || (i == 0 && !keep_ids)) {
+                sqlite3_bind_null(insert, i + 1);
+            } else if (archive_columns[i].encoding == ARCHIVE_DELTA || archive_columns[i].encoding == ARCHIVE_INTEGER) {
+                sqlite3_bind_int64(insert, i + 1, value);
+            } else {
+                sqlite3_bind_text(insert, i + 1, text, (int)length, text == buffer ? SQLITE_TRANSIENT : SQLITE_STATIC);
+            }
+        }
+        if (rc == SQLITE_CORRUPT) {
+            fprintf(stderr, "Error: '%s' is damaged at row %llu.\n", file_name, (unsigned long long)row + 1);
+            break;
+        }
+
+        rc = sqlite3_step(insert);
+        sqlite3_reset(insert);
+        if (rc != SQLITE_DONE) {
+            fprintf(stderr, "Failed to insert contact: %s\n", sqlite3_errmsg(session->db));
+            break;
+        }
+        rc = SQLITE_OK;
+        if ((row + 1) % IMPORT_PROGRESS_INTERVAL == 0) {
+            printf("  %llu contacts loaded (%.0f%% of the archive)...\n", (unsigned long long)row + 1, 100.0 * (row + 1) / rows);
+            fflush(stdout);
+        }
+    }
+    session_finalize(session, insert);
+
+    // With the IDs kept, the log also carries on from the archived log's highest ID, so the IDs
+    // of contacts deleted before archiving aren't given out again
+    if (rc == SQLITE_OK && keep_ids && archive.header->id_sequence > 0 && archive.header->id_sequence <= INT64_MAX) {
+        rc = session_prepare(session, "UPDATE sqlite_sequence SET seq = max(seq, ?) WHERE name = 'contacts'", 0, &insert);
+        if (rc == SQLITE_OK) {
+            sqlite3_bind_int64(insert, 1, (sqlite3_int64)archive.header->id_sequence);
+            rc = sqlite3_step(insert) == SQLITE_DONE ? SQLITE_OK : SQLITE_ERROR;
+            session_finalize(session, insert);
+        }
+        if (rc == SQLITE_OK && sqlite3_changes(session->db) == 0) {
+            rc = session_prepare(session, "INSERT INTO sqlite_sequence (name, seq) VALUES ('contacts', ?)", 0, &insert);
+            if (rc == SQLITE_OK) {
+                sqlite3_bind_int64(insert, 1, (sqlite3_int64)archive.header->id_sequence);
+                rc = sqlite3_step(insert) == SQLITE_DONE ? SQLITE_OK : SQLITE_ERROR;
+                session_finalize(session, insert);
+            }
+        }
+        if (rc != SQLITE_OK) {
+            fprintf(stderr, "Failed to restore the ID sequence: %s\n", sqlite3_errmsg(session->db));
+        }
+    }
+    close_archive(&archive);
+
+    if (rc == SQLITE_OK) {
+        rc = sqlite3_exec(session->db, in_batch ? "RELEASE restore_archive" : "COMMIT", 0, 0, &err_msg);
+    }
+    if (rc != SQLITE_OK) {
+        if (err_msg) {
+            fprintf(stderr, "SQL error: %s\n", err_msg);
+            sqlite3_free(err_msg);
+        }
+        sqlite3_exec(session->db, rollback, 0, 0, NULL);
+        return rc;
+    }
+
+    // The loaded contacts went straight into the table, so the indexes and score are built again
+    free(session->dupes.entries);
+    memset(&session->dupes, 0, sizeof(session->dupes));
+    build_dupe_index(session);
+    char scp_file[sizeof(session->partials.scp_file)];
+    snprintf(scp_file, sizeof(scp_file), "%s", session->partials.scp_file);
+    build_partial_index(session, scp_file[0] ? scp_file : NULL);
+    if (session->contest) {
+        rebuild_contest_score(session);
+    }
+
+    double seconds = (monotonic_us() - started_us) / 1e6;
+    printf("Loaded %llu contacts from '%s' in %.2f s (%.0f rows/sec)%s.\n", (unsigned long long)rows, file_name, seconds,
+           seconds > 0 ? rows / seconds : 0.0, keep_ids ? ", with their IDs" : ", with new IDs after the log's own");
+    return SQLITE_OK;
+}
+
+// Function to show QSOs by year and band, and DXCC entities by band, straight from an archive.
+// Only the qso_epoch, band and country_prefix columns are read; the band and entity of each QSO
+// are dictionary codes, so the scan doesn't look at a single string per row.
+int scan_archive(const char *file_name) {
+    LogArchive archive;
+    ArchiveCursor epochs, band_codes, entity_codes;
+
+    if (open_archive(file_name, &archive) != 0) {
+        return -1;
+    }
+    long long started_us = monotonic_us();
+    archive_cursor(&archive, 15, &epochs);
+    archive_cursor(&archive, 14, &band_codes);
+    archive_cursor(&archive, 9, &entity_codes);
+
+    // Each band name in the dictionary, matched to bands[] once
+    uint64_t band_entries = band_codes.column->entry_count, entity_entries = entity_codes.column->entry_count;
+    int *band_of_code = malloc((band_entries + 1) * sizeof(int));
+    unsigned char *worked = calloc((entity_entries + 1) * (BAND_COUNT + 1), 1);
+    long long (*year_qsos)[BAND_COUNT + 1] = calloc(ARCHIVE_LAST_YEAR - ARCHIVE_FIRST_YEAR + 2, sizeof(*year_qsos));
+    if (band_of_code == NULL || worked == NULL || year_qsos == NULL) {
+        fprintf(stderr, "Out of memory.\n");
+        free(band_of_code);
+        free(worked);
+        free(year_qsos);
+        close_archive(&archive);
+        return -1;
+    }
+    band_of_code[0] = BAND_COUNT;
+    for (uint64_t code = 1; code <= band_entries; code++) {
+        size_t length = band_codes.string_offsets[code] - band_codes.string_offsets[code - 1];
+        const char *name = band_codes.strings + band_codes.string_offsets[code - 1];
+        band_of_code[code] = BAND_COUNT;
+        for (size_t band = 0; band < BAND_COUNT; band++) {
+            if (strlen(bands[band].name) == length && memcmp(bands[band].name, name, length) == 0) {
+                band_of_code[code] = (int)band;
+            }
+        }
+    }
+
+    // Years are found from the day number, which only needs working out when the year changes
+    long long year_start = 0, year_end = 0;
+    int year = 0, rc = 0;
+    uint64_t rows = archive.header->row_count;
+    for (uint64_t row = 0; row < rows; row++) {
+        long long epoch, band_code = archive_next_code(&band_codes), entity_code = archive_next_code(&entity_codes);
+        int has_epoch = archive_next_integer(&epochs, &epoch);
+        if (band_code < 0 || entity_code < 0 || has_epoch < 0) {
+            fprintf(stderr, "Error: '%s' is damaged at row %llu.\n", file_name, (unsigned long long)row + 1);
+            rc = -1;
+            break;
+        }
+        int band = band_of_code[band_code];
+        int slot = ARCHIVE_LAST_YEAR - ARCHIVE_FIRST_YEAR + 1; // For QSOs without a usable year
+        if (has_epoch) {
+            if (epoch < year_start || epoch >= year_end) {
+                int month, day, seconds;
+                epoch_to_civil(epoch, &year, &month, &day, &seconds);
+                year_start = days_from_civil(year, 1, 1) * 86400;
+                year_end = days_from_civil(year + 1, 1, 1) * 86400;
+            }
+            if (year >= ARCHIVE_FIRST_YEAR && year <= ARCHIVE_LAST_YEAR) {
+                slot = year - ARCHIVE_FIRST_YEAR;
+            }
+        }
+        year_qsos[slot][band]++;
+        worked[entity_code * (BAND_COUNT + 1) + band] = 1;
+    }
+    double seconds = (monotonic_us() - started_us) / 1e6;
+
+    if (rc == 0) {
+        uint64_t read = 0;
+        for (int i = 0; i < ARCHIVE_COLUMN_COUNT; i++) {
+            read += i == 9 || i == 14 || i == 15 ? archive.header->columns[i].size : 0;
+        }
+        printf("Archive '%s': %llu contacts; 3 of %d columns read (%.1f of %.1f MB) in %.3f s.\n", file_name,
+               (unsigned long long)rows, ARCHIVE_COLUMN_COUNT, read / 1048576.0, archive.image.size / 1048576.0, seconds);
+
+        long long band_totals[BAND_COUNT + 1] = { 0 };
+        for (int slot = 0; slot <= ARCHIVE_LAST_YEAR - ARCHIVE_FIRST_YEAR + 1; slot++) {
+            for (size_t band = 0; band <= BAND_COUNT; band++) {
+                band_totals[band] += year_qsos[slot][band];
+            }
+        }
+        printf("  Year   ");
+        for (size_t band = 0; band <= BAND_COUNT; band++) {
+            if (band_totals[band] > 0) {
+                printf(" %7s", band < BAND_COUNT ? bands[band].name : "other");
+            }
+        }
+        printf("    Total\n");
+        for (int slot = 0; slot <= ARCHIVE_LAST_YEAR - ARCHIVE_FIRST_YEAR + 2; slot++) {
+            const long long *counts = slot <= ARCHIVE_LAST_YEAR - ARCHIVE_FIRST_YEAR + 1 ? year_qsos[slot] : band_totals;
+            long long total = 0;
+            for (size_t band = 0; band <= BAND_COUNT; band++) {
+                total += counts[band];
+            }
+            if (total == 0) {
+                continue;
+            }
+            char label[16];
+            snprintf(label, sizeof(label), "%d", ARCHIVE_FIRST_YEAR + slot);
+            printf("  %-7s", slot == ARCHIVE_LAST_YEAR - ARCHIVE_FIRST_YEAR + 1 ? "no date" :
+                             slot == ARCHIVE_LAST_YEAR - ARCHIVE_FIRST_YEAR + 2 ? "Total" : label);
+            for (size_t band = 0; band <= BAND_COUNT; band++) {
+                if (band_totals[band] > 0) {
+                    printf(" %7lld", counts[band]);
+                }
+            }
+            printf(" %8lld\n", total);
+        }
+
+        // DXCC entities (country file prefixes) worked on each band and on any band
+        long long entities = 0;
+        for (uint64_t code = 1; code <= entity_entries; code++) {
+            for (size_t band = 0; band <= BAND_COUNT; band++) {
+                if (worked[code * (BAND_COUNT + 1) + band] &&
+                    entity_codes.string_offsets[code] > entity_codes.string_offsets[code - 1]) {
+                    entities++;
+                    break;
+                }
+            }
+        }
+        printf("  DXCC   ");
+        for (size_t band = 0; band <= BAND_COUNT; band++) {
+            if (band_totals[band] == 0) {
+                continue;
+            }
+            long long count = 0;
+            for (uint64_t code = 1; code <= entity_entries; code++) {
+                count += worked[code * (BAND_COUNT + 1) + band] &&
+                         entity_codes.string_offsets[code] > entity_codes.string_offsets[code - 1];
+            }
+            printf(" %7lld", count);
+        }
+        printf(" %8lld\n", entities);
+    }
+
+    free(band_of_code);
+    free(worked);
+    free(year_qsos);
+    close_archive(&archive);
+    return rc;
+}
+
+// Function to delete a contact by ID
+int delete_contact(LoggerSession *session, int contact_id) {
+    long long started_us = monotonic_us();
+    if (session->remote) {
+        return remote_delete_contact(session, contact_id);
+    }
+    int rc = begin_write(session);
+    if (rc != SQLITE_OK) {
+        return rc;
+    }
+
+    // Note the callsign so its dupe index entry can be refreshed afterwards
+    char callsign[64] = "";
+    sqlite3_stmt *stmt = session_statement(session, STMT_SELECT_CALLSIGN_BY_ID);
+    if (stmt == NULL) {
+        return SQLITE_ERROR;
+    }
+    sqlite3_bind_int(stmt, 1, contact_id);
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        snprintf(callsign, sizeof(callsign), "%s", (const char *)sqlite3_column_text(stmt, 0));
+    }
+    sqlite3_reset(stmt);
+    ContestQso before;
+    int counted_before = session->contest && contest_read_qso(session, contact_id, &before);
+
+    stmt = session_statement(session, STMT_DELETE_CONTACT);
+    if (stmt == NULL) {
+        return SQLITE_ERROR;
+    }
+
+    // Bind the contact ID to the prepared statement
+    sqlite3_bind_int(stmt, 1, contact_id);
+
+    // Execute the statement
+    rc = sqlite3_step(stmt);
+    if (rc != SQLITE_DONE) {
+        fprintf(stderr, "Failed to delete contact: %s\n", sqlite3_errmsg(session->db));
+    }
+
+    sqlite3_reset(stmt);
+    if (rc != SQLITE_DONE) {
+        return rc;
+    }
+
+    dupe_index_refresh(session, callsign);
+    if (counted_before) {
+        contest_count(session->contest, &before, -1);
+    }
+    return end_write(session, started_us);
+}
+
+// Function to load a contact from the database by ID
+int load_contact(LoggerSession *session, int contact_id, Contact *contact) {
+    int rc;
+
+    if (!log_readable(session, 0)) {
+        return SQLITE_CANTOPEN;
+    }
+
+    sqlite3_stmt *stmt = session_statement(session, STMT_SELECT_CONTACT);
+    if (stmt == NULL) {
+        return SQLITE_ERROR;
+    }
+
+    // Bind the contact ID to the prepared statement
+    sqlite3_bind_int(stmt, 1, contact_id);
+
+    if ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        snprintf(contact->callsign_worked, sizeof(contact->callsign_worked), "%s", (const char *)sqlite3_column_text(stmt, 0));
+        snprintf(contact->frequency, sizeof(contact->frequency), "%s", (const char *)sqlite3_column_text(stmt, 1));
+        snprintf(contact->mode, sizeof(contact->mode), "%s", (const char *)sqlite3_column_text(stmt, 2));
+        snprintf(contact->sent_report, sizeof(contact->sent_report), "%s", (const char *)sqlite3_column_text(stmt, 3));
+        snprintf(contact->received_report, sizeof(contact->received_report), "%s", (const char *)sqlite3_column_text(stmt, 4));
+
+        const char *date_time = (const char *)sqlite3_column_text(stmt, 5);
+        sscanf(date_time, "%19s %19s", contact->contact_date, contact->contact_time);
+
+        snprintf(contact->comment, sizeof(contact->comment), "%s",
+                 sqlite3_column_text(stmt, 6) ? (const char *)sqlite3_column_text(stmt, 6) : "");
+
+        snprintf(contact->country, sizeof(contact->country), "%s",
+                 sqlite3_column_text(stmt, 7) ? (const char *)sqlite3_column_text(stmt, 7) : "");
+        snprintf(contact->country_prefix, sizeof(contact->country_prefix), "%s",
+                 sqlite3_column_text(stmt, 8) ? (const char *)sqlite3_column_text(stmt, 8) : "");
+        contact->cq_zone = sqlite3_column_int(stmt, 9);
+        contact->itu_zone = sqlite3_column_int(stmt, 10);
+        snprintf(contact->continent, sizeof(contact->continent), "%s",
+                 sqlite3_column_text(stmt, 11) ? (const char *)sqlite3_column_text(stmt, 11) : "");
+        snprintf(contact->state, sizeof(contact->state), "%s",
+                 sqlite3_column_text(stmt, 12) ? (const char *)sqlite3_column_text(stmt, 12) : "");
+        contact->serial = sqlite3_column_int64(stmt, 13);
+
+        printf("Contact ID %d loaded into current fields.\n", contact_id);
+        sqlite3_reset(stmt);
+        return SQLITE_OK;
+    } else {
+        printf("No contact found with ID %d.\n", contact_id);
+        sqlite3_reset(stmt);
+        return SQLITE_NOTFOUND;
+    }
+}
+
+// Function to map a file read-only into memory
+int map_file(const char *file_name, MappedFile *mapped) {
+    struct stat st;
+    mapped->data = NULL;
+    mapped->size = 0;
+
+    int fd = open(file_name, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Cannot open file '%s' for reading.\n", file_name);
+        return -1;
+    }
+
+    if (fstat(fd, &st) != 0) {
+        fprintf(stderr, "Cannot read file '%s'.\n", file_name);
+        close(fd);
+        return -1;
+    }
+
+    if (st.st_size > 0) {
+        void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            fprintf(stderr, "Cannot map file '%s' into memory.\n", file_name);
+            close(fd);
+            return -1;
+        }
+        madvise(data, st.st_size, MADV_SEQUENTIAL);
+        mapped->data = data;
+        mapped->size = st.st_size;
+    }
+
+    close(fd);
+    return 0;
+}
+
+// Function to release a mapped file
+void unmap_file(MappedFile *mapped) {
+    if (mapped->data) {
+        munmap((void *)mapped->data, mapped->size);
+    }
+    mapped->data = NULL;
+    mapped->size = 0;
+}
+
+// Function to read the next <TAG:len>value data specifier without copying it.
+// <EOH> and <EOR> come back as fields with an empty value. Returns 1 for a field, 0 at the end.
+int adif_next_field(AdifParser *parser, AdifField *field) {
+    const char *data = parser->data;
+    size_t size = parser->size;
+    size_t pos = parser->position;
+
+    while (1) {
+        const char *open = memchr(data + pos, '<', size - pos);
+        if (open == NULL) {
+            parser->position = size;
+            return 0;
+        }
+        pos = open - data + 1;
+
+        // Tag name runs up to ':' or '>'
+        size_t name_start = pos;
+        while (pos < size && data[pos] != ':' && data[pos] != '>' && data[pos] != '<') {
+            pos++;
+        }
+        if (pos >= size) {
+            parser->position = size;
+            return 0;
+        }
+        if (data[pos] == '<' || pos == name_start) {
+            continue; // Stray '<' in free text
+        }
+
+        field->name = data + name_start;
+        field->name_length = pos - name_start;
+        field->value = data + pos;
+        field->value_length = 0;
+
+        if (data[pos] == '>') {
+            parser->position = pos + 1;
+            return 1;
+        }
+
+        // Length, then an optional :type indicator
+        size_t length = 0;
+        pos++;
+        while (pos < size && isdigit((unsigned char)data[pos])) {
+            length = length * 10 + (data[pos] - '0');
+            pos++;
+        }
+        while (pos < size && data[pos] != '>') {
+            pos++;
+        }
+        if (pos >= size) {
+            parser->position = size;
+            return 0;
+        }
+        pos++;
+
+        if (length > size - pos) {
+            length = size - pos;
+        }
+        field->value = data + pos;
+        field->value_length = length;
+        parser->position = pos + length;
+        return 1;
+    }
+}
+
+// Function to compare an ADIF field name, ignoring case
+static int adif_name_is(const AdifField *field, const char *name) {
+    return strlen(name) == field->name_length && strncasecmp(field->name, name, field->name_length) == 0;
+}
+
+// Function to collect the fields of the next ADIF record, skipping the header.
+// Returns 1 for a record, 0 at the end of the data.
+int adif_next_record(AdifParser *parser, AdifRecord *record) {
+    AdifField field;
+    memset(record, 0, sizeof(*record));
+
+    while (adif_next_field(parser, &field)) {
+        if (adif_name_is(&field, "EOR")) {
+            return 1;
+        } else if (adif_name_is(&field, "EOH")) {
+            memset(record, 0, sizeof(*record)); // Everything so far was header
+        } else if (field.value_length == 0) {
+            continue;
+        } else if (adif_name_is(&field, "CALL")) {
+            record->call = field;
+        } else if (adif_name_is(&field, "FREQ")) {
+            record->freq = field;
+        } else if (adif_name_is(&field, "MODE")) {
+            record->mode = field;
+        } else if (adif_name_is(&field, "SUBMODE")) {
+            record->submode = field;
+        } else if (adif_name_is(&field, "RST_SENT")) {
+            record->rst_sent = field;
+        } else if (adif_name_is(&field, "RST_RCVD")) {
+            record->rst_rcvd = field;
+        } else if (adif_name_is(&field, "QSO_DATE")) {
+            record->qso_date = field;
+        } else if (adif_name_is(&field, "TIME_ON")) {
+            record->time_on = field;
+        } else if (adif_name_is(&field, "COMMENT")) {
+            record->comment = field;
+        } else if (adif_name_is(&field, "NOTES")) {
+            record->notes = field;
+        } else if (adif_name_is(&field, "COUNTRY")) {
+            record->country = field;
+        } else if (adif_name_is(&field, "CQZ")) {
+            record->cq_zone = field;
+        } else if (adif_name_is(&field, "ITUZ")) {
+            record->itu_zone = field;
+        } else if (adif_name_is(&field, "CONT")) {
+            record->continent = field;
+        } else if (adif_name_is(&field, "STATE")) {
+            record->state = field;
+        } else if (adif_name_is(&field, "BAND")) {
+            record->band = field;
+        } else if (adif_name_is(&field, "QSL_RCVD")) {
+            record->qsl_rcvd = field;
+        } else if (adif_name_is(&field, "QSLRDATE")) {
+            record->qsl_rcvd_date = field;
+        } else if (adif_name_is(&field, "STX")) {
+            record->stx = field;
+        }
+    }
+
+    return 0;
+}
+
+// Function to bind an ADIF value as text, pointing at the mapped file rather than copying it
+static void bind_adif_text(sqlite3_stmt *stmt, int index, const AdifField *field) {
+    if (field->value) {
+        sqlite3_bind_text(stmt, index, field->value, (int)field->value_length, SQLITE_STATIC);
+    } else {
+        sqlite3_bind_text(stmt, index, "", 0, SQLITE_STATIC);
+    }
+}
+
+// Function to turn ADIF QSO_DATE (YYYYMMDD) and TIME_ON (HHMM or HHMMSS) into the
+// logger's "YYYY-MM-DD HH:MM[:SS]" date_time format. Returns 0 if the date is unusable.
+static int adif_date_time(const AdifRecord *record, char *buffer, size_t buffer_size) {
+    const char *d = record->qso_date.value;
+    const char *t = record->time_on.value;
+    size_t t_length = t ? record->time_on.value_length : 0;
+
+    if (d == NULL || record->qso_date.value_length != 8) {
+        return 0;
+    }
+    for (int i = 0; i < 8; i++) {
+        if (!isdigit((unsigned char)d[i])) {
+            return 0;
+        }
+    }
+    for (size_t i = 0; i < t_length; i++) {
+        if (!isdigit((unsigned char)t[i])) {
+            t_length = 0;
+            break;
+        }
+    }
+
+    if (t_length >= 6) {
+        snprintf(buffer, buffer_size, "%.4s-%.2s-%.2s %.2s:%.2s:%.2s", d, d + 4, d + 6, t, t + 2, t + 4);
+    } else if (t_length >= 4) {
+        snprintf(buffer, buffer_size, "%.4s-%.2s-%.2s %.2s:%.2s", d, d + 4, d + 6, t, t + 2);
+    } else {
+        snprintf(buffer, buffer_size, "%.4s-%.2s-%.2s 00:00", d, d + 4, d + 6);
+    }
+    return 1;
+}
+
+// Function to turn an ADIF FREQ (MHz) into the kHz the logger normally stores, e.g. 14.025 -> 14025
+// and 0.4742 -> 474.2k
+static void adif_frequency(const AdifField *field, char *buffer, size_t buffer_size) {
+    char mhz[32];
+    size_t length = field->value_length < sizeof(mhz) - 1 ? field->value_length : sizeof(mhz) - 1;
+
+    buffer[0] = '\0';
+    if (field->value == NULL) {
+        return;
+    }
+    memcpy(mhz, field->value, length);
+    mhz[length] = '\0';
+
+    char *end;
+    double khz = strtod(mhz, &end) * 1000.0;
+    if (end == mhz || khz <= 0) {
+        snprintf(buffer, buffer_size, "%s", mhz); // Not a number, keep it as written
+    } else {
+        snprintf(buffer, buffer_size, "%.3f", khz);
+        // Trim trailing zeros (and a trailing decimal point) from the kHz value
+        char *last = buffer + strlen(buffer) - 1;
+        while (*last == '0') {
+            *last-- = '\0';
+        }
+        if (*last == '.') {
+            *last = '\0';
+        }
+        // Below 1000 kHz (630m, 2200m) a number with a decimal point would be read back as MHz
+        if (khz < 1000.0) {
+            size_t used = strlen(buffer);
+            snprintf(buffer + used, buffer_size - used, "k");
+        }
+    }
+}
+
+// Function to import contacts from an ADIF file in a single transaction
+int import_adif(LoggerSession *session, const char *file_name) {
+    MappedFile mapped;
+    AdifRecord record;
+    char date_time[40];
+    char frequency[40];
+    char *err_msg = NULL;
+    long long imported = 0, skipped = 0;
+    int rc;
+
+    if (map_file(file_name, &mapped) != 0) {
+        return -1;
+    }
+
+    // Commit anything contest mode has pending, then take the whole import as one transaction
+    rc = flush_group_commit(session);
+    if (rc == SQLITE_OK) {
+        rc = sqlite3_exec(session->db, "BEGIN IMMEDIATE", 0, 0, &err_msg);
+    }
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "SQL error: %s\n", err_msg ? err_msg : sqlite3_errmsg(session->db));
+        sqlite3_free(err_msg);
+        unmap_file(&mapped);
+        return rc;
+    }
+
+    long long started_us = monotonic_us();
+    AdifParser parser = { mapped.data, mapped.size, 0 };
+
+    while (adif_next_record(&parser, &record)) {
+        if (record.call.value == NULL || !adif_date_time(&record, date_time, sizeof(date_time))) {
+            skipped++;
+            continue;
+        }
+
+        sqlite3_stmt *stmt = session_statement(session, STMT_INSERT_CONTACT);
+        if (stmt == NULL) {
+            rc = SQLITE_ERROR;
+            break;
+        }
+
+        // The call is stored as the logger stores a typed one, upper case, so that dupe checks and searches find it
+        Contact resolved = { .country = "" };
+        normalize_callsign(record.call.value, record.call.value_length,
+                           resolved.callsign_worked, sizeof(resolved.callsign_worked));
+        adif_frequency(&record.freq, frequency, sizeof(frequency));
+        sqlite3_bind_text(stmt, 1, resolved.callsign_worked, -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt, 2, frequency, -1, SQLITE_STATIC);
+        bind_adif_text(stmt, 3, record.submode.value ? &record.submode : &record.mode);
+        bind_adif_text(stmt, 4, &record.rst_sent);
+        bind_adif_text(stmt, 5, &record.rst_rcvd);
+        sqlite3_bind_text(stmt, 6, date_time, -1, SQLITE_STATIC);
+        bind_adif_text(stmt, 7, record.comment.value ? &record.comment : &record.notes);
+        long long hz = bind_frequency(stmt, 13, frequency, strlen(frequency));
+        long long epoch = parse_date_time_epoch(date_time, strlen(date_time));
+        if (epoch != NO_EPOCH) {
+            sqlite3_bind_int64(stmt, 15, epoch);
+        }
+
+        // Country details come from the file if it has them, otherwise from the country file.
+        // The country file prefix is kept either way, as it's what DXCC credit is counted by.
+        if (session->countries.nodes) {
+            lookup_country(&session->countries, resolved.callsign_worked, &resolved);
+        }
+        if (record.country.value) {
+            bind_adif_text(stmt, 8, &record.country);
+            if (resolved.country[0]) {
+                sqlite3_bind_text(stmt, 9, resolved.country_prefix, -1, SQLITE_TRANSIENT);
+            }
+            if (record.cq_zone.value) {
+                bind_adif_text(stmt, 10, &record.cq_zone);
+            }
+            if (record.itu_zone.value) {
+                bind_adif_text(stmt, 11, &record.itu_zone);
+            }
+            if (record.continent.value) {
+                bind_adif_text(stmt, 12, &record.continent);
+            }
+        } else if (resolved.country[0]) {
+            sqlite3_bind_text(stmt, 8, resolved.country, -1, SQLITE_TRANSIENT);
+            sqlite3_bind_text(stmt, 9, resolved.country_prefix, -1, SQLITE_TRANSIENT);
+            sqlite3_bind_int(stmt, 10, resolved.cq_zone);
+            sqlite3_bind_int(stmt, 11, resolved.itu_zone);
+            sqlite3_bind_text(stmt, 12, resolved.continent, -1, SQLITE_TRANSIENT);
+        }
+
+        char prefix[16];
+        wpx_prefix(resolved.callsign_worked, prefix, sizeof(prefix));
+        if (record.state.value) {
+            bind_adif_text(stmt, 16, &record.state);
+        }
+        if (prefix[0]) {
+            sqlite3_bind_text(stmt, 17, prefix, -1, SQLITE_TRANSIENT);
+        }
+        if (record.qsl_rcvd.value) {
+            bind_adif_text(stmt, 18, &record.qsl_rcvd);
+        }
+        const char *d = record.qsl_rcvd_date.value;
+        if (d && record.qsl_rcvd_date.value_length == 8) {
+            char qsl_date[12];
+            snprintf(qsl_date, sizeof(qsl_date), "%.4s-%.2s-%.2s", d, d + 4, d + 6);
+            sqlite3_bind_text(stmt, 19, qsl_date, -1, SQLITE_TRANSIENT);
+        }
+
+        // The serial number sent, if the file gives it as a plain number
+        long long serial = 0;
+        size_t digits = 0;
+        while (digits < record.stx.value_length && digits < 9 && isdigit((unsigned char)record.stx.value[digits])) {
+            serial = serial * 10 + (record.stx.value[digits++] - '0');
+        }
+        if (digits > 0 && digits == record.stx.value_length && serial > 0) {
+            sqlite3_bind_int64(stmt, 20, serial);
+        }
+
+        rc = sqlite3_step(stmt);
+        sqlite3_reset(stmt);
+        if (rc != SQLITE_DONE) {
+            fprintf(stderr, "Failed to insert contact: %s\n", sqlite3_errmsg(session->db));
+            break;
+        }
+        rc = SQLITE_OK;
+
+        const AdifField *mode = record.submode.value ? &record.submode : &record.mode;
+        dupe_index_add(&session->dupes, record.call.value, record.call.value_length,
+                       band_index_for_hz(hz),
+                       mode_category(mode->value, mode->value_length));
+
+        imported++;
+        if (imported % IMPORT_PROGRESS_INTERVAL == 0) {
+            printf("  %lld contacts imported (%.0f%% of file)...\n", imported, 100.0 * parser.position / mapped.size);
+            fflush(stdout);
+        }
+    }
+
+    if (rc == SQLITE_OK) {
+        rc = sqlite3_exec(session->db, "COMMIT", 0, 0, &err_msg);
+    }
+    if (rc != SQLITE_OK) {
+        if (err_msg) {
+            fprintf(stderr, "SQL error: %s\n", err_msg);
+            sqlite3_free(err_msg);
+        }
+        sqlite3_exec(session->db, "ROLLBACK", 0, 0, NULL);
+        unmap_file(&mapped);
+
+        // Drop what the rolled back records added to the dupe index
+        free(session->dupes.entries);
+        memset(&session->dupes, 0, sizeof(session->dupes));
+        build_dupe_index(session);
+        if (session->contest) {
+            rebuild_contest_score(session);
+        }
+        return rc;
+    }
+
+    // Rebuild the partial index so the imported callsigns are indexed rather than scanned
+    char scp_file[sizeof(session->partials.scp_file)];
+    snprintf(scp_file, sizeof(scp_file), "%s", session->partials.scp_file);
+    build_partial_index(session, scp_file[0] ? scp_file : NULL);
+
+    // Imported contacts go straight into the table, so the contest score is counted again
+    if (session->contest) {
+        rebuild_contest_score(session);
+    }
+
+    double seconds = (monotonic_us() - started_us) / 1e6;
+    printf("Imported %lld contacts from '%s' in %.2f s (%.0f rows/sec), %lld records skipped.\n",
+           imported, file_name, seconds, seconds > 0 ? imported / seconds : 0.0, skipped);
+
+    unmap_file(&mapped);
+    return SQLITE_OK;
+}
+
+// Function to order QSO keys by callsign, band, mode group and time, the order both sides are merged in
+static int compare_qsl_keys(const void *a, const void *b) {
+    const QslKey *x = a, *y = b;
+    int result = strcmp(x->callsign, y->callsign);
+    if (result == 0) {
+        result = x->band != y->band ? (x->band < y->band ? -1 : 1) : 0;
+    }
+    if (result == 0) {
+        result = x->mode != y->mode ? (x->mode < y->mode ? -1 : 1) : 0;
+    }
+    if (result == 0) {
+        result = x->epoch != y->epoch ? (x->epoch < y->epoch ? -1 : 1) : 0;
+    }
+    return result;
+}
+
+// Function to compare just the callsign, band and mode group of two QSO keys
+static int compare_qsl_groups(const QslKey *x, const QslKey *y) {
+    int result = strcmp(x->callsign, y->callsign);
+    if (result == 0) {
+        result = x->band != y->band ? (x->band < y->band ? -1 : 1) : 0;
+    }
+    if (result == 0) {
+        result = x->mode != y->mode ? (x->mode < y->mode ? -1 : 1) : 0;
+    }
+    return result;
+}
+
+// Function to order matched confirmations by contact ID, so the write back walks the table in order
+static int compare_qsl_ids(const void *a, const void *b) {
+    const QslKey *x = a, *y = b;
+    return x->id != y->id ? (x->id < y->id ? -1 : 1) : 0;
+}
+
+// Function to append a key to a growing array of them. Returns 0 if out of memory.
+static int append_qsl_key(QslKey **keys, size_t *count, size_t *capacity, const QslKey *key) {
+    if (*count == *capacity) {
+        size_t new_capacity = *capacity ? *capacity * 2 : 4096;
+        QslKey *grown = realloc(*keys, new_capacity * sizeof(QslKey));
+        if (grown == NULL) {
+            return 0;
+        }
+        *keys = grown;
+        *capacity = new_capacity;
+    }
+    (*keys)[(*count)++] = *key;
+    return 1;
+}
+
+// Function to print a confirmation that couldn't be matched to exactly one contact
+static void print_qsl_key(const char *what, const QslKey *key) {
+    int year, month, day, seconds;
+
+    epoch_to_civil(key->epoch, &year, &month, &day, &seconds);
+    printf("  %-9s record %-6lld %-12s %04d-%02d-%02d %02d:%02d  %s\n", what, key->id, key->callsign,
+           year, month, day, seconds / 3600, seconds / 60 % 60,
+           key->band < (int)BAND_COUNT ? bands[key->band].name : "?");
+}
+
+// Function to read the contacts in the main log into QSO keys. Returns NULL on error.
+static QslKey *load_contact_keys(LoggerSession *session, size_t *count) {
+    sqlite3_stmt *stmt;
+    QslKey *keys = NULL;
+    size_t capacity = 0;
+
+    *count = 0;
+    int rc = session_prepare(session, "SELECT id, callsign, frequency_hz, mode, qso_epoch FROM main.contacts "
+                             "WHERE qso_epoch IS NOT NULL", 0, &stmt);
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "Failed to read contacts: %s\n", sqlite3_errmsg(session->db));
+        return NULL;
+    }
+
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        QslKey key = { .qsl_date = "" };
+        const char *callsign = (const char *)sqlite3_column_text(stmt, 1);
+        const char *mode = (const char *)sqlite3_column_text(stmt, 3);
+
+        normalize_callsign(callsign ? callsign : "", sqlite3_column_bytes(stmt, 1), key.callsign, sizeof(key.callsign));
+        key.band = band_index_for_hz(sqlite3_column_int64(stmt, 2));
+        key.mode = mode_category(mode ? mode : "", sqlite3_column_bytes(stmt, 3));
+        key.epoch = sqlite3_column_int64(stmt, 4);
+        key.id = sqlite3_column_int64(stmt, 0);
+        if (key.callsign[0] && !append_qsl_key(&keys, count, &capacity, &key)) {
+            rc = SQLITE_NOMEM;
+            break;
+        }
+    }
+    session_finalize(session, stmt);
+
+    if (rc != SQLITE_DONE) {
+        fprintf(stderr, "Failed to read contacts: %s\n", rc == SQLITE_NOMEM ? "out of memory" : sqlite3_errmsg(session->db));
+        free(keys);
+        return NULL;
+    }
+    if (keys == NULL) {
+        keys = malloc(sizeof(QslKey)); // An empty log is not an error
+    }
+    return keys;
+}
+
+// Function to read the confirmations in a QSL ADIF file (LoTW, eQSL or a card list) into QSO keys.
+// Records without a callsign or date, or whose QSL_RCVD says they aren't confirmed, are counted in *skipped.
+static QslKey *load_confirmation_keys(const MappedFile *mapped, size_t *count, long long *skipped) {
+    AdifParser parser = { mapped->data, mapped->size, 0 };
+    AdifRecord record;
+    QslKey *keys = NULL;
+    size_t capacity = 0;
+    long long record_number = 0;
+    char date_time[40], frequency[40], today[12];
+
+    *count = 0;
+    *skipped = 0;
+    get_current_date(today, sizeof(today));
+
+    while (adif_next_record(&parser, &record)) {
+        record_number++;
+        const AdifField *confirmed = &record.qsl_rcvd;
+        if (record.call.value == NULL || !adif_date_time(&record, date_time, sizeof(date_time)) ||
+            (confirmed->value && toupper((unsigned char)confirmed->value[0]) != 'Y' &&
+             toupper((unsigned char)confirmed->value[0]) != 'V')) {
+            (*skipped)++;
+            continue;
+        }
+
+        // A call too long to be in the log is skipped rather than cut short into one that might be
+        QslKey key;
+        normalize_callsign(record.call.value, record.call.value_length, key.callsign, sizeof(key.callsign));
+        key.epoch = parse_date_time_epoch(date_time, strlen(date_time));
+        key.id = record_number;
+        if (key.epoch == NO_EPOCH || record.call.value_length >= sizeof(key.callsign)) {
+            (*skipped)++;
+            continue;
+        }
+
+        // The band as confirmed if the file gives one, otherwise the band its frequency falls in
+        key.band = BAND_COUNT;
+        if (record.band.value && record.band.value_length < sizeof(frequency)) {
+            for (size_t i = 0; i < record.band.value_length; i++) {
+                frequency[i] = tolower((unsigned char)record.band.value[i]);
+            }
+            frequency[record.band.value_length] = '\0';
+            key.band = band_index_for_name(frequency);
+        }
+        if (key.band == BAND_COUNT && record.freq.value) {
+            adif_frequency(&record.freq, frequency, sizeof(frequency));
+            key.band = band_index_for_frequency(frequency, strlen(frequency));
+        }
+
+        const AdifField *mode = record.submode.value ? &record.submode : &record.mode;
+        key.mode = mode_category(mode->value ? mode->value : "", mode->value_length);
+
+        const char *d = record.qsl_rcvd_date.value;
+        if (d && record.qsl_rcvd_date.value_length == 8) {
+            snprintf(key.qsl_date, sizeof(key.qsl_date), "%.4s-%.2s-%.2s", d, d + 4, d + 6);
+        } else {
+            snprintf(key.qsl_date, sizeof(key.qsl_date), "%s", today);
+        }
+
+        if (!append_qsl_key(&keys, count, &capacity, &key)) {
+            fprintf(stderr, "Out of memory reading confirmations.\n");
+            free(keys);
+            return NULL;
+        }
+    }
+
+    if (keys == NULL) {
+        keys = malloc(sizeof(QslKey));
+    }
+    return keys;
+}
+
+// Function to mark contacts confirmed from a QSL ADIF file.  Both the confirmations and the log are
+// reduced to (callsign, band, mode group, time) keys, sorted, and merged in one pass: a confirmation
+// matches when exactly one contact in its group is within the time window, and all the matches are
+// written back in a single transaction.
+int import_confirmations(LoggerSession *session, const char *file_name, int minutes) {
+    MappedFile mapped;
+    QslKey *confirmations, *contacts;
+    size_t confirmation_count, contact_count;
+    long long skipped, matched = 0, ambiguous = 0, unmatched = 0, newly_confirmed = 0;
+    long long window = (long long)minutes * 60;
+    int rc;
+
+    if (map_file(file_name, &mapped) != 0) {
+        return -1;
+    }
+    long long started_us = monotonic_us();
+    confirmations = load_confirmation_keys(&mapped, &confirmation_count, &skipped);
+    unmap_file(&mapped);
+    if (confirmations == NULL) {
+        return SQLITE_NOMEM;
+    }
+    contacts = load_contact_keys(session, &contact_count);
+    if (contacts == NULL) {
+        free(confirmations);
+        return SQLITE_ERROR;
+    }
+
+    qsort(confirmations, confirmation_count, sizeof(QslKey), compare_qsl_keys);
+    qsort(contacts, contact_count, sizeof(QslKey), compare_qsl_keys);
+
+    // Merge: matched confirmations are moved to the front of the array, with the contact's ID in place
+    // of the record number.  Within a group both sides are in time order, so the window only moves forward.
+    size_t listed_unmatched = 0, listed_ambiguous = 0;
+    size_t c = 0;
+    for (size_t q = 0; q < confirmation_count; q++) {
+        QslKey *confirmation = &confirmations[q];
+        while (c < contact_count && compare_qsl_groups(&contacts[c], confirmation) < 0) {
+            c++;
+        }
+
+        size_t first = c, candidates = 0, candidate = 0;
+        while (first < contact_count && compare_qsl_groups(&contacts[first], confirmation) == 0 &&
+               contacts[first].epoch < confirmation->epoch - window) {
+            first++;
+        }
+        for (size_t i = first; i < contact_count && compare_qsl_groups(&contacts[i], confirmation) == 0 &&
+             contacts[i].epoch <= confirmation->epoch + window; i++) {
+            candidate = i;
+            candidates++;
+        }
+
+        if (candidates == 1) {
+            QslKey match = *confirmation;
+            match.id = contacts[candidate].id;
+            confirmations[matched++] = match;
+        } else if (candidates == 0) {
+            if (listed_unmatched++ < QSL_REPORT_LIMIT) {
+                print_qsl_key("unmatched", confirmation);
+            }
+            unmatched++;
+        } else {
+            if (listed_ambiguous++ < QSL_REPORT_LIMIT) {
+                print_qsl_key("ambiguous", confirmation);
+            }
+            ambiguous++;
+        }
+    }
+    free(contacts);
+
+    // Write the matches back in ID order, as one transaction
+    qsort(confirmations, matched, sizeof(QslKey), compare_qsl_ids);
+    sqlite3_stmt *stmt = NULL;
+    rc = flush_group_commit(session);
+    if (rc == SQLITE_OK) {
+        rc = sqlite3_exec(session->db, "BEGIN IMMEDIATE", 0, 0, NULL);
+    }
+    if (rc == SQLITE_OK) {
+        rc = session_prepare(session, "UPDATE main.contacts SET qsl_rcvd = 'Y', qsl_rcvd_date = ?1 "
+                             "WHERE id = ?2 AND coalesce(qsl_rcvd, '') <> 'Y'", 0, &stmt);
+    }
+    for (long long i = 0; rc == SQLITE_OK && i < matched; i++) {
+        sqlite3_bind_text(stmt, 1, confirmations[i].qsl_date, -1, SQLITE_STATIC);
+        sqlite3_bind_int64(stmt, 2, confirmations[i].id);
+        rc = sqlite3_step(stmt);
+        sqlite3_reset(stmt);
+        if (rc == SQLITE_DONE) {
+            newly_confirmed += sqlite3_changes(session->db);
+            rc = SQLITE_OK;
+        }
+    }
+    session_finalize(session, stmt);
+    if (rc == SQLITE_OK) {
+        rc = sqlite3_exec(session->db, "COMMIT", 0, 0, NULL);
+    }
+    free(confirmations);
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "Failed to record confirmations: %s\n", sqlite3_errmsg(session->db));
+        sqlite3_exec(session->db, "ROLLBACK", 0, 0, NULL);
+        return rc;
+    }
+
+    double seconds = (monotonic_us() - started_us) / 1e6;
+    printf("Matched %lld of %zu confirmations in '%s' against %zu contacts in %.2f s (within %d minutes):\n",
+           matched, confirmation_count, file_name, contact_count, seconds, minutes);
+    printf("  %lld matched (%lld newly confirmed), %lld ambiguous, %lld unmatched, %lld records skipped.\n",
+           matched, newly_confirmed, ambiguous, unmatched, skipped);
+    return SQLITE_OK;
+}
+
+// Reader for the Qt QDataStream encoding (big-endian) that WSJT-X's UDP messages use
+typedef struct {
+    const unsigned char *data;
+    size_t size;
+    size_t position;
+    int error;
+} QtStream;
+
+// Function to read a big-endian unsigned integer of 1 to 8 bytes from a Qt stream
+static unsigned long long qt_read_uint(QtStream *stream, size_t bytes) {
+    unsigned long long value = 0;
+    if (stream->error || bytes > stream->size - stream->position) {
+        stream->error = 1;
+        return 0;
+    }
+    for (size_t i = 0; i < bytes; i++) {
+        value = (value << 8) | stream->data[stream->position++];
+    }
+    return value;
+}
+
+// Function to read a Qt utf8 string (a byte count, or 0xffffffff for null, then the bytes)
+static void qt_read_string(QtStream *stream, char *buffer, size_t buffer_size) {
+    unsigned long long length = qt_read_uint(stream, 4);
+    buffer[0] = '\0';
+    if (stream->error || length == 0xffffffffULL) {
+        return;
+    }
+    if (length > stream->size - stream->position) {
+        stream->error = 1;
+        return;
+    }
+    snprintf(buffer, buffer_size, "%.*s", (int)length, (const char *)stream->data + stream->position);
+    stream->position += length;
+}
+
+// Function to read a Qt QDateTime as seconds since 1970: a Julian day, milliseconds since
+// midnight and a time spec (UTC, local or an offset from UTC in seconds)
+static long long qt_read_date_time(QtStream *stream) {
+    long long julian_day = (long long)qt_read_uint(stream, 8);
+    long long ms = (long long)qt_read_uint(stream, 4);
+    int spec = (int)qt_read_uint(stream, 1);
+    long long offset = 0;
+    if (spec == 2) {
+        offset = (int32_t)qt_read_uint(stream, 4);
+    } else if (spec == 3) {
+        stream->error = 1; // Named time zones aren't something WSJT-X sends
+    }
+    // A null date, or one outside the years the logger takes, is as good as a malformed message
+    if (julian_day < 2440588 + days_from_civil(1900, 1, 1) || julian_day >= 2440588 + days_from_civil(2101, 1, 1) ||
+        ms >= 86400000 || offset <= -86400 || offset >= 86400) {
+        stream->error = 1;
+    }
+    if (stream->error) {
+        return 0;
+    }
+    return (julian_day - 2440588) * 86400 + ms / 1000 - offset;
+}
+
+// Function to fill in a contact's date and time from seconds since 1970
+static void contact_set_epoch(Contact *contact, long long epoch) {
+    int year, month, day, seconds;
+
+    epoch_to_civil(epoch, &year, &month, &day, &seconds);
+    snprintf(contact->contact_date, sizeof(contact->contact_date), "%04d-%02d-%02d", year, month, day);
+    snprintf(contact->contact_time, sizeof(contact->contact_time), "%02d:%02d:%02d",
+             seconds / 3600, seconds / 60 % 60, seconds % 60);
+}
+
+// Function to fill in a contact from an ADIF record. Returns 0 without a callsign or date.
+static int contact_from_adif(const AdifRecord *record, Contact *contact) {
+    char date_time[40];
+    const AdifField *mode = record->submode.value ? &record->submode : &record->mode;
+    const AdifField *comment = record->comment.value ? &record->comment : &record->notes;
+
+    if (record->call.value == NULL || !adif_date_time(record, date_time, sizeof(date_time))) {
+        return 0;
+    }
+    memset(contact, 0, sizeof(*contact));
+    snprintf(contact->callsign_worked, sizeof(contact->callsign_worked), "%.*s",
+             (int)record->call.value_length, record->call.value);
+    adif_frequency(&record->freq, contact->frequency, sizeof(contact->frequency));
+    snprintf(contact->mode, sizeof(contact->mode), "%.*s", (int)mode->value_length, mode->value ? mode->value : "");
+    snprintf(contact->sent_report, sizeof(contact->sent_report), "%.*s",
+             (int)record->rst_sent.value_length, record->rst_sent.value ? record->rst_sent.value : "");
+    snprintf(contact->received_report, sizeof(contact->received_report), "%.*s",
+             (int)record->rst_rcvd.value_length, record->rst_rcvd.value ? record->rst_rcvd.value : "");
+    snprintf(contact->comment, sizeof(contact->comment), "%.*s",
+             (int)comment->value_length, comment->value ? comment->value : "");
+    snprintf(contact->state, sizeof(contact->state), "%.*s",
+             (int)record->state.value_length, record->state.value ? record->state.value : "");
+    long long epoch = parse_date_time_epoch(date_time, strlen(date_time));
+    if (epoch == NO_EPOCH) {
+        return 0;
+    }
+    contact_set_epoch(contact, epoch);
+    return 1;
+}
+
+// Function to decode a WSJT-X UDP datagram.  "QSO logged" (type 5) and "logged ADIF" (type 12)
+// messages become a contact; returns 1 for those, 0 for any other message and -1 if it's malformed.
+int decode_wsjtx_packet(const unsigned char *data, size_t size, Contact *contact) {
+    QtStream stream = { data, size, 0, 0 };
+    char text[256];
+
+    if (qt_read_uint(&stream, 4) != WSJTX_MAGIC) {
+        return -1;
+    }
+    qt_read_uint(&stream, 4); // Schema number
+    unsigned long long type = qt_read_uint(&stream, 4);
+    qt_read_string(&stream, text, sizeof(text)); // Id of the sending program
+    if (stream.error) {
+        return -1;
+    }
+
+    if (type == 5) {
+        char grid[16], power[16], name[64];
+        memset(contact, 0, sizeof(*contact));
+        qt_read_date_time(&stream); // Time off
+        qt_read_string(&stream, contact->callsign_worked, sizeof(contact->callsign_worked));
+        qt_read_string(&stream, grid, sizeof(grid));
+        long long hz = (long long)qt_read_uint(&stream, 8);
+        qt_read_string(&stream, contact->mode, sizeof(contact->mode));
+        qt_read_string(&stream, contact->sent_report, sizeof(contact->sent_report));
+        qt_read_string(&stream, contact->received_report, sizeof(contact->received_report));
+        qt_read_string(&stream, power, sizeof(power));
+        qt_read_string(&stream, contact->comment, sizeof(contact->comment));
+        qt_read_string(&stream, name, sizeof(name));
+        long long time_on = qt_read_date_time(&stream);
+        if (stream.error || contact->callsign_worked[0] == '\0') {
+            return -1;
+        }
+
+        format_frequency(hz, contact->frequency, sizeof(contact->frequency));
+        contact_set_epoch(contact, time_on);
+    } else if (type == 12) {
+        unsigned long long length = qt_read_uint(&stream, 4);
+        if (stream.error || length > size - stream.position) {
+            return -1;
+        }
+        AdifParser parser = { (const char *)data + stream.position, (size_t)length, 0 };
+        AdifRecord record;
+        if (!adif_next_record(&parser, &record) || !contact_from_adif(&record, contact)) {
+            return -1;
+        }
+    } else {
+        return 0;
+    }
+
+    for (int i = 0; contact->callsign_worked[i] != '\0'; i++) {
+        contact->callsign_worked[i] = toupper((unsigned char)contact->callsign_worked[i]);
+    }
+    for (int i = 0; contact->mode[i] != '\0'; i++) {
+        contact->mode[i] = toupper((unsigned char)contact->mode[i]);
+    }
+    return 1;
+}
+
+// Function to check whether a QSO has already been queued, and remember it if not.
+// WSJT-X reports every QSO both as a "QSO logged" message and as ADIF.
+static int udp_seen_recently(UdpListener *udp, const Contact *contact) {
+    char callsign[sizeof(udp->recent_calls[0])];
+    char date_time[40];
+
+    normalize_callsign(contact->callsign_worked, strlen(contact->callsign_worked), callsign, sizeof(callsign));
+    snprintf(date_time, sizeof(date_time), "%s %s", contact->contact_date, contact->contact_time);
+    long long epoch = parse_date_time_epoch(date_time, strlen(date_time));
+    for (int i = 0; i < UDP_RECENT_QSOS; i++) {
+        if (udp->recent_epochs[i] == epoch && strcmp(udp->recent_calls[i], callsign) == 0) {
+            return 1;
+        }
+    }
+    snprintf(udp->recent_calls[udp->recent_next], sizeof(udp->recent_calls[0]), "%s", callsign);
+    udp->recent_epochs[udp->recent_next] = epoch;
+    udp->recent_next = (udp->recent_next + 1) % UDP_RECENT_QSOS;
+    return 0;
+}
+
+// Function run by the listener thread: receive datagrams, decode them and queue the QSOs.
+// It never touches the database, so a slow disk can't make it miss packets.
+static void *udp_listener_thread(void *arg) {
+    UdpListener *udp = arg;
+    static unsigned char packet[65536];
+    Contact contact;
+
+    while (!atomic_load(&udp->stop)) {
+        // Wake up now and then to notice being stopped
+        struct pollfd pfd = { udp->socket_fd, POLLIN, 0 };
+        if (poll(&pfd, 1, 250) <= 0) {
+            continue;
+        }
+        ssize_t size = recv(udp->socket_fd, packet, sizeof(packet), 0);
+        long long received_us = monotonic_us();
+        if (size < 0) {
+            continue;
+        }
+        atomic_fetch_add(&udp->packets, 1);
+
+        int result = decode_wsjtx_packet(packet, (size_t)size, &contact);
+        if (result < 0) {
+            atomic_fetch_add(&udp->malformed, 1);
+            continue;
+        } else if (result == 0) {
+            atomic_fetch_add(&udp->ignored, 1);
+            continue;
+        } else if (udp_seen_recently(udp, &contact)) {
+            atomic_fetch_add(&udp->duplicates, 1);
+            continue;
+        }
+
+        size_t head = atomic_load_explicit(&udp->head, memory_order_relaxed);
+        size_t tail = atomic_load_explicit(&udp->tail, memory_order_acquire);
+        if (head - tail == UDP_QUEUE_SIZE) {
+            atomic_fetch_add(&udp->dropped, 1);
+            continue;
+        }
+        UdpQso *slot = &udp->slots[head & (UDP_QUEUE_SIZE - 1)];
+        slot->contact = contact;
+        slot->received_us = received_us;
+        atomic_store_explicit(&udp->head, head + 1, memory_order_release);
+        atomic_fetch_add(&udp->qsos, 1);
+
+        // One byte is enough to wake the writer; if the pipe is full it's awake already
+        ssize_t ignored = write(udp->wake_fds[1], "", 1);
+        (void)ignored;
+    }
+    return NULL;
+}
+
+// Function to read a UDP port number.  Returns 0 unless all of it is a number from 1 to 65535.
+int parse_udp_port(const char *text) {
+    char *end;
+    errno = 0;
+    long port = strtol(text, &end, 10);
+    if (errno != 0 || end == text || *end != '\0' || port < 1 || port > 65535) {
+        return 0;
+    }
+    return (int)port;
+}
+
+// Function to start listening for QSOs on a UDP port on this machine
+int start_udp_listener(LoggerSession *session, int port) {
+    if (session->udp) {
+        printf("Already listening on UDP port %d.\n", session->udp->port);
+        return 0;
+    }
+
+    UdpListener *udp = calloc(1, sizeof(UdpListener));
+    if (udp == NULL) {
+        fprintf(stderr, "Out of memory starting the UDP listener.\n");
+        return -1;
+    }
+    udp->port = port;
+    udp->started_us = monotonic_us();
+    udp->wake_fds[0] = udp->wake_fds[1] = -1;
+
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons((unsigned short)port);
+
+    // A big receive buffer rides out bursts while the listener thread isn't scheduled
+    int reuse = 1, buffer_size = UDP_RECEIVE_BUFFER;
+    udp->socket_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (udp->socket_fd >= 0) {
+        setsockopt(udp->socket_fd, SOL_SOCKET, SO_RCVBUF, &buffer_size, sizeof(buffer_size));
+    }
+    if (udp->socket_fd < 0 ||
+        setsockopt(udp->socket_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) != 0 ||
+        bind(udp->socket_fd, (struct sockaddr *)&address, sizeof(address)) != 0 ||
+        pipe(udp->wake_fds) != 0) {
+        fprintf(stderr, "Cannot listen on UDP port %d: %s\n", port, strerror(errno));
+    } else {
+        fcntl(udp->wake_fds[0], F_SETFL, O_NONBLOCK);
+        fcntl(udp->wake_fds[1], F_SETFL, O_NONBLOCK);
+        if (pthread_create(&udp->thread, NULL, udp_listener_thread, udp) == 0) {
+            session->udp = udp;
+            printf("Listening for logged QSOs on UDP port %d.\n", port);
+            return 0;
+        }
+        fprintf(stderr, "Cannot start the UDP listener thread.\n");
+    }
+
+    if (udp->socket_fd >= 0) {
+        close(udp->socket_fd);
+    }
+    if (udp->wake_fds[0] >= 0) {
+        close(udp->wake_fds[0]);
+        close(udp->wake_fds[1]);
+    }
+    free(udp);
+    return -1;
+}
+
+// Function to write the QSOs waiting in the UDP queue, as one transaction unless contest or
+// batch mode is already grouping writes.  Returns how many were written.
+// The writes are made here on the main thread, through the session like any other QSO, so the
+// dupe index, partial checks and contest score stay in step.  The cost is that the commit's
+// fsyncs hold up the prompt: once per batch, however many QSOs arrived together, and in
+// contest mode only when a group commit falls due.
+int drain_udp_queue(LoggerSession *session) {
+    UdpListener *udp = session->udp;
+    char discard[256];
+    long long received_us[UDP_QUEUE_SIZE];
+    char logged[UDP_QUEUE_SIZE];
+    int rc = SQLITE_OK;
+
+    if (udp == NULL) {
+        return 0;
+    }
+    while (read(udp->wake_fds[0], discard, sizeof(discard)) > 0) {
+        // Just emptying the pipe; the queue says what's waiting
+    }
+
+    size_t tail = atomic_load_explicit(&udp->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&udp->head, memory_order_acquire);
+    if (head == tail) {
+        return 0;
+    }
+
+    int own_transaction = !session->remote && !session->contest_mode && !session->batch_mode &&
+                          sqlite3_get_autocommit(session->db);
+    if (own_transaction) {
+        sqlite3_stmt *stmt = session_statement(session, STMT_BEGIN);
+        rc = stmt ? sqlite3_step(stmt) : SQLITE_ERROR;
+        if (stmt) {
+            sqlite3_reset(stmt);
+        }
+        if (rc != SQLITE_DONE) {
+            fprintf(stderr, "Failed to begin transaction: %s\n", sqlite3_errmsg(session->db));
+            return 0; // Leave the QSOs queued for the next try
+        }
+    }
+
+    int count = 0;
+    size_t first = tail;
+    for (; tail != head; tail++) {
+        UdpQso *qso = &udp->slots[tail & (UDP_QUEUE_SIZE - 1)];
+        Contact *contact = &qso->contact;
+        if (session->countries.nodes) {
+            lookup_country(&session->countries, contact->callsign_worked, contact);
+        }
+        logged[tail - first] = log_contact(session, contact) == SQLITE_OK;
+        if (logged[tail - first]) {
+            received_us[count++] = qso->received_us;
+        } else {
+            udp->failed++;
+        }
+    }
+
+    if (own_transaction) {
+        sqlite3_stmt *stmt = session_statement(session, STMT_COMMIT);
+        rc = stmt ? sqlite3_step(stmt) : SQLITE_ERROR;
+        if (stmt) {
+            sqlite3_reset(stmt);
+        }
+        if (rc != SQLITE_DONE) {
+            fprintf(stderr, "Failed to commit QSOs from UDP: %s\n", sqlite3_errmsg(session->db));
+            sqlite3_exec(session->db, "ROLLBACK", 0, 0, NULL);
+            udp->failed += count;
+            count = 0;
+        }
+    }
+
+    // Written (and committed, unless contest mode holds the commit back): latency is from arrival to now
+    long long now_us = monotonic_us();
+    for (int i = 0; i < count; i++) {
+        latency_record(&udp->latency, now_us - received_us[i]);
+    }
+    int listed = 0;
+    for (size_t i = first; count > 0 && i != head && listed < UDP_LISTED_QSOS; i++) {
+        if (!logged[i - first]) {
+            continue;
+        }
+        const Contact *contact = &udp->slots[i & (UDP_QUEUE_SIZE - 1)].contact;
+        printf("  UDP: logged %s %s %s %s/%s at %s %s.\n", contact->callsign_worked, contact->frequency,
+               contact->mode, contact->sent_report, contact->received_report, contact->contact_date, contact->contact_time);
+        listed++;
+    }
+    if (count > listed) {
+        printf("  UDP: ...and %d more.\n", count - listed);
+    }
+    udp->written += count;
+    udp->batches++;
+
+    // Only now hand the slots back to the listener
+    atomic_store_explicit(&udp->tail, head, memory_order_release);
+    return count;
+}
+
+// Function to stop the UDP listener, writing anything still queued
+void stop_udp_listener(LoggerSession *session) {
+    UdpListener *udp = session->udp;
+    if (udp == NULL) {
+        return;
+    }
+
+    atomic_store(&udp->stop, 1);
+    pthread_join(udp->thread, NULL);
+    drain_udp_queue(session);
+    close(udp->socket_fd);
+    close(udp->wake_fds[0]);
+    close(udp->wake_fds[1]);
+    free(udp);
+    session->udp = NULL;
+}
+
+// Function to show the UDP listener's counters and how long QSOs took to reach the log
+void display_udp_status(LoggerSession *session) {
+    UdpListener *udp = session->udp;
+    if (udp == NULL) {
+        printf("Not listening for UDP QSOs. Use 'j on [port]' to start (WSJT-X sends to port %d).\n", UDP_DEFAULT_PORT);
+        return;
+    }
+
+    size_t queued = atomic_load(&udp->head) - atomic_load(&udp->tail);
+    printf("\nListening on UDP port %d for %.0f s:\n", udp->port, (monotonic_us() - udp->started_us) / 1e6);
+    printf("  Datagrams: %lld received, %lld QSOs, %lld duplicates, %lld other messages, %lld malformed\n",
+           (long long)atomic_load(&udp->packets), (long long)atomic_load(&udp->qsos),
+           (long long)atomic_load(&udp->duplicates), (long long)atomic_load(&udp->ignored),
+           (long long)atomic_load(&udp->malformed));
+    printf("  QSOs: %lld written in %lld batches, %zu queued, %lld dropped (queue full), %lld failed\n",
+           udp->written, udp->batches, queued, (long long)atomic_load(&udp->dropped), udp->failed);
+    if (udp->latency.count) {
+        printf("  Arrival to log (ms):\n");
+        printf("              count      mean      p50<      p90<      p99<       max\n");
+        display_latency("QSOs", &udp->latency);
+    }
+}
+
+// A position connected to the logging daemon
+typedef struct {
+    int fd;
+    int position;           // Number given out in order of connection, shown with its QSOs
+    char in[DAEMON_LINE_SIZE * 2];
+    size_t in_used;
+    char *out;              // Replies and broadcasts the socket hasn't taken yet
+    size_t out_used;
+    size_t out_capacity;
+    int hung_up;            // Sent everything it's going to; answer what's left, then let go
+    int closed;             // Dropped: an error, or it stopped reading
+} DaemonPosition;
+
+// Requests a position can make of the daemon
+typedef enum {
+    DAEMON_LOG,
+    DAEMON_EDIT,
+    DAEMON_DELETE,
+    DAEMON_RESERVE          // A serial number for a QSO the position has started
+} DaemonRequestKind;
+
+// One request in the daemon's current group commit
+typedef struct {
+    DaemonPosition *from;
+    DaemonRequestKind kind;
+    Contact contact;                // For a delete, only the ID is set
+    char previous_callsign[64];     // What an edited or deleted contact was logged as
+    long long id;
+    long long serial;               // Serial number given to a new QSO, or reserved for one
+    char error[96];                 // Why it wasn't written, empty if it was
+} DaemonRequest;
+
+// The logging daemon: positions connected to it and its counters
+typedef struct {
+    int listen_fd;
+    DaemonPosition *positions[DAEMON_MAX_POSITIONS];
+    int position_count;
+    int positions_seen;
+    long long next_serial;
+    long long requests;
+    long long failed;
+    long long commits;
+    LatencyHistogram commit_latency;    // From BEGIN to COMMIT of each group
+    long long started_us;
+} LoggingDaemon;
+
+// A position's connection to the logging daemon
+struct RemoteLog {
+    char address[256];
+    int fd;
+    int connected;
+    InputReader reader;     // Lines from the daemon
+    int position;           // Number the daemon gave this position
+    long long next_serial;
+    int unanswered;         // Requests given up on, whose replies may still turn up
+    char log_host[256];     // Computer the daemon's log file is on, and its path there
+    char log_file[1024];
+    int has_log;            // The daemon's log file is open read-only as this session's log
+};
+
+// What a line from the daemon turned out to be
+enum {
+    REMOTE_UPDATE,          // Dupe or serial number state, applied quietly
+    REMOTE_NOTICE,          // Something shown to the operator
+    REMOTE_READY,           // End of the state sent on connecting
+    REMOTE_OK,
+    REMOTE_ERROR
+};
+
+#define DAEMON_CONTACT_FIELDS 15
+
+static volatile sig_atomic_t daemon_stop;
+
+// Function to note that the daemon has been asked to stop
+static void daemon_signal(int signal_number) {
+    (void)signal_number;
+    daemon_stop = 1;
+}
+
+// Function to find the port of a daemon address that names one ("7373" or "host:7373").
+// Returns NULL for the path of a Unix-domain socket.
+static const char *daemon_tcp_port(const char *address) {
+    const char *colon = strrchr(address, ':');
+    const char *port = colon ? colon + 1 : address;
+    if (*port == '\0') {
+        return NULL;
+    }
+    for (const char *p = port; *p; p++) {
+        if (!isdigit((unsigned char)*p)) {
+            return NULL;
+        }
+    }
+    return port;
+}
+
+// Function to open a socket on a daemon address: listen on it for the daemon, or connect to it
+// for a position.  A TCP address without a host listens on every interface, or connects to this machine.
+static int open_daemon_socket(const char *address, int listen_on) {
+    const char *port = daemon_tcp_port(address);
+    int fd = -1;
+
+    if (port == NULL) {
+        struct sockaddr_un un;
+        memset(&un, 0, sizeof(un));
+        un.sun_family = AF_UNIX;
+        if (strlen(address) >= sizeof(un.sun_path)) {
+            fprintf(stderr, "Socket path '%s' is too long.\n", address);
+            return -1;
+        }
+        snprintf(un.sun_path, sizeof(un.sun_path), "%s", address);
+
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd >= 0 && listen_on) {
+            // A socket file is either a running daemon's or left behind by one that didn't stop cleanly
+            struct stat st;
+            if (stat(address, &st) == 0 && S_ISSOCK(st.st_mode)) {
+                int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+                int alive = probe >= 0 && connect(probe, (struct sockaddr *)&un, sizeof(un)) == 0;
+                if (probe >= 0) {
+                    close(probe);
+                }
+                if (alive) {
+                    fprintf(stderr, "A logging daemon is already listening on '%s'.\n", address);
+                    close(fd);
+                    return -1;
+                }
+                unlink(address);
+            }
+            if (bind(fd, (struct sockaddr *)&un, sizeof(un)) == 0 && listen(fd, 16) == 0) {
+                return fd;
+            }
+        } else if (fd >= 0 && connect(fd, (struct sockaddr *)&un, sizeof(un)) == 0) {
+            return fd;
+        }
+    } else {
+        char host[256] = "";
+        if (port != address) {
+            snprintf(host, sizeof(host), "%.*s", (int)(port - 1 - address), address);
+        }
+
+        struct addrinfo hints, *found = NULL;
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_flags = listen_on ? AI_PASSIVE : 0;
+        int rc = getaddrinfo(host[0] ? host : NULL, port, &hints, &found);
+        if (rc != 0) {
+            fprintf(stderr, "Cannot find '%s': %s\n", address, gai_strerror(rc));
+            return -1;
+        }
+        for (struct addrinfo *ai = found; ai; ai = ai->ai_next) {
+            fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+            if (fd < 0) {
+                continue;
+            }
+            int one = 1;
+            if (listen_on) {
+                setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+                if (bind(fd, ai->ai_addr, ai->ai_addrlen) == 0 && listen(fd, 16) == 0) {
+                    break;
+                }
+            } else if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) {
+                // Requests are single small lines, each waited on; don't hold them back
+                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+                break;
+            }
+            close(fd);
+            fd = -1;
+        }
+        freeaddrinfo(found);
+        if (fd >= 0) {
+            return fd;
+        }
+    }
+
+    fprintf(stderr, "Cannot %s '%s': %s\n", listen_on ? "listen on" : "connect to", address, strerror(errno));
+    if (fd >= 0) {
+        close(fd);
+    }
+    return -1;
+}
+
+// Function to add a field to a request or broadcast line.  Fields are separated by tabs,
+// so tabs and line breaks within one become spaces.
+static void daemon_field(char *line, size_t line_size, const char *value) {
+    size_t used = strlen(line);
+    if (used > 0 && used + 1 < line_size) {
+        line[used++] = '\t';
+    }
+    for (; *value && used + 1 < line_size; value++) {
+        line[used++] = (*value == '\t' || *value == '\n' || *value == '\r') ? ' ' : *value;
+    }
+    line[used] = '\0';
+}
+
+// Function to split a line at its tabs.  Returns how many fields it has.
+static int daemon_split(char *line, char **fields, int max_fields) {
+    int count = 0;
+    line[strcspn(line, "\r\n")] = '\0';
+    while (count < max_fields) {
+        fields[count++] = line;
+        char *tab = strchr(line, '\t');
+        if (tab == NULL) {
+            break;
+        }
+        *tab = '\0';
+        line = tab + 1;
+    }
+    return count;
+}
+
+// Function to add a contact's fields to a request line, in the order daemon_get_contact reads them
+static void daemon_put_contact(char *line, size_t line_size, const Contact *contact) {
+    char cq_zone[16], itu_zone[16], serial[32];
+    snprintf(cq_zone, sizeof(cq_zone), "%d", contact->cq_zone);
+    snprintf(itu_zone, sizeof(itu_zone), "%d", contact->itu_zone);
+    snprintf(serial, sizeof(serial), "%lld", contact->serial);
+
+    const char *fields[DAEMON_CONTACT_FIELDS] = {
+        contact->callsign_worked, contact->frequency, contact->mode, contact->sent_report,
+        contact->received_report, contact->contact_date, contact->contact_time, contact->state,
+        contact->country, contact->country_prefix, cq_zone, itu_zone, contact->continent, contact->comment,
+        serial
+    };
+    for (int i = 0; i < DAEMON_CONTACT_FIELDS; i++) {
+        daemon_field(line, line_size, fields[i]);
+    }
+}
+
+// Function to read a contact from the fields of a request line
+static void daemon_get_contact(char **fields, Contact *contact) {
+    memset(contact, 0, sizeof(*contact));
+    snprintf(contact->callsign_worked, sizeof(contact->callsign_worked), "%s", fields[0]);
+    snprintf(contact->frequency, sizeof(contact->frequency), "%s", fields[1]);
+    snprintf(contact->mode, sizeof(contact->mode), "%s", fields[2]);
+    snprintf(contact->sent_report, sizeof(contact->sent_report), "%s", fields[3]);
+    snprintf(contact->received_report, sizeof(contact->received_report), "%s", fields[4]);
+    snprintf(contact->contact_date, sizeof(contact->contact_date), "%s", fields[5]);
+    snprintf(contact->contact_time, sizeof(contact->contact_time), "%s", fields[6]);
+    snprintf(contact->state, sizeof(contact->state), "%s", fields[7]);
+    snprintf(contact->country, sizeof(contact->country), "%s", fields[8]);
+    snprintf(contact->country_prefix, sizeof(contact->country_prefix), "%s", fields[9]);
+    contact->cq_zone = atoi(fields[10]);
+    contact->itu_zone = atoi(fields[11]);
+    snprintf(contact->continent, sizeof(contact->continent), "%s", fields[12]);
+    snprintf(contact->comment, sizeof(contact->comment), "%s", fields[13]);
+    contact->serial = atoll(fields[14]);
+}
+
+// Function to queue a line for a position.  A position that lets too much pile up is dropped
+// rather than letting it hold up the daemon or fill its memory.
+static void daemon_queue(DaemonPosition *position, const char *line) {
+    size_t length = strlen(line);
+    if (position->closed) {
+        return;
+    }
+    if (position->out_used + length > position->out_capacity) {
+        if (position->out_used + length > DAEMON_MAX_BACKLOG) {
+            fprintf(stderr, "Position %d isn't reading what it's sent; disconnecting it.\n", position->position);
+            position->closed = 1;
+            return;
+        }
+        size_t capacity = position->out_capacity ? position->out_capacity : 65536;
+        while (capacity < position->out_used + length) {
+            capacity *= 2;
+        }
+        char *out = realloc(position->out, capacity);
+        if (out == NULL) {
+            position->closed = 1;
+            return;
+        }
+        position->out = out;
+        position->out_capacity = capacity;
+    }
+    memcpy(position->out + position->out_used, line, length);
+    position->out_used += length;
+}
+
+// Function to queue a line for every position
+static void daemon_broadcast(LoggingDaemon *daemon, const char *line) {
+    for (int i = 0; i < daemon->position_count; i++) {
+        daemon_queue(daemon->positions[i], line);
+    }
+}
+
+// Function to send a position as much of what's queued for it as its socket will take
+static void daemon_flush(DaemonPosition *position) {
+    size_t sent = 0;
+    while (sent < position->out_used && !position->closed) {
+        ssize_t count = send(position->fd, position->out + sent, position->out_used - sent, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (count > 0) {
+            sent += count;
+        } else if (count < 0 && errno == EINTR) {
+            continue;
+        } else {
+            if (count == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+                position->closed = 1;
+            }
+            break;
+        }
+    }
+    memmove(position->out, position->out + sent, position->out_used - sent);
+    position->out_used -= sent;
+}
+
+// Function to read whatever a position has sent
+static void daemon_receive(DaemonPosition *position) {
+    while (position->in_used < sizeof(position->in) && !position->hung_up) {
+        ssize_t count = recv(position->fd, position->in + position->in_used, sizeof(position->in) - position->in_used, MSG_DONTWAIT);
+        if (count > 0) {
+            position->in_used += count;
+        } else if (count < 0 && errno == EINTR) {
+            continue;
+        } else {
+            if (count == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+                position->hung_up = 1;
+            }
+            break;
+        }
+    }
+}
+
+// Function to take the next complete line a position has sent.  Returns 0 if there isn't one.
+static int daemon_next_line(DaemonPosition *position, char *line, size_t line_size) {
+    char *newline = memchr(position->in, '\n', position->in_used);
+    if (newline == NULL) {
+        if (position->in_used == sizeof(position->in)) {
+            fprintf(stderr, "Position %d sent a line too long to be a request; disconnecting it.\n", position->position);
+            position->closed = 1;
+        }
+        return 0;
+    }
+
+    size_t length = (size_t)(newline - position->in);
+    size_t copy = length < line_size - 1 ? length : line_size - 1;
+    memcpy(line, position->in, copy);
+    line[copy] = '\0';
+    memmove(position->in, newline + 1, position->in_used - length - 1);
+    position->in_used -= length + 1;
+    return 1;
+}
+
+// Function to read a request line: LOG <contact>, EDIT <ID> <contact>, DELETE <ID> or RESERVE.
+// Returns 0 if it's a request the daemon understands.
+static int daemon_parse_request(char *line, DaemonRequest *request) {
+    char *fields[2 + DAEMON_CONTACT_FIELDS];
+    int count = daemon_split(line, fields, 2 + DAEMON_CONTACT_FIELDS);
+
+    request->previous_callsign[0] = '\0';
+    request->error[0] = '\0';
+    request->id = 0;
+    request->serial = 0;
+
+    if (strcmp(fields[0], "LOG") == 0 && count == 1 + DAEMON_CONTACT_FIELDS) {
+        request->kind = DAEMON_LOG;
+        daemon_get_contact(fields + 1, &request->contact);
+    } else if (strcmp(fields[0], "EDIT") == 0 && count == 2 + DAEMON_CONTACT_FIELDS && atoi(fields[1]) > 0) {
+        request->kind = DAEMON_EDIT;
+        daemon_get_contact(fields + 2, &request->contact);
+        request->contact.id = (unsigned int)atoi(fields[1]);
+    } else if (strcmp(fields[0], "DELETE") == 0 && count == 2 && atoi(fields[1]) > 0) {
+        request->kind = DAEMON_DELETE;
+        memset(&request->contact, 0, sizeof(request->contact));
+        request->contact.id = (unsigned int)atoi(fields[1]);
+    } else if (strcmp(fields[0], "RESERVE") == 0 && count == 1) {
+        request->kind = DAEMON_RESERVE;
+        memset(&request->contact, 0, sizeof(request->contact));
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+// Function to make the line giving a station's dupe index entry: a band mask per mode group
+static void daemon_worked_line(char *line, size_t line_size, const char *normalized, const DupeEntry *entry) {
+    size_t used = snprintf(line, line_size, "WORKED\t%s", normalized);
+    for (int m = 0; m < MODE_CATEGORY_COUNT && used < line_size; m++) {
+        used += snprintf(line + used, line_size - used, "\t%u", entry ? entry->worked[m] : 0);
+    }
+    if (used + 1 < line_size) {
+        line[used++] = '\n';
+        line[used] = '\0';
+    }
+}
+
+// Function to tell every position how a station now stands in the dupe index
+static void daemon_broadcast_worked(LoggerSession *session, LoggingDaemon *daemon, const char *callsign) {
+    char normalized[64], line[128];
+    normalize_callsign(callsign, strlen(callsign), normalized, sizeof(normalized));
+    if (normalized[0] == '\0') {
+        return;
+    }
+    daemon_worked_line(line, sizeof(line), normalized, dupe_find(&session->dupes, normalized, 0));
+    daemon_broadcast(daemon, line);
+}
+
+// Function to take on a new position: where the log is, everything it needs to check dupes, then the next serial number
+static void daemon_accept(LoggerSession *session, LoggingDaemon *daemon) {
+    int fd = accept(daemon->listen_fd, NULL, NULL);
+    if (fd < 0) {
+        return;
+    }
+    if (daemon->position_count == DAEMON_MAX_POSITIONS) {
+        fprintf(stderr, "Turned a position away: %d are connected already.\n", DAEMON_MAX_POSITIONS);
+        close(fd);
+        return;
+    }
+    DaemonPosition *position = calloc(1, sizeof(DaemonPosition));
+    if (position == NULL) {
+        close(fd);
+        return;
+    }
+    int one = 1;
+    fcntl(fd, F_SETFL, O_NONBLOCK);
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)); // Fails harmlessly on a Unix-domain socket
+    position->fd = fd;
+    position->position = ++daemon->positions_seen;
+
+    // The welcome says where the log file is, so a position on the same computer can read it
+    char line[DAEMON_LINE_SIZE], number[16], host[256] = "";
+    const char *file = sqlite3_db_filename(session->db, "main");
+    gethostname(host, sizeof(host) - 1);
+    snprintf(number, sizeof(number), "%d", position->position);
+    snprintf(line, sizeof(line), "WELCOME");
+    daemon_field(line, sizeof(line) - 1, number);
+    daemon_field(line, sizeof(line) - 1, host);
+    daemon_field(line, sizeof(line) - 1, file ? file : "");
+    strcat(line, "\n");
+    daemon_queue(position, line);
+    for (size_t i = 0; i < session->dupes.capacity; i++) {
+        const DupeEntry *entry = &session->dupes.entries[i];
+        unsigned int any_mode = 0;
+        for (int m = 0; m < MODE_CATEGORY_COUNT; m++) {
+            any_mode |= entry->worked[m];
+        }
+        if (entry->callsign[0] && any_mode) {
+            daemon_worked_line(line, sizeof(line), entry->callsign, entry);
+            daemon_queue(position, line);
+        }
+    }
+    snprintf(line, sizeof(line), "SERIAL\t%lld\nREADY\n", daemon->next_serial);
+    daemon_queue(position, line);
+
+    daemon->positions[daemon->position_count++] = position;
+    printf("Position %d connected (%d connected).\n", position->position, daemon->position_count);
+    daemon_flush(position);
+}
+
+// Function to write a batch of requests as one transaction, then tell every position what changed
+// and each one how its requests went.  The broadcasts go first, so a position's dupe index is
+// up to date by the time it hears its QSO is in the log.
+static void daemon_commit_batch(LoggerSession *session, LoggingDaemon *daemon, DaemonRequest *batch, int count) {
+    long long started_us = monotonic_us();
+    long long first_serial = daemon->next_serial;
+    char line[DAEMON_LINE_SIZE];
+
+    // Reservations only take a number.  A number is never given out twice, even if the QSO it was
+    // taken for isn't logged or the commit fails, as the position may have sent it already.
+    for (int i = 0; i < count; i++) {
+        if (batch[i].kind == DAEMON_RESERVE) {
+            batch[i].serial = daemon->next_serial++;
+        }
+    }
+
+    sqlite3_stmt *stmt = session_statement(session, STMT_BEGIN);
+    int rc = stmt ? sqlite3_step(stmt) : SQLITE_ERROR;
+    if (stmt) {
+        sqlite3_reset(stmt);
+    }
     if (rc != SQLITE_DONE) {
-        fprintf(stderr, "Failed to delete contact: %s\n", sqlite3_errmsg(db));
+        fprintf(stderr, "Failed to begin transaction: %s\n", sqlite3_errmsg(session->db));
+        for (int i = 0; i < count; i++) {
+            if (batch[i].kind != DAEMON_RESERVE) {
+                snprintf(batch[i].error, sizeof(batch[i].error), "the daemon couldn't start a transaction");
+            }
+        }
+    } else {
+        for (int i = 0; i < count; i++) {
+            DaemonRequest *request = &batch[i];
+            if (request->kind == DAEMON_RESERVE) {
+                continue;
+            }
+
+            // Edits and deletes need the contact to be there; note its callsign for the dupe broadcast
+            if (request->kind != DAEMON_LOG) {
+                stmt = session_statement(session, STMT_SELECT_CALLSIGN_BY_ID);
+                if (stmt == NULL) {
+                    snprintf(request->error, sizeof(request->error), "the daemon couldn't look up the contact");
+                    continue;
+                }
+                sqlite3_bind_int(stmt, 1, (int)request->contact.id);
+                if (sqlite3_step(stmt) == SQLITE_ROW) {
+                    snprintf(request->previous_callsign, sizeof(request->previous_callsign), "%s",
+                             (const char *)sqlite3_column_text(stmt, 0));
+                } else {
+                    snprintf(request->error, sizeof(request->error), "no contact with ID %u", request->contact.id);
+                }
+                sqlite3_reset(stmt);
+                if (request->error[0]) {
+                    continue;
+                }
+            }
+
+            if (request->kind == DAEMON_DELETE) {
+                rc = delete_contact(session, (int)request->contact.id);
+            } else {
+                if (session->countries.nodes && request->contact.country[0] == '\0') {
+                    lookup_country(&session->countries, request->contact.callsign_worked, &request->contact);
+                }
+                // A new QSO keeps the serial its position reserved (and sent); one without takes the next
+                if (request->kind == DAEMON_LOG && request->contact.serial <= 0) {
+                    request->contact.serial = daemon->next_serial++;
+                } else if (request->kind == DAEMON_LOG && request->contact.serial >= daemon->next_serial) {
+                    daemon->next_serial = request->contact.serial + 1;
+                }
+                rc = log_contact(session, &request->contact);
+            }
+            if (rc != SQLITE_OK) {
+                snprintf(request->error, sizeof(request->error), "%s", sqlite3_errmsg(session->db));
+                continue;
+            }
+            if (request->kind == DAEMON_LOG) {
+                request->id = sqlite3_last_insert_rowid(session->db);
+                request->serial = request->contact.serial;
+            } else {
+                request->id = request->contact.id;
+            }
+        }
+
+        stmt = session_statement(session, STMT_COMMIT);
+        rc = stmt ? sqlite3_step(stmt) : SQLITE_ERROR;
+        if (stmt) {
+            sqlite3_reset(stmt);
+        }
+        if (rc != SQLITE_DONE) {
+            // None of it happened: say so, and put the dupe index back
+            fprintf(stderr, "Failed to commit: %s\n", sqlite3_errmsg(session->db));
+            sqlite3_exec(session->db, "ROLLBACK", 0, 0, NULL);
+            for (int i = 0; i < count; i++) {
+                if (batch[i].kind == DAEMON_RESERVE) {
+                    continue;
+                }
+                if (batch[i].error[0] == '\0') {
+                    snprintf(batch[i].error, sizeof(batch[i].error), "the daemon couldn't commit it");
+                }
+                dupe_index_refresh(session, batch[i].previous_callsign);
+                dupe_index_refresh(session, batch[i].contact.callsign_worked);
+            }
+        }
+        latency_record(&daemon->commit_latency, monotonic_us() - started_us);
+        daemon->commits++;
+    }
+
+    for (int i = 0; i < count; i++) {
+        DaemonRequest *request = &batch[i];
+        if (request->error[0]) {
+            continue;
+        }
+        if (request->kind == DAEMON_RESERVE) {
+            printf("Position %d: reserved serial %lld.\n", request->from->position, request->serial);
+            continue;
+        }
+        if (request->previous_callsign[0]) {
+            daemon_broadcast_worked(session, daemon, request->previous_callsign);
+        }
+        if (request->kind == DAEMON_DELETE) {
+            printf("Position %d: deleted contact ID %lld (%s).\n", request->from->position, request->id,
+                   request->previous_callsign);
+            continue;
+        }
+        daemon_broadcast_worked(session, daemon, request->contact.callsign_worked);
+        if (request->kind == DAEMON_EDIT) {
+            printf("Position %d: edited contact ID %lld (%s).\n", request->from->position, request->id,
+                   request->contact.callsign_worked);
+            continue;
+        }
+
+        const Contact *contact = &request->contact;
+        char number[64];
+        snprintf(line, sizeof(line), "QSO");
+        snprintf(number, sizeof(number), "%d", request->from->position);
+        daemon_field(line, sizeof(line) - 1, number);
+        snprintf(number, sizeof(number), "%lld", request->serial);
+        daemon_field(line, sizeof(line) - 1, number);
+        daemon_field(line, sizeof(line) - 1, contact->callsign_worked);
+        daemon_field(line, sizeof(line) - 1, contact->frequency);
+        daemon_field(line, sizeof(line) - 1, contact->mode);
+        strcat(line, "\n");
+        daemon_broadcast(daemon, line);
+        printf("Position %d: logged %s %s %s (ID %lld, serial %lld).\n", request->from->position,
+               contact->callsign_worked, contact->frequency, contact->mode, request->id, request->serial);
+    }
+    if (daemon->next_serial != first_serial) {
+        snprintf(line, sizeof(line), "SERIAL\t%lld\n", daemon->next_serial);
+        daemon_broadcast(daemon, line);
+    }
+
+    for (int i = 0; i < count; i++) {
+        DaemonRequest *request = &batch[i];
+        if (request->error[0]) {
+            snprintf(line, sizeof(line), "ERR");
+            daemon_field(line, sizeof(line) - 1, request->error);
+            strcat(line, "\n");
+            daemon->failed++;
+            printf("Position %d: request failed: %s.\n", request->from->position, request->error);
+        } else {
+            snprintf(line, sizeof(line), "OK\t%lld\t%lld\n", request->id, request->serial);
+        }
+        daemon_queue(request->from, line);
+    }
+    daemon->requests += count;
+}
+
+// Function to run the logging daemon until it's stopped with Ctrl-C or SIGTERM.  It is the only
+// writer of the log: each time round, it takes the requests every position has sent (up to
+// DAEMON_BATCH_SIZE) and writes them in one transaction, so the more positions are logging at
+// once, the more QSOs share each commit.
+int run_daemon(LoggerSession *session, const char *address) {
+    LoggingDaemon daemon;
+    char *err_msg = NULL;
+    memset(&daemon, 0, sizeof(daemon));
+    daemon.started_us = monotonic_us();
+
+    // WAL, so positions reading the log file for views, searches and exports neither wait for the
+    // daemon's commits nor hold them up.  FULL sync, because a position is told its QSO is safe.
+    if (sqlite3_exec(session->db, "PRAGMA main.journal_mode=WAL; PRAGMA main.synchronous=FULL;", 0, 0, &err_msg) != SQLITE_OK) {
+        fprintf(stderr, "SQL error: %s\n", err_msg);
+        sqlite3_free(err_msg);
+        return -1;
+    }
+
+    // Serial numbers carry on from the highest ID the log has ever given out (contact IDs are never
+    // reused) or serial it has stored, so a deleted QSO's serial isn't handed out again after a restart
+    sqlite3_stmt *stmt;
+    if (session_prepare(session, "SELECT max(coalesce((SELECT seq FROM sqlite_sequence WHERE name = 'contacts'), "
+                        "(SELECT max(id) FROM contacts), 0), coalesce((SELECT max(serial) FROM contacts), 0))",
+                        0, &stmt) != SQLITE_OK) {
+        fprintf(stderr, "Failed to prepare statement: %s\n", sqlite3_errmsg(session->db));
+        return -1;
+    }
+    daemon.next_serial = (sqlite3_step(stmt) == SQLITE_ROW ? sqlite3_column_int64(stmt, 0) : 0) + 1;
+    session_finalize(session, stmt);
+
+    daemon.listen_fd = open_daemon_socket(address, 1);
+    DaemonRequest *batch = malloc(DAEMON_BATCH_SIZE * sizeof(DaemonRequest));
+    if (daemon.listen_fd < 0 || batch == NULL) {
+        if (daemon.listen_fd >= 0) {
+            close(daemon.listen_fd);
+        }
+        free(batch);
+        return -1;
+    }
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = daemon_signal;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    printf("Logging daemon listening on %s for log '%s' (%zu stations worked, next serial %lld). Ctrl-C stops it.\n",
+           address, session->logs[0].name, session->dupes.used, daemon.next_serial);
+    fflush(stdout);
+
+    struct pollfd pfds[1 + DAEMON_MAX_POSITIONS];
+    char line[DAEMON_LINE_SIZE];
+    int full = 0;   // The last batch filled up, so requests may still be waiting in the buffers
+
+    while (!daemon_stop) {
+        int polled = daemon.position_count;
+        pfds[0] = (struct pollfd){ daemon.listen_fd, POLLIN, 0 };
+        for (int i = 0; i < polled; i++) {
+            DaemonPosition *position = daemon.positions[i];
+            pfds[i + 1] = (struct pollfd){ position->fd, (short)((position->hung_up ? 0 : POLLIN) | (position->out_used ? POLLOUT : 0)), 0 };
+        }
+        if (poll(pfds, polled + 1, full ? 0 : -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            fprintf(stderr, "poll: %s\n", strerror(errno));
+            break;
+        }
+
+        for (int i = 0; i < polled; i++) {
+            if (pfds[i + 1].revents & POLLOUT) {
+                daemon_flush(daemon.positions[i]);
+            }
+            if (pfds[i + 1].revents & (POLLIN | POLLHUP | POLLERR)) {
+                daemon_receive(daemon.positions[i]);
+            }
+        }
+        if (pfds[0].revents & POLLIN) {
+            daemon_accept(session, &daemon);
+        }
+
+        // Take a line from each position in turn, so a busy one can't crowd out the others
+        int count = 0, took = 1;
+        while (took && count < DAEMON_BATCH_SIZE) {
+            took = 0;
+            for (int i = 0; i < daemon.position_count && count < DAEMON_BATCH_SIZE; i++) {
+                DaemonPosition *position = daemon.positions[i];
+                if (position->closed || !daemon_next_line(position, line, sizeof(line))) {
+                    continue;
+                }
+                took = 1;
+                if (daemon_parse_request(line, &batch[count]) == 0) {
+                    batch[count++].from = position;
+                } else {
+                    daemon_queue(position, "ERR\tunknown request\n");
+                }
+            }
+        }
+        full = count == DAEMON_BATCH_SIZE;
+        if (count > 0) {
+            daemon_commit_batch(session, &daemon, batch, count);
+        }
+
+        // Send the replies and broadcasts, and let go of positions that have gone
+        for (int i = 0; i < daemon.position_count; i++) {
+            DaemonPosition *position = daemon.positions[i];
+            if (position->out_used) {
+                daemon_flush(position);
+            }
+            if (position->closed || (position->hung_up && memchr(position->in, '\n', position->in_used) == NULL)) {
+                memmove(&daemon.positions[i], &daemon.positions[i + 1], (daemon.position_count - i - 1) * sizeof(daemon.positions[0]));
+                daemon.position_count--;
+                i--;
+                printf("Position %d disconnected (%d connected).\n", position->position, daemon.position_count);
+                close(position->fd);
+                free(position->out);
+                free(position);
+            }
+        }
+        fflush(stdout);
+    }
+
+    for (int i = 0; i < daemon.position_count; i++) {
+        daemon_flush(daemon.positions[i]);
+        close(daemon.positions[i]->fd);
+        free(daemon.positions[i]->out);
+        free(daemon.positions[i]);
+    }
+    close(daemon.listen_fd);
+    if (daemon_tcp_port(address) == NULL) {
+        unlink(address);
+    }
+    free(batch);
+
+    double seconds = (monotonic_us() - daemon.started_us) / 1e6;
+    printf("\nLogging daemon stopped after %.0f s: %lld requests (%lld failed) in %lld group commits, %.1f per commit.\n",
+           seconds, daemon.requests, daemon.failed, daemon.commits,
+           daemon.commits ? (double)daemon.requests / daemon.commits : 0.0);
+    if (daemon.commit_latency.count) {
+        printf("  Group commits (ms):\n");
+        printf("              count      mean      p50<      p90<      p99<       max\n");
+        display_latency("commits", &daemon.commit_latency);
+    }
+    return 0;
+}
+
+// Function to act on a line from the daemon.  fields holds the line's fields afterwards.
+static int remote_handle_line(LoggerSession *session, char *line, char **fields, int max_fields) {
+    RemoteLog *remote = session->remote;
+    int count = daemon_split(line, fields, max_fields);
+
+    if (strcmp(fields[0], "WORKED") == 0 && count == 2 + MODE_CATEGORY_COUNT) {
+        size_t used = session->dupes.used;
+        unsigned int worked = 0;
+        DupeEntry *entry = dupe_find(&session->dupes, fields[1], 1);
+        if (entry) {
+            for (int m = 0; m < MODE_CATEGORY_COUNT; m++) {
+                entry->worked[m] = (unsigned int)strtoul(fields[2 + m], NULL, 10);
+                worked |= entry->worked[m];
+            }
+        }
+        if (worked) {
+            partial_index_note_call(&session->partials, fields[1], session->dupes.used > used);
+        }
+    } else if (strcmp(fields[0], "SERIAL") == 0 && count == 2) {
+        remote->next_serial = atoll(fields[1]);
+    } else if (strcmp(fields[0], "WELCOME") == 0 && count == 4) {
+        remote->position = atoi(fields[1]);
+        snprintf(remote->log_host, sizeof(remote->log_host), "%s", fields[2]);
+        snprintf(remote->log_file, sizeof(remote->log_file), "%s", fields[3]);
+    } else if (strcmp(fields[0], "QSO") == 0 && count == 6) {
+        if (atoi(fields[1]) != remote->position) {
+            printf("\n  Position %s logged %s %s %s (serial %s).\n", fields[1], fields[3], fields[4], fields[5], fields[2]);
+            return REMOTE_NOTICE;
+        }
+    } else if (strcmp(fields[0], "READY") == 0) {
+        return REMOTE_READY;
+    } else if (strcmp(fields[0], "OK") == 0 && count == 3) {
+        return REMOTE_OK;
+    } else if (strcmp(fields[0], "ERR") == 0) {
+        if (count < 2) {
+            fields[1] = "no reason given";
+        }
+        return REMOTE_ERROR;
+    }
+    return REMOTE_UPDATE;
+}
+
+// Function to note that the daemon has gone.  Nothing is written locally instead: the next
+// request tries to connect again.
+static void remote_lost(LoggerSession *session) {
+    RemoteLog *remote = session->remote;
+    if (remote->connected) {
+        printf("\nLost the connection to the logging daemon; QSOs can't be logged until it's back.\n");
+    }
+    remote->connected = 0;
+    if (remote->fd >= 0) {
+        close(remote->fd);
+        remote->fd = -1;
+    }
+}
+
+// Function to open a connection to the daemon and read its welcome: the position number and where the log is
+static int remote_open(RemoteLog *remote) {
+    char line[DAEMON_LINE_SIZE];
+    char *fields[8];
+
+    int fd = open_daemon_socket(remote->address, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    remote->fd = fd;
+    remote->unanswered = 0;
+    remote->reader = (InputReader){ fd, "", 0, 0, 0, -1, -1 };
+
+    if (read_input_line(&remote->reader, line, sizeof(line), DAEMON_REPLY_TIMEOUT_MS) != 1 ||
+        daemon_split(line, fields, 8) != 4 || strcmp(fields[0], "WELCOME") != 0) {
+        fprintf(stderr, "The logging daemon at '%s' didn't answer.\n", remote->address);
+        close(fd);
+        remote->fd = -1;
+        return -1;
+    }
+    remote->position = atoi(fields[1]);
+    snprintf(remote->log_host, sizeof(remote->log_host), "%s", fields[2]);
+    snprintf(remote->log_file, sizeof(remote->log_file), "%s", fields[3]);
+    return 0;
+}
+
+// Function to take the daemon's dupe index and serial number in place of this position's own
+static int remote_sync(LoggerSession *session) {
+    RemoteLog *remote = session->remote;
+    char line[DAEMON_LINE_SIZE];
+    char *fields[8];
+
+    free(session->dupes.entries);
+    memset(&session->dupes, 0, sizeof(session->dupes));
+    while (1) {
+        if (read_input_line(&remote->reader, line, sizeof(line), DAEMON_REPLY_TIMEOUT_MS) != 1) {
+            fprintf(stderr, "The logging daemon at '%s' didn't answer.\n", remote->address);
+            close(remote->fd);
+            remote->fd = -1;
+            return -1;
+        }
+        if (remote_handle_line(session, line, fields, 8) == REMOTE_READY) {
+            break;
+        }
+    }
+
+    remote->connected = 1;
+    printf("Connected to the logging daemon at '%s' as position %d (%zu stations worked, next serial %lld).\n",
+           remote->address, remote->position, session->dupes.used, remote->next_serial);
+    return 0;
+}
+
+// Function to connect to the daemon again after losing it
+static int remote_connect(LoggerSession *session) {
+    if (remote_open(session->remote) != 0) {
+        return -1;
+    }
+    return remote_sync(session);
+}
+
+// Function to open the session of a position logging through the daemon at an address.  The
+// daemon is the only writer of the log: if its log file is on this computer, the session reads it
+// read-only, so views, searches and exports see every position's QSOs; if not, the session's
+// log is an empty one in memory, and the commands that read the log are refused.
+int open_position_session(LoggerSession *session, const char *address) {
+    RemoteLog *remote = calloc(1, sizeof(RemoteLog));
+    char host[256] = "";
+    if (remote == NULL) {
+        fprintf(stderr, "Out of memory connecting to the logging daemon.\n");
+        return -1;
+    }
+    snprintf(remote->address, sizeof(remote->address), "%s", address);
+    remote->fd = -1;
+    if (remote_open(remote) != 0) {
+        free(remote);
+        return -1;
+    }
+
+    gethostname(host, sizeof(host) - 1);
+    remote->has_log = remote->log_file[0] && strcmp(host, remote->log_host) == 0 && access(remote->log_file, R_OK) == 0;
+    int rc = remote->has_log ? open_session_flags(session, remote->log_file, SQLITE_OPEN_READONLY)
+                             : open_session_flags(session, ":memory:", SQLITE_OPEN_READWRITE);
+    if (rc != SQLITE_OK) {
+        close(remote->fd);
+        free(remote);
+        return -1;
+    }
+    if (!remote->has_log) {
+        printf("The log file of the logging daemon at '%s' isn't on this computer; only logging and the dupe checks work here.\n",
+               address);
+    }
+    session->remote = remote;
+    return 0;
+}
+
+// Function to finish connecting a position opened with open_position_session to the daemon
+int connect_to_daemon(LoggerSession *session) {
+    return remote_sync(session);
+}
+
+// Function to check a command that reads the log can run here.  A position without the daemon's
+// log file has only an empty one, so unless quiet it says so rather than showing nothing.
+int log_readable(const LoggerSession *session, int quiet) {
+    if (session->remote && !session->remote->has_log) {
+        if (!quiet) {
+            printf("Error: The log is on the logging daemon's computer, so this position can't read it.\n");
+        }
+        return 0;
+    }
+    return 1;
+}
+
+// Function to close the connection to the daemon
+void disconnect_from_daemon(LoggerSession *session) {
+    if (session->remote == NULL) {
+        return;
+    }
+    if (session->remote->fd >= 0) {
+        close(session->remote->fd);
+    }
+    free(session->remote);
+    session->remote = NULL;
+}
+
+// Function to apply whatever the daemon has sent since last time: dupe and serial number
+// changes, and QSOs logged at other positions.  Returns how many lines were shown.
+int remote_poll(LoggerSession *session) {
+    RemoteLog *remote = session->remote;
+    char line[DAEMON_LINE_SIZE];
+    char *fields[8];
+    int shown = 0;
+
+    while (remote && remote->connected) {
+        int status = read_input_line(&remote->reader, line, sizeof(line), 0);
+        if (status == 0) {
+            break;
+        } else if (status < 0) {
+            remote_lost(session);
+            shown++;
+            break;
+        }
+        int kind = remote_handle_line(session, line, fields, 8);
+        if (kind == REMOTE_NOTICE) {
+            shown++;
+        } else if ((kind == REMOTE_OK || kind == REMOTE_ERROR) && remote->unanswered > 0) {
+            remote->unanswered--;
+        }
+    }
+    return shown;
+}
+
+// Function to send the daemon a request and wait for its answer, applying the broadcasts that
+// come first.  Returns SQLITE_OK once the daemon has committed it.
+static int remote_request(LoggerSession *session, const char *request, long long *id, long long *serial) {
+    RemoteLog *remote = session->remote;
+    char line[DAEMON_LINE_SIZE];
+    char *fields[8];
+
+    if (!remote->connected && remote_connect(session) != 0) {
+        printf("Error: Not connected to the logging daemon; nothing was written.\n");
+        return SQLITE_CANTOPEN;
+    }
+
+    size_t length = strlen(request), sent = 0;
+    while (sent < length) {
+        ssize_t count = send(remote->fd, request + sent, length - sent, MSG_NOSIGNAL);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            remote_lost(session);
+            return SQLITE_IOERR;
+        }
+        sent += count;
+    }
+
+    while (1) {
+        int status = read_input_line(&remote->reader, line, sizeof(line), DAEMON_REPLY_TIMEOUT_MS);
+        if (status == 0) {
+            printf("Error: No answer from the logging daemon; the request may still be logged.\n");
+            remote->unanswered++;
+            return SQLITE_BUSY;
+        } else if (status < 0) {
+            remote_lost(session);
+            return SQLITE_IOERR;
+        }
+
+        int kind = remote_handle_line(session, line, fields, 8);
+        if ((kind == REMOTE_OK || kind == REMOTE_ERROR) && remote->unanswered > 0) {
+            remote->unanswered--; // The answer to a request given up on
+        } else if (kind == REMOTE_OK) {
+            *id = atoll(fields[1]);
+            *serial = atoll(fields[2]);
+            break;
+        } else if (kind == REMOTE_ERROR) {
+            printf("Error: The logging daemon turned it down: %s.\n", fields[1]);
+            return SQLITE_ERROR;
+        }
+    }
+
+    // Anything that came in behind the answer
+    remote_poll(session);
+    return SQLITE_OK;
+}
+
+// Function to log a new contact, or save an edited one, through the daemon
+int remote_log_contact(LoggerSession *session, Contact *contact) {
+    char request[DAEMON_LINE_SIZE], number[16];
+    long long id = 0, serial = 0;
+
+    if (contact->id > 0) {
+        snprintf(number, sizeof(number), "%u", contact->id);
+        snprintf(request, sizeof(request), "EDIT");
+        daemon_field(request, sizeof(request) - 1, number);
+    } else {
+        snprintf(request, sizeof(request), "LOG");
+    }
+    daemon_put_contact(request, sizeof(request) - 1, contact);
+    strcat(request, "\n");
+
+    int rc = remote_request(session, request, &id, &serial);
+    if (rc == SQLITE_OK && session->batch_mode) {
+        session->batch_writes++;
+    }
+    if (rc == SQLITE_OK && contact->id > 0) {
+        printf("Contact ID %lld updated.\n", id);
+    } else if (rc == SQLITE_OK) {
+        printf("Logged as contact ID %lld, serial %lld.\n", id, serial);
+    }
+    return rc;
+}
+
+// Function to have the daemon set a serial number aside for the QSO just started, so no other
+// position sends the same one and the contact is logged with the number that went out
+int remote_reserve_serial(LoggerSession *session, Contact *contact) {
+    long long id = 0, serial = 0;
+
+    int rc = remote_request(session, "RESERVE\n", &id, &serial);
+    if (rc == SQLITE_OK) {
+        contact->serial = serial;
+        printf("Serial %lld reserved for this QSO.\n", serial);
+    }
+    return rc;
+}
+
+// Function to delete a contact through the daemon
+int remote_delete_contact(LoggerSession *session, int contact_id) {
+    char request[64];
+    long long id = 0, serial = 0;
+
+    snprintf(request, sizeof(request), "DELETE\t%d\n", contact_id);
+    return remote_request(session, request, &id, &serial);
+}
+
+// Function to wait for a socket to be ready, or just for a while (fd -1), unless the rig poller is
+// stopped first.  Returns 1 when the socket is ready, 0 on timeout and -1 when stopped.
+static int rig_wait(RigPoller *rig, int fd, short events, int timeout_ms) {
+    long long deadline_us = monotonic_us() + (long long)timeout_ms * 1000;
+    struct pollfd pfd[2] = { { rig->stop_fds[0], POLLIN, 0 }, { fd, events, 0 } };
+
+    while (1) {
+        long long remaining_us = deadline_us - monotonic_us();
+        int ready = poll(pfd, 2, remaining_us > 0 ? (int)((remaining_us + 999) / 1000) : 0);
+        if (ready < 0 && errno == EINTR) {
+            continue;
+        }
+        if (ready > 0 && pfd[0].revents) {
+            return -1;
+        }
+        return ready > 0 ? 1 : 0;
+    }
+}
+
+// Function to connect to rigctld, giving up after RIG_TIMEOUT_MS.  The address is host:port,
+// a port on this machine, or a host with rigctld's usual port.  Returns the socket, -1 on
+// failure (error says why) or -2 when the poller is stopped.
+static int rig_connect(RigPoller *rig, char *error, size_t error_size) {
+    char host[256] = "localhost";
+    const char *port = daemon_tcp_port(rig->address);
+    if (port == NULL) {
+        snprintf(host, sizeof(host), "%s", rig->address);
+        port = strrchr(RIG_DEFAULT_ADDRESS, ':') + 1;
+    } else if (port != rig->address) {
+        snprintf(host, sizeof(host), "%.*s", (int)(port - 1 - rig->address), rig->address);
+    }
+
+    struct addrinfo hints, *found = NULL;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    int rc = getaddrinfo(host, port, &hints, &found);
+    if (rc != 0) {
+        snprintf(error, error_size, "can't find %s: %s", host, gai_strerror(rc));
+        return -1;
+    }
+
+    int fd = -1;
+    snprintf(error, error_size, "can't connect");
+    for (struct addrinfo *ai = found; ai; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd < 0) {
+            continue;
+        }
+        fcntl(fd, F_SETFL, O_NONBLOCK);
+        int ready = 1;
+        if (connect(fd, ai->ai_addr, ai->ai_addrlen) != 0) {
+            if (errno != EINPROGRESS) {
+                snprintf(error, error_size, "%s", strerror(errno));
+                close(fd);
+                fd = -1;
+                continue;
+            }
+            ready = rig_wait(rig, fd, POLLOUT, RIG_TIMEOUT_MS);
+        }
+
+        int socket_error = 0;
+        socklen_t length = sizeof(socket_error);
+        if (ready == 1) {
+            getsockopt(fd, SOL_SOCKET, SO_ERROR, &socket_error, &length);
+        }
+        if (ready == 1 && socket_error == 0) {
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            break;
+        }
+        if (ready == 0) {
+            snprintf(error, error_size, "no answer within %d ms", RIG_TIMEOUT_MS);
+        } else if (ready == 1) {
+            snprintf(error, error_size, "%s", strerror(socket_error));
+        }
+        close(fd);
+        fd = ready < 0 ? -2 : -1;
+        if (fd == -2) {
+            break;
+        }
+    }
+    freeaddrinfo(found);
+    return fd;
+}
+
+// Function to ask rigctld for the frequency and mode, as one exchange: f answers with the frequency
+// in Hz, m with the mode and passband, each on a line, and a failed command with RPRT and an error
+// number.  Returns 0 with both filled in, -1 on failure (error says why) or -2 when stopped.
+static int rig_query(RigPoller *rig, int fd, long long *hz, char *mode, size_t mode_size, char *error, size_t error_size) {
+    static const char request[] = "f\nm\n";
+    char answer[256];
+    size_t used = 0;
+    int lines = 0;
+    long long deadline_us = monotonic_us() + RIG_TIMEOUT_MS * 1000LL;
+
+    if (send(fd, request, sizeof(request) - 1, MSG_NOSIGNAL | MSG_DONTWAIT) != (ssize_t)(sizeof(request) - 1)) {
+        snprintf(error, error_size, "can't send: %s", strerror(errno));
+        return -1;
+    }
+
+    while (lines < 3) {
+        long long remaining_us = deadline_us - monotonic_us();
+        int ready = remaining_us > 0 ? rig_wait(rig, fd, POLLIN, (int)((remaining_us + 999) / 1000)) : 0;
+        if (ready < 0) {
+            return -2;
+        } else if (ready == 0) {
+            snprintf(error, error_size, "no answer within %d ms", RIG_TIMEOUT_MS);
+            return -1;
+        }
+
+        ssize_t count = recv(fd, answer + used, sizeof(answer) - 1 - used, MSG_DONTWAIT);
+        if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+            continue;
+        } else if (count <= 0) {
+            snprintf(error, error_size, "rigctld closed the connection");
+            return -1;
+        }
+        used += count;
+        answer[used] = '\0';
+
+        lines = 0;
+        for (char *line = answer; line && *line; line = strchr(line, '\n') ? strchr(line, '\n') + 1 : NULL) {
+            if (strncmp(line, "RPRT ", 5) == 0) {
+                snprintf(error, error_size, "rigctld error %d", atoi(line + 5));
+                return -1;
+            }
+            lines += strchr(line, '\n') != NULL;
+        }
+        if (used == sizeof(answer) - 1 && lines < 3) {
+            snprintf(error, error_size, "answer too long");
+            return -1;
+        }
+    }
+
+    char *end;
+    *hz = (long long)(strtod(answer, &end) + 0.5);
+    char *mode_line = strchr(answer, '\n') + 1;
+    size_t mode_length = strcspn(mode_line, "\r\n");
+    if (end == answer || *hz <= 0 || mode_length == 0) {
+        snprintf(error, error_size, "can't read the answer");
+        return -1;
+    }
+    snprintf(mode, mode_size, "%.*s", (int)mode_length, mode_line);
+    return 0;
+}
+
+// Function run by the rig poller thread.  It polls quickly while the frequency or mode is changing
+// and backs off (doubling up to RIG_POLL_MAX_MS) once they settle, and a slow rig is polled less
+// often still.  A missing rig is retried less and less often, up to every RIG_RETRY_MAX_MS.
+static void *rig_poller_thread(void *arg) {
+    RigPoller *rig = arg;
+    char error[96], mode[20];
+    long long hz = 0;
+    int fd = -1;
+    int interval_ms = RIG_POLL_MIN_MS;
+    int retry_ms = RIG_POLL_MIN_MS * 4;
+
+    while (1) {
+        int rc = 0;
+        long long started_us = monotonic_us();
+        if (fd < 0) {
+            fd = rig_connect(rig, error, sizeof(error));
+            rc = fd < 0 ? fd : 0;
+        }
+        if (rc == 0) {
+            rc = rig_query(rig, fd, &hz, mode, sizeof(mode), error, sizeof(error));
+        }
+        if (rc == -2) {
+            break;
+        }
+        long long elapsed_us = monotonic_us() - started_us;
+
+        pthread_mutex_lock(&rig->lock);
+        rig->polls++;
+        if (rc == 0) {
+            latency_record(&rig->latency, elapsed_us);
+            rig->connected = 1;
+            if (hz != rig->hz || strcmp(mode, rig->mode) != 0) {
+                rig->hz = hz;
+                snprintf(rig->mode, sizeof(rig->mode), "%s", mode);
+                rig->changes++;
+                interval_ms = RIG_POLL_MIN_MS;
+            } else {
+                interval_ms = interval_ms * 2 < RIG_POLL_MAX_MS ? interval_ms * 2 : RIG_POLL_MAX_MS;
+            }
+            if (interval_ms < elapsed_us * 4 / 1000) {
+                interval_ms = elapsed_us * 4 / 1000 < RIG_POLL_MAX_MS ? (int)(elapsed_us * 4 / 1000) : RIG_POLL_MAX_MS;
+            }
+            retry_ms = RIG_POLL_MIN_MS * 4;
+        } else {
+            rig->failures++;
+            rig->connected = 0;
+            snprintf(rig->error, sizeof(rig->error), "%s", error);
+            interval_ms = retry_ms;
+            retry_ms = retry_ms * 2 < RIG_RETRY_MAX_MS ? retry_ms * 2 : RIG_RETRY_MAX_MS;
+        }
+        rig->interval_ms = interval_ms;
+        pthread_mutex_unlock(&rig->lock);
+
+        if (rc != 0 && fd >= 0) {
+            close(fd);
+            fd = -1;
+        }
+        if (rig_wait(rig, -1, 0, interval_ms) < 0) {
+            break;
+        }
+    }
+
+    if (fd >= 0) {
+        close(fd);
+    }
+    return NULL;
+}
+
+// Function to start polling rigctld for the frequency and mode
+int start_rig_poller(LoggerSession *session, const char *address) {
+    if (session->rig) {
+        printf("Already polling the rig at %s.\n", session->rig->address);
+        return 0;
+    }
+
+    RigPoller *rig = calloc(1, sizeof(RigPoller));
+    if (rig == NULL) {
+        fprintf(stderr, "Out of memory starting the rig poller.\n");
+        return -1;
+    }
+    snprintf(rig->address, sizeof(rig->address), "%s", address);
+    rig->interval_ms = RIG_POLL_MIN_MS;
+    rig->started_us = monotonic_us();
+    pthread_mutex_init(&rig->lock, NULL);
+
+    if (pipe(rig->stop_fds) != 0) {
+        fprintf(stderr, "Cannot start the rig poller: %s\n", strerror(errno));
+    } else if (pthread_create(&rig->thread, NULL, rig_poller_thread, rig) != 0) {
+        fprintf(stderr, "Cannot start the rig poller thread.\n");
+        close(rig->stop_fds[0]);
+        close(rig->stop_fds[1]);
+    } else {
+        session->rig = rig;
+        printf("Polling the rig at %s for frequency and mode.\n", address);
+        return 0;
+    }
+
+    pthread_mutex_destroy(&rig->lock);
+    free(rig);
+    return -1;
+}
+
+// Function to stop polling the rig
+void stop_rig_poller(LoggerSession *session) {
+    RigPoller *rig = session->rig;
+    if (rig == NULL) {
+        return;
+    }
+
+    ssize_t ignored = write(rig->stop_fds[1], "", 1);
+    (void)ignored;
+    pthread_join(rig->thread, NULL);
+    close(rig->stop_fds[0]);
+    close(rig->stop_fds[1]);
+    pthread_mutex_destroy(&rig->lock);
+    free(rig);
+    session->rig = NULL;
+}
+
+// Function to turn a rigctld mode into the mode logged.  On a data mode (PKTUSB and the like) the
+// rig can't tell FT8 from RTTY, so a digital mode the operator has set is kept; otherwise it's DATA.
+static void rig_mode_name(const char *rig_mode, const char *current, char *buffer, size_t buffer_size) {
+    static const char *renamed[][2] = {
+        { "CWR", "CW" }, { "RTTYR", "RTTY" }, { "WFM", "FM" }, { "AMS", "AM" }, { "SAM", "AM" }, { "SAL", "AM" }, { "SAH", "AM" }
+    };
+    char mode[20];
+
+    if (strncmp(rig_mode, "PKT", 3) == 0) {
+        snprintf(mode, sizeof(mode), "%s", mode_category(current, strlen(current)) == MODE_DIGITAL ? current : "DATA");
+    } else {
+        snprintf(mode, sizeof(mode), "%s", rig_mode);
+        for (size_t i = 0; i < sizeof(renamed) / sizeof(renamed[0]); i++) {
+            if (strcmp(rig_mode, renamed[i][0]) == 0) {
+                snprintf(mode, sizeof(mode), "%s", renamed[i][1]);
+            }
+        }
+    }
+    snprintf(buffer, buffer_size, "%s", mode);
+}
+
+// Function to copy the rig's frequency and mode into the current contact when either has changed
+// since they were last copied, so a frequency or mode typed in stays until the rig is retuned.
+// A contact loaded with u for editing is left alone.  Returns 1 if the contact was changed.
+int apply_rig_state(LoggerSession *session, Contact *contact) {
+    RigPoller *rig = session->rig;
+    if (rig == NULL || contact->id > 0) {
+        return 0;
+    }
+
+    char mode[20];
+    long long hz;
+    pthread_mutex_lock(&rig->lock);
+    int changed = rig->changes != rig->applied;
+    hz = rig->hz;
+    snprintf(mode, sizeof(mode), "%s", rig->mode);
+    rig->applied = rig->changes;
+    pthread_mutex_unlock(&rig->lock);
+
+    if (changed) {
+        format_frequency(hz, contact->frequency, sizeof(contact->frequency));
+        rig_mode_name(mode, contact->mode, contact->mode, sizeof(contact->mode));
+    }
+    return changed;
+}
+
+// Function to show what the rig poller has seen and how quickly the rig answers
+void display_rig_status(LoggerSession *session) {
+    RigPoller *rig = session->rig;
+    if (rig == NULL) {
+        printf("Not polling a rig. Use 'R on [host:port]' to start (rigctld listens on %s).\n", RIG_DEFAULT_ADDRESS);
+        return;
+    }
+
+    pthread_mutex_lock(&rig->lock);
+    RigPoller copy = *rig;
+    pthread_mutex_unlock(&rig->lock);
+
+    char frequency[20];
+    format_frequency(copy.hz, frequency, sizeof(frequency));
+    printf("\nPolling the rig at %s for %.0f s: %s%s%s\n", copy.address, (monotonic_us() - copy.started_us) / 1e6,
+           copy.connected ? "connected" : "not connected", copy.connected || !copy.error[0] ? "" : " - ",
+           copy.connected ? "" : copy.error);
+    if (copy.changes) {
+        printf("  Rig: %s kHz %s, changed %llu times\n", frequency, copy.mode, copy.changes);
+    }
+    printf("  Polls: %lld, %lld failed, next in %d ms\n", copy.polls, copy.failures, copy.interval_ms);
+    if (copy.latency.count) {
+        printf("  Round trip (ms):\n");
+        printf("              count      mean      p50<      p90<      p99<       max\n");
+        display_latency("polls", &copy.latency);
+    }
+}
+
+// Country file trie node while it is being built, before it is packed into the image
+typedef struct {
+    int first_child;
+    int next_sibling;
+    char symbol;
+    int32_t prefix_record;
+    int32_t exact_record;
+} CtyBuildNode;
+
+// Growable arrays used while building the country file image
+typedef struct {
+    CtyEntity *entities;
+    size_t entity_count, entity_capacity;
+    CtyRecord *records;
+    size_t record_count, record_capacity;
+    CtyBuildNode *nodes;
+    size_t node_count, node_capacity;
+} CtyBuilder;
+
+// Function to grow a builder array so one more element fits
+static int cty_reserve(void **array, size_t *capacity, size_t count, size_t element_size) {
+    if (count < *capacity) {
+        return 1;
+    }
+    size_t new_capacity = *capacity ? *capacity * 2 : 256;
+    void *grown = realloc(*array, new_capacity * element_size);
+    if (grown == NULL) {
+        return 0;
+    }
+    *array = grown;
+    *capacity = new_capacity;
+    return 1;
+}
+
+// Function to add a trie node and return its index, or -1 when out of memory
+static int cty_new_node(CtyBuilder *builder, char symbol) {
+    if (!cty_reserve((void **)&builder->nodes, &builder->node_capacity, builder->node_count, sizeof(CtyBuildNode))) {
+        return -1;
+    }
+    CtyBuildNode *node = &builder->nodes[builder->node_count];
+    node->first_child = -1;
+    node->next_sibling = -1;
+    node->symbol = symbol;
+    node->prefix_record = -1;
+    node->exact_record = -1;
+    return (int)builder->node_count++;
+}
+
+// Function to insert a prefix (or an exact callsign) into the trie being built
+static int cty_insert(CtyBuilder *builder, const char *key, int exact, int32_t record) {
+    int node = 0;
+
+    for (; *key; key++) {
+        // Children are kept sorted by symbol so the packed image can be searched in order
+        int *link = &builder->nodes[node].first_child;
+        while (*link >= 0 && builder->nodes[*link].symbol < *key) {
+            link = &builder->nodes[*link].next_sibling;
+        }
+        if (*link < 0 || builder->nodes[*link].symbol != *key) {
+            int child = cty_new_node(builder, *key);
+            if (child < 0) {
+                return 0;
+            }
+            // cty_new_node may have moved the array, so find the link again
+            link = &builder->nodes[node].first_child;
+            while (*link >= 0 && builder->nodes[*link].symbol < *key) {
+                link = &builder->nodes[*link].next_sibling;
+            }
+            builder->nodes[child].next_sibling = *link;
+            *link = child;
+        }
+        node = *link;
+    }
+
+    if (exact) {
+        builder->nodes[node].exact_record = record;
     } else {
-        printf("Contact with ID %d has been deleted.\n", contact_id);
+        builder->nodes[node].prefix_record = record;
+    }
+    return 1;
+}
+
+// Function to trim spaces from both ends of a string in place
+static char *trim_spaces(char *text) {
+    while (isspace((unsigned char)*text)) {
+        text++;
+    }
+    char *end = text + strlen(text);
+    while (end > text && isspace((unsigned char)end[-1])) {
+        *--end = '\0';
+    }
+    return text;
+}
+
+// Function to parse one alias from a cty.dat prefix list, e.g. =W1AW(5)[8]{NA} or KH6,
+// and add it to the trie with its overrides
+static int cty_add_alias(CtyBuilder *builder, char *alias, uint16_t entity) {
+    CtyRecord record;
+    char key[32];
+    size_t length = 0;
+    int exact = 0;
+
+    alias = trim_spaces(alias);
+    if (*alias == '=') {
+        exact = 1;
+        alias++;
+    }
+
+    const CtyEntity *e = &builder->entities[entity];
+    memset(&record, 0, sizeof(record));
+    record.entity = entity;
+    record.cq_zone = e->cq_zone;
+    record.itu_zone = e->itu_zone;
+    memcpy(record.continent, e->continent, 2);
+
+    while (*alias && length < sizeof(key) - 1 && (isalnum((unsigned char)*alias) || *alias == '/')) {
+        key[length++] = toupper((unsigned char)*alias++);
+    }
+    key[length] = '\0';
+    if (length == 0) {
+        return 1;
+    }
+
+    // Overrides: (CQ zone) [ITU zone] <lat/lon> {continent} ~UTC offset~
+    while (*alias) {
+        char open = *alias++;
+        char close = open == '(' ? ')' : open == '[' ? ']' : open == '<' ? '>' : open == '{' ? '}' : open == '~' ? '~' : 0;
+        if (close == 0) {
+            continue;
+        }
+        char *end = strchr(alias, close);
+        if (end == NULL) {
+            break;
+        }
+        if (open == '(') {
+            record.cq_zone = (uint8_t)atoi(alias);
+        } else if (open == '[') {
+            record.itu_zone = (uint8_t)atoi(alias);
+        } else if (open == '{' && end - alias >= 2) {
+            record.continent[0] = alias[0];
+            record.continent[1] = alias[1];
+        }
+        alias = end + 1;
+    }
+
+    if (!cty_reserve((void **)&builder->records, &builder->record_capacity, builder->record_count, sizeof(CtyRecord))) {
+        return 0;
+    }
+    builder->records[builder->record_count] = record;
+    return cty_insert(builder, key, exact, (int32_t)builder->record_count++);
+}
+
+// Function to parse a cty.dat country file into the builder
+static int cty_parse(CtyBuilder *builder, char *text) {
+    char *cursor = text;
+
+    while (1) {
+        char *fields[8];
+        int field_count = 0;
+
+        // Entity line: name:CQ:ITU:continent:latitude:longitude:UTC offset:primary prefix:
+        while (field_count < 8) {
+            char *colon = strchr(cursor, ':');
+            if (colon == NULL) {
+                return field_count == 0 && *trim_spaces(cursor) == '\0';
+            }
+            *colon = '\0';
+            fields[field_count++] = trim_spaces(cursor);
+            cursor = colon + 1;
+        }
+
+        // Alias list, comma separated across lines and ending with ';'
+        char *semicolon = strchr(cursor, ';');
+        if (semicolon == NULL) {
+            return 0;
+        }
+        *semicolon = '\0';
+
+        if (!cty_reserve((void **)&builder->entities, &builder->entity_capacity, builder->entity_count, sizeof(CtyEntity)) ||
+            builder->entity_count >= UINT16_MAX) {
+            return 0;
+        }
+        CtyEntity *entity = &builder->entities[builder->entity_count];
+        memset(entity, 0, sizeof(*entity));
+        snprintf(entity->name, sizeof(entity->name), "%s", fields[0]);
+        snprintf(entity->prefix, sizeof(entity->prefix), "%s", fields[7][0] == '*' ? fields[7] + 1 : fields[7]);
+        entity->cq_zone = (uint8_t)atoi(fields[1]);
+        entity->itu_zone = (uint8_t)atoi(fields[2]);
+        entity->continent[0] = fields[3][0];
+        entity->continent[1] = fields[3][0] ? fields[3][1] : '\0';
+        entity->latitude = (float)atof(fields[4]);
+        entity->longitude = (float)atof(fields[5]);
+        entity->utc_offset = (float)atof(fields[6]);
+        uint16_t entity_index = (uint16_t)builder->entity_count++;
+
+        char *save = NULL;
+        for (char *alias = strtok_r(cursor, ",", &save); alias; alias = strtok_r(NULL, ",", &save)) {
+            if (!cty_add_alias(builder, alias, entity_index)) {
+                return 0;
+            }
+        }
+        cursor = semicolon + 1;
+    }
+}
+
+// Function to build the binary prefix trie image from a cty.dat country file
+int build_country_image(const char *text_file, const char *image_file) {
+    MappedFile mapped;
+    CtyBuilder builder;
+    int ok = 0;
+
+    if (map_file(text_file, &mapped) != 0) {
+        return -1;
+    }
+
+    memset(&builder, 0, sizeof(builder));
+    char *text = malloc(mapped.size + 1);
+    if (text) {
+        memcpy(text, mapped.data, mapped.size);
+        text[mapped.size] = '\0';
+        ok = cty_new_node(&builder, '\0') == 0 && cty_parse(&builder, text);
+    }
+    unmap_file(&mapped);
+    free(text);
+
+    if (!ok) {
+        fprintf(stderr, "Error: '%s' is not a valid cty.dat country file.\n", text_file);
+    }
+
+    // Pack the trie breadth first, so each node's children sit next to each other in the image
+    CtyNode *packed = ok ? malloc(builder.node_count * sizeof(CtyNode)) : NULL;
+    int *order = ok ? malloc(builder.node_count * sizeof(int)) : NULL;
+    if (ok && (packed == NULL || order == NULL)) {
+        fprintf(stderr, "Out of memory.\n");
+        ok = 0;
+    }
+    if (ok) {
+        size_t head = 0, tail = 0;
+        order[tail++] = 0;
+        while (head < tail) {
+            const CtyBuildNode *node = &builder.nodes[order[head]];
+            CtyNode *out = &packed[head++];
+            memset(out, 0, sizeof(*out));
+            out->symbol = node->symbol;
+            out->prefix_record = node->prefix_record;
+            out->exact_record = node->exact_record;
+            out->first_child = (uint32_t)tail;
+            for (int child = node->first_child; child >= 0; child = builder.nodes[child].next_sibling) {
+                order[tail++] = child;
+                out->child_count++;
+            }
+        }
+
+        CtyImageHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, CTY_IMAGE_MAGIC, sizeof(CTY_IMAGE_MAGIC));
+        header.entity_count = (uint32_t)builder.entity_count;
+        header.record_count = (uint32_t)builder.record_count;
+        header.node_count = (uint32_t)builder.node_count;
+
+        // The image may be mapped by this logger (z) or another one, and a mapped file that's
+        // truncated under it faults on the next lookup: the new image is written alongside and
+        // renamed over the old one, which stays mapped until it's let go
+        char temp_file[1024];
+        snprintf(temp_file, sizeof(temp_file), "%s.tmp", image_file);
+        FILE *file = fopen(temp_file, "wb");
+        if (file == NULL ||
+            fwrite(&header, sizeof(header), 1, file) != 1 ||
+            fwrite(builder.entities, sizeof(CtyEntity), builder.entity_count, file) != builder.entity_count ||
+            fwrite(builder.records, sizeof(CtyRecord), builder.record_count, file) != builder.record_count ||
+            fwrite(packed, sizeof(CtyNode), builder.node_count, file) != builder.node_count ||
+            fflush(file) != 0 || fsync(fileno(file)) != 0) {
+            fprintf(stderr, "Cannot write file '%s'.\n", temp_file);
+            ok = 0;
+        }
+        if (file && fclose(file) != 0) {
+            ok = 0;
+        }
+        if (ok && rename(temp_file, image_file) != 0) {
+            fprintf(stderr, "Cannot replace file '%s': %s\n", image_file, strerror(errno));
+            ok = 0;
+        }
+        if (!ok && file) {
+            unlink(temp_file);
+        }
+        if (ok) {
+            printf("Country file '%s': %zu entities, %zu prefixes and calls, %zu trie nodes written to '%s'.\n",
+                   text_file, builder.entity_count, builder.record_count, builder.node_count, image_file);
+        }
+    }
+
+    free(packed);
+    free(order);
+    free(builder.entities);
+    free(builder.records);
+    free(builder.nodes);
+    return ok ? 0 : -1;
+}
+
+// Function to map a binary country file image built by build_country_image
+int load_country_image(CountryFile *countries, const char *image_file) {
+    CountryFile loaded;
+    memset(&loaded, 0, sizeof(loaded));
+
+    if (map_file(image_file, &loaded.image) != 0) {
+        return -1;
+    }
+
+    const CtyImageHeader *header = (const CtyImageHeader *)loaded.image.data;
+    if (loaded.image.size < sizeof(CtyImageHeader) ||
+        memcmp(header->magic, CTY_IMAGE_MAGIC, sizeof(CTY_IMAGE_MAGIC)) != 0 ||
+        loaded.image.size != sizeof(CtyImageHeader) + header->entity_count * sizeof(CtyEntity) +
+                             header->record_count * sizeof(CtyRecord) + header->node_count * sizeof(CtyNode) ||
+        header->node_count == 0) {
+        fprintf(stderr, "Error: '%s' is not a valid country file image.\n", image_file);
+        unmap_file(&loaded.image);
+        return -1;
+    }
+
+    loaded.entities = (const CtyEntity *)(header + 1);
+    loaded.records = (const CtyRecord *)(loaded.entities + header->entity_count);
+    loaded.nodes = (const CtyNode *)(loaded.records + header->record_count);
+    loaded.entity_count = header->entity_count;
+    loaded.node_count = header->node_count;
+
+    // Lookups follow these indices without checking them, so a damaged or stale image is refused here
+    for (uint32_t i = 0; i < header->record_count; i++) {
+        if (loaded.records[i].entity >= header->entity_count) {
+            fprintf(stderr, "Error: '%s' is damaged (record %u has no entity).\n", image_file, i);
+            unmap_file(&loaded.image);
+            return -1;
+        }
+    }
+    for (uint32_t i = 0; i < header->node_count; i++) {
+        const CtyNode *node = &loaded.nodes[i];
+        if ((uint64_t)node->first_child + node->child_count > header->node_count ||
+            node->prefix_record < -1 || node->prefix_record >= (int64_t)header->record_count ||
+            node->exact_record < -1 || node->exact_record >= (int64_t)header->record_count) {
+            fprintf(stderr, "Error: '%s' is damaged (node %u is out of range).\n", image_file, i);
+            unmap_file(&loaded.image);
+            return -1;
+        }
+    }
+
+    free_country_file(countries);
+    *countries = loaded;
+    return 0;
+}
+
+// Function to release a mapped country file
+void free_country_file(CountryFile *countries) {
+    unmap_file(&countries->image);
+    memset(countries, 0, sizeof(*countries));
+}
+
+// Function to walk the trie along key. Returns the record for the longest matching prefix,
+// or the exact-callsign record when the whole key is an exact entry; -1 if nothing matches.
+static int32_t cty_match(const CountryFile *countries, const char *key, int *exact) {
+    const CtyNode *node = &countries->nodes[0];
+    int32_t best = -1;
+
+    for (; *key; key++) {
+        const CtyNode *child = NULL;
+        for (uint32_t i = 0; i < node->child_count; i++) {
+            const CtyNode *candidate = &countries->nodes[node->first_child + i];
+            if (candidate->symbol == *key) {
+                child = candidate;
+                break;
+            }
+            if (candidate->symbol > *key) {
+                break;
+            }
+        }
+        if (child == NULL) {
+            *exact = 0;
+            return best;
+        }
+        node = child;
+        if (node->prefix_record >= 0) {
+            best = node->prefix_record;
+        }
+    }
+
+    *exact = node->exact_record >= 0;
+    return *exact ? node->exact_record : best;
+}
+
+// Function to resolve a callsign's entity, zones and continent into the contact.
+// Returns 1 when found, 0 otherwise (the contact's country fields are then cleared).
+int lookup_country(const CountryFile *countries, const char *callsign, Contact *contact) {
+    static const char *ignored_suffixes[] = { "P", "M", "A", "QRP", "LH", "B" };
+    char key[32];
+    int32_t record = -1;
+
+    contact->country[0] = '\0';
+    contact->country_prefix[0] = '\0';
+    contact->cq_zone = 0;
+    contact->itu_zone = 0;
+    contact->continent[0] = '\0';
+
+    if (countries->nodes == NULL || callsign[0] == '\0') {
+        return 0;
+    }
+
+    int exact;
+    snprintf(key, sizeof(key), "%s", callsign);
+    record = cty_match(countries, key, &exact);
+
+    // Portable calls: KH6/W1AW and W1AW/KH6 count for KH6, W1AW/4 for W4, and /P, /M etc. are ignored
+    char *slash = strchr(key, '/');
+    if (slash && !exact) {
+        char base[32], other[32];
+        *slash = '\0';
+        snprintf(base, sizeof(base), "%s", key);
+        snprintf(other, sizeof(other), "%s", slash + 1);
+        char *second_slash = strchr(other, '/');
+        if (second_slash) {
+            *second_slash = '\0';
+        }
+
+        if (strcmp(other, "MM") == 0 || strcmp(other, "AM") == 0) {
+            return 0; // Maritime and aeronautical mobile aren't in any entity
+        }
+
+        int ignore_other = other[0] == '\0';
+        for (size_t i = 0; i < sizeof(ignored_suffixes) / sizeof(ignored_suffixes[0]); i++) {
+            if (strcmp(other, ignored_suffixes[i]) == 0) {
+                ignore_other = 1;
+            }
+        }
+
+        if (ignore_other) {
+            record = cty_match(countries, base, &exact);
+        } else if (strlen(other) == 1 && isdigit((unsigned char)other[0])) {
+            // Replace the call area digit: W1AW/4 -> W4AW
+            for (char *p = base + strlen(base) - 1; p >= base; p--) {
+                if (isdigit((unsigned char)*p)) {
+                    *p = other[0];
+                    break;
+                }
+            }
+            record = cty_match(countries, base, &exact);
+        } else {
+            // The shorter side is the prefix being operated from
+            record = cty_match(countries, strlen(other) < strlen(base) ? other : base, &exact);
+        }
+    }
+
+    if (record < 0) {
+        return 0;
+    }
+
+    const CtyRecord *r = &countries->records[record];
+    const CtyEntity *e = &countries->entities[r->entity];
+    snprintf(contact->country, sizeof(contact->country), "%.*s", (int)sizeof(e->name), e->name);
+    snprintf(contact->country_prefix, sizeof(contact->country_prefix), "%.*s", (int)sizeof(e->prefix), e->prefix);
+    contact->cq_zone = r->cq_zone;
+    contact->itu_zone = r->itu_zone;
+    snprintf(contact->continent, sizeof(contact->continent), "%.2s", r->continent);
+    return 1;
+}
+
+// Function to load the country file at startup: the binary image if it's there and no older than
+// the cty.dat text file, otherwise build it again from cty.dat
+void load_country_file_at_startup(CountryFile *countries) {
+    struct stat image, text;
+    int have_image = stat(CTY_IMAGE_FILE, &image) == 0;
+    int have_text = stat(CTY_TEXT_FILE, &text) == 0;
+    int stale = have_image && have_text && (text.st_mtim.tv_sec > image.st_mtim.tv_sec ||
+                (text.st_mtim.tv_sec == image.st_mtim.tv_sec && text.st_mtim.tv_nsec > image.st_mtim.tv_nsec));
+
+    if (!stale && access(CTY_IMAGE_FILE, R_OK) == 0) {
+        if (load_country_image(countries, CTY_IMAGE_FILE) == 0) {
+            return;
+        }
+    }
+    if (access(CTY_TEXT_FILE, R_OK) == 0 && build_country_image(CTY_TEXT_FILE, CTY_IMAGE_FILE) == 0) {
+        load_country_image(countries, CTY_IMAGE_FILE);
+    }
+}
+
+// Function to map a callsign character to its gram symbol, or -1 if it can't be in a callsign
+static int scp_symbol(char c) {
+    if (c >= 'A' && c <= 'Z') {
+        return c - 'A';
+    } else if (c >= '0' && c <= '9') {
+        return 26 + (c - '0');
+    } else if (c == '/') {
+        return 36;
+    }
+    return -1;
+}
+
+// Function to get the gram number for the two or three characters at text (length 2 or 3), or -1
+static int scp_gram(const char *text, int length) {
+    int a = scp_symbol(text[0]), b = scp_symbol(text[1]);
+    if (a < 0 || b < 0) {
+        return -1;
+    }
+    if (length == 2) {
+        // Bigrams are numbered after all the trigrams
+        return SCP_SYMBOLS * SCP_SYMBOLS * SCP_SYMBOLS + a * SCP_SYMBOLS + b;
+    }
+    int c = scp_symbol(text[2]);
+    return c < 0 ? -1 : (a * SCP_SYMBOLS + b) * SCP_SYMBOLS + c;
+}
+
+#define SCP_GRAM_COUNT (SCP_SYMBOLS * SCP_SYMBOLS * SCP_SYMBOLS + SCP_SYMBOLS * SCP_SYMBOLS)
+
+// Callsign plus where it came from, used while building the partial index
+typedef struct {
+    const char *call;
+    uint8_t in_log;
+} ScpSource;
+
+// Function to order callsigns for the partial index
+static int compare_scp_sources(const void *a, const void *b) {
+    return strcmp(((const ScpSource *)a)->call, ((const ScpSource *)b)->call);
+}
+
+// Function to release the partial index
+void free_partial_index(PartialIndex *index) {
+    free(index->names);
+    free(index->calls);
+    free(index->in_log);
+    free(index->gram_start);
+    free(index->gram_calls);
+    free(index->recent);
+    memset(index, 0, sizeof(*index));
+}
+
+// Function to build the Super Check Partial index from a master callsign file
+// (one call per line, # comments) and every callsign in the dupe index
+int build_partial_index(LoggerSession *session, const char *scp_file) {
+    PartialIndex built;
+    MappedFile mapped = { NULL, 0 };
+    ScpSource *sources = NULL;
+    size_t source_count = 0;
+    uint32_t *last_call = NULL;
+
+    memset(&built, 0, sizeof(built));
+    snprintf(built.scp_file, sizeof(built.scp_file), "%s", scp_file ? scp_file : "");
+    if (scp_file && map_file(scp_file, &mapped) != 0) {
+        return -1;
+    }
+
+    // Count the candidates: lines in the master file plus stations in the log
+    size_t capacity = session->dupes.used + 1;
+    for (size_t i = 0; i < mapped.size; i++) {
+        capacity += mapped.data[i] == '\n';
+    }
+    capacity++;
+
+    sources = malloc(capacity * sizeof(ScpSource));
+    built.names = malloc(mapped.size + session->dupes.used * sizeof(((DupeEntry *)0)->callsign) + 1);
+    if (sources == NULL || built.names == NULL) {
+        goto out_of_memory;
+    }
+
+    // Copy each master file callsign, upper case, into the names arena
+    size_t used = 0;
+    const char *line = mapped.data;
+    const char *end = mapped.data + mapped.size;
+    while (line && line < end) {
+        const char *newline = memchr(line, '\n', end - line);
+        const char *line_end = newline ? newline : end;
+        if (*line != '#') {
+            size_t start = used;
+            for (const char *p = line; p < line_end; p++) {
+                char c = toupper((unsigned char)*p);
+                if (scp_symbol(c) >= 0) {
+                    built.names[used++] = c;
+                }
+            }
+            if (used > start) {
+                built.names[used++] = '\0';
+                sources[source_count].call = (const char *)(uintptr_t)start; // Offset until names stops moving
+                sources[source_count++].in_log = 0;
+            }
+        }
+        line = newline ? newline + 1 : NULL;
+    }
+
+    // Then every station in the log
+    for (size_t i = 0; i < session->dupes.capacity; i++) {
+        const DupeEntry *entry = &session->dupes.entries[i];
+        unsigned int worked = 0;
+        for (int m = 0; m < MODE_CATEGORY_COUNT; m++) {
+            worked |= entry->worked[m];
+        }
+        if (entry->callsign[0] && worked) {
+            size_t start = used;
+            used += snprintf(built.names + used, sizeof(entry->callsign), "%s", entry->callsign) + 1;
+            sources[source_count].call = (const char *)(uintptr_t)start;
+            sources[source_count++].in_log = 1;
+        }
+    }
+    for (size_t i = 0; i < source_count; i++) {
+        sources[i].call = built.names + (uintptr_t)sources[i].call;
+    }
+
+    // Sort and merge duplicates, remembering whether any copy came from the log
+    qsort(sources, source_count, sizeof(ScpSource), compare_scp_sources);
+    built.calls = malloc((source_count + 1) * sizeof(uint32_t));
+    built.in_log = malloc(source_count + 1);
+    built.gram_start = calloc(SCP_GRAM_COUNT + 1, sizeof(uint32_t));
+    last_call = malloc(SCP_GRAM_COUNT * sizeof(uint32_t));
+    if (built.calls == NULL || built.in_log == NULL || built.gram_start == NULL || last_call == NULL) {
+        goto out_of_memory;
+    }
+    for (size_t i = 0; i < source_count; i++) {
+        if (built.call_count > 0 && strcmp(built.names + built.calls[built.call_count - 1], sources[i].call) == 0) {
+            built.in_log[built.call_count - 1] |= sources[i].in_log;
+            continue;
+        }
+        built.calls[built.call_count] = (uint32_t)(sources[i].call - built.names);
+        built.in_log[built.call_count++] = sources[i].in_log;
+    }
+
+    // Two passes over every gram of every call: count the postings, then fill them in.
+    // last_call stops a gram that appears twice in one call from being posted twice.
+    for (int pass = 0; pass < 2; pass++) {
+        memset(last_call, 0xff, SCP_GRAM_COUNT * sizeof(uint32_t));
+        for (uint32_t id = 0; id < built.call_count; id++) {
+            const char *call = built.names + built.calls[id];
+            size_t length = strlen(call);
+            for (int n = 2; n <= 3; n++) {
+                for (size_t i = 0; i + n <= length; i++) {
+                    int gram = scp_gram(call + i, n);
+                    if (gram < 0 || last_call[gram] == id) {
+                        continue;
+                    }
+                    last_call[gram] = id;
+                    if (pass == 0) {
+                        built.gram_start[gram + 1]++;
+                    } else {
+                        built.gram_calls[built.gram_start[gram]++] = id;
+                    }
+                }
+            }
+        }
+
+        if (pass == 0) {
+            for (int gram = 0; gram < SCP_GRAM_COUNT; gram++) {
+                built.gram_start[gram + 1] += built.gram_start[gram];
+            }
+            built.gram_calls = malloc((built.gram_start[SCP_GRAM_COUNT] + 1) * sizeof(uint32_t));
+            if (built.gram_calls == NULL) {
+                goto out_of_memory;
+            }
+        } else {
+            // Filling advanced each start to the next gram's start; shift them back
+            memmove(built.gram_start + 1, built.gram_start, SCP_GRAM_COUNT * sizeof(uint32_t));
+            built.gram_start[0] = 0;
+        }
     }
 
-    sqlite3_finalize(stmt);
-    sqlite3_close(db);
-    return rc == SQLITE_DONE ? SQLITE_OK : rc;
+    free(sources);
+    free(last_call);
+    unmap_file(&mapped);
+    free_partial_index(&session->partials);
+    session->partials = built;
+    return 0;
+
+out_of_memory:
+    fprintf(stderr, "Out of memory building the partial callsign index.\n");
+    free(sources);
+    free(last_call);
+    unmap_file(&mapped);
+    free_partial_index(&built);
+    return -1;
 }
 
-// Function to load a contact from the database by ID
-int load_contact(const char *db_name, int contact_id, Contact *contact) {
-    sqlite3 *db;
-    sqlite3_stmt *stmt;
-    int rc;
+// Function to find a callsign in the sorted index, returning its id or -1
+static long partial_index_find(const PartialIndex *index, const char *callsign) {
+    long low = 0, high = (long)index->call_count - 1;
+    while (low <= high) {
+        long middle = (low + high) / 2;
+        int order = strcmp(index->names + index->calls[middle], callsign);
+        if (order == 0) {
+            return middle;
+        }
+        if (order < 0) {
+            low = middle + 1;
+        } else {
+            high = middle - 1;
+        }
+    }
+    return -1;
+}
 
-    const char *sql = "SELECT callsign, frequency, mode, sent_report, received_report, "
-                      "date_time, comment FROM contacts WHERE id = ?";
+// Function to make a newly logged callsign visible to partial checks without rebuilding the index.
+// first_contact says the call has never been logged, so it can't be in the recent list already.
+void partial_index_note_call(PartialIndex *index, const char *callsign, int first_contact) {
+    char normalized[64];
+    normalize_callsign(callsign, strlen(callsign), normalized, sizeof(normalized));
+    if (normalized[0] == '\0' || strlen(normalized) >= sizeof(index->recent[0])) {
+        return; // Not noted rather than noted cut short, as the dupe index does
+    }
 
-    rc = sqlite3_open(db_name, &db);
-    if (rc != SQLITE_OK) {
-        fprintf(stderr, "Cannot open database: %s\n", sqlite3_errmsg(db));
-        return rc;
+    long id = partial_index_find(index, normalized);
+    if (id >= 0) {
+        index->in_log[id] = 1;
+        return;
+    }
+    for (size_t i = 0; !first_contact && i < index->recent_count; i++) {
+        if (strcmp(index->recent[i], normalized) == 0) {
+            return;
+        }
+    }
+    if (index->recent_count == index->recent_capacity) {
+        size_t capacity = index->recent_capacity ? index->recent_capacity * 2 : 64;
+        void *grown = realloc(index->recent, capacity * sizeof(index->recent[0]));
+        if (grown == NULL) {
+            return;
+        }
+        index->recent = grown;
+        index->recent_capacity = capacity;
     }
+    snprintf(index->recent[index->recent_count++], sizeof(index->recent[0]), "%s", normalized);
+}
 
-    rc = sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
-    if (rc != SQLITE_OK) {
-        fprintf(stderr, "Failed to prepare statement: %s\n", sqlite3_errmsg(db));
-        sqlite3_close(db);
-        return rc;
+// Function to check whether a fragment (with ? matching any one character) appears anywhere in a callsign
+static int partial_matches(const char *call, const char *fragment, size_t fragment_length) {
+    size_t call_length = strlen(call);
+    for (size_t start = 0; start + fragment_length <= call_length; start++) {
+        size_t i = 0;
+        while (i < fragment_length && (fragment[i] == '?' || fragment[i] == call[start + i])) {
+            i++;
+        }
+        if (i == fragment_length) {
+            return 1;
+        }
     }
+    return 0;
+}
 
-    // Bind the contact ID to the prepared statement
-    sqlite3_bind_int(stmt, 1, contact_id);
+// Function to list the known callsigns containing a fragment, e.g. ?3N or K3N
+void super_check_partial(LoggerSession *session, const char *fragment) {
+    const PartialIndex *index = &session->partials;
+    char pattern[32];
+    size_t length = 0;
+
+    for (const char *p = fragment; *p && length < sizeof(pattern) - 1; p++) {
+        char c = toupper((unsigned char)*p);
+        if (c != '?' && scp_symbol(c) < 0) {
+            printf("Error: '%c' can't be part of a callsign.\n", *p);
+            return;
+        }
+        pattern[length++] = c;
+    }
+    pattern[length] = '\0';
+    if (length < 2) {
+        printf("Error: Enter at least two characters for a partial check.\n");
+        return;
+    }
 
-    if ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
-        snprintf(contact->callsign_worked, sizeof(contact->callsign_worked), "%s", (const char *)sqlite3_column_text(stmt, 0));
-        snprintf(contact->frequency, sizeof(contact->frequency), "%s", (const char *)sqlite3_column_text(stmt, 1));
-        snprintf(contact->mode, sizeof(contact->mode), "%s", (const char *)sqlite3_column_text(stmt, 2));
-        snprintf(contact->sent_report, sizeof(contact->sent_report), "%s", (const char *)sqlite3_column_text(stmt, 3));
-        snprintf(contact->received_report, sizeof(contact->received_report), "%s", (const char *)sqlite3_column_text(stmt, 4));
+    long long started_us = monotonic_us();
 
-        const char *date_time = (const char *)sqlite3_column_text(stmt, 5);
-        sscanf(date_time, "%19s %19s", contact->contact_date, contact->contact_time);
+    // Pick the gram in the pattern with the fewest postings; every match must contain it
+    uint32_t best_start = 0, best_end = index->call_count;
+    int have_gram = 0;
+    for (int n = 3; n >= 2; n--) {
+        for (size_t i = 0; i + n <= length; i++) {
+            int gram = scp_gram(pattern + i, n);
+            if (gram < 0 || index->gram_start == NULL) {
+                continue; // Contains a ?
+            }
+            uint32_t start = index->gram_start[gram], end = index->gram_start[gram + 1];
+            if (!have_gram || end - start < best_end - best_start) {
+                best_start = start;
+                best_end = end;
+                have_gram = 1;
+            }
+        }
+    }
 
-        snprintf(contact->comment, sizeof(contact->comment), "%s",
-                 sqlite3_column_text(stmt, 6) ? (const char *)sqlite3_column_text(stmt, 6) : "");
+    // Verify the candidates; without a usable gram, every call is a candidate
+    const char *matches[SCP_MAX_LISTED];
+    int match_in_log[SCP_MAX_LISTED];
+    int listed = 0;
+    long total = 0;
+    for (uint32_t i = best_start; i < best_end; i++) {
+        uint32_t id = have_gram ? index->gram_calls[i] : i;
+        const char *call = index->names + index->calls[id];
+        if (partial_matches(call, pattern, length)) {
+            if (listed < SCP_MAX_LISTED) {
+                match_in_log[listed] = index->in_log[id];
+                matches[listed++] = call;
+            }
+            total++;
+        }
+    }
+    for (size_t i = 0; i < index->recent_count; i++) {
+        if (partial_matches(index->recent[i], pattern, length)) {
+            if (listed < SCP_MAX_LISTED) {
+                match_in_log[listed] = 1;
+                matches[listed++] = index->recent[i];
+            }
+            total++;
+        }
+    }
 
-        printf("Contact ID %d loaded into current fields.\n", contact_id);
-        sqlite3_finalize(stmt);
-        sqlite3_close(db);
-        return SQLITE_OK;
-    } else {
-        printf("No contact found with ID %d.\n", contact_id);
-        sqlite3_finalize(stmt);
-        sqlite3_close(db);
-        return SQLITE_NOTFOUND;
+    long long elapsed_us = monotonic_us() - started_us;
+
+    printf("Partial check '%s': %ld match%s (%lld us), * = in the log\n", pattern, total, total == 1 ? "" : "es", elapsed_us);
+    for (int i = 0; i < listed; i++) {
+        printf("  %s%-12s", match_in_log[i] ? "*" : " ", matches[i]);
+        if (i % 6 == 5 || i == listed - 1) {
+            printf("\n");
+        }
+    }
+    if (total > listed) {
+        printf("  ...and %ld more.\n", total - listed);
     }
 }
 
@@ -420,31 +9501,191 @@ void set_contact_time(Contact *contact) {
 }
 
 
-int main() {
+// The benchmark (bench.c) includes this file and supplies its own main
+#ifndef LOGGER_NO_MAIN
+int main(int argc, char *argv[]) {
     char input[INPUT_BUFFER_SIZE];
     char *token;
     int running = 1;
+    int show_prompt = 1;
+    int batch_mode = 0;
+    long long batch_lines = 0;
+    const char *db_name = DEFAULT_LOG_FILE;
+    const char *attach_names[MAX_LOGS];
+    int attach_count = 0;
+    int udp_port = 0;
+    const char *daemon_address = NULL;
+    const char *connect_address = NULL;
+    const char *rig_address = NULL;
+    int export_threads = 0;
+    InputReader reader = { STDIN_FILENO, "", 0, 0, 0, -1, -1 };
+
+    // Handle the command line options
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-b") == 0 || strcmp(argv[i], "--batch") == 0) {
+            batch_mode = 1;
+            if (i + 1 < argc && (argv[i + 1][0] != '-' || strcmp(argv[i + 1], "-") == 0)) {
+                i++;
+                if (strcmp(argv[i], "-") != 0) {
+                    reader.fd = open(argv[i], O_RDONLY);
+                    if (reader.fd < 0) {
+                        fprintf(stderr, "Cannot open command file '%s'.\n", argv[i]);
+                        return 1;
+                    }
+                }
+            }
+        } else if ((strcmp(argv[i], "-d") == 0 || strcmp(argv[i], "--db") == 0) && i + 1 < argc) {
+            db_name = argv[++i];
+        } else if ((strcmp(argv[i], "-o") == 0 || strcmp(argv[i], "--open") == 0) && i + 1 < argc) {
+            if (attach_count >= MAX_LOGS - 1) {
+                fprintf(stderr, "At most %d logs can be open at once.\n", MAX_LOGS);
+                return 1;
+            }
+            attach_names[attach_count++] = argv[++i];
+        } else if (strcmp(argv[i], "-j") == 0 || strcmp(argv[i], "--udp") == 0) {
+            udp_port = UDP_DEFAULT_PORT;
+            if (i + 1 < argc && isdigit((unsigned char)argv[i + 1][0])) {
+                udp_port = parse_udp_port(argv[++i]);
+                if (udp_port == 0) {
+                    fprintf(stderr, "The UDP port must be a number from 1 to 65535.\n");
+                    return 1;
+                }
+            }
+        } else if (strcmp(argv[i], "-r") == 0 || strcmp(argv[i], "--rig") == 0) {
+            rig_address = i + 1 < argc && argv[i + 1][0] != '-' ? argv[++i] : RIG_DEFAULT_ADDRESS;
+        } else if ((strcmp(argv[i], "-t") == 0 || strcmp(argv[i], "--threads") == 0) && i + 1 < argc) {
+            export_threads = atoi(argv[++i]);
+            if (export_threads < 1 || export_threads > EXPORT_MAX_THREADS) {
+                fprintf(stderr, "The number of export threads must be from 1 to %d.\n", EXPORT_MAX_THREADS);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--daemon") == 0) {
+            daemon_address = i + 1 < argc && argv[i + 1][0] != '-' ? argv[++i] : DAEMON_DEFAULT_ADDRESS;
+        } else if (strcmp(argv[i], "--connect") == 0) {
+            connect_address = i + 1 < argc && argv[i + 1][0] != '-' ? argv[++i] : DAEMON_DEFAULT_ADDRESS;
+        } else if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
+            display_usage(argv[0]);
+            return 0;
+        } else {
+            fprintf(stderr, "Unknown option '%s'.\n", argv[i]);
+            display_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (daemon_address && (connect_address || batch_mode || udp_port || rig_address)) {
+        fprintf(stderr, "The daemon runs on its own: --daemon can't be used with --connect, -b, -j or -r.\n");
+        return 1;
+    }
 
     // Initialize a Contact structure with default values
-    Contact current_contact = {"", "", "", "", "", "", "", "", 0};
+    Contact current_contact = {"", "", "", "", "", "", "", "", 0, "", "", 0, 0, "", "", 0};
     get_current_date(current_contact.contact_date, sizeof(current_contact.contact_date));
     get_current_time(current_contact.contact_time, sizeof(current_contact.contact_time));
 
-    display_title();
+    if (!batch_mode) {
+        display_title();
+    }
 
-    // Initialize the SQLite database
-    const char *db_name = "contacts_logger.db";
-    if (initialize_database(db_name) != SQLITE_OK) {
-        fprintf(stderr, "Failed to initialize the database. Exiting.\n");
+    // Open the session that stays connected for the life of the program.  A position doesn't
+    // have a log of its own: it reads the daemon's, which only the daemon writes.
+    LoggerSession session;
+    if (connect_address) {
+        if (open_position_session(&session, connect_address) != 0) {
+            fprintf(stderr, "Failed to connect to the logging daemon. Exiting.\n");
+            return 1;
+        }
+    } else {
+        if (initialize_database(db_name) != SQLITE_OK) {
+            fprintf(stderr, "Failed to initialize the database. Exiting.\n");
+            return 1;
+        }
+        if (open_session(&session, db_name) != SQLITE_OK) {
+            fprintf(stderr, "Failed to open the database. Exiting.\n");
+            return 1;
+        }
+    }
+    if (export_threads > 0) {
+        session.export_threads = export_threads;
+    }
+    load_country_file_at_startup(&session.countries);
+    build_partial_index(&session, access(SCP_FILE, R_OK) == 0 ? SCP_FILE : NULL);
+    for (int i = 0; i < attach_count; i++) {
+        if (attach_log(&session, attach_names[i]) != SQLITE_OK) {
+            fprintf(stderr, "Failed to open log '%s'. Exiting.\n", attach_names[i]);
+            close_session(&session);
+            return 1;
+        }
+    }
+    if (daemon_address) {
+        int rc = run_daemon(&session, daemon_address);
+        close_session(&session);
+        return rc == 0 ? 0 : 1;
+    }
+    if (connect_address && connect_to_daemon(&session) != 0) {
+        fprintf(stderr, "Failed to connect to the logging daemon. Exiting.\n");
+        close_session(&session);
         return 1;
     }
+    if (udp_port && start_udp_listener(&session, udp_port) == 0) {
+        reader.wake_fd = session.udp->wake_fds[0];
+    }
+    if (rig_address) {
+        start_rig_poller(&session, rig_address);
+    }
+    session.batch_mode = batch_mode;
+    long long batch_started_us = monotonic_us();
+    int timed_command = 0;          // Command being timed, until the next one starts
+    long long command_started_us = 0;
 
     while (running) {
-        display_current_contact(&current_contact);
-        printf("> ");
-        if (fgets(input, INPUT_BUFFER_SIZE, stdin) == NULL) {
-            continue; // Handle EOF or empty input
+        if (show_prompt && !batch_mode) {
+            long long display_started_us = monotonic_us();
+            apply_rig_state(&session, &current_contact);
+            display_current_contact(&current_contact);
+            if (session.remote && current_contact.serial > 0) {
+                printf("Position %d, serial %lld for this QSO%s\n", session.remote->position, current_contact.serial,
+                       session.remote->connected ? "" : " (not connected to the daemon)");
+            } else if (session.remote) {
+                printf("Position %d, next serial %lld%s\n", session.remote->position, session.remote->next_serial,
+                       session.remote->connected ? "" : " (not connected to the daemon)");
+            }
+            printf("> ");
+            fflush(stdout);
+            latency_record(&session.stats.redisplay, monotonic_us() - display_started_us);
+        }
+
+        // Wait for input, but no longer than the contest mode durability window allows
+        reader.remote_fd = session.remote && session.remote->connected ? session.remote->fd : -1;
+        int status = read_input_line(&reader, input, INPUT_BUFFER_SIZE, group_commit_timeout_ms(&session));
+        if (status == 0) {
+            flush_group_commit(&session);
+            show_prompt = 0;
+            continue;
+        } else if (status == 2) {
+            // QSOs from the UDP listener; the operator's half-typed line is left alone
+            if (drain_udp_queue(&session) > 0 && !batch_mode) {
+                printf("> ");
+                fflush(stdout);
+            }
+            show_prompt = 0;
+            continue;
+        } else if (status == 3) {
+            // Dupe and serial number changes from the daemon, and QSOs logged at other positions
+            if (remote_poll(&session) > 0 && !batch_mode) {
+                printf("> ");
+                fflush(stdout);
+            }
+            show_prompt = 0;
+            continue;
+        } else if (status < 0) {
+            if (!batch_mode) {
+                printf("\n");
+            }
+            break; // End of input
         }
+        show_prompt = 1;
+        batch_lines++;
 
         // Remove trailing newline character from fgets
         size_t len = strlen(input);
@@ -452,16 +9693,31 @@ int main() {
             input[len - 1] = '\0';
         }
 
+        // The rig may have been retuned since the prompt was shown; the line's commands see where it is now
+        if (apply_rig_state(&session, &current_contact)) {
+            printf("From the rig: %s %s.\n", current_contact.frequency, current_contact.mode);
+        }
+
         // Tokenize the input line
         token = strtok(input, " ");
         while (token != NULL) {
+            // Some commands hand over to the next with continue, so each is timed up to the start of the next
+            long long now_us = monotonic_us();
+            if (timed_command) {
+                latency_record(&session.stats.commands[timed_command], now_us - command_started_us);
+            }
+            timed_command = (unsigned char)token[0] & 0x7f;
+            command_started_us = now_us;
+
             switch (token[0]) {
                 case 'a': {
                     token = strtok(NULL, " "); // Get the ID
                     if (token) {
                         int contact_id = atoi(token);
                         if (contact_id > 0) {
-                            if (delete_contact(db_name, contact_id) == SQLITE_OK) {
+                            if (delete_contact(&session, contact_id) == SQLITE_OK) {
+                                // On a position, this is once the daemon has answered that it's done
+                                printf("Contact with ID %d has been deleted.\n", contact_id);
                                 printf("Delete successful.\n");
                             } else {
                                 printf("Failed to delete contact.\n");
@@ -474,9 +9730,17 @@ int main() {
                     }
                     break;
                 }                    
+                case 'b':
+                    token = strtok(NULL, " "); // Get the award, if any
+                    display_awards(&session, token);
+                    break;
+
                 case 'c':
                     token = strtok(NULL, " ");
-                    if (token) {
+                    if (token && strchr(token, '?')) {
+                        // A fragment with wildcards is a partial check, not a callsign
+                        super_check_partial(&session, token);
+                    } else if (token) {
                         // Convert the callsign to uppercase
                         for (int i = 0; token[i] != '\0'; i++) {
                             token[i] = toupper(token[i]);
@@ -486,6 +9750,13 @@ int main() {
                         strncpy(current_contact.callsign_worked, token, sizeof(current_contact.callsign_worked) - 1);
                         current_contact.callsign_worked[sizeof(current_contact.callsign_worked) - 1] = '\0';
                         printf("Callsign set to '%s'.\n", current_contact.callsign_worked);
+                        if (session.remote && current_contact.id == 0 && current_contact.serial == 0) {
+                            remote_reserve_serial(&session, &current_contact); // What's sent is what's logged
+                        }
+                        lookup_country(&session.countries, current_contact.callsign_worked, &current_contact);
+                        display_dupe_status(&session, &current_contact);
+                        display_award_status(&session, &current_contact);
+                        display_contest_qso(&session, &current_contact);
                     } else {
                         printf("Error: Callsign not provided.\n");
                         token = NULL;
@@ -553,13 +9824,18 @@ int main() {
                 case 'e': {
                     token = strtok(NULL, " "); // Get the filename
                     if (token) {
-                        if (export_contacts(db_name, token) == SQLITE_OK) {
+                        char *file_name = token, filters[INPUT_BUFFER_SIZE];
+                        token = take_view_params(filters, sizeof(filters));
+                        if (export_contacts(&session, file_name, filters) == SQLITE_OK) {
                             printf("Export successful.\n");
                         } else {
                             printf("Export failed.\n");
                         }
+                        if (token) {
+                            continue; // The word after the search terms is the next command
+                        }
                     } else {
-                        printf("Error: No filename provided. Usage: e <filename>\n");
+                        printf("Error: No filename provided. Usage: e <filename> [search terms]\n");
                     }
                     break;
                 }
@@ -569,99 +9845,177 @@ int main() {
                     if (token) {
                         strncpy(current_contact.frequency, token, sizeof(current_contact.frequency) - 1);
                         current_contact.frequency[sizeof(current_contact.frequency) - 1] = '\0';
-                        printf("Frequency set to '%s'.\n", current_contact.frequency);
+                        long long hz = parse_frequency_hz(current_contact.frequency, strlen(current_contact.frequency));
+                        const char *band = band_for_hz(hz);
+                        if (hz <= 0) {
+                            printf("Frequency set to '%s' (warning: not a frequency the logger can read).\n", current_contact.frequency);
+                        } else {
+                            printf("Frequency set to '%s' (%.6g MHz, %s).\n", current_contact.frequency, hz / 1e6, band ? band : "out of band");
+                        }
+                        if (current_contact.callsign_worked[0]) {
+                            display_dupe_status(&session, &current_contact);
+                        }
                     } else {
                         printf("Error: Frequency not provided.\n");
                     }
                     break;
+                case 'g': {
+                    token = strtok(NULL, " "); // Get the filename
+                    if (token && session.remote) {
+                        printf("Error: Imports write the log file directly; run them with the daemon stopped.\n");
+                    } else if (token) {
+                        if (import_adif(&session, token) == SQLITE_OK) {
+                            printf("Import successful.\n");
+                        } else {
+                            printf("Import failed.\n");
+                        }
+                    } else {
+                        printf("Error: No filename provided. Usage: g <filename>\n");
+                    }
+                    break;
+                }
+
                 case 'h':
                     display_help();
                     break;
 
+                case '/': {
+                    // The words can follow the slash directly (/4-square) or after a space
+                    char words[INPUT_BUFFER_SIZE];
+                    char *rest = strtok(NULL, "");
+                    snprintf(words, sizeof(words), "%s%s%s", token + 1, token[1] && rest ? " " : "", rest ? rest : "");
+                    search_notes(&session, words);
+                    break;
+                }
 
+                case 'q': {
+                    token = strtok(NULL, " "); // Get the filename
+                    if (token && session.remote) {
+                        printf("Error: Imports write the log file directly; run them with the daemon stopped.\n");
+                    } else if (token) {
+                        // The time window is taken only if the next word is all a number of minutes;
+                        // otherwise it's the next command
+                        char *file_name = token, *end;
+                        int window = QSL_MATCH_MINUTES;
+                        token = strtok(NULL, " ");
+                        if (token) {
+                            errno = 0;
+                            long minutes = strtol(token, &end, 10);
+                            if (errno == 0 && end != token && *end == '\0' && minutes > 0 && minutes <= INT_MAX) {
+                                window = (int)minutes;
+                                token = NULL;
+                            }
+                        }
+                        if (import_confirmations(&session, file_name, window) != SQLITE_OK) {
+                            printf("Confirmation import failed.\n");
+                        }
+                        if (token) {
+                            continue;
+                        }
+                    } else {
+                        printf("Error: No filename provided. Usage: q <filename> [minutes]\n");
+                    }
+                    break;
+                }
 
-case 'i': {
-    token = strtok(NULL, " "); // Get the filename
-    if (token) {
-        FILE *file = fopen(token, "w");
-        if (!file) {
-            printf("Error: Unable to open file '%s' for writing.\n", token);
-            break;
-        }
-
-        // Open the database
-        sqlite3 *db;
-        sqlite3_stmt *stmt;
-        const char *sql = "SELECT callsign, frequency, mode, sent_report, received_report, date_time, comment FROM contacts";
-        if (sqlite3_open(db_name, &db) != SQLITE_OK) {
-            fprintf(stderr, "Error: Cannot open database: %s\n", sqlite3_errmsg(db));
-            fclose(file);
-            break;
-        }
-
-        if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK) {
-            fprintf(stderr, "Error: Failed to prepare SQL statement: %s\n", sqlite3_errmsg(db));
-            sqlite3_close(db);
-            fclose(file);
-            break;
-        }
-
-        // Write ADIF header
-        fprintf(file, "<ADIF_VER:5>3.1.2\n");
-        fprintf(file, "PROGRAMID:OSL\n");
-        fprintf(file, "PROGRAMVERSION:%s\n\n", CODE_VERSION);
-
-        // Process each row and write in ADIF format
-        while (sqlite3_step(stmt) == SQLITE_ROW) {
-            const char *callsign = (const char *)sqlite3_column_text(stmt, 0);
-            const char *frequency = (const char *)sqlite3_column_text(stmt, 1);
-            const char *mode = (const char *)sqlite3_column_text(stmt, 2);
-            const char *sent_report = (const char *)sqlite3_column_text(stmt, 3);
-            const char *received_report = (const char *)sqlite3_column_text(stmt, 4);
-            const char *date_time = (const char *)sqlite3_column_text(stmt, 5);
-            const char *comment = (const char *)sqlite3_column_text(stmt, 6);
-
-            // Parse date_time to extract date (YYYYMMDD) and time (HHMM)
-            char date[9] = "";
-            char time[5] = "";
-            int year, month, day, hour, minute;
-            if (sscanf(date_time, "%4d-%2d-%2d %2d:%2d", &year, &month, &day, &hour, &minute) == 5) {
-                snprintf(date, sizeof(date), "%04d%02d%02d", year, month, day); // Format as YYYYMMDD
-                snprintf(time, sizeof(time), "%02d%02d", hour, minute);         // Format as HHMM
-            } else {
-                printf("Error: Invalid date_time format in database: '%s'\n", date_time);
-                continue;
-            }
-
-            // Write ADIF entry
-            fprintf(file,
-                    "<QSO_DATE:8>%s <TIME_ON:4>%s <CALL:%d>%s "
-                    "<MODE:%d>%s "
-                    "<RST_SENT:%d>%s <RST_RCVD:%d>%s <COMMENT:%d>%s <EOR>\n",
-                    date,
-                    time,
-                    (int)strlen(callsign), callsign,
-                    (int)strlen(mode), mode,
-                    (int)strlen(sent_report), sent_report,
-                    (int)strlen(received_report), received_report,
-                    comment ? (int)strlen(comment) : 0, comment ? comment : "");
-        }
-
+                case 'i': {
+                    token = strtok(NULL, " "); // Get the filename
+                    if (token) {
+                        char *file_name = token, filters[INPUT_BUFFER_SIZE];
+                        token = take_view_params(filters, sizeof(filters));
+                        if (export_adif(&session, file_name, filters) != SQLITE_OK) {
+                            printf("Error: ADIF export to '%s' failed.\n", file_name);
+                        }
+                        if (token) {
+                            continue; // The word after the search terms is the next command
+                        }
+                    } else {
+                        printf("Error: No filename provided. Usage: i <filename> [search terms]\n");
+                    }
+                    break;
+                }
 
-        sqlite3_finalize(stmt);
-        sqlite3_close(db);
-        fclose(file);
-        printf("Database exported to '%s' in ADIF format.\n", token);
-    } else {
-        printf("Error: No filename provided. Usage: i <filename>\n");
-    }
-    break;
-}
+                case 'j': {
+                    token = strtok(NULL, " ");
+                    if (token == NULL) {
+                        display_udp_status(&session);
+                    } else if (strcmp(token, "on") == 0) {
+                        char *port = strtok(NULL, " ");
+                        int port_number = port ? parse_udp_port(port) : UDP_DEFAULT_PORT;
+                        if (port_number == 0) {
+                            printf("Error: Invalid port '%s'. The port must be a number from 1 to 65535.\n", port);
+                        } else if (start_udp_listener(&session, port_number) == 0) {
+                            reader.wake_fd = session.udp->wake_fds[0];
+                        }
+                    } else if (strcmp(token, "off") == 0) {
+                        if (session.udp) {
+                            display_udp_status(&session);
+                            stop_udp_listener(&session);
+                            printf("UDP listener stopped.\n");
+                        }
+                        reader.wake_fd = -1;
+                    } else {
+                        printf("Error: Unknown option '%s'. Usage: j, j on [port], j off\n", token);
+                    }
+                    break;
+                }
 
+                case 'k': {
+                    token = strtok(NULL, " ");
+                    if (!token) {
+                        display_contest_status(&session);
+                    } else if (strcmp(token, "on") == 0) {
+                        if (set_contest_mode(&session, 1) == SQLITE_OK) {
+                            printf("Contest mode on.\n");
+                            display_contest_status(&session);
+                        }
+                    } else if (strcmp(token, "off") == 0) {
+                        if (session.contest_mode) {
+                            display_contest_status(&session);
+                        }
+                        if (set_contest_mode(&session, 0) == SQLITE_OK) {
+                            printf("Contest mode off.\n");
+                        }
+                    } else if (strcmp(token, "sync") == 0) {
+                        token = strtok(NULL, " ");
+                        if (token) {
+                            for (int i = 0; token[i] != '\0'; i++) {
+                                token[i] = toupper(token[i]);
+                            }
+                        }
+                        if (token && (strcmp(token, "OFF") == 0 || strcmp(token, "NORMAL") == 0 || strcmp(token, "FULL") == 0)) {
+                            snprintf(session.synchronous, sizeof(session.synchronous), "%s", token);
+                            if (session.contest_mode) {
+                                set_contest_mode(&session, 1);
+                            }
+                            printf("Contest mode synchronous set to '%s'.\n", session.synchronous);
+                        } else {
+                            printf("Error: Usage: k sync OFF|NORMAL|FULL\n");
+                        }
+                    } else if (strcmp(token, "batch") == 0) {
+                        char *qsos = strtok(NULL, " ");
+                        char *ms = qsos ? strtok(NULL, " ") : NULL;
+                        if (qsos && ms && atoi(qsos) > 0 && atoi(ms) > 0) {
+                            session.group_commit_qsos = atoi(qsos);
+                            session.group_commit_ms = atoi(ms);
+                            printf("Group commit set to every %d QSOs or %d ms.\n", session.group_commit_qsos, session.group_commit_ms);
+                        } else {
+                            printf("Error: Usage: k batch <QSOs> <ms>\n");
+                        }
+                    } else {
+                        printf("Error: Unknown contest mode option '%s'.\n", token);
+                    }
+                    break;
+                }
 
                 case 'l':
-                    if (log_contact(db_name, &current_contact) == SQLITE_OK) {
-                        printf("Contact has been logged to the database.\n");
+                    if (log_contact(&session, &current_contact) == SQLITE_OK) {
+                        if (!session.remote) {
+                            printf("Contact has been logged to the database.\n"); // A position has said so with its ID and serial
+                        }
+                        if (!batch_mode) {
+                            display_contest_summary(&session);
+                        }
 
                         // Preserve frequency, mode, and date as defaults
                         char previous_frequency[20];
@@ -673,7 +10027,7 @@ case 'i': {
                         strncpy(previous_date, current_contact.contact_date, sizeof(previous_date));
 
                         // Reset current_contact but keep preserved defaults
-                        current_contact = (Contact){"", "", "", "", "", "", "", "", 0};
+                        current_contact = (Contact){"", "", "", "", "", "", "", "", 0, "", "", 0, 0, "", "", 0};
                         strncpy(current_contact.frequency, previous_frequency, sizeof(current_contact.frequency));
                         strncpy(current_contact.mode, previous_mode, sizeof(current_contact.mode));
                         strncpy(current_contact.contact_date, previous_date, sizeof(current_contact.contact_date));
@@ -695,6 +10049,9 @@ case 'i': {
                             current_contact.mode[i] = toupper(current_contact.mode[i]);
                         }
                         printf("Mode set to '%s'.\n", current_contact.mode);
+                        if (current_contact.callsign_worked[0]) {
+                            display_dupe_status(&session, &current_contact);
+                        }
                     } else {
                         printf("Error: Mode not provided.\n");
                     }
@@ -741,12 +10098,23 @@ case 'i': {
                     }
                     break;
                 }
+                case 'p':
+                    token = strtok(NULL, " ");
+                    if (token) {
+                        super_check_partial(&session, token);
+                    } else {
+                        printf("%u callsigns available for partial checks.\n",
+                               session.partials.call_count + (unsigned int)session.partials.recent_count);
+                    }
+                    break;
+
                 case 'r':
                     token = strtok(NULL, " ");
                     if (token) {
                         strncpy(current_contact.received_report, token, sizeof(current_contact.received_report) - 1);
                         current_contact.received_report[sizeof(current_contact.received_report) - 1] = '\0';
                         printf("Received report set to '%s'.\n", current_contact.received_report);
+                        display_contest_qso(&session, &current_contact);
                     } else {
                         printf("Error: Received report not provided.\n");
                     }
@@ -837,7 +10205,7 @@ case 'i': {
                     if (token) {
                         int contact_id = atoi(token);
                         if (contact_id > 0) {
-                            if (load_contact(db_name, contact_id, &current_contact) == SQLITE_OK) {
+                            if (load_contact(&session, contact_id, &current_contact) == SQLITE_OK) {
                                 // Set the comment field to indicate this is an update
                                 //snprintf(current_contact.comment, sizeof(current_contact.comment), "UPDATE:%d", contact_id);
                                 current_contact.id = contact_id;
@@ -852,112 +10220,157 @@ case 'i': {
                     break;
                 }
 
+                case 'o': {
+                    token = strtok(NULL, " ");
+                    if (token && strcmp(token, "close") == 0) {
+                        token = strtok(NULL, " "); // Get the log name
+                        if (token == NULL) {
+                            printf("Error: No log name provided. Usage: o close <name>\n");
+                        } else if (detach_log(&session, token) == SQLITE_OK) {
+                            printf("Log '%s' closed.\n", token);
+                        }
+                    } else if (token && attach_log(&session, token) == SQLITE_OK) {
+                        printf("Log '%s' opened.\n", session.logs[session.log_count - 1].name);
+                    }
+                    if (token == NULL) {
+                        display_logs(&session);
+                    }
+                    break;
+                }
+
                 case 'v': {
                     token = strtok(NULL, ""); // Get the rest of the line after "v"
-                    char query[512] = "SELECT id, callsign, frequency, mode, sent_report, received_report, date_time, comment FROM contacts";
-                    int has_condition = 0;
+                    view_contacts(&session, token);
+                    break;
+                }
 
-                    if (token) {
-                        // Handle different types of parameters
-                        if (token[0] == '+') {
-                            // First N contacts
-                            int limit = atoi(token + 1);
-                            if (limit > 0) {
-                                snprintf(query + strlen(query), sizeof(query) - strlen(query), " ORDER BY id LIMIT %d", limit);
-                                has_condition = 1;
-                            } else {
-                                printf("Invalid parameter for '+N'. Showing all contacts.\n");
-                            }
-                        } else if (token[0] == '-') {
-                            // Last N contacts
-                            int limit = atoi(token + 1);
-                            if (limit > 0) {
-                                snprintf(query + strlen(query), sizeof(query) - strlen(query), " ORDER BY id DESC LIMIT %d", limit);
-                                has_condition = 1;
-                            } else {
-                                printf("Invalid parameter for '-N'. Showing all contacts.\n");
-                            }
-                        } else if (strchr(token, '-')) {
-                            // Range of IDs
-                            int start_id, end_id;
-                            if (sscanf(token, "%d-%d", &start_id, &end_id) == 2 && start_id > 0 && end_id >= start_id) {
-                                snprintf(query + strlen(query), sizeof(query) - strlen(query),
-                                         " WHERE id BETWEEN %d AND %d ORDER BY id", start_id, end_id);
-                                has_condition = 1;
-                            } else {
-                                printf("Invalid range for 'ID-Range'. Showing all contacts.\n");
-                            }
-                        } else if (isdigit(token[0])) {
-                            // Single ID
-                            int id = atoi(token);
-                            if (id > 0) {
-                                snprintf(query + strlen(query), sizeof(query) - strlen(query), " WHERE id = %d ORDER BY id", id);
-                                has_condition = 1;
-                            } else {
-                                printf("Invalid parameter for 'ID'. Showing all contacts.\n");
-                            }
-                        } else {
-                            printf("Unknown parameter. Showing all contacts.\n");
+                case 'R': {
+                    token = strtok(NULL, " ");
+                    if (token == NULL) {
+                        display_rig_status(&session);
+                    } else if (strcmp(token, "on") == 0) {
+                        char *address = strtok(NULL, " ");
+                        start_rig_poller(&session, address ? address : RIG_DEFAULT_ADDRESS);
+                    } else if (strcmp(token, "off") == 0) {
+                        if (session.rig) {
+                            display_rig_status(&session);
+                            stop_rig_poller(&session);
+                            printf("Rig polling stopped.\n");
                         }
+                    } else {
+                        printf("Error: Unknown option '%s'. Usage: R, R on [host:port], R off\n", token);
                     }
+                    break;
+                }
 
-                    // Add a default ORDER BY clause if no specific condition was provided
-                    if (!has_condition) {
-                        snprintf(query + strlen(query), sizeof(query) - strlen(query), " ORDER BY id");
+                case 'K': {
+                    token = strtok(NULL, " ");
+                    if (token == NULL) {
+                        display_contest_score(&session);
+                    } else if (strcmp(token, "off") == 0) {
+                        if (session.contest) {
+                            display_contest_score(&session);
+                            stop_contest_scoring(&session);
+                            printf("Contest scoring stopped.\n");
+                        }
+                    } else {
+                        char *station = strtok(NULL, " ");
+                        char *date = station ? strtok(NULL, " ") : NULL;
+                        char *time = date ? strtok(NULL, " ") : NULL;
+                        if (station) {
+                            start_contest_scoring(&session, token, station, date, time);
+                        } else {
+                            printf("Error: Usage: K <contest> <your call> [YYYY-MM-DD [HH:MM]], K, K off\n");
+                        }
                     }
+                    break;
+                }
 
-                    // Execute the query
-                    sqlite3 *db;
-                    sqlite3_stmt *stmt;
-                    int rc = sqlite3_open(db_name, &db);
-                    if (rc != SQLITE_OK) {
-                        fprintf(stderr, "Cannot open database: %s\n", sqlite3_errmsg(db));
-                        break;
+                case 'C': {
+                    token = strtok(NULL, " "); // Get the filename
+                    if (token) {
+                        if (export_cabrillo(&session, token) != SQLITE_OK) {
+                            printf("Error: Cabrillo export to '%s' failed.\n", token);
+                        }
+                    } else {
+                        printf("Error: No filename provided. Usage: C <filename>\n");
                     }
+                    break;
+                }
 
-                    printf("Executing query: %s\n", query); // Debugging line to check the query
-
-                    rc = sqlite3_prepare_v2(db, query, -1, &stmt, NULL);
-                    if (rc != SQLITE_OK) {
-                        fprintf(stderr, "Failed to prepare statement: %s\n", sqlite3_errmsg(db));
-                        sqlite3_close(db);
-                        break;
+                case 'A': {
+                    token = strtok(NULL, " "); // Get the filename, or load or scan
+                    char *archive_file = NULL;
+                    if (token && (strcmp(token, "load") == 0 || strcmp(token, "scan") == 0)) {
+                        archive_file = strtok(NULL, " "); // Only these two take a second word
                     }
+                    if (token && strcmp(token, "load") == 0 && archive_file) {
+                        if (session.remote) {
+                            printf("Error: Archives load into the log file directly; load them with the daemon stopped.\n");
+                        } else if (restore_archive(&session, archive_file) != SQLITE_OK) {
+                            printf("Error: Loading the archive '%s' failed.\n", archive_file);
+                        }
+                    } else if (token && strcmp(token, "scan") == 0 && archive_file) {
+                        scan_archive(archive_file);
+                    } else if (token && strcmp(token, "load") != 0 && strcmp(token, "scan") != 0) {
+                        if (archive_log(&session, token) != SQLITE_OK) {
+                            printf("Error: Archiving the log to '%s' failed.\n", token);
+                        }
+                    } else {
+                        printf("Error: Usage: A <filename>, A load <filename> or A scan <filename>\n");
+                    }
+                    break;
+                }
 
-                    printf("\nLogged Contacts:\n");
-                    printf("| ID | Call Sign  | Frequency | Mode | Sent Rpt  | Recv Rpt  | Date/Time         | Notes \n");
-
-                    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
-                        int id = sqlite3_column_int(stmt, 0);
-                        const char *callsign = (const char *)sqlite3_column_text(stmt, 1);
-                        const char *frequency = (const char *)sqlite3_column_text(stmt, 2);
-                        const char *mode = (const char *)sqlite3_column_text(stmt, 3);
-                        const char *sent_report = (const char *)sqlite3_column_text(stmt, 4);
-                        const char *received_report = (const char *)sqlite3_column_text(stmt, 5);
-                        const char *date_time = (const char *)sqlite3_column_text(stmt, 6);
-                        const char *comment = (const char *)sqlite3_column_text(stmt, 7);
+                case 'T': {
+                    token = strtok(NULL, ""); // Get the rest of the line after "T"
+                    display_statistics(&session, token);
+                    break;
+                }
 
-                        printf("| %-2d | %-10s | %-9s | %-4s | %-9s | %-9s | %-17s | %-12s \n",
-                               id, callsign ? callsign : "",
-                               frequency ? frequency : "",
-                               mode ? mode : "",
-                               sent_report ? sent_report : "",
-                               received_report ? received_report : "",
-                               date_time ? date_time : "",
-                               comment ? comment : "");
+                case 'z': {
+                    token = strtok(NULL, " "); // Get the filename
+                    const char *text_file = token ? token : CTY_TEXT_FILE;
+                    if (build_country_image(text_file, CTY_IMAGE_FILE) == 0 &&
+                        load_country_image(&session.countries, CTY_IMAGE_FILE) == 0) {
+                        printf("Country file loaded.\n");
+                        lookup_country(&session.countries, current_contact.callsign_worked, &current_contact);
+                    } else {
+                        printf("Failed to load country file '%s'.\n", text_file);
                     }
+                    break;
+                }
 
-
-                    if (rc != SQLITE_DONE) {
-                        fprintf(stderr, "Failed to retrieve contacts: %s\n", sqlite3_errmsg(db));
+                case 'w':
+                    token = strtok(NULL, " ");
+                    if (token && strcmp(token, "reset") == 0) {
+                        reset_stats(&session);
+                        timed_command = 0; // Don't count the reset itself
+                        printf("Statistics reset.\n");
+                    } else {
+                        display_stats(&session);
                     }
+                    break;
 
-                    sqlite3_finalize(stmt);
-                    sqlite3_close(db);
+                case 'y':
+                    token = strtok(NULL, " ");
+                    if (token) {
+                        snprintf(current_contact.state, sizeof(current_contact.state), "%s", token);
+                        for (int i = 0; current_contact.state[i] != '\0'; i++) {
+                            current_contact.state[i] = toupper((unsigned char)current_contact.state[i]);
+                        }
+                        printf("State set to '%s'.\n", current_contact.state);
+                        display_award_status(&session, &current_contact);
+                    } else {
+                        printf("Error: State not provided.\n");
+                    }
                     break;
-                }
 
                 case 'x':
+                    if (session.contest_mode) {
+                        display_contest_status(&session);
+                    }
+                    flush_group_commit(&session);
                     printf("Exiting the program.\n");
                     running = 0;
                     break;
@@ -967,8 +10380,27 @@ case 'i': {
 
             token = strtok(NULL, " "); // Move to the next token
         }
+        if (timed_command) {
+            latency_record(&session.stats.commands[timed_command], monotonic_us() - command_started_us);
+            timed_command = 0;
+        }
     }
 
-    return 0;
-}
+    // The script's transaction is committed here, at x or the end of the input
+    int exit_code = 0;
+    if (batch_mode) {
+        int rc = flush_group_commit(&session);
+        exit_code = rc == SQLITE_OK ? 0 : 1;
+        double seconds = (monotonic_us() - batch_started_us) / 1e6;
+        printf("Batch: %lld lines, %lld contacts written in %.2f s (%.0f lines/sec)%s.\n",
+               batch_lines, session.batch_writes, seconds, seconds > 0 ? batch_lines / seconds : 0.0,
+               rc == SQLITE_OK ? "" : ", commit FAILED");
+        if (reader.fd != STDIN_FILENO) {
+            close(reader.fd);
+        }
+    }
 
+    close_session(&session);
+    return exit_code;
+}
+#endif
@@ -0,0 +1,231 @@
+/*
+
+  Old School Command Line Logger - WSJT-X test sender
+
+  Stands in for WSJT-X (or JTDX) when trying out the logger's UDP listener:
+  sends made-up FT8 and FT4 QSOs the way WSJT-X reports them, as a
+  "QSO logged" message followed by the same QSO as ADIF, along with the
+  heartbeats and status messages the logger should ignore.
+
+  How to compile:
+
+  gcc -O2 wsjtx_sender.c -o wsjtx_sender
+
+  How to run (with ./logger -j or 'j on' listening):
+
+  ./wsjtx_sender [-p port] [-n QSOs] [-r QSOs per second] [-q|-a]
+
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#define SENDER_DEFAULT_PORT 2237
+#define SENDER_ID "WSJT-X"
+#define WSJTX_MAGIC 0xadbccbdaU
+#define WSJTX_SCHEMA 2
+
+// A datagram being encoded in Qt's QDataStream format (big-endian)
+typedef struct {
+    unsigned char data[2048];
+    size_t used;
+} Packet;
+
+static unsigned long long sender_state = 88172645463325252ULL;
+
+// Function to get the next pseudo-random number (xorshift64)
+static unsigned long long sender_random(void) {
+    sender_state ^= sender_state << 13;
+    sender_state ^= sender_state >> 7;
+    sender_state ^= sender_state << 17;
+    return sender_state;
+}
+
+// Function to append a big-endian unsigned integer of 1 to 8 bytes
+static void put_uint(Packet *packet, unsigned long long value, int bytes) {
+    for (int i = bytes - 1; i >= 0; i--) {
+        packet->data[packet->used++] = (unsigned char)(value >> (i * 8));
+    }
+}
+
+// Function to append a Qt utf8 string: a byte count, then the bytes
+static void put_string(Packet *packet, const char *text) {
+    size_t length = strlen(text);
+    put_uint(packet, length, 4);
+    memcpy(packet->data + packet->used, text, length);
+    packet->used += length;
+}
+
+// Function to append a QDateTime in UTC from seconds since 1970
+static void put_date_time(Packet *packet, long long epoch) {
+    put_uint(packet, (unsigned long long)(epoch / 86400 + 2440588), 8); // Julian day
+    put_uint(packet, (unsigned long long)(epoch % 86400) * 1000, 4);    // Milliseconds since midnight
+    put_uint(packet, 1, 1);                                             // Qt::UTC
+}
+
+// Function to start a message: magic number, schema, message type and the sender's id
+static void put_header(Packet *packet, int type) {
+    packet->used = 0;
+    put_uint(packet, WSJTX_MAGIC, 4);
+    put_uint(packet, WSJTX_SCHEMA, 4);
+    put_uint(packet, (unsigned long long)type, 4);
+    put_string(packet, SENDER_ID);
+}
+
+// Function to send a finished message
+static int send_packet(int fd, const struct sockaddr_in *address, const Packet *packet) {
+    return sendto(fd, packet->data, packet->used, 0, (const struct sockaddr *)address, sizeof(*address)) ==
+           (ssize_t)packet->used ? 0 : -1;
+}
+
+int main(int argc, char *argv[]) {
+    static const char *prefixes[] = { "K", "W", "N", "AA", "KB", "VE", "DL", "G", "F", "JA", "VK", "PY", "EA", "I" };
+    static const long long dials[] = { 1840000, 3573000, 7074000, 10136000, 14074000, 18100000, 21074000, 28074000 };
+    int port = SENDER_DEFAULT_PORT;
+    long count = 10;
+    double rate = 0;
+    int send_logged = 1, send_adif = 1;
+
+    // Handle the command line options
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+            port = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            count = atol(argv[++i]);
+        } else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            rate = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-q") == 0) {
+            send_adif = 0;
+        } else if (strcmp(argv[i], "-a") == 0) {
+            send_logged = 0;
+        } else {
+            fprintf(stderr, "Usage: %s [-p port] [-n QSOs] [-r QSOs per second] [-q|-a]\n", argv[0]);
+            fprintf(stderr, "  -p  UDP port on this machine to send to (default %d)\n", SENDER_DEFAULT_PORT);
+            fprintf(stderr, "  -n  Number of QSOs to send (default 10)\n");
+            fprintf(stderr, "  -r  QSOs per second (default: as fast as possible)\n");
+            fprintf(stderr, "  -q  Send only the \"QSO logged\" message for each QSO\n");
+            fprintf(stderr, "  -a  Send only the ADIF message for each QSO\n");
+            return 1;
+        }
+    }
+
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) {
+        perror("socket");
+        return 1;
+    }
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons((unsigned short)port);
+
+    // A heartbeat first, as WSJT-X sends when it starts: type 0, max schema, version, revision
+    Packet packet;
+    put_header(&packet, 0);
+    put_uint(&packet, 3, 4);
+    put_string(&packet, "2.6.1");
+    put_string(&packet, "");
+    send_packet(fd, &address, &packet);
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    long long now = (long long)time(NULL);
+    long sent = 0, failed = 0;
+
+    for (long n = 0; n < count; n++) {
+        // Pace the QSOs if a rate was given
+        if (rate > 0) {
+            struct timespec due = start;
+            double offset = n / rate;
+            due.tv_sec += (time_t)offset;
+            due.tv_nsec += (long)((offset - (time_t)offset) * 1e9);
+            if (due.tv_nsec >= 1000000000L) {
+                due.tv_sec++;
+                due.tv_nsec -= 1000000000L;
+            }
+            clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, NULL);
+        }
+
+        char call[16], grid[8], sent_report[8], received_report[8], adif[512];
+        const char *prefix = prefixes[sender_random() % (sizeof(prefixes) / sizeof(prefixes[0]))];
+        snprintf(call, sizeof(call), "%s%d%c%c%c", prefix, (int)(sender_random() % 10),
+                 'A' + (int)(sender_random() % 26), 'A' + (int)(sender_random() % 26), 'A' + (int)(sender_random() % 26));
+        snprintf(grid, sizeof(grid), "%c%c%d%d", 'A' + (int)(sender_random() % 18), 'A' + (int)(sender_random() % 18),
+                 (int)(sender_random() % 10), (int)(sender_random() % 10));
+        snprintf(sent_report, sizeof(sent_report), "%+03d", (int)(sender_random() % 30) - 24);
+        snprintf(received_report, sizeof(received_report), "%+03d", (int)(sender_random() % 30) - 24);
+        const char *mode = sender_random() % 4 ? "FT8" : "FT4";
+        long long hz = dials[sender_random() % (sizeof(dials) / sizeof(dials[0]))] + 200 + (long long)(sender_random() % 2800);
+
+        // Each QSO a minute after the last, ending now
+        long long time_on = now - (count - n) * 60;
+        long long time_off = time_on + 45;
+
+        // A status message in between, which the logger should ignore: type 1, dial frequency, mode, DX call
+        put_header(&packet, 1);
+        put_uint(&packet, (unsigned long long)(hz - hz % 1000), 8);
+        put_string(&packet, mode);
+        put_string(&packet, call);
+        send_packet(fd, &address, &packet);
+
+        if (send_logged) {
+            // QSO logged: type 5
+            put_header(&packet, 5);
+            put_date_time(&packet, time_off);
+            put_string(&packet, call);
+            put_string(&packet, grid);
+            put_uint(&packet, (unsigned long long)hz, 8);
+            put_string(&packet, mode);
+            put_string(&packet, sent_report);
+            put_string(&packet, received_report);
+            put_string(&packet, "100");
+            put_string(&packet, n % 5 == 0 ? "test QSO from wsjtx_sender" : "");
+            put_string(&packet, "");
+            put_date_time(&packet, time_on);
+            put_string(&packet, "");
+            put_string(&packet, "K3NG");
+            put_string(&packet, "FM19");
+            if (send_packet(fd, &address, &packet) != 0) {
+                failed++;
+            }
+        }
+
+        if (send_adif) {
+            // Logged ADIF: type 12, the same QSO as an ADIF file with one record
+            time_t t = (time_t)time_on;
+            struct tm utc;
+            char qso_date[16], qso_time[16], mhz[32];
+            gmtime_r(&t, &utc);
+            strftime(qso_date, sizeof(qso_date), "%Y%m%d", &utc);
+            strftime(qso_time, sizeof(qso_time), "%H%M%S", &utc);
+            snprintf(mhz, sizeof(mhz), "%lld.%06lld", hz / 1000000, hz % 1000000);
+            snprintf(adif, sizeof(adif),
+                     "\n<adif_ver:5>3.1.0\n<programid:6>WSJT-X\n<EOH>\n"
+                     "<call:%zu>%s <gridsquare:%zu>%s <mode:%zu>%s <rst_sent:%zu>%s <rst_rcvd:%zu>%s "
+                     "<qso_date:8>%s <time_on:6>%s <freq:%zu>%s <station_callsign:4>K3NG <EOR>",
+                     strlen(call), call, strlen(grid), grid, strlen(mode), mode, strlen(sent_report), sent_report,
+                     strlen(received_report), received_report, qso_date, qso_time, strlen(mhz), mhz);
+            put_header(&packet, 12);
+            put_string(&packet, adif);
+            if (send_packet(fd, &address, &packet) != 0) {
+                failed++;
+            }
+        }
+        sent++;
+    }
+
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    printf("Sent %ld QSOs to UDP port %d in %.2f s (%.0f QSOs/sec), %ld sends failed.\n",
+           sent, port, seconds, seconds > 0 ? sent / seconds : 0.0, failed);
+    close(fd);
+    return 0;
+}